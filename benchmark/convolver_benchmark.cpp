@@ -0,0 +1,53 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <audio>
+
+// This benchmark measures audio_convolver at several buffer sizes, as seconds of
+// impulse response that one core can convolve in real time (for one channel at
+// 48 kHz). The tail segments are computed in the callback here, so that all the work
+// is done on one thread and counted. Build with optimisations (and e.g. -mavx2
+// -mfma) for meaningful numbers.
+
+using namespace std::experimental;
+
+constexpr double sample_rate = 48'000;
+constexpr double impulse_response_seconds = 2.0;
+constexpr double audio_seconds = 20.0;
+
+double measure_impulse_response_seconds_per_core(std::size_t buffer_size) {
+  audio_noise_generator noise(audio_noise_color::white, 1, 1);
+  std::vector<float> impulse_response(std::size_t(impulse_response_seconds * sample_rate));
+  noise.render(impulse_response.data(), impulse_response.size());
+
+  audio_convolver convolver({impulse_response}, buffer_size, 4096, false);
+
+  std::vector<float> data(buffer_size);
+  noise.render(data.data(), data.size());
+
+  const std::size_t num_buffers = std::size_t(audio_seconds * sample_rate) / buffer_size;
+  const auto start = std::chrono::steady_clock::now();
+
+  for (std::size_t i = 0; i < num_buffers; ++i) {
+    audio_buffer<float> buffer(data.data(), buffer_size, 1, contiguous_interleaved);
+    convolver.process(buffer);
+  }
+
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  const double realtime_factor = double(num_buffers * buffer_size) / sample_rate / elapsed.count();
+  return impulse_response_seconds * realtime_factor;
+}
+
+int main() {
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << "Impulse response seconds per core:\n";
+
+  for (std::size_t buffer_size : {32, 64, 128, 256, 512})
+    std::cout << "  " << std::setw(3) << buffer_size << " frames: " << std::setw(7) << measure_impulse_response_seconds_per_core(buffer_size) << "\n";
+}
@@ -0,0 +1,54 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <audio>
+
+// This benchmark measures audio_real_fft, a forward and an inverse transform per
+// iteration, in nanoseconds per iteration and in "MFLOPS" (5 n log2(n) / 2 flops per
+// real transform, the usual convention). Build with optimisations (and e.g. -mavx2
+// -mfma) for meaningful numbers.
+
+using namespace std::experimental;
+
+void measure(std::size_t size) {
+  audio_real_fft fft(size);
+  audio_noise_generator noise;
+
+  std::vector<float> x(size), re(fft.num_bins()), im(fft.num_bins());
+  noise.render(x.data(), size);
+
+  std::size_t log2_size = 0;
+  while ((std::size_t(1) << log2_size) < size)
+    ++log2_size;
+
+  const std::size_t num_iterations = 200'000'000 / (size * log2_size) + 1;
+  const auto start = std::chrono::steady_clock::now();
+
+  for (std::size_t i = 0; i < num_iterations; ++i) {
+    fft.forward(x.data(), re.data(), im.data());
+    fft.inverse(re.data(), im.data(), x.data());
+    x[0] *= 1.0f / float(size);
+  }
+
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  const double seconds_per_iteration = elapsed.count() / double(num_iterations);
+  const double flops = 2 * 2.5 * double(size) * double(log2_size);
+
+  std::cout << "  " << std::setw(5) << size << ": "
+            << std::setw(9) << seconds_per_iteration * 1e9 << " ns, "
+            << std::setw(7) << flops / seconds_per_iteration / 1e6 << " MFLOPS\n";
+}
+
+int main() {
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << "Real FFT, forward + inverse:\n";
+
+  for (std::size_t size : {64, 256, 1024, 4096, 16384})
+    measure(size);
+}
@@ -0,0 +1,70 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <audio>
+
+// This benchmark measures the throughput of audio_biquad_filter and audio_svf_filter
+// in millions of samples (frames times channels) per second, for interleaved and
+// deinterleaved buffers of 2, 8 and 64 channels with 1 and 4 cascaded sections.
+// Build with optimisations (and e.g. -mavx2 -mfma) for meaningful numbers.
+
+using namespace std::experimental;
+
+constexpr double sample_rate = 48'000;
+constexpr std::size_t block_size = 256;
+
+template <typename _FilterType>
+double measure_msamples_per_second(std::size_t num_channels, std::size_t num_sections, bool interleaved) {
+  _FilterType filter(sample_rate, num_channels, num_sections);
+  for (std::size_t section = 0; section < num_sections; ++section)
+    filter.set_section(section, audio_filter_type::bell, 100.0 * double(section + 1), 1.0, 3.0);
+
+  filter.reset();
+
+  std::vector<float> data(block_size * num_channels, 0.25f);
+  std::vector<float*> channels(num_channels);
+  for (std::size_t channel = 0; channel < num_channels; ++channel)
+    channels[channel] = data.data() + channel * block_size;
+
+  const std::size_t num_blocks = 20'000'000 / (block_size * num_channels * num_sections) + 1;
+  const auto start = std::chrono::steady_clock::now();
+
+  for (std::size_t i = 0; i < num_blocks; ++i) {
+    if (interleaved) {
+      audio_buffer<float> buffer(data.data(), block_size, num_channels, contiguous_interleaved);
+      filter.process(buffer);
+    }
+    else {
+      audio_buffer<float> buffer(channels.data(), block_size, num_channels, ptr_to_ptr_deinterleaved);
+      filter.process(buffer);
+    }
+  }
+
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return double(num_blocks * block_size * num_channels) / elapsed.count() / 1e6;
+}
+
+template <typename _FilterType>
+void run(const char* name) {
+  std::cout << name << ", MSamples/s:\n";
+  for (std::size_t num_sections : {1, 4}) {
+    for (std::size_t num_channels : {2, 8, 64}) {
+      std::cout << "  " << num_sections << (num_sections == 1 ? " section,  " : " sections, ")
+                << std::setw(2) << num_channels << " channels: "
+                << "interleaved " << std::setw(7) << measure_msamples_per_second<_FilterType>(num_channels, num_sections, true)
+                << ", deinterleaved " << std::setw(7) << measure_msamples_per_second<_FilterType>(num_channels, num_sections, false) << "\n";
+    }
+  }
+}
+
+int main() {
+  std::cout << std::fixed << std::setprecision(1);
+  run<audio_biquad_filter>("Biquad");
+  run<audio_svf_filter>("SVF");
+}
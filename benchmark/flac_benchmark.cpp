@@ -0,0 +1,114 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <audio>
+
+// This benchmark measures the FLAC encoder that audio_file_recorder uses, on one
+// core: how many megabytes of PCM it compresses per second and the compression
+// ratio (encoded size over PCM size). Pass a WAV or AIFF file to measure it on
+// recorded material; like audio_file_recorder, it encodes files with more than
+// eight channels as one stream per group of eight. Otherwise it uses synthetic
+// stereo material, a mix of decaying harmonic tones over quiet pink noise. Build
+// with optimisations for meaningful numbers.
+
+using namespace std::experimental;
+
+// Channel c of the material, as floating-point samples.
+std::vector<std::vector<float>> synthetic_material(std::size_t num_frames) {
+  constexpr double sample_rate = 48'000;
+  std::vector<std::vector<float>> channels(2, std::vector<float>(num_frames));
+  audio_noise_generator noise(audio_noise_color::pink, 2);
+
+  for (std::size_t channel = 0; channel < 2; ++channel) {
+    noise.render(channels[channel].data(), num_frames);
+    for (std::size_t frame = 0; frame < num_frames; ++frame) {
+      const double t = double(frame) / sample_rate;
+      const double note_time = std::fmod(t, 0.5);
+      const double pitch = 110.0 * std::pow(2.0, double((frame / 24'000) % 12) / 12);
+
+      double tone = 0;
+      for (int harmonic = 1; harmonic <= 6; ++harmonic)
+        tone += std::sin(2 * 3.14159265358979 * pitch * harmonic * t + 0.3 * double(channel)) / harmonic;
+
+      channels[channel][frame] = float(0.3 * tone * std::exp(-4 * note_time)) + 0.01f * channels[channel][frame];
+    }
+  }
+
+  return channels;
+}
+
+std::vector<std::vector<float>> file_material(const char* path) {
+  auto reader = open_audio_file(path);
+  if (!reader) {
+    std::cout << "Cannot read " << path << "\n";
+    return {};
+  }
+
+  const std::size_t num_channels = reader->get_format().num_channels;
+  std::vector<float> frames(reader->size_frames() * num_channels);
+  audio_buffer<float> buffer(frames.data(), reader->size_frames(), num_channels, contiguous_interleaved);
+  reader->read(0, buffer);
+
+  std::vector<std::vector<float>> channels(num_channels, std::vector<float>(reader->size_frames()));
+  for (std::size_t frame = 0; frame < reader->size_frames(); ++frame)
+    for (std::size_t channel = 0; channel < num_channels; ++channel)
+      channels[channel][frame] = frames[frame * num_channels + channel];
+
+  return channels;
+}
+
+void measure(const std::vector<std::vector<float>>& material, unsigned bits) {
+  const std::size_t num_channels = material.size();
+  const std::size_t num_frames = material[0].size();
+  constexpr std::size_t block_size = __audio_flac_encoder::block_size;
+
+  std::vector<std::vector<std::int32_t>> samples(num_channels, std::vector<std::int32_t>(num_frames));
+  for (std::size_t channel = 0; channel < num_channels; ++channel)
+    for (std::size_t frame = 0; frame < num_frames; ++frame)
+      samples[channel][frame] = __audio_quantize_sample(material[channel][frame], bits);
+
+  std::vector<__audio_flac_encoder> encoders;
+  for (std::size_t first_channel = 0; first_channel < num_channels; first_channel += __audio_flac_encoder::max_channels)
+    encoders.emplace_back(std::min(__audio_flac_encoder::max_channels, num_channels - first_channel), bits, 48'000);
+
+  std::vector<std::uint8_t> encoded;
+  encoded.reserve(num_frames * num_channels * 4);
+  std::vector<const std::int32_t*> pointers(num_channels);
+
+  const auto start = std::chrono::steady_clock::now();
+
+  for (std::size_t first = 0; first < num_frames; first += block_size) {
+    for (std::size_t channel = 0; channel < num_channels; ++channel)
+      pointers[channel] = samples[channel].data() + first;
+
+    for (std::size_t group = 0; group < encoders.size(); ++group)
+      encoders[group].encode_frame(pointers.data() + group * __audio_flac_encoder::max_channels,
+                                   std::min(block_size, num_frames - first), first / block_size, encoded);
+  }
+
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  const double pcm_bytes = double(num_frames * num_channels * bits / 8);
+
+  std::cout << "  " << std::setw(2) << bits << "-bit: "
+            << std::setw(7) << pcm_bytes / elapsed.count() / 1e6 << " MB/s per core, ratio "
+            << std::setw(5) << double(encoded.size()) / pcm_bytes << "\n";
+}
+
+int main(int argc, char* argv[]) {
+  const auto material = argc > 1 ? file_material(argv[1]) : synthetic_material(48'000 * 60);
+  if (material.empty() || material[0].empty())
+    return 1;
+
+  std::cout << std::fixed << std::setprecision(3);
+  std::cout << "FLAC encoding, " << material.size() << " channels, " << material[0].size() << " frames:\n";
+
+  for (unsigned bits : {16, 24})
+    measure(material, bits);
+}
@@ -0,0 +1,150 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <audio>
+
+// This benchmark runs the library's device I/O path on loopback device pairs, so
+// it needs no audio hardware. It measures the round-trip latency from an impulse
+// rendered by the output device to its arrival at the input device, both in frames
+// and in time stamps, and the overhead per period of the I/O path, with the devices
+// used directly and through audio_aggregate_device, on a free-running clock.
+
+#ifdef _LIBSTDAUDIO_HAS_LOOPBACK_DEVICES
+
+using namespace std::experimental;
+
+void fill(audio_buffer<float>& buffer, float value) noexcept {
+  for (std::size_t frame = 0; frame < buffer.size_frames(); ++frame)
+    for (std::size_t channel = 0; channel < buffer.size_channels(); ++channel)
+      buffer(frame, channel) = value;
+}
+
+void measure_round_trip(std::size_t latency_frames) {
+  audio_loopback_config config;
+  config.num_channels = 1;
+  config.buffer_size_frames = 128;
+  config.latency_frames = latency_frames;
+  auto pair = add_audio_loopback_device_pair(config);
+
+  // The impulse goes out on the 10th period, so that both devices are running.
+  constexpr std::size_t impulse_frame = 10 * 128 + 5;
+  std::atomic<bool> done = false;
+  std::size_t output_position = 0, input_position = 0, detected_frame = 0;
+  audio_clock_t::time_point impulse_time, detected_time;
+
+  pair->output.connect([&](audio_device&, audio_device_io<float>& io) noexcept {
+    const std::size_t num_frames = io.output_buffer->size_frames();
+    if (impulse_frame >= output_position && impulse_frame < output_position + num_frames) {
+      io.output_buffer->operator()(impulse_frame - output_position, 0) = 1.0f;
+      impulse_time = *io.output_time + std::chrono::duration_cast<audio_clock_t::duration>(
+        std::chrono::duration<double>(double(impulse_frame - output_position) / config.sample_rate));
+    }
+    output_position += num_frames;
+  });
+
+  pair->input.connect([&](audio_device&, audio_device_io<float>& io) noexcept {
+    const std::size_t num_frames = io.input_buffer->size_frames();
+    for (std::size_t frame = 0; frame < num_frames && !done; ++frame) {
+      if (io.input_buffer->operator()(frame, 0) > 0.5f) {
+        detected_frame = input_position + frame;
+        detected_time = *io.input_time + std::chrono::duration_cast<audio_clock_t::duration>(
+          std::chrono::duration<double>(double(frame) / config.sample_rate));
+        done = true;
+      }
+    }
+    input_position += num_frames;
+  });
+
+  pair->input.start();
+  pair->output.start();
+  while (!done)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  pair->output.stop();
+  pair->input.stop();
+  remove_audio_loopback_device_pair(pair->output);
+
+  const std::chrono::duration<double, std::milli> round_trip_time = detected_time - impulse_time;
+  std::cout << "  " << std::setw(4) << latency_frames << " frames configured: measured "
+            << std::setw(4) << detected_frame - impulse_frame << " frames, "
+            << round_trip_time.count() << " ms\n";
+}
+
+template <typename Start, typename Stop>
+void measure_periods(const char* label, std::atomic<std::size_t>& num_periods, Start start, Stop stop) {
+  constexpr std::size_t num_measured_periods = 200'000;
+
+  const auto start_time = std::chrono::steady_clock::now();
+  start();
+  while (num_periods < num_measured_periods)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start_time;
+  const std::size_t periods = num_periods;
+  stop();
+
+  std::cout << "  " << std::setw(10) << label << ": " << std::setw(7) << elapsed.count() / double(periods)
+            << " ns per period\n";
+}
+
+void measure_overhead(unsigned buffer_size_frames) {
+  audio_loopback_config config;
+  config.num_channels = 2;
+  config.buffer_size_frames = buffer_size_frames;
+  config.clock = audio_loopback_clock::free_running;
+  std::cout << buffer_size_frames << " frames, stereo:\n";
+
+  {
+    auto pair = add_audio_loopback_device_pair(config);
+    std::atomic<std::size_t> num_periods = 0;
+    pair->output.connect([](audio_device&, audio_device_io<float>& io) noexcept {
+      fill(*io.output_buffer, 0.25f);
+    });
+    pair->input.connect([&](audio_device&, audio_device_io<float>&) noexcept {
+      num_periods.fetch_add(1, std::memory_order_relaxed);
+    });
+
+    measure_periods("devices", num_periods,
+                    [&] { pair->input.start(); pair->output.start(); },
+                    [&] { pair->output.stop(); pair->input.stop(); });
+    remove_audio_loopback_device_pair(pair->output);
+  }
+
+  {
+    auto pair = add_audio_loopback_device_pair(config);
+    audio_aggregate_device<float> aggregate({&pair->output, &pair->input}, 0);
+    std::atomic<std::size_t> num_periods = 0;
+    aggregate.connect([&](audio_aggregate_device<float>&, audio_device_io<float>& io) noexcept {
+      fill(*io.output_buffer, 0.25f);
+      num_periods.fetch_add(1, std::memory_order_relaxed);
+    });
+
+    measure_periods("aggregate", num_periods, [&] { aggregate.start(); }, [&] { aggregate.stop(); });
+    remove_audio_loopback_device_pair(pair->output);
+  }
+}
+
+int main() {
+  std::cout << std::fixed << std::setprecision(2);
+
+  std::cout << "Round trip, 128 frames at 48 kHz:\n";
+  for (std::size_t latency_frames : {0, 37, 300})
+    measure_round_trip(latency_frames);
+
+  std::cout << std::setprecision(0);
+  for (unsigned buffer_size_frames : {64, 512})
+    measure_overhead(buffer_size_frames);
+}
+
+#else
+
+int main() {
+  std::cout << "Loopback devices are only available with the null backend.\n";
+}
+
+#endif
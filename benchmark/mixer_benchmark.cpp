@@ -0,0 +1,59 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <audio>
+
+// This benchmark measures how many mono voices audio_mixer can pan and mix into a
+// stereo output on one core in real time, at 48 kHz. Every voice is a naive sawtooth,
+// so the numbers include a (cheap) per-voice render. Build with optimisations.
+
+using namespace std::experimental;
+
+double measure_voices_per_core(std::size_t buffer_size_frames, std::size_t num_voices) {
+  constexpr double sample_rate = 48'000;
+  constexpr double audio_seconds = 5;
+
+  audio_mixer<float> mixer(2, num_voices, buffer_size_frames);
+  for (std::size_t voice = 0; voice < num_voices; ++voice) {
+    const float increment = float(55.0 * double(voice % 48 + 1) / sample_rate);
+    const float pan = float(voice % 17) / 8.0f - 1.0f;
+
+    mixer.add_source([increment, phase = 0.0f](audio_buffer<float>& buffer) mutable noexcept {
+      for (std::size_t frame = 0; frame < buffer.size_frames(); ++frame) {
+        buffer(frame, 0) = 2.0f * phase - 1.0f;
+        phase += increment;
+        phase -= float(int(phase));
+      }
+    }, 1, 1.0f / float(num_voices), pan);
+  }
+
+  std::vector<float> data(2 * buffer_size_frames);
+  audio_buffer<float> output(data.data(), buffer_size_frames, 2, contiguous_interleaved);
+  const auto num_blocks = std::size_t(audio_seconds * sample_rate) / buffer_size_frames;
+
+  const auto start = std::chrono::steady_clock::now();
+  for (std::size_t block = 0; block < num_blocks; ++block)
+    mixer.process(output);
+
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  const double realtime_factor = double(num_blocks * buffer_size_frames) / sample_rate / elapsed.count();
+  return double(num_voices) * realtime_factor;
+}
+
+int main() {
+  std::cout << std::fixed << std::setprecision(0);
+
+  for (std::size_t buffer_size : {64, 256}) {
+    std::cout << "Buffer size " << buffer_size << ":\n";
+    for (std::size_t num_voices : {16, 256, 1024}) {
+      std::cout << "  " << std::setw(5) << num_voices << " voices mixed: "
+                << std::setw(8) << measure_voices_per_core(buffer_size, num_voices) << " voices per core\n";
+    }
+  }
+}
@@ -0,0 +1,56 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <vector>
+#include <audio>
+
+// This benchmark measures how many samples of noise per second audio_noise_generator
+// produces for each colour, compared with minstd_rand and uniform_real_distribution
+// per sample. Build with optimisations (and e.g. -mavx2 -mfma) for meaningful numbers.
+
+using namespace std::experimental;
+
+constexpr std::size_t block_size = 256;
+constexpr std::size_t num_blocks = 100'000;
+
+template <typename _Function>
+double measure_gsamples_per_second(_Function&& render_block) {
+  std::vector<float> block(block_size);
+  float sink = 0;
+
+  const auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < num_blocks; ++i) {
+    render_block(block.data());
+    sink += block[i % block_size];
+  }
+
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  volatile float result = sink;
+  (void)result;
+  return double(block_size * num_blocks) / elapsed.count() / 1e9;
+}
+
+int main() {
+  std::minstd_rand engine;
+  std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+  const double baseline = measure_gsamples_per_second([&](float* block) {
+    for (std::size_t i = 0; i < block_size; ++i)
+      block[i] = distribution(engine);
+  });
+
+  audio_noise_generator white(audio_noise_color::white);
+  audio_noise_generator pink(audio_noise_color::pink);
+  audio_noise_generator brown(audio_noise_color::brown);
+
+  std::cout << std::fixed << std::setprecision(2) << "GSamples/s:\n"
+            << "  minstd_rand + uniform_real_distribution: " << baseline << "\n"
+            << "  white: " << measure_gsamples_per_second([&](float* block) { white.render(block, block_size); }) << "\n"
+            << "  pink:  " << measure_gsamples_per_second([&](float* block) { pink.render(block, block_size); }) << "\n"
+            << "  brown: " << measure_gsamples_per_second([&](float* block) { brown.render(block, block_size); }) << "\n";
+}
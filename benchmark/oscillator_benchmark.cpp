@@ -0,0 +1,87 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <audio>
+
+// This benchmark compares audio_oscillator_bank with the per-sample std::sin and
+// std::fmod approach of the examples, in millions of oscillator samples per second.
+// Build with optimisations (and e.g. -mavx2 -mfma) for meaningful numbers.
+
+using namespace std::experimental;
+
+constexpr double sample_rate = 48'000;
+constexpr std::size_t block_size = 256;
+constexpr std::size_t num_blocks = 2'000;
+constexpr float two_pi = 6.28318530717958647692f;
+
+template <typename _Function>
+double measure_msamples_per_second(std::size_t num_oscillators, _Function&& render_block) {
+  std::vector<float> block(block_size);
+  float sink = 0;
+
+  const auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < num_blocks; ++i) {
+    render_block(block.data());
+    sink += block[i % block_size];
+  }
+
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  volatile float result = sink;
+  (void)result;
+  return double(num_oscillators * block_size * num_blocks) / elapsed.count() / 1e6;
+}
+
+double measure_std_sin(std::size_t num_oscillators) {
+  std::vector<float> phases(num_oscillators), deltas(num_oscillators);
+  for (std::size_t i = 0; i < num_oscillators; ++i)
+    deltas[i] = two_pi * float(100 + 10 * i) / float(sample_rate);
+
+  return measure_msamples_per_second(num_oscillators, [&](float* block) {
+    std::fill(block, block + block_size, 0.0f);
+    for (std::size_t i = 0; i < num_oscillators; ++i) {
+      for (std::size_t frame = 0; frame < block_size; ++frame) {
+        block[frame] += std::sin(phases[i]);
+        phases[i] = std::fmod(phases[i] + deltas[i], two_pi);
+      }
+    }
+  });
+}
+
+double measure_bank(std::size_t num_oscillators, audio_waveform waveform, const audio_wavetable* wavetable = nullptr) {
+  audio_oscillator_bank bank(num_oscillators, sample_rate);
+  for (std::size_t i = 0; i < num_oscillators; ++i) {
+    bank.set_waveform(i, waveform, wavetable);
+    bank.set_frequency(i, 100.0 + 10.0 * double(i));
+    bank.set_gain(i, 1.0f / float(num_oscillators));
+  }
+
+  return measure_msamples_per_second(num_oscillators, [&](float* block) {
+    bank.render(block, block_size);
+  });
+}
+
+int main() {
+  std::vector<float> cycle(2048);
+  for (std::size_t n = 0; n < cycle.size(); ++n)
+    cycle[n] = n < cycle.size() / 2 ? 1.0f : -1.0f;
+
+  const audio_wavetable wavetable(cycle.data(), cycle.size());
+
+  std::cout << std::fixed << std::setprecision(1);
+
+  for (std::size_t num_oscillators : {1, 64}) {
+    std::cout << num_oscillators << (num_oscillators == 1 ? " oscillator" : " oscillators") << ", MSamples/s:\n"
+              << "  std::sin + std::fmod: " << std::setw(8) << measure_std_sin(num_oscillators) << "\n"
+              << "  sine:                 " << std::setw(8) << measure_bank(num_oscillators, audio_waveform::sine) << "\n"
+              << "  saw (PolyBLEP):       " << std::setw(8) << measure_bank(num_oscillators, audio_waveform::saw) << "\n"
+              << "  square (PolyBLEP):    " << std::setw(8) << measure_bank(num_oscillators, audio_waveform::square) << "\n"
+              << "  wavetable:            " << std::setw(8) << measure_bank(num_oscillators, audio_waveform::wavetable, &wavetable) << "\n";
+  }
+}
@@ -0,0 +1,74 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <thread>
+#include <vector>
+#include <audio>
+
+// This benchmark records 128 channels at 192 kHz with audio_file_recorder, fed by
+// a simulated device callback of 256 frames that runs at a multiple of realtime,
+// and reports the data rate and how many frames were dropped because the disk
+// could not keep up. Pass a directory on the disk to measure as the argument
+// (the default is the system's temporary directory).
+
+using namespace std::experimental;
+
+constexpr std::size_t num_channels = 128;
+constexpr double sample_rate = 192'000;
+constexpr std::size_t block_frames = 256;
+constexpr double seconds_of_audio = 10;
+
+void measure(const std::string& path, audio_sample_format format, double speed) {
+  audio_file_recorder recorder(num_channels, sample_rate, format);
+  const auto num_blocks = std::size_t(seconds_of_audio * sample_rate / block_frames);
+  if (!recorder.start(path, num_blocks * block_frames)) {
+    std::cout << "Cannot create " << path << "\n";
+    return;
+  }
+
+  std::vector<float> block(block_frames * num_channels);
+  audio_noise_generator noise(audio_noise_color::white, 1);
+  noise.render(block.data(), block.size());
+
+  const auto period = std::chrono::duration<double>(block_frames / sample_rate / speed);
+  const auto start = std::chrono::steady_clock::now();
+
+  for (std::size_t i = 0; i < num_blocks; ++i) {
+    std::this_thread::sleep_until(start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(period * double(i)));
+    recorder.process(audio_buffer<float>(block.data(), block_frames, num_channels, contiguous_interleaved));
+  }
+
+  recorder.stop();
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  const auto statistics = recorder.get_statistics();
+  const double bytes = double(statistics.num_recorded_frames) * double(recorder.get_format().bytes_per_frame());
+
+  std::cout << "  " << std::setw(4) << speed << "x realtime: "
+            << std::setw(7) << bytes / elapsed.count() / 1e6 << " MB/s, "
+            << statistics.num_dropped_frames << " frames dropped"
+            << (statistics.write_failed ? ", write failed" : "") << "\n";
+
+  std::filesystem::remove(path);
+}
+
+int main(int argc, char* argv[]) {
+  const std::filesystem::path directory = argc > 1 ? argv[1] : std::filesystem::temp_directory_path();
+  const std::string path = (directory / "libstdaudio_recorder_benchmark.wav").string();
+
+  std::cout << std::fixed << std::setprecision(1);
+
+  std::cout << "128 channels, 192 kHz, 24-bit:\n";
+  for (double speed : {1.0, 2.0, 4.0})
+    measure(path, audio_sample_format::int24, speed);
+
+  std::cout << "128 channels, 192 kHz, 32-bit float:\n";
+  for (double speed : {1.0, 2.0, 4.0})
+    measure(path, audio_sample_format::float32, speed);
+}
@@ -0,0 +1,63 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <audio>
+
+// This benchmark measures the throughput of audio_resampler in input frames per second
+// for each quality preset. Build with optimisations (and e.g. -mavx2 -mfma) for meaningful numbers.
+
+using namespace std::experimental;
+
+const char* quality_name(audio_resampler_quality quality) {
+  switch (quality) {
+    case audio_resampler_quality::low: return "low";
+    case audio_resampler_quality::medium: return "medium";
+    case audio_resampler_quality::high: return "high";
+  }
+  return "";
+}
+
+double measure_mframes_per_second(double input_rate, double output_rate, std::size_t num_channels,
+                                  audio_resampler_quality quality, audio_resampler_mode mode) {
+  constexpr std::size_t block_size = 256;
+  constexpr std::size_t num_blocks = 4000;
+
+  audio_resampler<float> resampler(input_rate, output_rate, num_channels, quality, mode);
+  std::vector<float> input(block_size * num_channels, 0.25f);
+  std::vector<float> output(3 * block_size * num_channels);
+
+  const auto start = std::chrono::steady_clock::now();
+  std::size_t frames_processed = 0;
+
+  for (std::size_t i = 0; i < num_blocks; ++i) {
+    audio_buffer<float> in(input.data(), block_size, num_channels, contiguous_interleaved);
+    audio_buffer<float> out(output.data(), 3 * block_size, num_channels, contiguous_interleaved);
+    frames_processed += resampler.process(in, out).input_frames;
+  }
+
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return double(frames_processed) / elapsed.count() / 1e6;
+}
+
+int main() {
+  const std::pair<double, double> conversions[] = {{44'100, 48'000}, {48'000, 44'100}, {48'000, 96'000}, {96'000, 48'000}};
+  std::cout << std::fixed << std::setprecision(1);
+
+  for (auto mode : {audio_resampler_mode::fixed_ratio, audio_resampler_mode::variable_ratio}) {
+    std::cout << (mode == audio_resampler_mode::fixed_ratio ? "Fixed ratio" : "Variable ratio") << ", stereo:\n";
+
+    for (auto quality : {audio_resampler_quality::low, audio_resampler_quality::medium, audio_resampler_quality::high}) {
+      for (auto [input_rate, output_rate] : conversions) {
+        std::cout << "  " << std::setw(7) << std::left << quality_name(quality) << std::right
+                  << std::setw(5) << input_rate / 1000 << " -> " << std::setw(4) << output_rate / 1000 << " kHz: "
+                  << std::setw(6) << measure_mframes_per_second(input_rate, output_rate, 2, quality, mode) << " MFrames/s\n";
+      }
+    }
+  }
+}
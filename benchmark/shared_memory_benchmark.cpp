@@ -0,0 +1,142 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <vector>
+#include <audio>
+
+// This benchmark measures the round-trip latency between two local processes that
+// are connected by a pair of shared memory devices. The parent sends a period to
+// a child process, whose connected callback copies it into the ring going back,
+// and waits for it to return before sending the next one; the time this takes is
+// what the transport adds on top of the buffering of the periods themselves.
+
+#if defined(__linux__)
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std::experimental;
+
+constexpr unsigned num_channels = 2;
+constexpr unsigned sample_rate = 48'000;
+constexpr std::size_t num_warm_up_round_trips = 1000;
+constexpr std::size_t num_round_trips = 20'000;
+
+// Echoes every period from input to output until it receives a negative sample.
+[[noreturn]] void run_echo(int input_fd, int output_fd) {
+  auto input = open_audio_shared_memory_device(input_fd, audio_shared_memory_role::consumer);
+  auto output = open_audio_shared_memory_device(output_fd, audio_shared_memory_role::producer);
+  if (!input || !output || !output->start())
+    _exit(1);
+
+  std::atomic<bool> done = false;
+  input->connect([&](audio_shared_memory_device&, audio_device_io<float>& in) noexcept {
+    auto echo = [&](audio_shared_memory_device&, audio_device_io<float>& out) noexcept {
+      std::copy_n(in.input_buffer->data(), in.input_buffer->size_samples(), out.output_buffer->data());
+    };
+
+    output->wait();
+    output->process(echo);
+    if (in.input_buffer->data()[0] < 0)
+      done = true;
+  });
+
+  if (!input->start())
+    _exit(1);
+
+  while (!done)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+  _exit(0);
+}
+
+void measure(unsigned buffer_size_frames) {
+  auto to_child = create_audio_shared_memory_device(audio_shared_memory_role::producer, "to child", num_channels, sample_rate, buffer_size_frames, 2);
+  auto from_child = create_audio_shared_memory_device(audio_shared_memory_role::consumer, "from child", num_channels, sample_rate, buffer_size_frames, 2);
+  if (!to_child || !from_child) {
+    std::cout << "Cannot create shared memory devices\n";
+    return;
+  }
+
+  const pid_t child = fork();
+  if (child == 0)
+    run_echo(to_child->native_handle(), from_child->native_handle());
+
+  to_child->start();
+  from_child->start();
+
+  float value = 0;
+  auto send = [&](audio_shared_memory_device&, audio_device_io<float>& io) noexcept {
+    std::fill_n(io.output_buffer->data(), io.output_buffer->size_samples(), value);
+  };
+
+  bool echoed = false;
+  auto receive = [&](audio_shared_memory_device&, audio_device_io<float>& io) noexcept {
+    echoed = io.input_buffer->data()[0] == value;
+  };
+
+  std::vector<double> round_trips;
+  round_trips.reserve(num_round_trips);
+
+  for (std::size_t i = 0; i < num_warm_up_round_trips + num_round_trips; ++i) {
+    value = float(i);
+    const auto start = std::chrono::steady_clock::now();
+
+    to_child->wait();
+    to_child->process(send);
+    from_child->wait();
+    from_child->process(receive);
+
+    const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    if (!echoed) {
+      std::cout << "Period " << i << " came back wrong\n";
+      break;
+    }
+
+    if (i >= num_warm_up_round_trips)
+      round_trips.push_back(elapsed.count());
+  }
+
+  value = -1;
+  to_child->wait();
+  to_child->process(send);
+  waitpid(child, nullptr, 0);
+
+  if (round_trips.empty())
+    return;
+
+  std::sort(round_trips.begin(), round_trips.end());
+  const auto percentile = [&](double p) { return round_trips[std::size_t(p * double(round_trips.size() - 1))]; };
+  const double period_us = 1e6 * buffer_size_frames / sample_rate;
+
+  std::cout << "  " << std::setw(4) << buffer_size_frames << " frames (" << std::setw(6) << period_us << " us period): "
+            << "median " << std::setw(6) << percentile(0.5) << " us, "
+            << "99% " << std::setw(6) << percentile(0.99) << " us, "
+            << "max " << std::setw(7) << round_trips.back() << " us\n";
+}
+
+int main() {
+  // Best effort, as for a real audio thread.
+  __audio_set_realtime_thread_priority();
+
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << "Shared memory round trip between two processes, " << num_channels << " channels at " << sample_rate << " Hz:\n";
+  for (unsigned buffer_size_frames : {32, 128, 512})
+    measure(buffer_size_frames);
+}
+
+#else
+
+int main() {
+  std::cout << "Shared memory devices are only available on Linux.\n";
+}
+
+#endif // __linux__
@@ -0,0 +1,66 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <audio>
+
+// This benchmark measures how audio_worker_pool scales from 1 to 16 workers: every
+// simulated period runs 64 independent tasks, each filtering 256 frames of audio
+// through a cascade of one-pole filters, and the average time per period is reported
+// relative to running the same tasks on the calling thread alone.
+
+using namespace std::experimental;
+
+namespace {
+  constexpr std::size_t num_tasks = 64;
+  constexpr std::size_t num_frames = 256;
+  constexpr std::size_t num_stages = 32;
+  constexpr std::size_t num_periods = 2000;
+
+  struct task_state {
+    std::vector<float> samples = std::vector<float>(num_frames, 0.5f);
+    float states[num_stages] = {};
+  };
+
+  void run_task(task_state& task) noexcept {
+    for (std::size_t frame = 0; frame < num_frames; ++frame) {
+      float x = task.samples[frame];
+      for (auto& state : task.states) {
+        state += 0.1f * (x - state);
+        x = state;
+      }
+      task.samples[frame] = x + 1e-3f;
+    }
+  }
+
+  double measure_microseconds_per_period(std::size_t num_workers) {
+    audio_worker_pool pool(num_workers);
+    std::vector<task_state> tasks(num_tasks);
+
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t period = 0; period < num_periods; ++period)
+      pool.parallel_for(num_tasks, [&](std::size_t i) noexcept { run_task(tasks[i]); });
+
+    const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / double(num_periods);
+  }
+}
+
+int main() {
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << "Hardware threads: " << std::thread::hardware_concurrency() << "\n";
+
+  const double baseline = measure_microseconds_per_period(0);
+  std::cout << "   0 workers: " << std::setw(8) << baseline << " us per period\n";
+
+  for (std::size_t num_workers : {1, 2, 3, 4, 6, 8, 12, 16}) {
+    const double time = measure_microseconds_per_period(num_workers);
+    std::cout << "  " << std::setw(2) << num_workers << " workers: " << std::setw(8) << time
+              << " us per period, speedup " << std::setw(4) << baseline / time << "x\n";
+  }
+}
@@ -0,0 +1,90 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#ifdef _WIN32
+#define _USE_MATH_DEFINES
+#endif
+
+#include <cmath>
+#include <array>
+#include <cstddef>
+#include <thread>
+#include <audio>
+
+// This example app plays the same melody as melody.cpp, but the sequencer is written
+// as a coroutine that runs on the audio thread: instead of a state machine, it loops
+// over the notes and waits for the next period whenever it has filled a buffer.
+// Requires C++20.
+
+#ifdef _LIBSTDAUDIO_HAS_COROUTINES
+
+constexpr std::array<int, 22> notes = {
+  88, 86, 78, 78, 80, 80,
+  85, 83, 74, 74, 76, 76,
+  83, 81, 73, 73, 76, 76,
+  81, 81, 81, 81
+};
+
+constexpr float bpm = 260.0;
+
+float note_to_frequency_hz(int note) {
+  constexpr float pitch_standard_hz = 440.0f;
+  return pitch_standard_hz * std::pow(2.0f, float(note - 69) / 12.0f);
+}
+
+using namespace std::experimental;
+
+audio_stream_task play_melody(audio_stream_arena&, audio_stream<float>& stream, float sample_rate) {
+  const auto frames_per_note = std::size_t(sample_rate * 60.0f / bpm);
+  auto* io = &co_await stream.next_period();
+  std::size_t frame = 0;
+  float phase = 0;
+
+  for (int note : notes) {
+    const float delta = 2.0f * note_to_frequency_hz(note) * float(M_PI) / sample_rate;
+
+    for (std::size_t i = 0; i < frames_per_note; ++i) {
+      if (frame == io->output_buffer->size_frames()) {
+        io = &co_await stream.next_period();
+        frame = 0;
+      }
+
+      auto& out = *io->output_buffer;
+      for (std::size_t channel = 0; channel < out.size_channels(); ++channel)
+        out(frame, channel) = std::copysign(0.1f, std::sin(phase));
+
+      phase = std::fmod(phase + delta, 2.0f * float(M_PI));
+      ++frame;
+    }
+  }
+}
+
+int main() {
+  auto device = get_default_audio_output_device();
+  if (!device)
+    return 1;
+
+  alignas(std::max_align_t) static std::byte arena_memory[4096];
+  audio_stream_arena arena(arena_memory, sizeof(arena_memory));
+  audio_stream<float> stream;
+  stream.set_task(play_melody(arena, stream, float(device->get_sample_rate())));
+
+  device->connect([&stream](audio_device& d, audio_device_io<float>& io) noexcept {
+    stream(d, io);
+  });
+
+  device->start();
+  while (!stream.is_done()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+}
+
+#else
+
+int main() {
+  return 0;
+}
+
+#endif // _LIBSTDAUDIO_HAS_COROUTINES
@@ -3,16 +3,15 @@
 // Distributed under the Boost Software License, Version 1.0.
 // (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
 
-#ifdef _WIN32
-#define _USE_MATH_DEFINES
-#endif
-
-#include <cmath>
+#include <algorithm>
 #include <array>
+#include <cassert>
+#include <cmath>
 #include <thread>
 #include <audio>
 
 // This example app plays a short melody using a simple square wave synthesiser.
+// The band-limited oscillator avoids the aliasing of a naive square wave.
 
 constexpr std::array<int, 22> notes = {
   88, 86, 78, 78, 80, 80,
@@ -31,46 +30,48 @@ float note_to_frequency_hz(int note) {
 std::atomic<bool> stop = false;
 
 struct synthesiser {
-  float get_next_sample() {
-    assert (_sample_rate > 0);
-
-    _ms_counter += 1000.0f / _sample_rate;
-    if (_ms_counter >= _note_duration_ms) {
-      _ms_counter = 0;
-      if (++_current_note_index < notes.size()) {
-        update();
-      }
-      else {
+  template <typename _SampleType>
+  void process(std::experimental::audio_buffer<_SampleType>& buffer) noexcept {
+    std::size_t frame = 0;
+
+    // Render up to the next note change, then switch notes, until the buffer is full.
+    while (frame < buffer.size_frames()) {
+      if (_current_note_index >= notes.size()) {
+        _oscillator.set_gain(0);
+        _oscillator.process(buffer, frame, buffer.size_frames());
         stop.store(true);
-        return 0;
+        return;
       }
-    }
 
-    auto next_sample = std::copysign(0.1f, std::sin(_phase));
-    _phase = std::fmod(_phase + _delta, 2.0f * float(M_PI));
-    return next_sample;
+      const auto num_frames = std::min(std::size_t(buffer.size_frames()) - frame, _frames_left_in_note);
+      _oscillator.process(buffer, frame, frame + num_frames);
+      frame += num_frames;
+      _frames_left_in_note -= num_frames;
+
+      if (_frames_left_in_note == 0 && ++_current_note_index < notes.size())
+        start_note();
+    }
   }
 
   void set_sample_rate(float sample_rate) {
     _sample_rate = sample_rate;
-    update();
+    _oscillator.set_sample_rate(sample_rate);
+    start_note();
   }
 
 private:
-  void update() noexcept {
-    float frequency_hz = note_to_frequency_hz(notes.at(_current_note_index));
-    _delta = 2.0f * frequency_hz * static_cast<float>(M_PI / _sample_rate);
+  void start_note() noexcept {
+    assert (_sample_rate > 0);
+    _oscillator.set_frequency(note_to_frequency_hz(notes.at(_current_note_index)));
+    _frames_left_in_note = std::size_t(_sample_rate * 60.0f / bpm);
   }
 
   float _sample_rate = 0;
-  float _delta = 0;
-  float _phase = 0;
-  float _ms_counter = 0;
-  float _note_duration_ms = 60'000.0f / bpm;
-  int _current_note_index = 0;
+  std::experimental::audio_oscillator _oscillator{48'000, std::experimental::audio_waveform::square, 440.0, 0.1f};
+  std::size_t _frames_left_in_note = 0;
+  std::size_t _current_note_index = 0;
 };
 
-
 int main() {
   using namespace std::experimental;
 
@@ -85,14 +86,7 @@ int main() {
     if (!io.output_buffer.has_value())
       return;
 
-    auto& out = *io.output_buffer;
-
-    for (int frame = 0; frame < out.size_frames(); ++frame) {
-      auto next_sample = synth.get_next_sample();
-
-      for (int channel = 0; channel < out.size_channels(); ++channel)
-        out(frame, channel) = next_sample;
-    }
+    synth.process(*io.output_buffer);
   });
 
   device->start();
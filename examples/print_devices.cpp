@@ -26,6 +26,8 @@ void print_device_info(const audio_device& d) {
   std::cout << "- \"" << d.name() << "\", ";
   std::cout << "sample rate = " << d.get_sample_rate() << " Hz, ";
   std::cout << "buffer size = " << d.get_buffer_size_frames() << " frames, ";
+  if (auto latency = d.is_input() ? d.get_input_latency() : d.get_output_latency())
+    std::cout << "latency = " << latency->total_frames() << " frames, ";
   std::cout << (d.is_input() ? d.get_num_input_channels() : d.get_num_output_channels()) << " channels";
   std::cout << (is_default_device(d) ? " [DEFAULT DEVICE]\n" : "\n");
 };
@@ -3,14 +3,8 @@
 // Distributed under the Boost Software License, Version 1.0.
 // (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
 
-#ifdef _WIN32
-#define _USE_MATH_DEFINES
-#endif
-
-#include <cmath>
 #include <thread>
 #include <audio>
-#include <cmath>
 
 // This example app plays a sine wave of a given frequency for 5 seconds.
 
@@ -22,24 +16,16 @@ int main() {
     return 1;
 
   float frequency_hz = 440.0f;
-  float delta = 2.0f * frequency_hz * float(M_PI / device->get_sample_rate());
-  float phase = 0;
+  audio_oscillator oscillator(device->get_sample_rate(), audio_waveform::sine, frequency_hz, 0.2f);
 
   device->connect([=](audio_device&, audio_device_io<float>& io) mutable noexcept {
     if (!io.output_buffer.has_value())
       return;
 
-    auto& out = *io.output_buffer;
-
-    for (int frame = 0; frame < out.size_frames(); ++frame) {
-      float next_sample = std::sin(phase);
-      phase = std::fmod(phase + delta, 2.0f * static_cast<float>(M_PI));
-
-      for (int channel = 0; channel < out.size_channels(); ++channel)
-        out(frame, channel) = 0.2f * next_sample;
-    }
+    // Renders a whole block at once, into every channel.
+    oscillator.process(*io.output_buffer);
   });
 
   device->start();
   std::this_thread::sleep_for(std::chrono::seconds(5));
-}
\ No newline at end of file
+}
@@ -0,0 +1,60 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <thread>
+#include <audio>
+
+// This example app prints the loudest frequency of the input and the levels of a few
+// octave bands in regular intervals.
+
+float gain_to_db(float gain) noexcept {
+  return gain > 0 ? std::log10(gain) * 20.0f : -std::numeric_limits<float>::infinity();
+}
+
+int main() {
+  using namespace std::experimental;
+  audio_spectrum_analyzer analyzer(4096);
+
+  auto device = get_default_audio_input_device();
+  if (!device)
+    return 1;
+
+  device->connect([&](audio_device&, audio_device_io<float>& io) noexcept {
+    if (io.input_buffer.has_value())
+      analyzer.process(*io.input_buffer);
+  });
+
+  device->start();
+  const double sample_rate = double(device->get_sample_rate());
+
+  while(device->is_running()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(250));
+
+    const auto& magnitudes = analyzer.get_magnitudes();
+    const double bin_width = sample_rate / double(analyzer.fft_size());
+
+    std::size_t loudest = 1;
+    for (std::size_t k = 1; k < magnitudes.size(); ++k) {
+      if (magnitudes[k] > magnitudes[loudest])
+        loudest = k;
+    }
+
+    std::cout << std::fixed << std::setprecision(0) << std::setw(6) << double(loudest) * bin_width << " Hz |";
+
+    // Octave bands from 62.5 Hz up.
+    for (double low = 62.5; 2 * low < sample_rate / 2; low *= 2) {
+      float peak = 0;
+      for (std::size_t k = std::size_t(low / bin_width); k < std::size_t(2 * low / bin_width) && k < magnitudes.size(); ++k)
+        peak = std::max(peak, magnitudes[k]);
+
+      std::cout << std::setw(5) << std::max(gain_to_db(peak), -99.0f);
+    }
+
+    std::cout << " dB\n";
+  }
+}
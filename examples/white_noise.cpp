@@ -12,20 +12,16 @@
 int main() {
   using namespace std::experimental;
 
-  std::random_device rd;
-  std::minstd_rand gen(rd());
-  std::uniform_real_distribution<float> white_noise(-1.0f, 1.0f);
-
   if (auto device = get_default_audio_output_device()) {
+    // One independent stream per channel, filled a whole buffer at a time.
+    std::random_device rd;
+    audio_noise_generator white_noise(audio_noise_color::white, device->get_num_output_channels(), rd());
+
     device->connect([&](audio_device &, audio_device_io<float> &io) noexcept {
       if (!io.output_buffer.has_value())
         return;
 
-      auto &out = *io.output_buffer;
-
-      for (int frame = 0; frame < out.size_frames(); ++frame)
-        for (int channel = 0; channel < out.size_channels(); ++channel)
-          out(frame, channel) = white_noise(gen);
+      white_noise.process(*io.output_buffer);
     });
 
     device->start();
@@ -0,0 +1,503 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <vector>
+#include <__audio_frame_fifo.h>
+#include <__audio_triple_buffer.h>
+
+_LIBSTDAUDIO_NAMESPACE_BEGIN
+
+// Combines several devices into one, so that the input and output of all of them can be
+// processed in a single callback. The callback runs on the thread of the clock master
+// (the device at master_index); all other devices exchange audio with it through
+// lock-free FIFOs and are resampled to the master clock. The resampling ratio of each
+// device is steered by the clock estimates of both devices and by the fill level of its FIFO.
+//
+// Channels appear in the aggregate in the order of the devices. _DeviceType only needs
+// the usual audio_device interface; it is a template parameter so that virtual devices
+// can be aggregated as well. Nothing is allocated while the aggregate is running.
+template <typename _SampleType = float, typename _DeviceType = audio_device>
+class audio_aggregate_device {
+public:
+  using sample_type = _SampleType;
+  using index_type = typename audio_buffer<_SampleType>::index_type;
+
+  audio_aggregate_device(vector<_DeviceType*> devices,
+                         size_t master_index = 0,
+                         audio_resampler_quality quality = audio_resampler_quality::medium)
+    : _master_index(master_index),
+      _quality(quality) {
+    assert(master_index < devices.size());
+
+    for (auto* device : devices) {
+      assert(device != nullptr);
+      auto state = make_unique<_device_state>();
+      state->device = device;
+      // The aggregate hands all channels to its callback in one audio_buffer, so channels
+      // beyond what an audio_buffer can view are left out.
+      state->num_input_channels = min(index_type(max(device->get_num_input_channels(), 0)), _max_num_channels - _num_input_channels);
+      state->num_output_channels = min(index_type(max(device->get_num_output_channels(), 0)), _max_num_channels - _num_output_channels);
+      state->first_input_channel = _num_input_channels;
+      state->first_output_channel = _num_output_channels;
+
+      _num_input_channels += state->num_input_channels;
+      _num_output_channels += state->num_output_channels;
+      _devices.push_back(move(state));
+    }
+  }
+
+  audio_aggregate_device(const audio_aggregate_device&) = delete;
+  audio_aggregate_device& operator=(const audio_aggregate_device&) = delete;
+
+  ~audio_aggregate_device() {
+    stop();
+  }
+
+  size_t num_devices() const noexcept {
+    return _devices.size();
+  }
+
+  size_t master_index() const noexcept {
+    return _master_index;
+  }
+
+  int get_num_input_channels() const noexcept {
+    return int(_num_input_channels);
+  }
+
+  int get_num_output_channels() const noexcept {
+    return int(_num_output_channels);
+  }
+
+  double get_sample_rate() const noexcept {
+    return double(_master().device->get_sample_rate());
+  }
+
+  template <typename _CallbackType,
+            typename = enable_if_t<is_nothrow_invocable_v<_CallbackType, audio_aggregate_device&, audio_device_io<_SampleType>&>>>
+  void connect(_CallbackType callback) {
+    assert(!_running);
+    _user_callback = move(callback);
+  }
+
+  bool start() {
+    if (_running)
+      return true;
+
+    _prepare();
+
+    for (size_t i = 0; i < _devices.size(); ++i) {
+      _devices[i]->device->connect([this, i](_DeviceType&, audio_device_io<_SampleType>& io) noexcept {
+        if (i == _master_index)
+          _process_master(io);
+        else
+          _process_slave(*_devices[i], io);
+      });
+    }
+
+    // Start the master last, so that the other devices are already filling their FIFOs.
+    for (size_t i = 0; i < _devices.size(); ++i) {
+      if (i != _master_index && !_devices[i]->device->start()) {
+        _stop_devices();
+        return false;
+      }
+    }
+
+    if (!_master().device->start()) {
+      _stop_devices();
+      return false;
+    }
+
+    _running = true;
+    return true;
+  }
+
+  bool stop() {
+    if (_running) {
+      _stop_devices();
+      _running = false;
+    }
+
+    return true;
+  }
+
+  bool is_running() const noexcept {
+    return _running;
+  }
+
+  // The estimate of the given device's clock as of the master's last period. The audio
+  // thread is the only reader of the devices' estimators, so this reads a copy that it
+  // publishes for one control thread.
+  audio_clock_estimate get_clock_estimate(size_t device_index) noexcept {
+    auto& published = _devices.at(device_index)->published_clock;
+    published.update();
+    return published.read_buffer();
+  }
+
+  // Current output/input frame ratio of the resampler between the master and the given device.
+  double get_input_resampling_ratio(size_t device_index) const noexcept {
+    return _devices.at(device_index)->input_ratio.load(memory_order_relaxed);
+  }
+
+  double get_output_resampling_ratio(size_t device_index) const noexcept {
+    return _devices.at(device_index)->output_ratio.load(memory_order_relaxed);
+  }
+
+  // Number of times a device's FIFO ran empty (underrun) or full (overrun).
+  size_t get_underrun_count(size_t device_index) const noexcept {
+    return _devices.at(device_index)->underruns.load(memory_order_relaxed);
+  }
+
+  size_t get_overrun_count(size_t device_index) const noexcept {
+    return _devices.at(device_index)->overruns.load(memory_order_relaxed);
+  }
+
+private:
+  struct _device_state {
+    _DeviceType* device = nullptr;
+    index_type num_input_channels = 0;
+    index_type num_output_channels = 0;
+    index_type first_input_channel = 0;
+    index_type first_output_channel = 0;
+    double nominal_sample_rate = 0;
+    audio_clock_estimator clock;
+    __triple_buffer<audio_clock_estimate> published_clock;
+
+    // Only used for devices other than the master. The input FIFO is written by the
+    // device's thread and read by the master's, the output FIFO the other way round.
+    unique_ptr<__audio_frame_fifo<_SampleType>> input_fifo;
+    unique_ptr<__audio_frame_fifo<_SampleType>> output_fifo;
+    optional<audio_resampler<_SampleType>> input_resampler;
+    optional<audio_resampler<_SampleType>> output_resampler;
+    index_type target_fill = 0;
+    double average_input_fill = 0;
+    double average_output_fill = 0;
+    bool input_primed = false;
+    bool output_primed = false;
+
+    atomic<double> input_ratio = 1.0;
+    atomic<double> output_ratio = 1.0;
+    atomic<size_t> underruns = 0;
+    atomic<size_t> overruns = 0;
+  };
+
+  _device_state& _master() noexcept {
+    return *_devices[_master_index];
+  }
+
+  const _device_state& _master() const noexcept {
+    return *_devices[_master_index];
+  }
+
+  void _prepare() {
+    const double master_rate = double(_master().device->get_sample_rate());
+    const auto master_period = index_type(_master().device->get_buffer_size_frames());
+    _max_block_frames = max<index_type>(2 * master_period, _min_block_frames);
+
+    _input_scratch.assign(_num_input_channels * _max_block_frames, _SampleType{});
+    _output_scratch.assign(_num_output_channels * _max_block_frames, _SampleType{});
+    _input_channels.resize(_num_input_channels);
+    _output_channels.resize(_num_output_channels);
+    for (index_type channel = 0; channel < _num_input_channels; ++channel)
+      _input_channels[channel] = _input_scratch.data() + channel * _max_block_frames;
+    for (index_type channel = 0; channel < _num_output_channels; ++channel)
+      _output_channels[channel] = _output_scratch.data() + channel * _max_block_frames;
+
+    for (size_t i = 0; i < _devices.size(); ++i) {
+      auto& state = *_devices[i];
+      state.nominal_sample_rate = double(state.device->get_sample_rate());
+      state.clock.set_nominal_sample_rate(state.nominal_sample_rate);
+      state.underruns = 0;
+      state.overruns = 0;
+
+      if (i == _master_index)
+        continue;
+
+      // Aim for enough buffered frames to ride out one period of each device plus jitter.
+      const double rate_ratio = state.nominal_sample_rate / master_rate;
+      const auto master_period_in_device_frames = index_type(ceil(double(master_period) * rate_ratio));
+      const auto device_period = index_type(state.device->get_buffer_size_frames());
+      state.target_fill = (master_period_in_device_frames + device_period) * 3 / 2;
+      const auto fifo_capacity = 4 * (state.target_fill + device_period + master_period_in_device_frames);
+
+      if (state.num_input_channels > 0) {
+        state.input_fifo = make_unique<__audio_frame_fifo<_SampleType>>(state.num_input_channels, fifo_capacity);
+        state.input_resampler.emplace(state.nominal_sample_rate, master_rate, state.num_input_channels,
+                                      _quality, audio_resampler_mode::variable_ratio);
+        state.input_ratio = 1.0 / rate_ratio;
+        state.input_primed = false;
+      }
+
+      if (state.num_output_channels > 0) {
+        state.output_fifo = make_unique<__audio_frame_fifo<_SampleType>>(state.num_output_channels, fifo_capacity);
+        state.output_resampler.emplace(master_rate, state.nominal_sample_rate, state.num_output_channels,
+                                       _quality, audio_resampler_mode::variable_ratio);
+        state.output_ratio = rate_ratio;
+        state.output_primed = false;
+      }
+    }
+  }
+
+  void _stop_devices() {
+    _master().device->stop();
+    for (size_t i = 0; i < _devices.size(); ++i) {
+      if (i != _master_index)
+        _devices[i]->device->stop();
+    }
+  }
+
+  static void _update_clock(_device_state& state, const audio_device_io<_SampleType>& io, index_type num_frames) noexcept {
+    const auto& time = io.output_time.has_value() ? io.output_time : io.input_time;
+    state.clock.update(time.has_value() ? *time : audio_clock_t::now(), num_frames);
+  }
+
+  static index_type _num_frames(const audio_device_io<_SampleType>& io) noexcept {
+    return io.output_buffer.has_value() ? io.output_buffer->size_frames()
+         : io.input_buffer.has_value() ? io.input_buffer->size_frames()
+         : 0;
+  }
+
+  // Copies num_frames frames and the first min(#channels) channels between two buffers.
+  static void _copy_frames(const audio_buffer<_SampleType>& from, index_type from_frame,
+                           audio_buffer<_SampleType>& to, index_type to_frame,
+                           index_type num_frames) noexcept {
+    const index_type num_channels = min(from.size_channels(), to.size_channels());
+    for (index_type channel = 0; channel < num_channels; ++channel)
+      for (index_type frame = 0; frame < num_frames; ++frame)
+        to(to_frame + frame, channel) = from(from_frame + frame, channel);
+  }
+
+  // A view of some of the scratch channels, starting at the given frame.
+  audio_buffer<_SampleType> _scratch_view(vector<_SampleType*>& channels, index_type first_channel,
+                                          index_type num_channels, index_type first_frame,
+                                          index_type num_frames) noexcept {
+    array<_SampleType*, _max_num_channels> pointers = {};
+
+    for (index_type channel = 0; channel < num_channels; ++channel)
+      pointers[channel] = channels[first_channel + channel] + first_frame;
+
+    return {pointers.data(), num_frames, num_channels, ptr_to_ptr_deinterleaved};
+  }
+
+  void _process_slave(_device_state& state, audio_device_io<_SampleType>& io) noexcept {
+    const index_type num_frames = _num_frames(io);
+    _update_clock(state, io, num_frames);
+
+    if (io.input_buffer.has_value() && state.input_fifo) {
+      auto regions = state.input_fifo->prepare_write(num_frames);
+      _copy_frames(*io.input_buffer, 0, regions.first, 0, regions.first.size_frames());
+      _copy_frames(*io.input_buffer, regions.first.size_frames(), regions.second, 0, regions.second.size_frames());
+      state.input_fifo->commit_write(regions.size_frames());
+
+      if (regions.size_frames() < num_frames)
+        ++state.overruns;
+    }
+
+    if (io.output_buffer.has_value() && state.output_fifo) {
+      auto& out = *io.output_buffer;
+      index_type frames_read = 0;
+
+      if (!state.output_primed && state.output_fifo->size() >= state.target_fill)
+        state.output_primed = true;
+
+      if (state.output_primed) {
+        auto regions = state.output_fifo->prepare_read(num_frames);
+        _copy_frames(regions.first, 0, out, 0, regions.first.size_frames());
+        _copy_frames(regions.second, 0, out, regions.first.size_frames(), regions.second.size_frames());
+        state.output_fifo->commit_read(regions.size_frames());
+        frames_read = regions.size_frames();
+
+        if (frames_read < num_frames) {
+          ++state.underruns;
+          state.output_primed = false;
+        }
+      }
+
+      // Silence what the FIFO did not provide, including channels left out of the aggregate.
+      for (index_type channel = 0; channel < out.size_channels(); ++channel)
+        for (index_type frame = channel < state.num_output_channels ? frames_read : 0; frame < num_frames; ++frame)
+          out(frame, channel) = _SampleType{};
+    }
+  }
+
+  void _process_master(audio_device_io<_SampleType>& io) noexcept {
+    auto& master = _master();
+    const index_type num_frames = _num_frames(io);
+    _update_clock(master, io, num_frames);
+
+    for (index_type offset = 0; offset < num_frames; offset += _max_block_frames) {
+      const index_type block_frames = min(num_frames - offset, _max_block_frames);
+
+      if (io.input_buffer.has_value() && master.num_input_channels > 0) {
+        auto view = _scratch_view(_input_channels, master.first_input_channel, master.num_input_channels, 0, block_frames);
+        _copy_frames(*io.input_buffer, offset, view, 0, block_frames);
+      }
+
+      for (size_t i = 0; i < _devices.size(); ++i) {
+        if (i != _master_index && _devices[i]->input_fifo)
+          _pull_input(*_devices[i], block_frames);
+      }
+
+      fill(_output_scratch.begin(), _output_scratch.end(), _SampleType{});
+
+      audio_device_io<_SampleType> aggregate_io;
+      aggregate_io.input_time = io.input_time;
+      aggregate_io.output_time = io.output_time;
+      if (_num_input_channels > 0)
+        aggregate_io.input_buffer = audio_buffer<_SampleType>(_input_channels.data(), block_frames, _num_input_channels, ptr_to_ptr_deinterleaved);
+      if (_num_output_channels > 0)
+        aggregate_io.output_buffer = audio_buffer<_SampleType>(_output_channels.data(), block_frames, _num_output_channels, ptr_to_ptr_deinterleaved);
+
+      if (_user_callback)
+        invoke(_user_callback, *this, aggregate_io);
+
+      if (io.output_buffer.has_value() && master.num_output_channels > 0) {
+        auto view = _scratch_view(_output_channels, master.first_output_channel, master.num_output_channels, 0, block_frames);
+        _copy_frames(view, 0, *io.output_buffer, offset, block_frames);
+      }
+
+      for (size_t i = 0; i < _devices.size(); ++i) {
+        if (i != _master_index && _devices[i]->output_fifo)
+          _push_output(*_devices[i], block_frames);
+      }
+    }
+
+    _update_resampling_ratios();
+  }
+
+  // Resamples num_frames frames at the master rate out of the device's input FIFO
+  // into its channels of the input scratch buffer.
+  void _pull_input(_device_state& state, index_type num_frames) noexcept {
+    auto& fifo = *state.input_fifo;
+    index_type frames_produced = 0;
+
+    if (!state.input_primed && fifo.size() >= state.target_fill) {
+      state.input_primed = true;
+      state.average_input_fill = double(fifo.size());
+    }
+
+    while (state.input_primed && frames_produced < num_frames) {
+      auto regions = fifo.prepare_read(fifo.size());
+      if (regions.size_frames() == 0) {
+        ++state.underruns;
+        state.input_primed = false;
+        break;
+      }
+
+      auto out = _scratch_view(_input_channels, state.first_input_channel, state.num_input_channels,
+                               frames_produced, num_frames - frames_produced);
+      auto result = state.input_resampler->process(regions.first, out);
+      fifo.commit_read(result.input_frames);
+      frames_produced += result.output_frames;
+    }
+
+    for (index_type channel = 0; channel < state.num_input_channels; ++channel) {
+      auto* samples = _input_channels[state.first_input_channel + channel];
+      fill(samples + frames_produced, samples + num_frames, _SampleType{});
+    }
+  }
+
+  // Resamples num_frames frames of the device's channels in the output scratch buffer
+  // to the device rate and queues them in its output FIFO.
+  void _push_output(_device_state& state, index_type num_frames) noexcept {
+    auto& fifo = *state.output_fifo;
+    index_type frames_consumed = 0;
+
+    while (frames_consumed < num_frames) {
+      auto regions = fifo.prepare_write(fifo.space());
+      if (regions.size_frames() == 0) {
+        ++state.overruns;
+        break;
+      }
+
+      auto in = _scratch_view(_output_channels, state.first_output_channel, state.num_output_channels,
+                              frames_consumed, num_frames - frames_consumed);
+      auto result = state.output_resampler->process(in, regions.first);
+      fifo.commit_write(result.output_frames);
+      frames_consumed += result.input_frames;
+    }
+  }
+
+  static void _publish_clock(_device_state& state, const audio_clock_estimate& estimate) noexcept {
+    state.published_clock.write_buffer() = estimate;
+    state.published_clock.publish();
+  }
+
+  void _update_resampling_ratios() noexcept {
+    const auto master_clock = _master().clock.get_estimate();
+    const double master_rate = _master().nominal_sample_rate;
+    _publish_clock(_master(), master_clock);
+
+    for (size_t i = 0; i < _devices.size(); ++i) {
+      if (i == _master_index)
+        continue;
+
+      auto& state = *_devices[i];
+      const auto device_clock = state.clock.get_estimate();
+      _publish_clock(state, device_clock);
+
+      // Feed forward the measured drift between the two clocks once both estimates have settled...
+      double drift = 1.0;
+      if (master_clock.num_periods > _min_clock_periods && device_clock.num_periods > _min_clock_periods)
+        drift = master_clock.rate_ratio / device_clock.rate_ratio;
+
+      // ...and steer the FIFO towards its target fill level to correct the remaining error.
+      auto correction = [&](double& average_fill, index_type fill) {
+        average_fill += _fill_smoothing * (double(fill) - average_fill);
+        const double error = (average_fill - double(state.target_fill)) / (_fill_time_constant_seconds * state.nominal_sample_rate);
+        return 1.0 - clamp(error, -_max_correction, _max_correction);
+      };
+
+      if (state.input_fifo && state.input_primed) {
+        const double ratio = master_rate / state.nominal_sample_rate * drift
+                           * correction(state.average_input_fill, state.input_fifo->size());
+        state.input_resampler->set_ratio(ratio);
+        state.input_ratio.store(ratio, memory_order_relaxed);
+      }
+
+      if (state.output_fifo) {
+        const double ratio = state.nominal_sample_rate / master_rate / drift
+                           * correction(state.average_output_fill, state.output_fifo->size());
+        state.output_resampler->set_ratio(ratio);
+        state.output_ratio.store(ratio, memory_order_relaxed);
+      }
+    }
+  }
+
+  static constexpr index_type _min_block_frames = 1024;
+  static constexpr index_type _max_num_channels = audio_buffer<_SampleType>::max_num_channels;
+  static constexpr uint64_t _min_clock_periods = 100;
+  static constexpr double _fill_smoothing = 0.01;
+  static constexpr double _fill_time_constant_seconds = 1.0;
+  static constexpr double _max_correction = 0.01;
+
+  vector<unique_ptr<_device_state>> _devices;
+  size_t _master_index = 0;
+  audio_resampler_quality _quality;
+  index_type _num_input_channels = 0;
+  index_type _num_output_channels = 0;
+  bool _running = false;
+
+  index_type _max_block_frames = 0;
+  vector<_SampleType> _input_scratch;
+  vector<_SampleType> _output_scratch;
+  vector<_SampleType*> _input_channels;
+  vector<_SampleType*> _output_channels;
+
+  using __aggregate_callback_t = function<void(audio_aggregate_device&, audio_device_io<_SampleType>&)>;
+  __aggregate_callback_t _user_callback;
+};
+
+_LIBSTDAUDIO_NAMESPACE_END
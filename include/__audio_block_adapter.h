@@ -0,0 +1,170 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <cassert>
+#include <functional>
+#include <vector>
+
+_LIBSTDAUDIO_NAMESPACE_BEGIN
+
+// Wraps a callback so that it is always called with exactly block_size() frames,
+// however many frames the device delivers per period. Input is collected and output is
+// played back through internal FIFOs, which adds latency_frames() of latency in both
+// directions. All memory is allocated in the constructor.
+//
+// The callback receives contiguous deinterleaved buffers with the channel counts
+// passed to the constructor. Device channels beyond those are ignored on input and
+// silent on output. Timestamps are not forwarded, since blocks straddle periods.
+template <typename _SampleType, typename _CallbackType>
+class audio_block_adapter {
+public:
+  using sample_type = _SampleType;
+  using index_type = typename audio_buffer<_SampleType>::index_type;
+
+  audio_block_adapter(index_type block_size,
+                      index_type num_input_channels,
+                      index_type num_output_channels,
+                      _CallbackType callback)
+    : _callback(move(callback)),
+      _block_size(block_size),
+      _num_input_channels(num_input_channels),
+      _num_output_channels(num_output_channels),
+      _input_fifo(block_size * num_input_channels),
+      _output_block(block_size * num_output_channels),
+      _output_fifo(2 * block_size * num_output_channels) {
+    assert(block_size > 0 && (block_size & (block_size - 1)) == 0);
+    reset();
+  }
+
+  index_type block_size() const noexcept {
+    return _block_size;
+  }
+
+  index_type latency_frames() const noexcept {
+    return _block_size - 1;
+  }
+
+  void reset() noexcept {
+    fill(_input_fifo.begin(), _input_fifo.end(), _SampleType{});
+    fill(_output_fifo.begin(), _output_fifo.end(), _SampleType{});
+    _input_count = 0;
+    _output_read_pos = 0;
+    _output_count = latency_frames();
+  }
+
+  template <typename _DeviceType>
+  void operator()(_DeviceType& device, audio_device_io<_SampleType>& io) noexcept {
+    const index_type num_frames = io.output_buffer.has_value() ? io.output_buffer->size_frames()
+                                : io.input_buffer.has_value() ? io.input_buffer->size_frames()
+                                : 0;
+
+    // Invariant between chunks: _input_count + _output_count == latency_frames(),
+    // so the output FIFO never runs dry and never holds more than 2 * block_size frames.
+    for (index_type pos = 0; pos < num_frames;) {
+      const index_type chunk = min(num_frames - pos, _block_size - _input_count);
+
+      _push_input(io.input_buffer, pos, chunk);
+      if (_input_count == _block_size)
+        _process_block(device);
+
+      _pop_output(io.output_buffer, pos, chunk);
+      pos += chunk;
+    }
+  }
+
+private:
+  void _push_input(optional<audio_buffer<_SampleType>>& input, index_type pos, index_type num_frames) noexcept {
+    const index_type num_device_channels = input.has_value() ? input->size_channels() : 0;
+
+    for (index_type channel = 0; channel < _num_input_channels; ++channel) {
+      _SampleType* dest = _input_fifo.data() + channel * _block_size + _input_count;
+
+      if (channel < num_device_channels) {
+        for (index_type frame = 0; frame < num_frames; ++frame)
+          dest[frame] = (*input)(pos + frame, channel);
+      }
+      else {
+        fill(dest, dest + num_frames, _SampleType{});
+      }
+    }
+
+    _input_count += num_frames;
+  }
+
+  template <typename _DeviceType>
+  void _process_block(_DeviceType& device) noexcept {
+    audio_device_io<_SampleType> block_io;
+
+    if (_num_input_channels > 0)
+      block_io.input_buffer = audio_buffer<_SampleType>(_input_fifo.data(), _block_size, _num_input_channels, contiguous_deinterleaved);
+
+    if (_num_output_channels > 0)
+      block_io.output_buffer = audio_buffer<_SampleType>(_output_block.data(), _block_size, _num_output_channels, contiguous_deinterleaved);
+
+    invoke(_callback, device, block_io);
+    _input_count = 0;
+
+    const index_type capacity = 2 * _block_size;
+    const index_type write_pos = (_output_read_pos + _output_count) & (capacity - 1);
+    const index_type first_part = min(_block_size, capacity - write_pos);
+
+    for (index_type channel = 0; channel < _num_output_channels; ++channel) {
+      const _SampleType* src = _output_block.data() + channel * _block_size;
+      _SampleType* dest = _output_fifo.data() + channel * capacity;
+      copy(src, src + first_part, dest + write_pos);
+      copy(src + first_part, src + _block_size, dest);
+    }
+
+    _output_count += _block_size;
+  }
+
+  void _pop_output(optional<audio_buffer<_SampleType>>& output, index_type pos, index_type num_frames) noexcept {
+    assert(_output_count >= num_frames);
+
+    const index_type capacity = 2 * _block_size;
+
+    if (output.has_value()) {
+      for (index_type channel = 0; channel < output->size_channels(); ++channel) {
+        if (channel < _num_output_channels) {
+          const _SampleType* src = _output_fifo.data() + channel * capacity;
+          for (index_type frame = 0; frame < num_frames; ++frame)
+            (*output)(pos + frame, channel) = src[(_output_read_pos + frame) & (capacity - 1)];
+        }
+        else {
+          for (index_type frame = 0; frame < num_frames; ++frame)
+            (*output)(pos + frame, channel) = _SampleType{};
+        }
+      }
+    }
+
+    _output_read_pos = (_output_read_pos + num_frames) & (capacity - 1);
+    _output_count -= num_frames;
+  }
+
+  _CallbackType _callback;
+  index_type _block_size = 0;
+  index_type _num_input_channels = 0;
+  index_type _num_output_channels = 0;
+
+  vector<_SampleType> _input_fifo;
+  vector<_SampleType> _output_block;
+  vector<_SampleType> _output_fifo;
+  index_type _input_count = 0;
+  index_type _output_read_pos = 0;
+  index_type _output_count = 0;
+};
+
+template <typename _SampleType, typename _CallbackType>
+audio_block_adapter<_SampleType, decay_t<_CallbackType>> make_audio_block_adapter(
+    typename audio_buffer<_SampleType>::index_type block_size,
+    typename audio_buffer<_SampleType>::index_type num_input_channels,
+    typename audio_buffer<_SampleType>::index_type num_output_channels,
+    _CallbackType&& callback) {
+  return {block_size, num_input_channels, num_output_channels, forward<_CallbackType>(callback)};
+}
+
+_LIBSTDAUDIO_NAMESPACE_END
@@ -5,8 +5,11 @@
 
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <cassert>
 #include <chrono>
+#include <utility>
 
 _LIBSTDAUDIO_NAMESPACE_BEGIN
 
@@ -25,12 +28,16 @@ public:
   using sample_type = _SampleType;
   using index_type = size_t;
 
+  // The most channels a buffer can view. Devices and everything that wraps their
+  // buffers are limited to this.
+  static constexpr index_type max_num_channels = 128;
+
   audio_buffer(sample_type* data, index_type num_frames, index_type num_channels, contiguous_interleaved_t)
     : _num_frames(num_frames),
       _num_channels(num_channels),
       _stride(_num_channels),
       _is_contiguous(true) {
-    assert (num_channels <= _max_num_channels);
+    assert (num_channels <= max_num_channels);
     for (auto i = 0; i < _num_channels; ++i) {
       _channels[i] = data + i;
     }
@@ -41,7 +48,7 @@ public:
         _num_channels(num_channels),
         _stride(1),
         _is_contiguous(true) {
-    assert (num_channels <= _max_num_channels);
+    assert (num_channels <= max_num_channels);
     for (auto i = 0; i < _num_channels; ++i) {
       _channels[i] = data + (i * _num_frames);
     }
@@ -52,7 +59,7 @@ public:
         _num_channels(num_channels),
         _stride(1),
         _is_contiguous(false) {
-    assert (num_channels <= _max_num_channels);
+    assert (num_channels <= max_num_channels);
     copy (data, data + _num_channels, _channels.begin());
   }
 
@@ -97,8 +104,7 @@ private:
   index_type _num_frames = 0;
   index_type _num_channels = 0;
   index_type _stride = 0;
-  constexpr static size_t _max_num_channels = 16;
-  std::array<sample_type*, _max_num_channels> _channels = {};
+  std::array<sample_type*, max_num_channels> _channels = {};
 };
 
 // TODO: this is currently macOS specific!
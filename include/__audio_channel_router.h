@@ -0,0 +1,345 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <type_traits>
+#include <vector>
+#include <__audio_simd.h>
+
+_LIBSTDAUDIO_NAMESPACE_BEGIN
+
+// Standard channel layouts, with their channels in the order of the WAVE channel mask.
+enum class audio_channel_layout {
+  mono,          // M
+  stereo,        // L, R
+  quad,          // L, R, Ls, Rs
+  surround_5_1,  // L, R, C, LFE, Ls, Rs
+  surround_7_1,  // L, R, C, LFE, Lb, Rb, Ls, Rs
+};
+
+inline size_t get_audio_channel_layout_size(audio_channel_layout layout) noexcept {
+  switch (layout) {
+    case audio_channel_layout::mono: return 1;
+    case audio_channel_layout::stereo: return 2;
+    case audio_channel_layout::quad: return 4;
+    case audio_channel_layout::surround_5_1: return 6;
+    case audio_channel_layout::surround_7_1: return 8;
+  }
+
+  return 0;
+}
+
+// The largest standard layout that fits into the given number of channels.
+inline audio_channel_layout get_audio_channel_layout_for_size(size_t num_channels) noexcept {
+  if (num_channels >= 8) return audio_channel_layout::surround_7_1;
+  if (num_channels >= 6) return audio_channel_layout::surround_5_1;
+  if (num_channels >= 4) return audio_channel_layout::quad;
+  if (num_channels >= 2) return audio_channel_layout::stereo;
+  return audio_channel_layout::mono;
+}
+
+// Maps the channels of a source buffer onto those of a (device) buffer through a
+// matrix of gains: output channel o is the sum over all input channels i of
+// get_gain(o, i) times input channel i. The matrix starts out as the identity (the
+// first channels routed straight through, the rest silent), or as the conversion
+// between two standard layouts:
+//  - mono is copied to L and R, or to C where there is one;
+//  - C, surround and back channels that the output lacks are folded into its
+//    front or surround channels at -3 dB (ITU-R BS.775), and LFE is dropped;
+//  - to mono, L and R are averaged after folding the input down to stereo.
+//
+// The zero gains are skipped, so sparse matrices cost no more than the channels
+// they actually mix, and a matrix of only zeros and single unit gains per output is
+// processed as pure routing, which just copies samples. Mixing runs through the
+// SIMD kernels on whole channels; buffers whose channels are not contiguous are
+// deinterleaved into scratch memory for that, in blocks of up to max_block_frames.
+// All memory is allocated in the constructor; the gains must not be changed while
+// process() runs.
+template <typename _SampleType = float>
+class audio_channel_router {
+public:
+  static_assert(is_floating_point_v<_SampleType>, "audio_channel_router requires a floating-point sample type");
+
+  using sample_type = _SampleType;
+  using index_type = typename audio_buffer<_SampleType>::index_type;
+
+  audio_channel_router(index_type num_input_channels, index_type num_output_channels, index_type max_block_frames = 1024)
+    : _num_input_channels(num_input_channels),
+      _num_output_channels(num_output_channels),
+      _max_block_frames(max_block_frames),
+      _gains(num_input_channels * num_output_channels),
+      _rows(num_output_channels),
+      _is_input_used(num_input_channels),
+      _input_scratch(num_input_channels * max_block_frames),
+      _output_scratch(max_block_frames) {
+    assert(num_input_channels > 0 && num_output_channels > 0 && max_block_frames > 0);
+    _entries.reserve(num_input_channels * num_output_channels);
+
+    for (index_type channel = 0; channel < min(num_input_channels, num_output_channels); ++channel)
+      _gains[channel * num_input_channels + channel] = 1.0f;
+
+    _update();
+  }
+
+  audio_channel_router(audio_channel_layout input_layout, audio_channel_layout output_layout, index_type max_block_frames = 1024)
+    : audio_channel_router(input_layout, get_audio_channel_layout_size(output_layout), max_block_frames) {
+  }
+
+  // Converts to the largest standard layout that fits into num_output_channels, e.g.
+  // the channel count of a device; any further output channels stay silent.
+  audio_channel_router(audio_channel_layout input_layout, index_type num_output_channels, index_type max_block_frames = 1024)
+    : audio_channel_router(get_audio_channel_layout_size(input_layout), num_output_channels, max_block_frames) {
+    const auto output_layout = get_audio_channel_layout_for_size(num_output_channels);
+    const auto input_roles = _get_roles(input_layout);
+    const auto output_roles = _get_roles(output_layout);
+
+    fill(_gains.begin(), _gains.end(), 0.0f);
+    for (index_type input = 0; input < _num_input_channels; ++input) {
+      for (const auto& target : _fold(input_roles[input], output_roles)) {
+        if (target.gain != 0.0f)
+          _gains[target.channel * _num_input_channels + input] += target.gain;
+      }
+    }
+
+    _update();
+  }
+
+  index_type num_input_channels() const noexcept {
+    return _num_input_channels;
+  }
+
+  index_type num_output_channels() const noexcept {
+    return _num_output_channels;
+  }
+
+  float get_gain(index_type output_channel, index_type input_channel) const noexcept {
+    assert(output_channel < _num_output_channels && input_channel < _num_input_channels);
+    return _gains[output_channel * _num_input_channels + input_channel];
+  }
+
+  void set_gain(index_type output_channel, index_type input_channel, float gain) noexcept {
+    assert(output_channel < _num_output_channels && input_channel < _num_input_channels);
+    _gains[output_channel * _num_input_channels + input_channel] = gain;
+    _update();
+  }
+
+  // Sets all gains to zero.
+  void clear() noexcept {
+    fill(_gains.begin(), _gains.end(), 0.0f);
+    _update();
+  }
+
+  // Whether every output channel is either silent or a copy of one input channel.
+  bool is_pure_routing() const noexcept {
+    return _is_pure_routing;
+  }
+
+  // Overwrites output with the routed input. The two buffers need the same number of
+  // frames and must not overlap.
+  void process(const audio_buffer<_SampleType>& input, audio_buffer<_SampleType>& output) noexcept {
+    assert(input.size_channels() == _num_input_channels && output.size_channels() == _num_output_channels);
+    assert(input.size_frames() == output.size_frames());
+
+    const index_type num_frames = input.size_frames();
+    if (num_frames == 0)
+      return;
+
+    const bool channels_are_contiguous = input.channels_are_contiguous() && output.channels_are_contiguous();
+
+    if (_is_pure_routing && !channels_are_contiguous) {
+      _route(input, output);
+      return;
+    }
+
+    if (channels_are_contiguous) {
+      for (index_type channel = 0; channel < _num_output_channels; ++channel) {
+        _mix(channel, [&](index_type input_channel) { return &input(0, input_channel); }, &output(0, channel), num_frames);
+      }
+
+      return;
+    }
+
+    for (index_type offset = 0; offset < num_frames; offset += _max_block_frames) {
+      const index_type block_frames = min(num_frames - offset, _max_block_frames);
+
+      for (index_type channel = 0; channel < _num_input_channels; ++channel) {
+        if (!_is_input_used[channel])
+          continue;
+
+        _SampleType* scratch = _input_scratch.data() + channel * _max_block_frames;
+        for (index_type frame = 0; frame < block_frames; ++frame)
+          scratch[frame] = input(offset + frame, channel);
+      }
+
+      for (index_type channel = 0; channel < _num_output_channels; ++channel) {
+        _mix(channel, [&](index_type input_channel) { return _input_scratch.data() + input_channel * _max_block_frames; },
+             _output_scratch.data(), block_frames);
+
+        for (index_type frame = 0; frame < block_frames; ++frame)
+          output(offset + frame, channel) = _output_scratch[frame];
+      }
+    }
+  }
+
+private:
+  enum class _role { mono, left, right, centre, lfe, left_surround, right_surround, left_back, right_back };
+
+  struct _entry {
+    index_type input_channel;
+    _SampleType gain;
+  };
+
+  // The non-zero gains of one output channel.
+  struct _row {
+    size_t first_entry = 0;
+    size_t num_entries = 0;
+  };
+
+  struct _target {
+    size_t channel;
+    float gain;
+  };
+
+  static vector<_role> _get_roles(audio_channel_layout layout) {
+    switch (layout) {
+      case audio_channel_layout::mono:
+        return {_role::mono};
+      case audio_channel_layout::stereo:
+        return {_role::left, _role::right};
+      case audio_channel_layout::quad:
+        return {_role::left, _role::right, _role::left_surround, _role::right_surround};
+      case audio_channel_layout::surround_5_1:
+        return {_role::left, _role::right, _role::centre, _role::lfe, _role::left_surround, _role::right_surround};
+      case audio_channel_layout::surround_7_1:
+        return {_role::left, _role::right, _role::centre, _role::lfe,
+                _role::left_back, _role::right_back, _role::left_surround, _role::right_surround};
+    }
+
+    return {};
+  }
+
+  // Where a channel with the given role ends up in the output layout, and how loud.
+  static vector<_target> _fold(_role role, const vector<_role>& output_roles) {
+    constexpr float minus_3_db = 0.70710678f;
+
+    const auto find = [&](_role wanted) -> size_t {
+      return size_t(std::find(output_roles.begin(), output_roles.end(), wanted) - output_roles.begin());
+    };
+
+    // To mono via stereo: average whatever lands in L and R.
+    if (output_roles.size() == 1) {
+      if (role == _role::mono)
+        return {{0, 1.0f}};
+
+      float gain = 0;
+      for (const auto& target : _fold(role, {_role::left, _role::right}))
+        gain += 0.5f * target.gain;
+
+      return {{0, gain}};
+    }
+
+    if (find(role) < output_roles.size())
+      return {{find(role), 1.0f}};
+
+    switch (role) {
+      case _role::mono:
+        if (find(_role::centre) < output_roles.size())
+          return {{find(_role::centre), 1.0f}};
+        return {{find(_role::left), 1.0f}, {find(_role::right), 1.0f}};
+      case _role::centre:
+        return {{find(_role::left), minus_3_db}, {find(_role::right), minus_3_db}};
+      case _role::lfe:
+        return {};
+      case _role::left_surround:
+        return {{find(_role::left), minus_3_db}};
+      case _role::right_surround:
+        return {{find(_role::right), minus_3_db}};
+      case _role::left_back:
+        if (find(_role::left_surround) < output_roles.size())
+          return {{find(_role::left_surround), minus_3_db}};
+        return {{find(_role::left), minus_3_db}};
+      case _role::right_back:
+        if (find(_role::right_surround) < output_roles.size())
+          return {{find(_role::right_surround), minus_3_db}};
+        return {{find(_role::right), minus_3_db}};
+      default:
+        return {};
+    }
+  }
+
+  // Collects the non-zero gains of every output channel; the entries never outgrow
+  // the capacity reserved in the constructor.
+  void _update() noexcept {
+    _entries.clear();
+    fill(_is_input_used.begin(), _is_input_used.end(), false);
+    _is_pure_routing = true;
+
+    for (index_type output = 0; output < _num_output_channels; ++output) {
+      auto& row = _rows[output];
+      row.first_entry = _entries.size();
+
+      for (index_type input = 0; input < _num_input_channels; ++input) {
+        const float gain = _gains[output * _num_input_channels + input];
+        if (gain == 0.0f)
+          continue;
+
+        _entries.push_back({input, _SampleType(gain)});
+        _is_input_used[input] = true;
+      }
+
+      row.num_entries = _entries.size() - row.first_entry;
+      if (row.num_entries > 1 || (row.num_entries == 1 && _entries[row.first_entry].gain != _SampleType(1)))
+        _is_pure_routing = false;
+    }
+  }
+
+  // Writes the mix of one output channel to dst, reading the input channels through
+  // get_input(input_channel), which returns a pointer to num_frames contiguous samples.
+  template <typename _GetInputType>
+  void _mix(index_type output_channel, _GetInputType get_input, _SampleType* dst, index_type num_frames) const noexcept {
+    const auto& row = _rows[output_channel];
+    if (row.num_entries == 0) {
+      fill(dst, dst + num_frames, _SampleType(0));
+      return;
+    }
+
+    const auto* entry = _entries.data() + row.first_entry;
+    if (entry->gain == _SampleType(1))
+      copy(get_input(entry->input_channel), get_input(entry->input_channel) + num_frames, dst);
+    else
+      __simd_multiply(dst, get_input(entry->input_channel), entry->gain, num_frames);
+
+    for (size_t i = 1; i < row.num_entries; ++i)
+      __simd_accumulate(dst, get_input(entry[i].input_channel), entry[i].gain, num_frames);
+  }
+
+  // Pure routing between buffers with interleaved channels: copy sample by sample, a
+  // frame at a time.
+  void _route(const audio_buffer<_SampleType>& input, audio_buffer<_SampleType>& output) const noexcept {
+    for (index_type frame = 0; frame < input.size_frames(); ++frame) {
+      for (index_type channel = 0; channel < _num_output_channels; ++channel) {
+        const auto& row = _rows[channel];
+        output(frame, channel) = row.num_entries == 0 ? _SampleType(0) : input(frame, _entries[row.first_entry].input_channel);
+      }
+    }
+  }
+
+  index_type _num_input_channels;
+  index_type _num_output_channels;
+  index_type _max_block_frames;
+  vector<float> _gains;
+  vector<_entry> _entries;
+  vector<_row> _rows;
+  vector<bool> _is_input_used;
+  vector<_SampleType> _input_scratch;
+  vector<_SampleType> _output_scratch;
+  bool _is_pure_routing = true;
+};
+
+_LIBSTDAUDIO_NAMESPACE_END
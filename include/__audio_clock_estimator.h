@@ -0,0 +1,139 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <__audio_triple_buffer.h>
+
+_LIBSTDAUDIO_NAMESPACE_BEGIN
+
+struct audio_clock_estimate {
+  // Ratio between the measured and the nominal sample rate of the device,
+  // both relative to audio_clock_t.
+  double rate_ratio = 1.0;
+  double sample_rate = 0;
+
+  // RMS deviation of the observed period timestamps from the smoothed clock.
+  audio_clock_t::duration jitter = {};
+
+  optional<chrono::time_point<audio_clock_t>> next_period_time;
+  uint64_t num_periods = 0;
+};
+
+// Second-order delay-locked loop (see F. Adriaensen, "Using a DLL to filter time")
+// tracking the device clock against audio_clock_t. update() is meant to be called
+// once per period from the audio thread and runs in constant time without allocating;
+// get_estimate() may be called from a single other thread and never blocks.
+class audio_clock_estimator {
+public:
+  explicit audio_clock_estimator(double nominal_sample_rate = 0, double bandwidth_hz = 1.0) noexcept
+    : _nominal_sample_rate(nominal_sample_rate),
+      _bandwidth_hz(bandwidth_hz) {
+    assert(bandwidth_hz > 0);
+  }
+
+  // Must not be called concurrently with update().
+  void set_nominal_sample_rate(double nominal_sample_rate) noexcept {
+    _nominal_sample_rate = nominal_sample_rate;
+    reset();
+  }
+
+  double get_nominal_sample_rate() const noexcept {
+    return _nominal_sample_rate;
+  }
+
+  void reset() noexcept {
+    _num_periods = 0;
+    _jitter_variance = 0;
+  }
+
+  void update(chrono::time_point<audio_clock_t> period_time, size_t num_frames) noexcept {
+    if (_nominal_sample_rate <= 0 || num_frames == 0)
+      return;
+
+    if (_num_periods == 0) {
+      _start(period_time, num_frames);
+    }
+    else {
+      const double error = _seconds_since_epoch(period_time) - _predicted_time;
+      const double expected_period = _seconds_per_frame * double(_num_frames);
+
+      // A timestamp that is far off means we have missed periods or the stream was
+      // restarted; filtering across such a discontinuity would only corrupt the loop.
+      if (abs(error) > _max_error_periods * expected_period) {
+        _start(period_time, num_frames);
+      }
+      else {
+        const double omega = 2.0 * _pi * _bandwidth_hz * expected_period;
+        const double b = sqrt(2.0) * omega;
+        const double c = omega * omega;
+
+        const double filtered_time = _predicted_time + b * error;
+        _seconds_per_frame += c * error / double(_num_frames);
+        _predicted_time = filtered_time + _seconds_per_frame * double(num_frames);
+        _num_frames = num_frames;
+
+        _jitter_variance += _jitter_smoothing * (error * error - _jitter_variance);
+        ++_num_periods;
+      }
+    }
+
+    _publish();
+  }
+
+  audio_clock_estimate get_estimate() noexcept {
+    _estimates.update();
+    return _estimates.read_buffer();
+  }
+
+private:
+  void _start(chrono::time_point<audio_clock_t> period_time, size_t num_frames) noexcept {
+    _epoch = period_time;
+    _seconds_per_frame = 1.0 / _nominal_sample_rate;
+    _predicted_time = _seconds_per_frame * double(num_frames);
+    _num_frames = num_frames;
+    _jitter_variance = 0;
+    _num_periods = 1;
+  }
+
+  void _publish() noexcept {
+    auto& estimate = _estimates.write_buffer();
+    estimate.sample_rate = 1.0 / _seconds_per_frame;
+    estimate.rate_ratio = estimate.sample_rate / _nominal_sample_rate;
+    estimate.jitter = _to_duration(sqrt(_jitter_variance));
+    estimate.next_period_time = _epoch + _to_duration(_predicted_time);
+    estimate.num_periods = _num_periods;
+    _estimates.publish();
+  }
+
+  double _seconds_since_epoch(chrono::time_point<audio_clock_t> time) const noexcept {
+    return chrono::duration<double>(time - _epoch).count();
+  }
+
+  static audio_clock_t::duration _to_duration(double seconds) noexcept {
+    return chrono::duration_cast<audio_clock_t::duration>(chrono::duration<double>(seconds));
+  }
+
+  static constexpr double _pi = 3.14159265358979323846;
+  static constexpr double _max_error_periods = 2.0;
+  static constexpr double _jitter_smoothing = 0.01;
+
+  double _nominal_sample_rate = 0;
+  double _bandwidth_hz = 1.0;
+
+  chrono::time_point<audio_clock_t> _epoch = {};
+  double _predicted_time = 0;
+  double _seconds_per_frame = 0;
+  double _jitter_variance = 0;
+  size_t _num_frames = 0;
+  uint64_t _num_periods = 0;
+
+  __triple_buffer<audio_clock_estimate> _estimates;
+};
+
+_LIBSTDAUDIO_NAMESPACE_END
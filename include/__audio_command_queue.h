@@ -0,0 +1,278 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+_LIBSTDAUDIO_NAMESPACE_BEGIN
+
+// Bounded multi-producer, single-consumer queue for sending commands to the audio
+// thread (after Dmitry Vyukov's bounded MPMC queue). Pushing may happen from any number
+// of threads and is lock-free but not wait-free: a push retries its compare-and-swap
+// for as long as other pushes keep winning it. Popping must happen on one thread only
+// and never loops, but a producer preempted in the middle of its push holds back the
+// commands behind it until it resumes. Nothing is allocated after construction.
+template <typename _CommandType>
+class audio_command_queue {
+public:
+  static_assert(is_default_constructible_v<_CommandType> && is_move_assignable_v<_CommandType>,
+                "audio_command_queue requires default-constructible, move-assignable commands");
+
+  explicit audio_command_queue(size_t min_capacity)
+    : _cells(_round_up_to_power_of_two(min_capacity)),
+      _mask(_cells.size() - 1) {
+    for (size_t i = 0; i < _cells.size(); ++i)
+      _cells[i].sequence.store(i, memory_order_relaxed);
+  }
+
+  audio_command_queue(const audio_command_queue&) = delete;
+  audio_command_queue& operator=(const audio_command_queue&) = delete;
+
+  size_t capacity() const noexcept {
+    return _cells.size();
+  }
+
+  // Any thread; fails if the queue is full. Lock-free, see above.
+  bool try_push(_CommandType command) noexcept(is_nothrow_move_assignable_v<_CommandType>) {
+    auto position = _enqueue_position.load(memory_order_relaxed);
+    _cell* cell;
+
+    for (;;) {
+      cell = &_cells[position & _mask];
+      const auto sequence = cell->sequence.load(memory_order_acquire);
+      const auto difference = intptr_t(sequence) - intptr_t(position);
+
+      if (difference == 0) {
+        if (_enqueue_position.compare_exchange_weak(position, position + 1, memory_order_relaxed))
+          break;
+      }
+      else if (difference < 0) {
+        return false;
+      }
+      else {
+        position = _enqueue_position.load(memory_order_relaxed);
+      }
+    }
+
+    cell->command = move(command);
+    cell->sequence.store(position + 1, memory_order_release);
+    return true;
+  }
+
+  // Consumer only; fails if the queue is empty (or the oldest push is still in progress).
+  bool try_pop(_CommandType& command) noexcept(is_nothrow_move_assignable_v<_CommandType>) {
+    auto& cell = _cells[_dequeue_position & _mask];
+    if (cell.sequence.load(memory_order_acquire) != _dequeue_position + 1)
+      return false;
+
+    command = move(cell.command);
+    cell.sequence.store(_dequeue_position + _mask + 1, memory_order_release);
+    ++_dequeue_position;
+    return true;
+  }
+
+  // Consumer only; calls handler(command) for every command that is currently in the
+  // queue and returns how many there were. Bounded by the capacity of the queue.
+  template <typename _HandlerType>
+  size_t drain(_HandlerType&& handler) {
+    _CommandType command;
+    size_t count = 0;
+
+    while (count < _cells.size() && try_pop(command)) {
+      handler(command);
+      ++count;
+    }
+
+    return count;
+  }
+
+private:
+  struct _cell {
+    atomic<size_t> sequence = 0;
+    _CommandType command;
+  };
+
+  static size_t _round_up_to_power_of_two(size_t n) noexcept {
+    size_t result = 1;
+    while (result < n)
+      result *= 2;
+
+    return result;
+  }
+
+  vector<_cell> _cells;
+  size_t _mask = 0;
+  alignas(64) atomic<size_t> _enqueue_position = 0;
+  alignas(64) size_t _dequeue_position = 0;
+};
+
+template <typename _PayloadType>
+struct audio_event {
+  _PayloadType payload = {};
+
+  // When the event should take effect; events without a time apply at the start
+  // of the next period.
+  optional<audio_clock_t::time_point> time;
+};
+
+// Timestamped events for the audio thread. process() drains the queue at the start
+// of a period, converts event times into frame offsets within the period and splits
+// the period at those offsets, so that parameter changes apply sample-accurately.
+// Events that belong to a later period are kept until then.
+template <typename _PayloadType>
+class audio_event_queue {
+public:
+  explicit audio_event_queue(size_t min_capacity)
+    : _queue(min_capacity) {
+    _pending.reserve(_queue.capacity());
+  }
+
+  // Any thread. Lock-free, like audio_command_queue::try_push().
+  bool push(_PayloadType payload, optional<audio_clock_t::time_point> time = nullopt) {
+    return _queue.try_push({move(payload), time});
+  }
+
+  // Audio thread. Calls render(first_frame, last_frame) for each part of the period
+  // between events and handle_event(payload) at each event, in time order.
+  // period_time is the time of the first frame, sample_rate the device sample rate.
+  template <typename _EventHandlerType, typename _RenderFunctionType>
+  void process(size_t num_frames, optional<audio_clock_t::time_point> period_time, double sample_rate,
+               _EventHandlerType&& handle_event, _RenderFunctionType&& render) {
+    audio_event<_PayloadType> event;
+    while (_pending.size() < _pending.capacity() && _queue.try_pop(event)) {
+      // Keep events sorted by time and events with equal times in the order they arrived.
+      auto position = upper_bound(_pending.begin(), _pending.end(), event, [](const auto& a, const auto& b) {
+        return _sort_key(a) < _sort_key(b);
+      });
+      _pending.insert(position, move(event));
+    }
+
+    size_t frame = 0;
+    size_t num_handled = 0;
+
+    for (; num_handled < _pending.size(); ++num_handled) {
+      auto& next = _pending[num_handled];
+      const auto offset = max(frame, _frame_offset(next.time, period_time, sample_rate));
+      if (offset >= num_frames)
+        break;
+
+      if (offset > frame) {
+        render(frame, offset);
+        frame = offset;
+      }
+
+      handle_event(next.payload);
+    }
+
+    if (frame < num_frames)
+      render(frame, num_frames);
+
+    _pending.erase(_pending.begin(), _pending.begin() + ptrdiff_t(num_handled));
+  }
+
+  // Convenience overload that takes the period from a device callback.
+  template <typename _SampleType, typename _EventHandlerType, typename _RenderFunctionType>
+  void process(const audio_device_io<_SampleType>& io, double sample_rate,
+               _EventHandlerType&& handle_event, _RenderFunctionType&& render) {
+    const auto num_frames = io.output_buffer.has_value() ? io.output_buffer->size_frames()
+                          : io.input_buffer.has_value() ? io.input_buffer->size_frames()
+                          : 0;
+    const auto& period_time = io.output_time.has_value() ? io.output_time : io.input_time;
+
+    process(num_frames, period_time, sample_rate, forward<_EventHandlerType>(handle_event), forward<_RenderFunctionType>(render));
+  }
+
+private:
+  static audio_clock_t::time_point _sort_key(const audio_event<_PayloadType>& event) noexcept {
+    return event.time.value_or(audio_clock_t::time_point::min());
+  }
+
+  static size_t _frame_offset(const optional<audio_clock_t::time_point>& time,
+                              const optional<audio_clock_t::time_point>& period_time,
+                              double sample_rate) noexcept {
+    if (!time.has_value() || !period_time.has_value() || *time <= *period_time)
+      return 0;
+
+    const chrono::duration<double> delay = *time - *period_time;
+    return size_t(floor(delay.count() * sample_rate));
+  }
+
+  audio_command_queue<audio_event<_PayloadType>> _queue;
+  vector<audio_event<_PayloadType>> _pending;
+};
+
+// Hands objects that the audio thread no longer needs back to a non-realtime thread,
+// which destroys them in collect(). A single-producer, single-consumer ring, so
+// retire() is wait-free.
+class audio_garbage_queue {
+public:
+  explicit audio_garbage_queue(size_t capacity)
+    : _items(capacity + 1) {
+  }
+
+  audio_garbage_queue(const audio_garbage_queue&) = delete;
+  audio_garbage_queue& operator=(const audio_garbage_queue&) = delete;
+
+  ~audio_garbage_queue() {
+    collect();
+  }
+
+  // Audio thread. Takes ownership of the object unless the queue is full, in which
+  // case it returns false and the object is left alone.
+  template <typename _ObjectType>
+  bool retire(unique_ptr<_ObjectType>& object) noexcept {
+    if (!object)
+      return true;
+
+    const auto write = _write_index.load(memory_order_relaxed);
+    const auto next = write + 1 == _items.size() ? 0 : write + 1;
+    if (next == _read_index.load(memory_order_acquire))
+      return false;
+
+    _items[write] = {object.release(), [](void* p) { delete static_cast<_ObjectType*>(p); }};
+    _write_index.store(next, memory_order_release);
+    return true;
+  }
+
+  // Control thread. Destroys all retired objects and returns how many there were.
+  size_t collect() {
+    size_t count = 0;
+    auto read = _read_index.load(memory_order_relaxed);
+
+    while (read != _write_index.load(memory_order_acquire)) {
+      auto& item = _items[read];
+      item.destroy(item.object);
+      item = {};
+
+      read = read + 1 == _items.size() ? 0 : read + 1;
+      _read_index.store(read, memory_order_release);
+      ++count;
+    }
+
+    return count;
+  }
+
+private:
+  struct _item {
+    void* object = nullptr;
+    void (*destroy)(void*) = nullptr;
+  };
+
+  vector<_item> _items;
+  alignas(64) atomic<size_t> _write_index = 0;
+  alignas(64) atomic<size_t> _read_index = 0;
+};
+
+_LIBSTDAUDIO_NAMESPACE_END
@@ -0,0 +1,470 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include <__audio_fft.h>
+#include <__audio_simd.h>
+
+_LIBSTDAUDIO_NAMESPACE_BEGIN
+
+// One uniformly partitioned segment of the impulse responses: the part starting at
+// offset, cut into num_partitions partitions of partition_size samples, convolved by
+// overlap-save with a frequency-domain delay line (Wefers, "Partitioned convolution
+// algorithms for real-time auralization", 2015).
+//
+// Each call to compute() takes the next partition_size input samples of every
+// channel and yields the matching partition_size output samples of the segment's
+// contribution, which is due offset samples after the input; the caller feeds the
+// input early enough for that.
+class __audio_convolution_segment {
+public:
+  __audio_convolution_segment(const vector<vector<float>>& impulse_responses, size_t offset, size_t partition_size, size_t num_partitions)
+    : _num_channels(impulse_responses.size()),
+      _partition_size(partition_size),
+      _num_partitions(num_partitions),
+      _num_bins(partition_size + 1),
+      _fft(2 * partition_size),
+      _filter_re(_num_channels * num_partitions * _num_bins),
+      _filter_im(_num_channels * num_partitions * _num_bins),
+      _spectra_re(_num_channels * num_partitions * _num_bins),
+      _spectra_im(_num_channels * num_partitions * _num_bins),
+      _input(_num_channels * 2 * partition_size),
+      _accumulator_re(_num_bins),
+      _accumulator_im(_num_bins),
+      _time(2 * partition_size) {
+    // The filter spectra carry the 1 / (2 * partition_size) of the inverse transform.
+    const float scale = 1.0f / float(2 * partition_size);
+
+    for (size_t channel = 0; channel < _num_channels; ++channel) {
+      const auto& impulse_response = impulse_responses[channel];
+
+      for (size_t partition = 0; partition < num_partitions; ++partition) {
+        fill(_time.begin(), _time.end(), 0.0f);
+        const size_t first = offset + partition * partition_size;
+        for (size_t i = 0; i < partition_size && first + i < impulse_response.size(); ++i)
+          _time[i] = scale * impulse_response[first + i];
+
+        const size_t index = _spectrum_index(channel, partition);
+        _fft.forward(_time.data(), _filter_re.data() + index, _filter_im.data() + index);
+      }
+    }
+  }
+
+  size_t partition_size() const noexcept {
+    return _partition_size;
+  }
+
+  void reset() noexcept {
+    fill(_spectra_re.begin(), _spectra_re.end(), 0.0f);
+    fill(_spectra_im.begin(), _spectra_im.end(), 0.0f);
+    fill(_input.begin(), _input.end(), 0.0f);
+    _newest = 0;
+  }
+
+  // input and output hold partition_size samples per channel, channel after channel.
+  void compute(const float* input, float* output) noexcept {
+    _newest = (_newest + 1) % _num_partitions;
+
+    for (size_t channel = 0; channel < _num_channels; ++channel) {
+      // Overlap-save: transform the previous and the new partition of input together.
+      float* window = _input.data() + channel * 2 * _partition_size;
+      memcpy(window, window + _partition_size, _partition_size * sizeof(float));
+      memcpy(window + _partition_size, input + channel * _partition_size, _partition_size * sizeof(float));
+
+      const size_t newest = _spectrum_index(channel, _newest);
+      _fft.forward(window, _spectra_re.data() + newest, _spectra_im.data() + newest);
+
+      fill(_accumulator_re.begin(), _accumulator_re.end(), 0.0f);
+      fill(_accumulator_im.begin(), _accumulator_im.end(), 0.0f);
+
+      // The input spectrum from p partitions ago meets filter partition p.
+      for (size_t partition = 0; partition < _num_partitions; ++partition) {
+        const size_t age = (_newest + _num_partitions - partition) % _num_partitions;
+        const size_t x = _spectrum_index(channel, age);
+        const size_t h = _spectrum_index(channel, partition);
+        _multiply_accumulate(_spectra_re.data() + x, _spectra_im.data() + x,
+                             _filter_re.data() + h, _filter_im.data() + h);
+      }
+
+      _fft.inverse(_accumulator_re.data(), _accumulator_im.data(), _time.data());
+      memcpy(output + channel * _partition_size, _time.data() + _partition_size, _partition_size * sizeof(float));
+    }
+  }
+
+private:
+  size_t _spectrum_index(size_t channel, size_t partition) const noexcept {
+    return (channel * _num_partitions + partition) * _num_bins;
+  }
+
+  // accumulator += x * h over all bins.
+  void _multiply_accumulate(const float* x_re, const float* x_im, const float* h_re, const float* h_im) noexcept {
+    constexpr size_t w = __simd_float::width;
+    float* acc_re = _accumulator_re.data();
+    float* acc_im = _accumulator_im.data();
+
+    size_t k = 0;
+    for (; k + w <= _num_bins; k += w) {
+      const auto xr = __simd_float::load(x_re + k), xi = __simd_float::load(x_im + k);
+      const auto hr = __simd_float::load(h_re + k), hi = __simd_float::load(h_im + k);
+      (fma(xr, hr, __simd_float::load(acc_re + k)) - xi * hi).store(acc_re + k);
+      fma(xr, hi, fma(xi, hr, __simd_float::load(acc_im + k))).store(acc_im + k);
+    }
+
+    for (; k < _num_bins; ++k) {
+      acc_re[k] += x_re[k] * h_re[k] - x_im[k] * h_im[k];
+      acc_im[k] += x_re[k] * h_im[k] + x_im[k] * h_re[k];
+    }
+  }
+
+  size_t _num_channels;
+  size_t _partition_size;
+  size_t _num_partitions;
+  size_t _num_bins;
+  audio_real_fft _fft;
+  vector<float> _filter_re;
+  vector<float> _filter_im;
+  vector<float> _spectra_re;
+  vector<float> _spectra_im;
+  vector<float> _input;
+  vector<float> _accumulator_re;
+  vector<float> _accumulator_im;
+  vector<float> _time;
+  size_t _newest = 0;
+};
+
+// Zero-latency convolution of every channel with its own (long) impulse response,
+// e.g. for reverbs and room correction inside a device callback. The impulse
+// response is split non-uniformly (Gardner, "Efficient convolution without
+// input-output delay", 1995):
+//  - the first block_size samples run as a direct-form FIR filter, so the output
+//    has no latency whatever the buffer size;
+//  - the next part runs in partitions of block_size, computed in the callback at
+//    every block boundary;
+//  - the tail runs in partitions that grow by a factor of 4 up to
+//    max_partition_size. A segment with partitions of size P starts 2 * P samples
+//    into the impulse response, so its work for one partition may take a whole
+//    period of P samples; it runs on a background thread of its own, which the
+//    callback hands the input at one boundary and waits for at the next.
+// The callback thus does a roughly constant amount of work per block. If a
+// background thread misses its period, the callback waits for it rather than
+// dropping the tail.
+//
+// Without background threads, the tail segments are computed in the callback at
+// their boundaries instead, which is deterministic but makes the load uneven
+// (e.g. for offline rendering and tests). block_size and max_partition_size must
+// be powers of two. All memory is allocated and all threads are started in the
+// constructor.
+class audio_convolver {
+public:
+  explicit audio_convolver(const vector<vector<float>>& impulse_responses,
+                           size_t block_size = 64,
+                           size_t max_partition_size = 4096,
+                           bool background_threads = true)
+    : _num_channels(impulse_responses.size()),
+      _block_size(block_size),
+      _head(_num_channels * block_size),
+      _history(_num_channels * (2 * block_size - 1)),
+      _block_output(_num_channels * block_size) {
+    assert(_num_channels > 0);
+    assert(block_size > 0 && (block_size & (block_size - 1)) == 0);
+    assert((max_partition_size & (max_partition_size - 1)) == 0);
+
+    for (const auto& impulse_response : impulse_responses)
+      _length = max(_length, impulse_response.size());
+
+    // The head is stored reversed, so that each output sample is a dot product
+    // with the input history.
+    for (size_t channel = 0; channel < _num_channels; ++channel) {
+      const auto& impulse_response = impulse_responses[channel];
+      for (size_t i = 0; i < block_size && i < impulse_response.size(); ++i)
+        _head[channel * block_size + block_size - 1 - i] = impulse_response[i];
+    }
+
+    // Each segment covers the impulse response up to where the next one, with four
+    // times larger partitions, may start.
+    size_t offset = block_size;
+    size_t partition_size = block_size;
+    while (offset < _length) {
+      const size_t next_partition_size = 4 * partition_size;
+      const size_t next_offset = 2 * next_partition_size;
+      const bool is_last = next_partition_size > max(max_partition_size, block_size) || next_offset >= _length;
+      const size_t end = is_last ? _length : next_offset;
+      const size_t num_partitions = (end - offset + partition_size - 1) / partition_size;
+
+      auto segment = make_unique<__audio_convolution_segment>(impulse_responses, offset, partition_size, num_partitions);
+      if (partition_size == block_size)
+        _first_segment = move(segment);
+      else
+        _tail.push_back(make_unique<_tail_segment>(move(segment), _num_channels, background_threads));
+
+      offset = end;
+      partition_size = next_partition_size;
+    }
+
+    reset();
+  }
+
+  audio_convolver(const audio_convolver&) = delete;
+  audio_convolver& operator=(const audio_convolver&) = delete;
+
+  ~audio_convolver() {
+    for (auto& tail : _tail)
+      tail->stop();
+  }
+
+  size_t num_channels() const noexcept {
+    return _num_channels;
+  }
+
+  size_t block_size() const noexcept {
+    return _block_size;
+  }
+
+  // The length of the longest impulse response.
+  size_t impulse_response_length() const noexcept {
+    return _length;
+  }
+
+  // Clears the signal history. Not realtime-safe: it waits for background work.
+  void reset() noexcept {
+    for (auto& tail : _tail)
+      tail->reset();
+
+    if (_first_segment)
+      _first_segment->reset();
+
+    fill(_history.begin(), _history.end(), 0.0f);
+    fill(_block_output.begin(), _block_output.end(), 0.0f);
+    _block_position = 0;
+    _num_blocks = 0;
+  }
+
+  // Convolves input into output, which may be the same buffer. Both need
+  // num_channels() channels and the same number of frames, which can be anything.
+  template <typename _SampleType>
+  void process(const audio_buffer<_SampleType>& input, audio_buffer<_SampleType>& output) noexcept {
+    static_assert(is_floating_point_v<_SampleType>, "audio_convolver requires a floating-point sample type");
+    assert(size_t(input.size_channels()) == _num_channels && size_t(output.size_channels()) == _num_channels);
+    assert(input.size_frames() == output.size_frames());
+
+    const size_t num_frames = size_t(input.size_frames());
+    for (size_t first = 0; first < num_frames;) {
+      const size_t n = min(num_frames - first, _block_size - _block_position);
+      _process_chunk(input, output, first, n);
+      first += n;
+      _block_position += n;
+
+      if (_block_position == _block_size)
+        _end_block();
+    }
+  }
+
+  template <typename _SampleType>
+  void process(audio_buffer<_SampleType>& buffer) noexcept {
+    process(buffer, buffer);
+  }
+
+private:
+  // A segment of the tail with its double-buffered input and output and the thread
+  // that computes it.
+  class _tail_segment {
+  public:
+    _tail_segment(unique_ptr<__audio_convolution_segment> segment, size_t num_channels, bool background_thread)
+      : _segment(move(segment)),
+        _buffer_size(num_channels * _segment->partition_size()) {
+      for (size_t i = 0; i < 2; ++i) {
+        _input[i].resize(_buffer_size);
+        _output[i].resize(_buffer_size);
+      }
+
+      if (background_thread)
+        _thread = thread([this] { _thread_main(); });
+    }
+
+    size_t partition_size() const noexcept {
+      return _segment->partition_size();
+    }
+
+    // The input of the partition being collected, channel after channel.
+    float* input() noexcept {
+      return _input[_num_started % 2].data();
+    }
+
+    // The output of the partition due now, channel after channel.
+    const float* output() const noexcept {
+      return _output[(_num_started + 1) % 2].data();
+    }
+
+    // Called at the end of every partition: waits for the work started at the last
+    // boundary, whose output is due from now on, and starts the work on the input
+    // just collected.
+    void next_partition() noexcept {
+      _wait();
+      ++_num_started;
+
+      if (!_thread.joinable()) {
+        _compute(_num_started);
+        _num_finished.store(_num_started, memory_order_relaxed);
+        return;
+      }
+
+      _flush_denormals.store(__audio_fp_mode::flushes_denormals(), memory_order_relaxed);
+      _num_requested.store(_num_started, memory_order_seq_cst);
+      if (_sleeping.load(memory_order_seq_cst))
+        _wake_event.notify_all();
+      else
+        _wake_event.advance();
+    }
+
+    void reset() noexcept {
+      _wait();
+      _segment->reset();
+      for (size_t i = 0; i < 2; ++i) {
+        fill(_input[i].begin(), _input[i].end(), 0.0f);
+        fill(_output[i].begin(), _output[i].end(), 0.0f);
+      }
+    }
+
+    void stop() {
+      if (!_thread.joinable())
+        return;
+
+      _running.store(false, memory_order_seq_cst);
+      _wake_event.notify_all();
+      _thread.join();
+    }
+
+  private:
+    void _wait() noexcept {
+      while (_num_finished.load(memory_order_acquire) != _num_started)
+        __audio_cpu_pause();
+    }
+
+    // Partition number i reads the input collected before its boundary and writes
+    // the output due one partition later.
+    void _compute(uint64_t i) noexcept {
+      _segment->compute(_input[(i + 1) % 2].data(), _output[i % 2].data());
+    }
+
+    void _thread_main() {
+      __audio_set_realtime_thread_priority();
+      uint64_t num_finished = 0;
+
+      while (_running.load(memory_order_relaxed)) {
+        if (_num_requested.load(memory_order_acquire) > num_finished) {
+          audio_denormal_guard denormals(_flush_denormals.load(memory_order_relaxed));
+          _compute(++num_finished);
+          _num_finished.store(num_finished, memory_order_release);
+          continue;
+        }
+
+        // Read the epoch before checking for work one last time; a request made
+        // after that check moves the epoch on, so wait() returns at once.
+        _sleeping.store(true, memory_order_seq_cst);
+        const auto epoch = _wake_event.epoch();
+        if (_running.load(memory_order_seq_cst) && _num_requested.load(memory_order_seq_cst) == num_finished)
+          _wake_event.wait(epoch);
+
+        _sleeping.store(false, memory_order_seq_cst);
+      }
+    }
+
+    unique_ptr<__audio_convolution_segment> _segment;
+    size_t _buffer_size;
+    vector<float> _input[2];
+    vector<float> _output[2];
+    // Only touched by the audio thread.
+    uint64_t _num_started = 0;
+    atomic<uint64_t> _num_requested = 0;
+    atomic<uint64_t> _num_finished = 0;
+    atomic<bool> _flush_denormals = false;
+    atomic<bool> _running = true;
+    atomic<bool> _sleeping = false;
+    __audio_wake_event _wake_event;
+    thread _thread;
+  };
+
+  template <typename _SampleType>
+  void _process_chunk(const audio_buffer<_SampleType>& input, audio_buffer<_SampleType>& output, size_t first, size_t n) noexcept {
+    const size_t history_size = 2 * _block_size - 1;
+
+    for (size_t channel = 0; channel < _num_channels; ++channel) {
+      // The history holds the last block_size - 1 samples of the previous block,
+      // followed by the current block.
+      float* history = _history.data() + channel * history_size;
+      float* current = history + _block_size - 1 + _block_position;
+      for (size_t i = 0; i < n; ++i)
+        current[i] = float(input(first + i, channel));
+
+      for (auto& tail : _tail) {
+        const size_t partition_size = tail->partition_size();
+        const size_t position = (_num_blocks * _block_size) % partition_size + _block_position;
+        memcpy(tail->input() + channel * partition_size + position, current, n * sizeof(float));
+      }
+
+      const float* head = _head.data() + channel * _block_size;
+      for (size_t i = 0; i < n; ++i) {
+        float y = __simd_dot(head, history + _block_position + i, _block_size) + _block_output[channel * _block_size + _block_position + i];
+
+        for (auto& tail : _tail) {
+          const size_t partition_size = tail->partition_size();
+          const size_t position = (_num_blocks * _block_size) % partition_size + _block_position;
+          y += tail->output()[channel * partition_size + position + i];
+        }
+
+        output(first + i, channel) = _SampleType(y);
+      }
+    }
+  }
+
+  void _end_block() noexcept {
+    const size_t history_size = 2 * _block_size - 1;
+
+    if (_first_segment) {
+      // The block just completed is contiguous in the history of every channel; the
+      // segment wants it channel after channel, which the output buffer can hold.
+      for (size_t channel = 0; channel < _num_channels; ++channel)
+        memcpy(_block_output.data() + channel * _block_size, _history.data() + channel * history_size + _block_size - 1, _block_size * sizeof(float));
+
+      _first_segment->compute(_block_output.data(), _block_output.data());
+    }
+
+    for (size_t channel = 0; channel < _num_channels; ++channel) {
+      float* history = _history.data() + channel * history_size;
+      memmove(history, history + _block_size, (_block_size - 1) * sizeof(float));
+    }
+
+    _block_position = 0;
+    ++_num_blocks;
+
+    for (auto& tail : _tail) {
+      if ((_num_blocks * _block_size) % tail->partition_size() == 0)
+        tail->next_partition();
+    }
+  }
+
+  size_t _num_channels;
+  size_t _block_size;
+  size_t _length = 0;
+  vector<float> _head;
+  vector<float> _history;
+  // The first segment's output for the current block, channel after channel.
+  vector<float> _block_output;
+  unique_ptr<__audio_convolution_segment> _first_segment;
+  vector<unique_ptr<_tail_segment>> _tail;
+  size_t _block_position = 0;
+  uint64_t _num_blocks = 0;
+};
+
+_LIBSTDAUDIO_NAMESPACE_END
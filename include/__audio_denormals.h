@@ -0,0 +1,108 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+  #include <xmmintrin.h>
+  #define _LIBSTDAUDIO_FP_MODE_X86
+#elif defined(__aarch64__) || defined(_M_ARM64)
+  #if defined(_MSC_VER) && !defined(__clang__)
+    #include <intrin.h>
+  #endif
+  #define _LIBSTDAUDIO_FP_MODE_ARM64
+#elif defined(__arm__) && defined(__ARM_FP)
+  #define _LIBSTDAUDIO_FP_MODE_ARM32
+#endif
+
+_LIBSTDAUDIO_NAMESPACE_BEGIN
+
+// The floating-point control bits of the current thread that decide how denormal
+// numbers are handled: MXCSR on x86, FPCR/FPSCR on ARM. Decaying filters and reverb
+// tails end up in the denormal range, where many CPUs are an order of magnitude
+// slower; with flush-to-zero (and denormals-are-zero on x86) such values become 0.
+class __audio_fp_mode {
+public:
+  using state_type = uint64_t;
+
+  static state_type get() noexcept {
+#if defined(_LIBSTDAUDIO_FP_MODE_X86)
+    return _mm_getcsr();
+#elif defined(_LIBSTDAUDIO_FP_MODE_ARM64) && defined(_MSC_VER) && !defined(__clang__)
+    return _ReadStatusReg(ARM64_FPCR);
+#elif defined(_LIBSTDAUDIO_FP_MODE_ARM64)
+    state_type fpcr;
+    asm volatile("mrs %0, fpcr" : "=r"(fpcr));
+    return fpcr;
+#elif defined(_LIBSTDAUDIO_FP_MODE_ARM32)
+    uint32_t fpscr;
+    asm volatile("vmrs %0, fpscr" : "=r"(fpscr));
+    return fpscr;
+#else
+    return 0;
+#endif
+  }
+
+  static void set(state_type state) noexcept {
+#if defined(_LIBSTDAUDIO_FP_MODE_X86)
+    _mm_setcsr(unsigned(state));
+#elif defined(_LIBSTDAUDIO_FP_MODE_ARM64) && defined(_MSC_VER) && !defined(__clang__)
+    _WriteStatusReg(ARM64_FPCR, int64_t(state));
+#elif defined(_LIBSTDAUDIO_FP_MODE_ARM64)
+    asm volatile("msr fpcr, %0" : : "r"(state));
+#elif defined(_LIBSTDAUDIO_FP_MODE_ARM32)
+    asm volatile("vmsr fpscr, %0" : : "r"(uint32_t(state)));
+#else
+    (void)state;
+#endif
+  }
+
+  static constexpr state_type flush_denormals_bits() noexcept {
+#if defined(_LIBSTDAUDIO_FP_MODE_X86)
+    return 0x8040;  // FTZ | DAZ
+#elif defined(_LIBSTDAUDIO_FP_MODE_ARM64) || defined(_LIBSTDAUDIO_FP_MODE_ARM32)
+    return state_type(1) << 24;  // FZ
+#else
+    return 0;
+#endif
+  }
+
+  static bool is_supported() noexcept {
+    return flush_denormals_bits() != 0;
+  }
+
+  static bool flushes_denormals() noexcept {
+    return is_supported() && (get() & flush_denormals_bits()) == flush_denormals_bits();
+  }
+};
+
+// Enables flush-to-zero (and denormals-are-zero where available) on the current
+// thread for its lifetime and restores the previous state afterwards. Devices use
+// this around their callbacks when set_flush_denormals(true) was called before start().
+class audio_denormal_guard {
+public:
+  explicit audio_denormal_guard(bool enabled = true) noexcept
+    : _previous_state(__audio_fp_mode::get()),
+      _enabled(enabled && __audio_fp_mode::is_supported()) {
+    if (_enabled)
+      __audio_fp_mode::set(_previous_state | __audio_fp_mode::flush_denormals_bits());
+  }
+
+  ~audio_denormal_guard() {
+    if (_enabled)
+      __audio_fp_mode::set(_previous_state);
+  }
+
+  audio_denormal_guard(const audio_denormal_guard&) = delete;
+  audio_denormal_guard& operator=(const audio_denormal_guard&) = delete;
+
+private:
+  __audio_fp_mode::state_type _previous_state;
+  bool _enabled;
+};
+
+_LIBSTDAUDIO_NAMESPACE_END
@@ -5,6 +5,9 @@
 
 #pragma once
 
+#include <chrono>
+#include <cstddef>
+
 _LIBSTDAUDIO_NAMESPACE_BEGIN
 
 class audio_device;
@@ -16,6 +19,46 @@ inline optional<audio_device> get_default_audio_output_device();
 inline audio_device_list get_audio_input_device_list();
 inline audio_device_list get_audio_output_device_list();
 
+// End-to-end latency of one direction of a device, broken into its components.
+// device_frames is what the driver reports for the hardware and converters
+// (kAudioDevicePropertyLatency plus stream latency on CoreAudio, GetStreamLatency on WASAPI),
+// safety_offset_frames is what the OS keeps in flight on top of that
+// (kAudioDevicePropertySafetyOffset on CoreAudio, the shared-mode engine period on WASAPI),
+// and buffer_frames is the I/O buffer the callback is processing.
+struct audio_latency {
+  size_t device_frames = 0;
+  size_t safety_offset_frames = 0;
+  size_t buffer_frames = 0;
+  double sample_rate = 0;
+
+  size_t total_frames() const noexcept {
+    return device_frames + safety_offset_frames + buffer_frames;
+  }
+
+  chrono::nanoseconds to_duration(size_t num_frames) const noexcept {
+    if (sample_rate <= 0)
+      return {};
+
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::duration<double>(double(num_frames) / sample_rate));
+  }
+
+  chrono::nanoseconds device_duration() const noexcept {
+    return to_duration(device_frames);
+  }
+
+  chrono::nanoseconds safety_offset_duration() const noexcept {
+    return to_duration(safety_offset_frames);
+  }
+
+  chrono::nanoseconds buffer_duration() const noexcept {
+    return to_duration(buffer_frames);
+  }
+
+  chrono::nanoseconds total_duration() const noexcept {
+    return to_duration(total_frames());
+  }
+};
+
 enum class audio_device_list_event {
   device_list_changed,
   default_input_device_changed,
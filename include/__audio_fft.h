@@ -0,0 +1,242 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <__audio_simd.h>
+
+_LIBSTDAUDIO_NAMESPACE_BEGIN
+
+// FFT of real input of a power-of-two size n. The spectrum is kept in split form:
+// n/2 + 1 real parts and n/2 + 1 imaginary parts, which suits SIMD kernels working
+// on the bins. Neither direction is normalised: inverse(forward(x)) == n * x.
+//
+// The real transform runs as a complex FFT of size n/2 over the even and odd samples,
+// followed by a pass that separates their spectra. The complex FFT fuses pairs of
+// radix-2 passes into radix-4 passes, which halves the trips through memory, and
+// runs the butterflies a SIMD pack at a time once they are wide enough. The plan
+// computes the twiddles and the bit-reversal permutation in the constructor and keeps
+// them, and its scratch memory, cache-line aligned. Because of the scratch memory,
+// one plan must not be used by several threads at once.
+class audio_real_fft {
+public:
+  explicit audio_real_fft(size_t size)
+    : _size(size),
+      _half(size / 2),
+      _bit_reverse(_half),
+      _twiddle_re(_half),
+      _twiddle_im(_half),
+      _split_re(_half + 1),
+      _split_im(_half + 1),
+      _work_re(_half),
+      _work_im(_half) {
+    assert(size >= 2 && (size & (size - 1)) == 0);
+
+    size_t num_bits = 0;
+    while ((size_t(1) << num_bits) < _half)
+      ++num_bits;
+
+    for (size_t i = 0; i < _half; ++i) {
+      size_t reversed = 0;
+      for (size_t bit = 0; bit < num_bits; ++bit)
+        reversed |= ((i >> bit) & 1) << (num_bits - 1 - bit);
+
+      _bit_reverse[i] = uint32_t(reversed);
+    }
+
+    // The twiddles of the radix-2 pass producing transforms of length len start at
+    // index len/2 - 1; the radix-4 passes use those of the two passes they fuse.
+    for (size_t len = 2; len <= _half; len *= 2) {
+      for (size_t j = 0; j < len / 2; ++j) {
+        const double angle = -2 * _pi * double(j) / double(len);
+        _twiddle_re[len / 2 - 1 + j] = float(cos(angle));
+        _twiddle_im[len / 2 - 1 + j] = float(sin(angle));
+      }
+    }
+
+    for (size_t k = 0; k <= _half; ++k) {
+      const double angle = -2 * _pi * double(k) / double(size);
+      _split_re[k] = float(cos(angle));
+      _split_im[k] = float(sin(angle));
+    }
+  }
+
+  size_t size() const noexcept {
+    return _size;
+  }
+
+  // Number of bins in the spectrum: size() / 2 + 1.
+  size_t num_bins() const noexcept {
+    return _half + 1;
+  }
+
+  // Transforms size() samples into num_bins() real and imaginary parts.
+  void forward(const float* input, float* re, float* im) noexcept {
+    for (size_t i = 0; i < _half; ++i) {
+      _work_re[_bit_reverse[i]] = input[2 * i];
+      _work_im[_bit_reverse[i]] = input[2 * i + 1];
+    }
+
+    _complex_fft(_work_re.data(), _work_im.data());
+
+    // X[k] = E[k] + W^k O[k], with E and O the spectra of the even and odd samples,
+    // recovered from Z[k] and conj(Z[n/2 - k]).
+    for (size_t k = 0; k <= _half; ++k) {
+      const size_t a = k == _half ? 0 : k;
+      const size_t b = k == 0 ? 0 : _half - k;
+      const float even_re = 0.5f * (_work_re[a] + _work_re[b]);
+      const float even_im = 0.5f * (_work_im[a] - _work_im[b]);
+      const float odd_re = 0.5f * (_work_im[a] + _work_im[b]);
+      const float odd_im = -0.5f * (_work_re[a] - _work_re[b]);
+      re[k] = even_re + _split_re[k] * odd_re - _split_im[k] * odd_im;
+      im[k] = even_im + _split_re[k] * odd_im + _split_im[k] * odd_re;
+    }
+  }
+
+  // Transforms num_bins() real and imaginary parts back into size() samples, scaled by size().
+  void inverse(const float* re, const float* im, float* output) noexcept {
+    for (size_t k = 0; k < _half; ++k) {
+      const size_t b = _half - k;
+      const float even_re = re[k] + re[b];
+      const float even_im = im[k] - im[b];
+      const float diff_re = re[k] - re[b];
+      const float diff_im = im[k] + im[b];
+      const float odd_re = _split_re[k] * diff_re + _split_im[k] * diff_im;
+      const float odd_im = _split_re[k] * diff_im - _split_im[k] * diff_re;
+      _work_re[_bit_reverse[k]] = even_re - odd_im;
+      _work_im[_bit_reverse[k]] = even_im + odd_re;
+    }
+
+    // Swapping real and imaginary parts turns the forward transform into the inverse.
+    _complex_fft(_work_im.data(), _work_re.data());
+
+    for (size_t i = 0; i < _half; ++i) {
+      output[2 * i] = _work_re[i];
+      output[2 * i + 1] = _work_im[i];
+    }
+  }
+
+private:
+  static constexpr double _pi = 3.14159265358979323846;
+
+  // Stands in for __simd_float in the passes whose butterflies are narrower than a pack.
+  struct _scalar {
+    static constexpr size_t width = 1;
+    float value;
+
+    static _scalar load(const float* p) noexcept { return {*p}; }
+    void store(float* p) const noexcept { *p = value; }
+
+    friend _scalar operator+(_scalar a, _scalar b) noexcept { return {a.value + b.value}; }
+    friend _scalar operator-(_scalar a, _scalar b) noexcept { return {a.value - b.value}; }
+    friend _scalar operator*(_scalar a, _scalar b) noexcept { return {a.value * b.value}; }
+    friend _scalar fma(_scalar a, _scalar b, _scalar c) noexcept { return {a.value * b.value + c.value}; }
+  };
+
+  // In-place decimation-in-time FFT of _half points in bit-reversed order.
+  void _complex_fft(float* re, float* im) const noexcept {
+    size_t len = 1;
+    for (; 4 * len <= _half; len *= 4) {
+      if (len >= __simd_float::width)
+        _radix4_pass<__simd_float>(re, im, len);
+      else
+        _radix4_pass<_scalar>(re, im, len);
+    }
+
+    if (2 * len <= _half) {
+      if (len >= __simd_float::width)
+        _radix2_pass<__simd_float>(re, im, len);
+      else
+        _radix2_pass<_scalar>(re, im, len);
+    }
+  }
+
+  // (a_re + i a_im) * (b_re + i b_im)
+  template <typename _Pack>
+  static void _multiply(_Pack a_re, _Pack a_im, _Pack b_re, _Pack b_im, _Pack& re, _Pack& im) noexcept {
+    re = a_re * b_re - a_im * b_im;
+    im = fma(a_re, b_im, a_im * b_re);
+  }
+
+  // Combines transforms of length len into transforms of length 2 * len.
+  template <typename _Pack>
+  void _radix2_pass(float* re, float* im, size_t len) const noexcept {
+    const float* w_re = _twiddle_re.data() + len - 1;
+    const float* w_im = _twiddle_im.data() + len - 1;
+
+    for (size_t start = 0; start < _half; start += 2 * len) {
+      for (size_t j = 0; j < len; j += _Pack::width) {
+        const size_t a = start + j, b = a + len;
+        _Pack t_re, t_im;
+        _multiply(_Pack::load(w_re + j), _Pack::load(w_im + j), _Pack::load(re + b), _Pack::load(im + b), t_re, t_im);
+
+        const auto a_re = _Pack::load(re + a), a_im = _Pack::load(im + a);
+        (a_re - t_re).store(re + b);
+        (a_im - t_im).store(im + b);
+        (a_re + t_re).store(re + a);
+        (a_im + t_im).store(im + a);
+      }
+    }
+  }
+
+  // Combines transforms of length len into transforms of length 4 * len: two radix-2
+  // passes with the data kept in registers in between.
+  template <typename _Pack>
+  void _radix4_pass(float* re, float* im, size_t len) const noexcept {
+    const float* w1_re = _twiddle_re.data() + len - 1;
+    const float* w1_im = _twiddle_im.data() + len - 1;
+    const float* w2_re = _twiddle_re.data() + 2 * len - 1;
+    const float* w2_im = _twiddle_im.data() + 2 * len - 1;
+
+    for (size_t start = 0; start < _half; start += 4 * len) {
+      for (size_t j = 0; j < len; j += _Pack::width) {
+        const size_t i0 = start + j, i1 = i0 + len, i2 = i1 + len, i3 = i2 + len;
+
+        // First pass: (0, 1) and (2, 3), with the same twiddle.
+        const auto w1r = _Pack::load(w1_re + j), w1i = _Pack::load(w1_im + j);
+        _Pack t1_re, t1_im, t3_re, t3_im;
+        _multiply(w1r, w1i, _Pack::load(re + i1), _Pack::load(im + i1), t1_re, t1_im);
+        _multiply(w1r, w1i, _Pack::load(re + i3), _Pack::load(im + i3), t3_re, t3_im);
+
+        const auto x0_re = _Pack::load(re + i0), x0_im = _Pack::load(im + i0);
+        const auto x2_re = _Pack::load(re + i2), x2_im = _Pack::load(im + i2);
+        const auto b0_re = x0_re + t1_re, b0_im = x0_im + t1_im;
+        const auto b1_re = x0_re - t1_re, b1_im = x0_im - t1_im;
+        const auto b2_re = x2_re + t3_re, b2_im = x2_im + t3_im;
+        const auto b3_re = x2_re - t3_re, b3_im = x2_im - t3_im;
+
+        // Second pass: (0, 2) with twiddle j and (1, 3) with twiddle j + len.
+        _Pack u2_re, u2_im, u3_re, u3_im;
+        _multiply(_Pack::load(w2_re + j), _Pack::load(w2_im + j), b2_re, b2_im, u2_re, u2_im);
+        _multiply(_Pack::load(w2_re + j + len), _Pack::load(w2_im + j + len), b3_re, b3_im, u3_re, u3_im);
+
+        (b0_re + u2_re).store(re + i0);
+        (b0_im + u2_im).store(im + i0);
+        (b1_re + u3_re).store(re + i1);
+        (b1_im + u3_im).store(im + i1);
+        (b0_re - u2_re).store(re + i2);
+        (b0_im - u2_im).store(im + i2);
+        (b1_re - u3_re).store(re + i3);
+        (b1_im - u3_im).store(im + i3);
+      }
+    }
+  }
+
+  size_t _size;
+  size_t _half;
+  __simd_aligned_vector<uint32_t> _bit_reverse;
+  __simd_aligned_vector<float> _twiddle_re;
+  __simd_aligned_vector<float> _twiddle_im;
+  __simd_aligned_vector<float> _split_re;
+  __simd_aligned_vector<float> _split_im;
+  __simd_aligned_vector<float> _work_re;
+  __simd_aligned_vector<float> _work_im;
+};
+
+_LIBSTDAUDIO_NAMESPACE_END
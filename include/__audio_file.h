@@ -0,0 +1,462 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <type_traits>
+
+#if defined(_WIN32)
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+_LIBSTDAUDIO_NAMESPACE_BEGIN
+
+enum class audio_sample_format {
+  int8,
+  uint8,
+  int16,
+  int24,
+  int32,
+  float32,
+  float64,
+};
+
+inline size_t get_audio_sample_format_size(audio_sample_format format) noexcept {
+  switch (format) {
+    case audio_sample_format::int8:
+    case audio_sample_format::uint8: return 1;
+    case audio_sample_format::int16: return 2;
+    case audio_sample_format::int24: return 3;
+    case audio_sample_format::int32:
+    case audio_sample_format::float32: return 4;
+    case audio_sample_format::float64: return 8;
+  }
+
+  return 0;
+}
+
+// How the interleaved frames of an audio file are stored.
+struct audio_file_format {
+  double sample_rate = 0;
+  size_t num_channels = 0;
+  audio_sample_format sample_format = audio_sample_format::int16;
+  bool big_endian = false;
+
+  size_t bytes_per_frame() const noexcept {
+    return num_channels * get_audio_sample_format_size(sample_format);
+  }
+};
+
+// Read-only memory mapping of a whole file.
+class __audio_mapped_file {
+public:
+  __audio_mapped_file() = default;
+
+  explicit __audio_mapped_file(const string& path) noexcept {
+#if defined(_WIN32)
+    const HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+      return;
+
+    LARGE_INTEGER size;
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+      if (const HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr)) {
+        _data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        _size = _data != nullptr ? size_t(size.QuadPart) : 0;
+        CloseHandle(mapping);
+      }
+    }
+
+    CloseHandle(file);
+#else
+    const int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0)
+      return;
+
+    struct stat status;
+    if (fstat(file, &status) == 0 && status.st_size > 0) {
+      void* data = mmap(nullptr, size_t(status.st_size), PROT_READ, MAP_SHARED, file, 0);
+      if (data != MAP_FAILED) {
+        _data = static_cast<const uint8_t*>(data);
+        _size = size_t(status.st_size);
+        madvise(data, _size, MADV_SEQUENTIAL);
+      }
+    }
+
+    ::close(file);
+#endif
+  }
+
+  __audio_mapped_file(__audio_mapped_file&& other) noexcept
+    : _data(exchange(other._data, nullptr)),
+      _size(exchange(other._size, 0)) {
+  }
+
+  __audio_mapped_file& operator=(__audio_mapped_file&& other) noexcept {
+    if (this != &other) {
+      _unmap();
+      _data = exchange(other._data, nullptr);
+      _size = exchange(other._size, 0);
+    }
+
+    return *this;
+  }
+
+  ~__audio_mapped_file() {
+    _unmap();
+  }
+
+  const uint8_t* data() const noexcept {
+    return _data;
+  }
+
+  size_t size() const noexcept {
+    return _size;
+  }
+
+  // Asks the OS to start reading the given range in the background.
+  void prefetch(size_t offset, size_t size) const noexcept {
+    if (offset >= _size)
+      return;
+
+    size = min(size, _size - offset);
+#if defined(_WIN32)
+    WIN32_MEMORY_RANGE_ENTRY range = {const_cast<uint8_t*>(_data) + offset, size};
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+    const size_t page_size = size_t(sysconf(_SC_PAGESIZE));
+    const size_t aligned_offset = offset & ~(page_size - 1);
+    madvise(const_cast<uint8_t*>(_data) + aligned_offset, size + offset - aligned_offset, MADV_WILLNEED);
+#endif
+  }
+
+private:
+  void _unmap() noexcept {
+    if (_data == nullptr)
+      return;
+
+#if defined(_WIN32)
+    UnmapViewOfFile(_data);
+#else
+    munmap(const_cast<uint8_t*>(_data), _size);
+#endif
+    _data = nullptr;
+    _size = 0;
+  }
+
+  const uint8_t* _data = nullptr;
+  size_t _size = 0;
+};
+
+// Random access to the frames of a WAV (including RF64), AIFF/AIFC or raw PCM file,
+// converted to floating point. The file is memory-mapped, so reading does no system
+// calls; pages that are not resident yet are loaded on first access, so reading is
+// not realtime-safe (audio_file_player does it on a background thread). read() is
+// const and may be called from several threads at once.
+class audio_file_reader {
+public:
+  audio_file_reader(audio_file_reader&&) noexcept = default;
+  audio_file_reader& operator=(audio_file_reader&&) noexcept = default;
+
+  const audio_file_format& get_format() const noexcept {
+    return _format;
+  }
+
+  size_t size_frames() const noexcept {
+    return _num_frames;
+  }
+
+  // Converts the frames from first_frame on into dst, as many as fit and exist, and
+  // returns how many that were. Channels that dst has beyond the file's are silenced.
+  template <typename _SampleType>
+  size_t read(size_t first_frame, audio_buffer<_SampleType>& dst) const noexcept {
+    static_assert(is_floating_point_v<_SampleType>, "audio_file_reader requires a floating-point sample type");
+
+    if (first_frame >= _num_frames)
+      return 0;
+
+    const size_t num_frames = min(size_t(dst.size_frames()), _num_frames - first_frame);
+    const size_t num_channels = min(size_t(dst.size_channels()), _format.num_channels);
+    const uint8_t* src = _file.data() + _data_offset + first_frame * _format.bytes_per_frame();
+
+    switch (_format.sample_format) {
+      case audio_sample_format::int8:
+        _convert(src, dst, num_frames, num_channels, [](const uint8_t* p) { return double(int8_t(p[0])) / 128; });
+        break;
+      case audio_sample_format::uint8:
+        _convert(src, dst, num_frames, num_channels, [](const uint8_t* p) { return (double(p[0]) - 128) / 128; });
+        break;
+      case audio_sample_format::int16:
+        _convert(src, dst, num_frames, num_channels, [big_endian = _format.big_endian](const uint8_t* p) {
+          return double(int16_t(_load_unsigned(p, 2, big_endian))) / 32'768;
+        });
+        break;
+      case audio_sample_format::int24:
+        _convert(src, dst, num_frames, num_channels, [big_endian = _format.big_endian](const uint8_t* p) {
+          return double(int32_t(_load_unsigned(p, 3, big_endian) << 8) >> 8) / 8'388'608;
+        });
+        break;
+      case audio_sample_format::int32:
+        _convert(src, dst, num_frames, num_channels, [big_endian = _format.big_endian](const uint8_t* p) {
+          return double(int32_t(_load_unsigned(p, 4, big_endian))) / 2'147'483'648.0;
+        });
+        break;
+      case audio_sample_format::float32:
+        _convert(src, dst, num_frames, num_channels, [big_endian = _format.big_endian](const uint8_t* p) {
+          const auto bits = uint32_t(_load_unsigned(p, 4, big_endian));
+          float value;
+          memcpy(&value, &bits, sizeof(value));
+          return double(value);
+        });
+        break;
+      case audio_sample_format::float64:
+        _convert(src, dst, num_frames, num_channels, [big_endian = _format.big_endian](const uint8_t* p) {
+          const uint64_t bits = _load_unsigned(p, 8, big_endian);
+          double value;
+          memcpy(&value, &bits, sizeof(value));
+          return value;
+        });
+        break;
+    }
+
+    for (size_t channel = num_channels; channel < size_t(dst.size_channels()); ++channel)
+      for (size_t frame = 0; frame < num_frames; ++frame)
+        dst(frame, channel) = 0;
+
+    return num_frames;
+  }
+
+  // Asks the OS to start loading the given frames into memory in the background.
+  void prefetch(size_t first_frame, size_t num_frames) const noexcept {
+    if (first_frame < _num_frames)
+      _file.prefetch(_data_offset + first_frame * _format.bytes_per_frame(), min(num_frames, _num_frames - first_frame) * _format.bytes_per_frame());
+  }
+
+private:
+  friend optional<audio_file_reader> open_audio_file(const string& path);
+  friend optional<audio_file_reader> open_raw_audio_file(const string& path, const audio_file_format& format, size_t data_offset);
+
+  audio_file_reader(__audio_mapped_file file, const audio_file_format& format, size_t data_offset, size_t data_size)
+    : _file(move(file)),
+      _format(format),
+      _data_offset(data_offset),
+      _num_frames(format.bytes_per_frame() > 0 ? min(data_size, _file.size() - min(data_offset, _file.size())) / format.bytes_per_frame() : 0) {
+  }
+
+  template <typename _SampleType, typename _DecodeType>
+  void _convert(const uint8_t* src, audio_buffer<_SampleType>& dst, size_t num_frames, size_t num_channels, _DecodeType decode) const noexcept {
+    const size_t sample_size = get_audio_sample_format_size(_format.sample_format);
+    const size_t frame_size = _format.bytes_per_frame();
+
+    for (size_t frame = 0; frame < num_frames; ++frame, src += frame_size)
+      for (size_t channel = 0; channel < num_channels; ++channel)
+        dst(frame, channel) = _SampleType(decode(src + channel * sample_size));
+  }
+
+  static uint64_t _load_unsigned(const uint8_t* p, size_t num_bytes, bool big_endian) noexcept {
+    uint64_t result = 0;
+    for (size_t i = 0; i < num_bytes; ++i)
+      result |= uint64_t(p[big_endian ? num_bytes - 1 - i : i]) << (8 * i);
+
+    return result;
+  }
+
+  // Whatever the header says, an audio_buffer can only view up to max_num_channels channels.
+  static bool _has_supported_channels(const audio_file_format& format) noexcept {
+    return format.num_channels > 0 && format.num_channels <= size_t(audio_buffer<float>::max_num_channels);
+  }
+
+  // Integer sample formats from a bit depth; sample data is padded to whole bytes.
+  static optional<audio_sample_format> _integer_format(unsigned bits_per_sample, bool is_wav) noexcept {
+    switch ((bits_per_sample + 7) / 8) {
+      case 1: return is_wav ? audio_sample_format::uint8 : audio_sample_format::int8;
+      case 2: return audio_sample_format::int16;
+      case 3: return audio_sample_format::int24;
+      case 4: return audio_sample_format::int32;
+      default: return nullopt;
+    }
+  }
+
+  static optional<audio_file_reader> _parse_wav(__audio_mapped_file file) noexcept {
+    const uint8_t* data = file.data();
+    const size_t size = file.size();
+    const bool is_rf64 = memcmp(data, "RF64", 4) == 0;
+
+    audio_file_format format;
+    bool has_format = false;
+    uint64_t rf64_data_size = 0;
+
+    for (size_t position = 12; position + 8 <= size;) {
+      const uint8_t* chunk = data + position;
+      uint64_t chunk_size = _load_unsigned(chunk + 4, 4, false);
+      const uint8_t* body = chunk + 8;
+      const size_t body_size = size - position - 8;
+
+      if (memcmp(chunk, "ds64", 4) == 0 && body_size >= 16) {
+        rf64_data_size = _load_unsigned(body + 8, 8, false);
+      }
+      else if (memcmp(chunk, "fmt ", 4) == 0 && body_size >= 16) {
+        auto tag = unsigned(_load_unsigned(body, 2, false));
+        const unsigned bits_per_sample = unsigned(_load_unsigned(body + 14, 2, false));
+
+        // WAVE_FORMAT_EXTENSIBLE: the actual tag starts the sub-format GUID.
+        if (tag == 0xfffe && chunk_size >= 40 && body_size >= 26)
+          tag = unsigned(_load_unsigned(body + 24, 2, false));
+
+        format.num_channels = size_t(_load_unsigned(body + 2, 2, false));
+        format.sample_rate = double(_load_unsigned(body + 4, 4, false));
+
+        if (tag == 1) {
+          const auto sample_format = _integer_format(bits_per_sample, true);
+          if (!sample_format)
+            return nullopt;
+          format.sample_format = *sample_format;
+        }
+        else if (tag == 3 && (bits_per_sample == 32 || bits_per_sample == 64)) {
+          format.sample_format = bits_per_sample == 32 ? audio_sample_format::float32 : audio_sample_format::float64;
+        }
+        else {
+          return nullopt;
+        }
+
+        has_format = true;
+      }
+      else if (memcmp(chunk, "data", 4) == 0) {
+        if (!has_format || !_has_supported_channels(format))
+          return nullopt;
+
+        if (is_rf64 && chunk_size == 0xffff'ffff)
+          chunk_size = rf64_data_size;
+
+        return audio_file_reader(move(file), format, position + 8, size_t(min<uint64_t>(chunk_size, body_size)));
+      }
+
+      position += 8 + size_t(min<uint64_t>(chunk_size + (chunk_size & 1), body_size));
+    }
+
+    return nullopt;
+  }
+
+  // The sample rate of an AIFF file is an 80-bit IEEE 754 extended-precision number.
+  static double _load_extended(const uint8_t* p) noexcept {
+    const int exponent = int(_load_unsigned(p, 2, true) & 0x7fff);
+    const uint64_t mantissa = _load_unsigned(p + 2, 8, true);
+    const double magnitude = ldexp(double(mantissa), exponent - 16383 - 63);
+    return (p[0] & 0x80) ? -magnitude : magnitude;
+  }
+
+  static optional<audio_file_reader> _parse_aiff(__audio_mapped_file file) noexcept {
+    const uint8_t* data = file.data();
+    const size_t size = file.size();
+    const bool is_aifc = memcmp(data + 8, "AIFC", 4) == 0;
+
+    audio_file_format format;
+    format.big_endian = true;
+    bool has_format = false;
+
+    for (size_t position = 12; position + 8 <= size;) {
+      const uint8_t* chunk = data + position;
+      const uint64_t chunk_size = _load_unsigned(chunk + 4, 4, true);
+      const uint8_t* body = chunk + 8;
+      const size_t body_size = size - position - 8;
+
+      if (memcmp(chunk, "COMM", 4) == 0 && body_size >= 18) {
+        format.num_channels = size_t(_load_unsigned(body, 2, true));
+        const unsigned bits_per_sample = unsigned(_load_unsigned(body + 6, 2, true));
+        format.sample_rate = _load_extended(body + 8);
+
+        const auto sample_format = _integer_format(bits_per_sample, false);
+        if (sample_format)
+          format.sample_format = *sample_format;
+
+        bool supported = sample_format.has_value();
+        if (is_aifc && body_size >= 22) {
+          const uint8_t* compression = body + 18;
+          if (memcmp(compression, "sowt", 4) == 0) {
+            format.big_endian = false;
+          }
+          else if (memcmp(compression, "fl32", 4) == 0 || memcmp(compression, "FL32", 4) == 0) {
+            format.sample_format = audio_sample_format::float32;
+            supported = true;
+          }
+          else if (memcmp(compression, "fl64", 4) == 0 || memcmp(compression, "FL64", 4) == 0) {
+            format.sample_format = audio_sample_format::float64;
+            supported = true;
+          }
+          else if (memcmp(compression, "NONE", 4) != 0) {
+            return nullopt;
+          }
+        }
+
+        if (!supported)
+          return nullopt;
+
+        has_format = true;
+      }
+      else if (memcmp(chunk, "SSND", 4) == 0 && body_size >= 8) {
+        if (!has_format || !_has_supported_channels(format))
+          return nullopt;
+
+        const size_t offset = size_t(_load_unsigned(body, 4, true));
+        const size_t data_size = size_t(min<uint64_t>(chunk_size, body_size));
+        if (offset + 8 > data_size)
+          return nullopt;
+
+        return audio_file_reader(move(file), format, position + 16 + offset, data_size - 8 - offset);
+      }
+
+      position += 8 + size_t(min<uint64_t>(chunk_size + (chunk_size & 1), body_size));
+    }
+
+    return nullopt;
+  }
+
+  __audio_mapped_file _file;
+  audio_file_format _format;
+  size_t _data_offset = 0;
+  size_t _num_frames = 0;
+};
+
+// Opens a WAV, RF64 or AIFF/AIFC file with PCM or floating-point samples; returns
+// nullopt if the file cannot be opened or its format is not supported, which includes
+// files with more channels than audio_buffer<float>::max_num_channels.
+inline optional<audio_file_reader> open_audio_file(const string& path) {
+  __audio_mapped_file file(path);
+  if (file.size() < 12)
+    return nullopt;
+
+  const uint8_t* data = file.data();
+  if ((memcmp(data, "RIFF", 4) == 0 || memcmp(data, "RF64", 4) == 0) && memcmp(data + 8, "WAVE", 4) == 0)
+    return audio_file_reader::_parse_wav(move(file));
+
+  if (memcmp(data, "FORM", 4) == 0 && (memcmp(data + 8, "AIFF", 4) == 0 || memcmp(data + 8, "AIFC", 4) == 0))
+    return audio_file_reader::_parse_aiff(move(file));
+
+  return nullopt;
+}
+
+// Opens a file of headerless interleaved frames in the given format, starting at data_offset.
+inline optional<audio_file_reader> open_raw_audio_file(const string& path, const audio_file_format& format, size_t data_offset = 0) {
+  __audio_mapped_file file(path);
+  if (file.data() == nullptr || format.bytes_per_frame() == 0 || !audio_file_reader::_has_supported_channels(format))
+    return nullopt;
+
+  const size_t data_size = file.size() - min(data_offset, file.size());
+  return audio_file_reader(move(file), format, data_offset, data_size);
+}
+
+_LIBSTDAUDIO_NAMESPACE_END
@@ -0,0 +1,298 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <type_traits>
+#include <__audio_file.h>
+#include <__audio_frame_fifo.h>
+#include <__audio_triple_buffer.h>
+#include <__audio_worker_pool.h>
+
+_LIBSTDAUDIO_NAMESPACE_BEGIN
+
+// Streams an audio file from disk. A background I/O thread reads ahead into a
+// lock-free ring of buffer_frames frames; the audio thread only ever takes frames
+// out of the ring, so it never touches the file and never blocks. Frames that are
+// not in the ring when the audio thread needs them are replaced by silence and
+// counted as an underrun.
+//
+// seek() makes the I/O thread discard the ring and read pre_roll_frames frames from
+// the new position before the audio thread sees any of them, so that playback
+// resumes with a full cushion; until then the player outputs silence (which does not
+// count as an underrun). A newly constructed player pre-rolls from the start of the
+// file. With looping enabled, reading wraps from the loop end back to the loop start
+// without a gap.
+//
+// The control functions (seek, set_looping, is_ready, is_finished, get_position and
+// get_statistics) may be called from any one thread other than the audio thread.
+class audio_file_player {
+public:
+  struct statistics {
+    uint64_t num_underruns = 0;
+    uint64_t num_missing_frames = 0;
+    size_t buffered_frames = 0;
+  };
+
+  explicit audio_file_player(audio_file_reader file, size_t buffer_frames = 65'536, size_t pre_roll_frames = 16'384)
+    : _file(move(file)),
+      _fifo(max<size_t>(_file.get_format().num_channels, 1), buffer_frames),
+      _pre_roll_frames(min<size_t>(pre_roll_frames, _fifo.capacity())) {
+    _io_thread = thread([this] { _io_thread_main(); });
+  }
+
+  audio_file_player(const audio_file_player&) = delete;
+  audio_file_player& operator=(const audio_file_player&) = delete;
+
+  ~audio_file_player() {
+    _running.store(false, memory_order_relaxed);
+    _io_thread.join();
+  }
+
+  const audio_file_format& get_format() const noexcept {
+    return _file.get_format();
+  }
+
+  size_t size_frames() const noexcept {
+    return _file.size_frames();
+  }
+
+  size_t num_channels() const noexcept {
+    return _file.get_format().num_channels;
+  }
+
+  // Control thread.
+  void seek(size_t frame) noexcept {
+    _seek_target.store(min(frame, _file.size_frames()), memory_order_relaxed);
+    _seeks_requested.fetch_add(1, memory_order_release);
+  }
+
+  // Control thread. Plays [loop_start, loop_end) over and over once the playback
+  // position has reached it; loop_end is clamped to the end of the file.
+  void set_looping(bool looping, size_t loop_start = 0, size_t loop_end = SIZE_MAX) noexcept {
+    _control_loop = {looping, loop_start, min(loop_end, _file.size_frames())};
+    _loops.write_buffer() = _control_loop;
+    _loops.publish();
+  }
+
+  // Control thread. Whether the most recent seek, including the initial one, has
+  // finished pre-rolling.
+  bool is_ready() const noexcept {
+    return _seeks_completed.load(memory_order_acquire) == _seeks_requested.load(memory_order_acquire);
+  }
+
+  // Control thread. Whether every frame up to the end of the file has been played.
+  bool is_finished() const noexcept {
+    return is_ready() && _end_of_data.load(memory_order_acquire) && _fifo.size() == 0;
+  }
+
+  // Control thread. The file position of the next frame the audio thread will play.
+  // As it is computed from two counters that change concurrently, it is only
+  // approximate while playing, which is good enough for display.
+  size_t get_position() const noexcept {
+    if (!is_ready())
+      return _seek_target.load(memory_order_relaxed);
+
+    const size_t written = _written_position.load(memory_order_acquire);
+    const size_t buffered = _fifo.size();
+    if (buffered <= written)
+      return written - buffered;
+
+    // The ring holds frames from before the last wrap from loop end to loop start.
+    const size_t after_wrap = written - min(written, _control_loop.start);
+    return _control_loop.end - min(_control_loop.end, buffered - after_wrap);
+  }
+
+  // Control thread.
+  statistics get_statistics() const noexcept {
+    return {
+      _num_underruns.load(memory_order_relaxed),
+      _num_missing_frames.load(memory_order_relaxed),
+      _fifo.size()
+    };
+  }
+
+  // Audio thread. Hands up to num_frames frames to callback as one or two
+  // interleaved audio_buffer views straight into the ring, and returns how many
+  // frames that were. The views are only valid during the call.
+  template <typename _Callback>
+  size_t read(size_t num_frames, _Callback&& callback) noexcept {
+    // Announce the access before checking for a seek in progress, which the I/O
+    // thread announces before checking for an access (see _handle_seek).
+    _audio_reading.store(true, memory_order_seq_cst);
+    _seeking = _blocked.load(memory_order_seq_cst);
+    if (_seeking) {
+      _audio_reading.store(false, memory_order_release);
+      return 0;
+    }
+
+    auto regions = _fifo.prepare_read(num_frames);
+    const size_t num_read = size_t(regions.size_frames());
+    if (regions.first.size_frames() > 0)
+      callback(as_const(regions.first));
+    if (regions.second.size_frames() > 0)
+      callback(as_const(regions.second));
+
+    _fifo.commit_read(num_read);
+    _audio_reading.store(false, memory_order_release);
+    return num_read;
+  }
+
+  // Audio thread. Overwrites the output with the next frames of the file; channels
+  // beyond the file's are silenced, and so is whatever is missing.
+  template <typename _SampleType>
+  void process(audio_buffer<_SampleType>& output) noexcept {
+    static_assert(is_floating_point_v<_SampleType>, "audio_file_player requires a floating-point sample type");
+
+    const size_t num_frames = size_t(output.size_frames());
+    const size_t num_output_channels = size_t(output.size_channels());
+    const size_t num_file_channels = min(num_output_channels, num_channels());
+
+    // Checked before reading: once it is set, everything up to the end is in the ring.
+    const bool end_of_data = _end_of_data.load(memory_order_acquire);
+
+    size_t offset = 0;
+    const size_t num_read = read(num_frames, [&](const audio_buffer<float>& frames) {
+      for (size_t frame = 0; frame < size_t(frames.size_frames()); ++frame) {
+        for (size_t channel = 0; channel < num_file_channels; ++channel)
+          output(offset + frame, channel) = _SampleType(frames(frame, channel));
+        for (size_t channel = num_file_channels; channel < num_output_channels; ++channel)
+          output(offset + frame, channel) = 0;
+      }
+
+      offset += size_t(frames.size_frames());
+    });
+
+    for (size_t frame = num_read; frame < num_frames; ++frame)
+      for (size_t channel = 0; channel < num_output_channels; ++channel)
+        output(frame, channel) = 0;
+
+    if (num_read < num_frames && !end_of_data && !_seeking) {
+      _num_underruns.store(_num_underruns.load(memory_order_relaxed) + 1, memory_order_relaxed);
+      _num_missing_frames.store(_num_missing_frames.load(memory_order_relaxed) + (num_frames - num_read), memory_order_relaxed);
+    }
+  }
+
+  template <typename _DeviceType, typename _SampleType>
+  void operator()(_DeviceType&, audio_device_io<_SampleType>& io) noexcept {
+    if (io.output_buffer.has_value())
+      process(*io.output_buffer);
+  }
+
+private:
+  struct _loop_settings {
+    bool enabled = false;
+    size_t start = 0;
+    size_t end = 0;
+  };
+
+  // How much the I/O thread reads at a time, so that it notices seeks promptly.
+  static constexpr size_t _max_read_frames = 8192;
+  static constexpr auto _poll_interval = chrono::milliseconds(2);
+
+  void _io_thread_main() noexcept {
+    while (_running.load(memory_order_relaxed)) {
+      const auto seeks_requested = _seeks_requested.load(memory_order_acquire);
+      if (seeks_requested != _seeks_completed.load(memory_order_relaxed))
+        _handle_seek(seeks_requested);
+
+      while (_running.load(memory_order_relaxed)
+             && _seeks_requested.load(memory_order_relaxed) == seeks_requested
+             && _fill(_max_read_frames) > 0) {
+      }
+
+      this_thread::sleep_for(_poll_interval);
+    }
+  }
+
+  void _handle_seek(uint64_t seeks_requested) noexcept {
+    // Shut the audio thread out of the ring and wait until it has left it (a
+    // Dekker-style handshake with read(); both sides use sequentially consistent
+    // stores and loads, so at least one of them sees the other).
+    _blocked.store(true, memory_order_seq_cst);
+    while (_audio_reading.load(memory_order_seq_cst))
+      __audio_cpu_pause();
+
+    _fifo.reset();
+    _file_position = _seek_target.load(memory_order_relaxed);
+    _written_position.store(_file_position, memory_order_relaxed);
+    _end_of_data.store(false, memory_order_relaxed);
+
+    while (size_t(_fifo.size()) < _pre_roll_frames && _fill(_pre_roll_frames - size_t(_fifo.size())) > 0) {
+    }
+
+    _seeks_completed.store(seeks_requested, memory_order_release);
+    _blocked.store(false, memory_order_seq_cst);
+  }
+
+  // Reads up to max_frames frames into the ring and returns how many that were.
+  size_t _fill(size_t max_frames) noexcept {
+    _loops.update();
+    const auto& loop = _loops.read_buffer();
+    const bool looping = loop.enabled && loop.start < loop.end;
+    const size_t end = looping ? loop.end : _file.size_frames();
+
+    if (looping && _file_position >= end)
+      _file_position = loop.start;
+
+    if (_file_position >= end) {
+      _end_of_data.store(true, memory_order_release);
+      return 0;
+    }
+
+    auto regions = _fifo.prepare_write(min(max_frames, end - _file_position));
+    size_t num_read = _file.read(_file_position, regions.first);
+    num_read += _file.read(_file_position + num_read, regions.second);
+    if (num_read == 0)
+      return 0;
+
+    _fifo.commit_write(num_read);
+    _file_position += num_read;
+    _written_position.store(_file_position, memory_order_release);
+
+    if (looping && _file_position >= end)
+      _file_position = loop.start;
+
+    _file.prefetch(_file_position, _max_read_frames);
+    return num_read;
+  }
+
+  audio_file_reader _file;
+  __audio_frame_fifo<float> _fifo;
+  size_t _pre_roll_frames;
+
+  // Control thread to I/O thread.
+  __triple_buffer<_loop_settings> _loops;
+  _loop_settings _control_loop;
+  atomic<size_t> _seek_target = 0;
+  atomic<uint64_t> _seeks_requested = 1;
+  atomic<uint64_t> _seeks_completed = 0;
+  atomic<bool> _running = true;
+
+  // Only touched by the I/O thread.
+  size_t _file_position = 0;
+
+  // I/O thread to audio and control thread.
+  atomic<size_t> _written_position = 0;
+  atomic<bool> _end_of_data = false;
+  atomic<bool> _blocked = true;
+
+  // Audio thread to I/O and control thread.
+  atomic<bool> _audio_reading = false;
+  atomic<uint64_t> _num_underruns = 0;
+  atomic<uint64_t> _num_missing_frames = 0;
+
+  // Only touched by the audio thread: whether the last read found a seek in progress.
+  bool _seeking = false;
+
+  thread _io_thread;
+};
+
+_LIBSTDAUDIO_NAMESPACE_END
@@ -0,0 +1,994 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include <__audio_file.h>
+#include <__audio_flac_encoder.h>
+#include <__audio_frame_fifo.h>
+#include <__audio_simd.h>
+#include <__audio_worker_pool.h>
+
+#if defined(_WIN32)
+  #include <windows.h>
+#else
+  #include <cerrno>
+  #include <fcntl.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+_LIBSTDAUDIO_NAMESPACE_BEGIN
+
+// A file written at explicit offsets, optionally bypassing the page cache. Unbuffered
+// writes must be aligned to alignment in offset, size and memory; the first write
+// that is not falls back to buffered I/O for the rest of the file's life.
+class __audio_output_file {
+public:
+  static constexpr size_t alignment = 4096;
+
+  __audio_output_file() = default;
+  __audio_output_file(const __audio_output_file&) = delete;
+  __audio_output_file& operator=(const __audio_output_file&) = delete;
+
+  ~__audio_output_file() {
+    _close_handle();
+  }
+
+  bool open(const string& path, bool direct_io) noexcept {
+    _close_handle();
+
+#if defined(_WIN32)
+    const DWORD flags = direct_io ? FILE_FLAG_NO_BUFFERING | FILE_FLAG_WRITE_THROUGH : FILE_ATTRIBUTE_NORMAL;
+    _handle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, flags, nullptr);
+    _direct = direct_io && _handle != INVALID_HANDLE_VALUE;
+    return _handle != INVALID_HANDLE_VALUE;
+#else
+    constexpr int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+  #if defined(O_DIRECT)
+    // Not every file system supports O_DIRECT (tmpfs, for example, does not).
+    if (direct_io) {
+      _handle = ::open(path.c_str(), flags | O_DIRECT, 0644);
+      _direct = _handle >= 0;
+    }
+  #endif
+
+    if (_handle < 0)
+      _handle = ::open(path.c_str(), flags, 0644);
+
+  #if defined(__APPLE__)
+    if (direct_io && _handle >= 0)
+      _direct = fcntl(_handle, F_NOCACHE, 1) == 0;
+  #endif
+
+    return _handle >= 0;
+#endif
+  }
+
+  bool is_direct() const noexcept {
+    return _direct;
+  }
+
+  // Reserves disk space for the file without changing its size. A hint only: false
+  // means the file system could not do it, not that the file is unusable.
+  bool preallocate(uint64_t size) noexcept {
+#if defined(_WIN32)
+    FILE_ALLOCATION_INFO info;
+    info.AllocationSize.QuadPart = LONGLONG(size);
+    return SetFileInformationByHandle(_handle, FileAllocationInfo, &info, sizeof(info)) != 0;
+#elif defined(__linux__)
+    return fallocate(_handle, FALLOC_FL_KEEP_SIZE, 0, off_t(size)) == 0;
+#elif defined(__APPLE__)
+    fstore_t store = {F_ALLOCATECONTIG, F_PEOFPOSMODE, 0, off_t(size), 0};
+    if (fcntl(_handle, F_PREALLOCATE, &store) == 0)
+      return true;
+
+    store.fst_flags = F_ALLOCATEALL;
+    return fcntl(_handle, F_PREALLOCATE, &store) == 0;
+#else
+    (void)size;
+    return false;
+#endif
+  }
+
+  bool write_at(const void* data, size_t size, uint64_t offset) noexcept {
+    if (_direct && ((offset | size | reinterpret_cast<uintptr_t>(data)) & (alignment - 1)) != 0)
+      _disable_direct_io();
+
+#if defined(_WIN32)
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+      OVERLAPPED position = {};
+      position.Offset = DWORD(offset);
+      position.OffsetHigh = DWORD(offset >> 32);
+
+      DWORD written = 0;
+      if (!WriteFile(_handle, bytes, DWORD(min<size_t>(size, 1u << 30)), &written, &position) || written == 0)
+        return false;
+
+      bytes += written;
+      size -= written;
+      offset += written;
+    }
+
+    return true;
+#else
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+      const ssize_t written = pwrite(_handle, bytes, size, off_t(offset));
+      if (written < 0 && errno == EINTR)
+        continue;
+
+      // Some file systems only reject unbuffered writes once they happen.
+      if (written < 0 && errno == EINVAL && _direct) {
+        _disable_direct_io();
+        continue;
+      }
+
+      if (written <= 0)
+        return false;
+
+      bytes += written;
+      size -= size_t(written);
+      offset += uint64_t(written);
+    }
+
+    return true;
+#endif
+  }
+
+  // Makes the data written so far durable.
+  bool sync() noexcept {
+#if defined(_WIN32)
+    return FlushFileBuffers(_handle) != 0;
+#elif defined(__linux__)
+    return fdatasync(_handle) == 0;
+#else
+    return fsync(_handle) == 0;
+#endif
+  }
+
+  // Cuts off whatever was preallocated beyond size, syncs and closes.
+  bool close(uint64_t size) noexcept {
+#if defined(_WIN32)
+    FILE_END_OF_FILE_INFO info;
+    info.EndOfFile.QuadPart = LONGLONG(size);
+    bool result = SetFileInformationByHandle(_handle, FileEndOfFileInfo, &info, sizeof(info)) != 0;
+#else
+    bool result = ftruncate(_handle, off_t(size)) == 0;
+#endif
+    result = sync() && result;
+    _close_handle();
+    return result;
+  }
+
+private:
+  void _disable_direct_io() noexcept {
+    _direct = false;
+
+#if defined(_WIN32)
+    const HANDLE handle = ReOpenFile(_handle, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, FILE_ATTRIBUTE_NORMAL);
+    if (handle != INVALID_HANDLE_VALUE) {
+      CloseHandle(_handle);
+      _handle = handle;
+    }
+#elif defined(O_DIRECT)
+    fcntl(_handle, F_SETFL, fcntl(_handle, F_GETFL) & ~O_DIRECT);
+#elif defined(__APPLE__)
+    fcntl(_handle, F_NOCACHE, 0);
+#endif
+  }
+
+  void _close_handle() noexcept {
+#if defined(_WIN32)
+    if (_handle != INVALID_HANDLE_VALUE)
+      CloseHandle(_handle);
+    _handle = INVALID_HANDLE_VALUE;
+#else
+    if (_handle >= 0)
+      ::close(_handle);
+    _handle = -1;
+#endif
+    _direct = false;
+  }
+
+#if defined(_WIN32)
+  HANDLE _handle = INVALID_HANDLE_VALUE;
+#else
+  int _handle = -1;
+#endif
+  bool _direct = false;
+};
+
+// Rounds a floating-point sample to a bits-bit integer (at most 24), with clipping.
+inline int32_t __audio_quantize_sample(float sample, unsigned bits) noexcept {
+  const float scale = float(1 << (bits - 1));
+  return int32_t(lrintf(clamp(sample * scale, -scale, scale - 1)));
+}
+
+// Converts floating-point samples to little-endian sample data, with clipping.
+inline void __audio_encode_samples(const float* src, size_t num_samples, audio_sample_format format, uint8_t* dst) noexcept {
+  const auto store = [](uint8_t* p, uint64_t value, size_t num_bytes) {
+    for (size_t i = 0; i < num_bytes; ++i)
+      p[i] = uint8_t(value >> (8 * i));
+  };
+
+  switch (format) {
+    case audio_sample_format::int8:
+      for (size_t i = 0; i < num_samples; ++i)
+        dst[i] = uint8_t(int8_t(__audio_quantize_sample(src[i], 8)));
+      break;
+    case audio_sample_format::uint8:
+      for (size_t i = 0; i < num_samples; ++i)
+        dst[i] = uint8_t(__audio_quantize_sample(src[i], 8) + 128);
+      break;
+    case audio_sample_format::int16:
+      for (size_t i = 0; i < num_samples; ++i)
+        store(dst + 2 * i, uint32_t(__audio_quantize_sample(src[i], 16)), 2);
+      break;
+    case audio_sample_format::int24:
+      for (size_t i = 0; i < num_samples; ++i)
+        store(dst + 3 * i, uint32_t(__audio_quantize_sample(src[i], 24)), 3);
+      break;
+    case audio_sample_format::int32:
+      // In double, where 2^31 - 1 is exact.
+      for (size_t i = 0; i < num_samples; ++i)
+        store(dst + 4 * i, uint32_t(int32_t(llrint(clamp(double(src[i]) * 2'147'483'648.0, -2'147'483'648.0, 2'147'483'647.0)))), 4);
+      break;
+    case audio_sample_format::float32:
+      for (size_t i = 0; i < num_samples; ++i) {
+        uint32_t bits;
+        memcpy(&bits, src + i, sizeof(bits));
+        store(dst + 4 * i, bits, 4);
+      }
+      break;
+    case audio_sample_format::float64:
+      for (size_t i = 0; i < num_samples; ++i) {
+        const double sample = src[i];
+        uint64_t bits;
+        memcpy(&bits, &sample, sizeof(bits));
+        store(dst + 8 * i, bits, 8);
+      }
+      break;
+  }
+}
+
+// Appends to a file in large blocks after a header of one alignment unit, so that
+// with unbuffered I/O every block lands at an aligned offset; only the final, partial
+// block is written through the page cache. The header is written separately, e.g. a
+// placeholder on open and the final version on close.
+class __audio_block_writer {
+public:
+  static constexpr size_t header_size = __audio_output_file::alignment;
+
+  explicit __audio_block_writer(size_t block_bytes)
+    : _block_bytes(max(_round_up(block_bytes, __audio_output_file::alignment), __audio_output_file::alignment)),
+      _staging(2 * _block_bytes),
+      _header(header_size) {
+  }
+
+  bool open(const string& path, bool direct_io, uint64_t preallocate_bytes) noexcept {
+    _num_staged = 0;
+    _num_unsynced = 0;
+    _file_position = header_size;
+
+    if (!_file.open(path, direct_io))
+      return false;
+
+    if (preallocate_bytes > 0)
+      _file.preallocate(header_size + preallocate_bytes);
+
+    return true;
+  }
+
+  // Makes the file durable every sync_interval_bytes bytes; 0 only syncs on close.
+  void set_sync_interval(uint64_t sync_interval_bytes) noexcept {
+    _sync_interval = sync_interval_bytes;
+  }
+
+  // Bytes appended after the header so far.
+  uint64_t size() const noexcept {
+    return _file_position - header_size + _num_staged;
+  }
+
+  uint8_t* header() noexcept {
+    return _header.data();
+  }
+
+  bool write_header() noexcept {
+    return _file.write_at(_header.data(), header_size, 0);
+  }
+
+  // The most that may be written to reserve() before the next commit().
+  size_t max_reserve() const noexcept {
+    return _block_bytes;
+  }
+
+  uint8_t* reserve() noexcept {
+    return _staging.data() + _num_staged;
+  }
+
+  bool commit(size_t num_bytes) noexcept {
+    assert(num_bytes <= _block_bytes);
+    _num_staged += num_bytes;
+
+    while (_num_staged >= _block_bytes) {
+      if (!_write_staged(_block_bytes))
+        return false;
+    }
+
+    return true;
+  }
+
+  bool append(const uint8_t* data, size_t num_bytes) noexcept {
+    while (num_bytes > 0) {
+      const size_t n = min(num_bytes, _block_bytes);
+      memcpy(reserve(), data, n);
+      if (!commit(n))
+        return false;
+
+      data += n;
+      num_bytes -= n;
+    }
+
+    return true;
+  }
+
+  // Writes out what is left, then the header, and closes the file.
+  bool close() noexcept {
+    bool result = _num_staged == 0 || _write_staged(_num_staged);
+    result = write_header() && result;
+    return _file.close(_file_position) && result;
+  }
+
+private:
+  static size_t _round_up(size_t n, size_t multiple) noexcept {
+    return (n + multiple - 1) / multiple * multiple;
+  }
+
+  bool _write_staged(size_t num_bytes) noexcept {
+    if (!_file.write_at(_staging.data(), num_bytes, _file_position))
+      return false;
+
+    _file_position += num_bytes;
+    _num_staged -= num_bytes;
+    memmove(_staging.data(), _staging.data() + num_bytes, _num_staged);
+
+    _num_unsynced += num_bytes;
+    if (_sync_interval > 0 && _num_unsynced >= _sync_interval) {
+      _num_unsynced = 0;
+      return _file.sync();
+    }
+
+    return true;
+  }
+
+  using _aligned_bytes = vector<uint8_t, __simd_aligned_allocator<uint8_t, __audio_output_file::alignment>>;
+
+  size_t _block_bytes;
+  __audio_output_file _file;
+  _aligned_bytes _staging;
+  _aligned_bytes _header;
+  size_t _num_staged = 0;
+  uint64_t _file_position = 0;
+  uint64_t _sync_interval = 0;
+  uint64_t _num_unsynced = 0;
+};
+
+// Where the recorder's writer thread puts the frames it takes out of the ring.
+class __audio_file_writer {
+public:
+  virtual ~__audio_file_writer() = default;
+
+  virtual bool write(const float* frames, size_t num_frames) noexcept = 0;
+
+  // Writes out everything and completes the file(s).
+  virtual bool close() noexcept = 0;
+
+  uint64_t num_frames() const noexcept {
+    return _num_frames;
+  }
+
+protected:
+  uint64_t _num_frames = 0;
+};
+
+// Writes interleaved frames to a WAV file. The header is rewritten with the final
+// sizes on close, as RF64 if the file has grown beyond what a RIFF header can
+// describe or if always_rf64 is set.
+class __audio_wav_writer : public __audio_file_writer {
+public:
+  __audio_wav_writer(const audio_file_format& format, size_t write_block_bytes, bool always_rf64)
+    : _format(format),
+      _frame_bytes(format.bytes_per_frame()),
+      _always_rf64(always_rf64),
+      _blocks(write_block_bytes) {
+  }
+
+  bool open(const string& path, bool direct_io, uint64_t preallocate_frames, uint64_t sync_interval_bytes) noexcept {
+    _num_frames = 0;
+    _blocks.set_sync_interval(sync_interval_bytes);
+    if (!_blocks.open(path, direct_io, preallocate_frames * _frame_bytes))
+      return false;
+
+    // A placeholder, so that a file that is never closed still has a valid format.
+    _build_header();
+    return _blocks.write_header();
+  }
+
+  bool write(const float* frames, size_t num_frames) noexcept override {
+    const size_t max_frames_per_chunk = _blocks.max_reserve() / _frame_bytes;
+
+    while (num_frames > 0) {
+      const size_t n = min(num_frames, max_frames_per_chunk);
+      __audio_encode_samples(frames, n * _format.num_channels, _format.sample_format, _blocks.reserve());
+      if (!_blocks.commit(n * _frame_bytes))
+        return false;
+
+      _num_frames += n;
+      frames += n * _format.num_channels;
+      num_frames -= n;
+    }
+
+    return true;
+  }
+
+  bool close() noexcept override {
+    // The data chunk is padded to an even size.
+    bool result = true;
+    if ((_num_frames * _frame_bytes) % 2 != 0) {
+      const uint8_t pad = 0;
+      result = _blocks.append(&pad, 1);
+    }
+
+    _build_header();
+    return _blocks.close() && result;
+  }
+
+private:
+  static constexpr size_t _ds64_offset = 12;
+  static constexpr size_t _fmt_offset = _ds64_offset + 8 + 28;
+  static constexpr size_t _padding_offset = _fmt_offset + 8 + 40;
+  static constexpr size_t _data_offset = __audio_block_writer::header_size - 8;
+
+  void _store(size_t offset, uint64_t value, size_t num_bytes) noexcept {
+    for (size_t i = 0; i < num_bytes; ++i)
+      _blocks.header()[offset + i] = uint8_t(value >> (8 * i));
+  }
+
+  void _store_tag(size_t offset, const char* tag) noexcept {
+    memcpy(_blocks.header() + offset, tag, 4);
+  }
+
+  void _build_header() noexcept {
+    const uint64_t data_bytes = _num_frames * _frame_bytes;
+    const uint64_t riff_bytes = __audio_block_writer::header_size + _blocks.size() - 8;
+    const bool rf64 = _always_rf64 || riff_bytes > 0xffff'ffff;
+
+    fill(_blocks.header(), _blocks.header() + __audio_block_writer::header_size, uint8_t(0));
+
+    _store_tag(0, rf64 ? "RF64" : "RIFF");
+    _store(4, rf64 ? 0xffff'ffff : riff_bytes, 4);
+    _store_tag(8, "WAVE");
+
+    // Room for the ds64 chunk of RF64, which RIFF readers skip as JUNK.
+    _store_tag(_ds64_offset, rf64 ? "ds64" : "JUNK");
+    _store(_ds64_offset + 4, 28, 4);
+    if (rf64) {
+      _store(_ds64_offset + 8, riff_bytes, 8);
+      _store(_ds64_offset + 16, data_bytes, 8);
+      _store(_ds64_offset + 24, _num_frames, 8);
+    }
+
+    // WAVE_FORMAT_EXTENSIBLE, as required for more than two channels or 16 bits.
+    const bool is_float = _format.sample_format == audio_sample_format::float32 || _format.sample_format == audio_sample_format::float64;
+    const size_t bits_per_sample = 8 * get_audio_sample_format_size(_format.sample_format);
+    _store_tag(_fmt_offset, "fmt ");
+    _store(_fmt_offset + 4, 40, 4);
+    _store(_fmt_offset + 8, 0xfffe, 2);
+    _store(_fmt_offset + 10, _format.num_channels, 2);
+    _store(_fmt_offset + 12, uint32_t(lround(_format.sample_rate)), 4);
+    _store(_fmt_offset + 16, uint32_t(lround(_format.sample_rate)) * _frame_bytes, 4);
+    _store(_fmt_offset + 20, _frame_bytes, 2);
+    _store(_fmt_offset + 22, bits_per_sample, 2);
+    _store(_fmt_offset + 24, 22, 2);
+    _store(_fmt_offset + 26, bits_per_sample, 2);
+    _store(_fmt_offset + 28, 0, 4);
+    static constexpr uint8_t guid_suffix[14] = {0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71};
+    _store(_fmt_offset + 32, is_float ? 3 : 1, 2);
+    memcpy(_blocks.header() + _fmt_offset + 34, guid_suffix, sizeof(guid_suffix));
+
+    _store_tag(_padding_offset, "JUNK");
+    _store(_padding_offset + 4, _data_offset - _padding_offset - 8, 4);
+
+    _store_tag(_data_offset, "data");
+    _store(_data_offset + 4, rf64 ? 0xffff'ffff : data_bytes, 4);
+  }
+
+  audio_file_format _format;
+  size_t _frame_bytes;
+  bool _always_rf64;
+  __audio_block_writer _blocks;
+};
+
+using audio_file_recorder_executor = function<void(size_t num_tasks, void (*task)(void* context, size_t index), void* context)>;
+
+// Writes interleaved frames to FLAC files. FLAC allows at most eight channels, so
+// the channels are split into groups of eight with a file each. Frames are
+// collected into batches of several FLAC blocks, and all blocks of all groups in
+// a batch are encoded as independent tasks, through the executor if there is one.
+class __audio_flac_writer : public __audio_file_writer {
+public:
+  __audio_flac_writer(const audio_file_format& format, size_t write_block_bytes, audio_file_recorder_executor executor)
+    : _format(format),
+      _bits_per_sample(unsigned(8 * get_audio_sample_format_size(format.sample_format))),
+      _executor(move(executor)),
+      _batch(format.num_channels, vector<int32_t>(_batch_blocks * _block_size)) {
+    const size_t num_groups = (format.num_channels + _max_group_channels - 1) / _max_group_channels;
+    for (size_t group = 0; group < num_groups; ++group) {
+      auto& g = _groups.emplace_back();
+      g.first_channel = group * _max_group_channels;
+      g.num_channels = min(_max_group_channels, format.num_channels - g.first_channel);
+      g.blocks = make_unique<__audio_block_writer>(write_block_bytes);
+
+      for (size_t block = 0; block < _batch_blocks; ++block)
+        _slots.push_back({__audio_flac_encoder(g.num_channels, _bits_per_sample, unsigned(lround(format.sample_rate))), {}});
+    }
+  }
+
+  // The file of channel group group out of num_groups: path itself if there is only
+  // one, otherwise path with _1, _2, ... inserted before the extension.
+  static string group_path(const string& path, size_t group, size_t num_groups) {
+    if (num_groups == 1)
+      return path;
+
+    const size_t separator = path.find_last_of("/\\");
+    size_t extension = path.find_last_of('.');
+    if (extension == string::npos || (separator != string::npos && extension < separator))
+      extension = path.size();
+
+    return path.substr(0, extension) + "_" + to_string(group + 1) + path.substr(extension);
+  }
+
+  static bool supports(audio_sample_format format) noexcept {
+    return format == audio_sample_format::int8 || format == audio_sample_format::uint8
+           || format == audio_sample_format::int16 || format == audio_sample_format::int24;
+  }
+
+  bool open(const string& path, bool direct_io, uint64_t preallocate_frames, uint64_t sync_interval_bytes) noexcept {
+    _num_frames = 0;
+    _batch_frames = 0;
+    _num_flac_frames = 0;
+
+    for (size_t group = 0; group < _groups.size(); ++group) {
+      auto& g = _groups[group];
+      g.min_frame_size = UINT32_MAX;
+      g.max_frame_size = 0;
+      g.blocks->set_sync_interval(sync_interval_bytes);
+
+      // Preallocated as if uncompressed; what is left over is cut off on close.
+      const uint64_t preallocate_bytes = preallocate_frames * g.num_channels * (_bits_per_sample / 8);
+      if (!g.blocks->open(group_path(path, group, _groups.size()), direct_io, preallocate_bytes))
+        return false;
+
+      _build_header(g);
+      if (!g.blocks->write_header())
+        return false;
+    }
+
+    return true;
+  }
+
+  bool write(const float* frames, size_t num_frames) noexcept override {
+    const size_t num_channels = _format.num_channels;
+
+    while (num_frames > 0) {
+      const size_t n = min(num_frames, _batch.front().size() - _batch_frames);
+      for (size_t channel = 0; channel < num_channels; ++channel) {
+        int32_t* dst = _batch[channel].data() + _batch_frames;
+        for (size_t frame = 0; frame < n; ++frame)
+          dst[frame] = __audio_quantize_sample(frames[frame * num_channels + channel], _bits_per_sample);
+      }
+
+      _batch_frames += n;
+      _num_frames += n;
+      frames += n * num_channels;
+      num_frames -= n;
+
+      if (_batch_frames == _batch.front().size() && !_encode_batch())
+        return false;
+    }
+
+    return true;
+  }
+
+  bool close() noexcept override {
+    bool result = _batch_frames == 0 || _encode_batch();
+    for (auto& g : _groups) {
+      _build_header(g);
+      result = g.blocks->close() && result;
+    }
+
+    return result;
+  }
+
+private:
+  static constexpr size_t _max_group_channels = __audio_flac_encoder::max_channels;
+  static constexpr size_t _block_size = __audio_flac_encoder::block_size;
+  static constexpr size_t _batch_blocks = 8;
+
+  struct _group {
+    size_t first_channel = 0;
+    size_t num_channels = 0;
+    unique_ptr<__audio_block_writer> blocks;
+    uint32_t min_frame_size = UINT32_MAX;
+    uint32_t max_frame_size = 0;
+  };
+
+  struct _slot {
+    __audio_flac_encoder encoder;
+    vector<uint8_t> bytes;
+  };
+
+  // STREAMINFO, then padding up to where the frames start.
+  void _build_header(_group& g) {
+    const auto& encoder = _slots[size_t(&g - _groups.data()) * _batch_blocks].encoder;
+    const bool has_frames = g.max_frame_size > 0;
+
+    _header_bytes.clear();
+    encoder.write_stream_header(_header_bytes, _num_frames, has_frames ? g.min_frame_size : 0, g.max_frame_size, true);
+    __audio_flac_encoder::write_padding(_header_bytes, __audio_block_writer::header_size - _header_bytes.size());
+    memcpy(g.blocks->header(), _header_bytes.data(), _header_bytes.size());
+  }
+
+  static void _encode_task(void* context, size_t index) {
+    static_cast<__audio_flac_writer*>(context)->_encode(index);
+  }
+
+  // Task index is group * number of blocks in the batch + block.
+  void _encode(size_t index) {
+    const size_t num_blocks = (_batch_frames + _block_size - 1) / _block_size;
+    const size_t group = index / num_blocks;
+    const size_t block = index % num_blocks;
+    const auto& g = _groups[group];
+
+    array<const int32_t*, _max_group_channels> channels = {};
+    for (size_t channel = 0; channel < g.num_channels; ++channel)
+      channels[channel] = _batch[g.first_channel + channel].data() + block * _block_size;
+
+    auto& slot = _slots[group * _batch_blocks + block];
+    slot.bytes.clear();
+    slot.encoder.encode_frame(channels.data(), min(_block_size, _batch_frames - block * _block_size), _num_flac_frames + block, slot.bytes);
+  }
+
+  // The executor is the user's, and a frame's bytes grow until they have seen the
+  // largest frame, so encoding can throw. The batch is lost then, and the write fails
+  // like a failed write to the disk.
+  bool _encode_batch() noexcept {
+    const size_t num_blocks = (_batch_frames + _block_size - 1) / _block_size;
+    const size_t num_tasks = _groups.size() * num_blocks;
+
+    try {
+      if (_executor)
+        _executor(num_tasks, &_encode_task, this);
+      else
+        for (size_t index = 0; index < num_tasks; ++index)
+          _encode(index);
+    }
+    catch (...) {
+      _batch_frames = 0;
+      return false;
+    }
+
+    bool result = true;
+    for (size_t group = 0; group < _groups.size(); ++group) {
+      auto& g = _groups[group];
+      for (size_t block = 0; block < num_blocks; ++block) {
+        const auto& bytes = _slots[group * _batch_blocks + block].bytes;
+        g.min_frame_size = min(g.min_frame_size, uint32_t(bytes.size()));
+        g.max_frame_size = max(g.max_frame_size, uint32_t(bytes.size()));
+        result = result && g.blocks->append(bytes.data(), bytes.size());
+      }
+    }
+
+    _num_flac_frames += num_blocks;
+    _batch_frames = 0;
+    return result;
+  }
+
+  audio_file_format _format;
+  unsigned _bits_per_sample;
+  audio_file_recorder_executor _executor;
+  vector<vector<int32_t>> _batch;
+  size_t _batch_frames = 0;
+  uint64_t _num_flac_frames = 0;
+  vector<_group> _groups;
+  vector<_slot> _slots;
+  vector<uint8_t> _header_bytes;
+};
+
+enum class audio_file_type {
+  wav,
+  flac,
+};
+
+// Records the input of an audio device to a WAV or FLAC file. The audio thread only
+// copies its input into a lock-free ring of buffer_frames frames; a background
+// writer thread converts the frames to the file's sample format (and compresses them,
+// for FLAC) and writes them in large blocks, unbuffered where the OS and file system
+// allow. Frames that do not fit into the ring because the disk or the encoder has
+// fallen behind are dropped and counted.
+//
+// 8-bit WAV files are unsigned, so int8 is recorded as uint8. FLAC takes 8, 16 and
+// 24-bit integer formats and at most eight channels per file; with more channels,
+// the recording is split into one file per group of eight, named path_1, path_2 and
+// so on (with the extension kept at the end). FLAC encoding runs on the writer
+// thread, or as parallel tasks through the executor if one is set, e.g. a dedicated
+// audio_worker_pool (not one that the audio thread uses).
+//
+// start(), stop() and the setters must be called from one control thread; the
+// setters take effect with the next start(). The file is only complete once stop()
+// has returned, which rewrites its header with the final sizes.
+class audio_file_recorder {
+public:
+  struct statistics {
+    uint64_t num_recorded_frames = 0;
+    uint64_t num_dropped_frames = 0;
+    uint64_t num_overruns = 0;
+    bool write_failed = false;
+  };
+
+  audio_file_recorder(size_t num_channels,
+                      double sample_rate,
+                      audio_sample_format sample_format = audio_sample_format::int24,
+                      size_t buffer_frames = 1 << 18)
+    : _format{sample_rate, num_channels, sample_format == audio_sample_format::int8 ? audio_sample_format::uint8 : sample_format, false},
+      _fifo(clamp<size_t>(num_channels, 1, _max_num_channels), buffer_frames) {
+  }
+
+  audio_file_recorder(const audio_file_recorder&) = delete;
+  audio_file_recorder& operator=(const audio_file_recorder&) = delete;
+
+  ~audio_file_recorder() {
+    stop();
+  }
+
+  const audio_file_format& get_format() const noexcept {
+    return _format;
+  }
+
+  void set_file_type(audio_file_type type) noexcept {
+    _file_type = type;
+  }
+
+  void set_executor(audio_file_recorder_executor executor) {
+    _executor = move(executor);
+  }
+
+  // Bytes per write; the writer stays this far behind the audio thread at most.
+  void set_write_block_size(size_t num_bytes) noexcept {
+    _write_block_bytes = num_bytes;
+  }
+
+  // See __audio_block_writer::set_sync_interval.
+  void set_sync_interval(uint64_t num_bytes) noexcept {
+    _sync_interval_bytes = num_bytes;
+  }
+
+  void set_direct_io(bool enabled) noexcept {
+    _direct_io = enabled;
+  }
+
+  // Writes an RF64 header even if the file would fit a RIFF one, for tools that expect it.
+  void set_always_rf64(bool enabled) noexcept {
+    _always_rf64 = enabled;
+  }
+
+  // Starts a new recording, reserving disk space for preallocate_frames frames up
+  // front if that is nonzero. Returns false if the file cannot be created, the file
+  // type does not support the sample format, or the recorder has no channels or more
+  // than audio_buffer<float>::max_num_channels.
+  bool start(const string& path, uint64_t preallocate_frames = 0) {
+    stop();
+
+    if (_format.num_channels == 0 || _format.num_channels > _max_num_channels)
+      return false;
+
+    if (_file_type == audio_file_type::flac) {
+      if (!__audio_flac_writer::supports(_format.sample_format))
+        return false;
+
+      auto writer = make_unique<__audio_flac_writer>(_format, _write_block_bytes, _executor);
+      if (!writer->open(path, _direct_io, preallocate_frames, _sync_interval_bytes))
+        return false;
+      _writer = move(writer);
+    }
+    else {
+      auto writer = make_unique<__audio_wav_writer>(_format, _write_block_bytes, _always_rf64);
+      if (!writer->open(path, _direct_io, preallocate_frames, _sync_interval_bytes))
+        return false;
+      _writer = move(writer);
+    }
+
+    _fifo.reset();
+    _num_recorded_frames.store(0, memory_order_relaxed);
+    _num_dropped_frames.store(0, memory_order_relaxed);
+    _num_overruns.store(0, memory_order_relaxed);
+    _write_failed.store(false, memory_order_relaxed);
+    _stopping.store(false, memory_order_relaxed);
+
+    _writer_thread = thread([this] { _writer_thread_main(); });
+    _recording.store(true, memory_order_seq_cst);
+    return true;
+  }
+
+  // Stops recording, writes out whatever the ring still holds and completes the
+  // file. Returns false if anything could not be written.
+  bool stop() {
+    if (!_writer_thread.joinable())
+      return true;
+
+    // Shut the audio thread out and wait until it has left the ring (see process()).
+    _recording.store(false, memory_order_seq_cst);
+    while (_audio_writing.load(memory_order_seq_cst))
+      __audio_cpu_pause();
+
+    _stopping.store(true, memory_order_release);
+    _writer_thread.join();
+
+    const bool closed = _writer->close();
+    _writer.reset();
+    if (!closed)
+      _write_failed.store(true, memory_order_relaxed);
+
+    return !_write_failed.load(memory_order_relaxed);
+  }
+
+  bool is_recording() const noexcept {
+    return _recording.load(memory_order_relaxed);
+  }
+
+  statistics get_statistics() const noexcept {
+    return {
+      _num_recorded_frames.load(memory_order_relaxed),
+      _num_dropped_frames.load(memory_order_relaxed),
+      _num_overruns.load(memory_order_relaxed),
+      _write_failed.load(memory_order_relaxed)
+    };
+  }
+
+  // Audio thread. Channels of the input beyond the recorder's are ignored, missing
+  // ones are recorded as silence.
+  template <typename _SampleType>
+  void process(const audio_buffer<_SampleType>& input) noexcept {
+    static_assert(is_floating_point_v<_SampleType>, "audio_file_recorder requires a floating-point sample type");
+
+    _audio_writing.store(true, memory_order_seq_cst);
+    if (!_recording.load(memory_order_seq_cst)) {
+      _audio_writing.store(false, memory_order_release);
+      return;
+    }
+
+    const size_t num_frames = size_t(input.size_frames());
+    auto regions = _fifo.prepare_write(num_frames);
+    const size_t num_written = size_t(regions.size_frames());
+    _copy(input, 0, regions.first);
+    _copy(input, size_t(regions.first.size_frames()), regions.second);
+    _fifo.commit_write(num_written);
+
+    if (num_written < num_frames) {
+      _num_overruns.store(_num_overruns.load(memory_order_relaxed) + 1, memory_order_relaxed);
+      _num_dropped_frames.store(_num_dropped_frames.load(memory_order_relaxed) + (num_frames - num_written), memory_order_relaxed);
+    }
+
+    _audio_writing.store(false, memory_order_release);
+  }
+
+  template <typename _DeviceType, typename _SampleType>
+  void operator()(_DeviceType&, audio_device_io<_SampleType>& io) noexcept {
+    if (io.input_buffer.has_value())
+      process(*io.input_buffer);
+  }
+
+private:
+  static constexpr auto _poll_interval = chrono::milliseconds(2);
+  static constexpr size_t _max_num_channels = audio_buffer<float>::max_num_channels;
+
+  template <typename _SampleType>
+  void _copy(const audio_buffer<_SampleType>& input, size_t first_frame, audio_buffer<float>& dst) noexcept {
+    const size_t num_frames = size_t(dst.size_frames());
+    const size_t num_channels = size_t(dst.size_channels());
+    const size_t num_input_channels = min(num_channels, size_t(input.size_channels()));
+    if (num_frames == 0)
+      return;
+
+    if constexpr (is_same_v<_SampleType, float>) {
+      if (input.frames_are_contiguous() && size_t(input.size_channels()) == num_channels) {
+        memcpy(dst.data(), &input(first_frame, 0), num_frames * num_channels * sizeof(float));
+        return;
+      }
+    }
+
+    for (size_t frame = 0; frame < num_frames; ++frame) {
+      for (size_t channel = 0; channel < num_input_channels; ++channel)
+        dst(frame, channel) = float(input(first_frame + frame, channel));
+      for (size_t channel = num_input_channels; channel < num_channels; ++channel)
+        dst(frame, channel) = 0;
+    }
+  }
+
+  void _writer_thread_main() noexcept {
+    for (;;) {
+      // Read the flag first: once it is set, the audio thread has stopped writing.
+      const bool stopping = _stopping.load(memory_order_acquire);
+      if (!_drain(stopping ? 0 : _write_block_frames()) && stopping)
+        return;
+
+      if (stopping)
+        continue;
+
+      this_thread::sleep_for(_poll_interval);
+    }
+  }
+
+  size_t _write_block_frames() const noexcept {
+    const size_t num_frames = _write_block_bytes / max<size_t>(_format.bytes_per_frame(), 1);
+    return clamp<size_t>(num_frames, 1, size_t(_fifo.capacity()) / 2);
+  }
+
+  // Writes out the ring once it holds at least min_frames frames. Returns whether
+  // there was anything to write.
+  bool _drain(size_t min_frames) noexcept {
+    auto regions = _fifo.prepare_read(_fifo.capacity());
+    const size_t num_frames = size_t(regions.size_frames());
+    if (num_frames == 0 || num_frames < min_frames)
+      return false;
+
+    if (!_write_failed.load(memory_order_relaxed)) {
+      const bool written = _writer->write(regions.first.data(), size_t(regions.first.size_frames()))
+                           && _writer->write(regions.second.data(), size_t(regions.second.size_frames()));
+      if (!written)
+        _write_failed.store(true, memory_order_relaxed);
+    }
+
+    _fifo.commit_read(num_frames);
+    _num_recorded_frames.store(_writer->num_frames(), memory_order_relaxed);
+    return true;
+  }
+
+  audio_file_format _format;
+  __audio_frame_fifo<float> _fifo;
+  size_t _write_block_bytes = 1 << 20;
+  uint64_t _sync_interval_bytes = 0;
+  bool _direct_io = true;
+  bool _always_rf64 = false;
+  audio_file_type _file_type = audio_file_type::wav;
+  audio_file_recorder_executor _executor;
+
+  unique_ptr<__audio_file_writer> _writer;
+  thread _writer_thread;
+  atomic<bool> _stopping = false;
+
+  atomic<bool> _recording = false;
+  atomic<bool> _audio_writing = false;
+  atomic<uint64_t> _num_recorded_frames = 0;
+  atomic<uint64_t> _num_dropped_frames = 0;
+  atomic<uint64_t> _num_overruns = 0;
+  atomic<bool> _write_failed = false;
+};
+
+_LIBSTDAUDIO_NAMESPACE_END
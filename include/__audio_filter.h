@@ -0,0 +1,448 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <type_traits>
+#include <vector>
+#include <__audio_simd.h>
+
+_LIBSTDAUDIO_NAMESPACE_BEGIN
+
+enum class audio_filter_type {
+  lowpass,
+  highpass,
+  bandpass,
+  notch,
+  allpass,
+  // Peaking EQ; gain_db sets the boost or cut at the centre frequency.
+  bell,
+  low_shelf,
+  high_shelf,
+};
+
+// Transposed direct form II biquad with coefficients from the RBJ Audio EQ Cookbook.
+// The cheapest section, but coefficient changes can glitch while it is ringing.
+struct __audio_biquad_section {
+  static constexpr size_t num_coefficients = 5;  // b0, b1, b2, a1, a2
+  using coefficients = array<float, num_coefficients>;
+
+  static coefficients identity() noexcept {
+    return {1, 0, 0, 0, 0};
+  }
+
+  static coefficients design(audio_filter_type type, double frequency, double q, double gain_db, double sample_rate) noexcept {
+    const double w = 2 * 3.14159265358979323846 * frequency / sample_rate;
+    const double cos_w = cos(w);
+    const double alpha = sin(w) / (2 * q);
+    const double a = pow(10.0, gain_db / 40);
+
+    double b0 = 1, b1 = 0, b2 = 0, a0 = 1, a1 = 0, a2 = 0;
+    switch (type) {
+      case audio_filter_type::lowpass:
+        b0 = (1 - cos_w) / 2; b1 = 1 - cos_w; b2 = b0;
+        a0 = 1 + alpha; a1 = -2 * cos_w; a2 = 1 - alpha;
+        break;
+      case audio_filter_type::highpass:
+        b0 = (1 + cos_w) / 2; b1 = -(1 + cos_w); b2 = b0;
+        a0 = 1 + alpha; a1 = -2 * cos_w; a2 = 1 - alpha;
+        break;
+      case audio_filter_type::bandpass:
+        b0 = alpha; b1 = 0; b2 = -alpha;
+        a0 = 1 + alpha; a1 = -2 * cos_w; a2 = 1 - alpha;
+        break;
+      case audio_filter_type::notch:
+        b0 = 1; b1 = -2 * cos_w; b2 = 1;
+        a0 = 1 + alpha; a1 = -2 * cos_w; a2 = 1 - alpha;
+        break;
+      case audio_filter_type::allpass:
+        b0 = 1 - alpha; b1 = -2 * cos_w; b2 = 1 + alpha;
+        a0 = 1 + alpha; a1 = -2 * cos_w; a2 = 1 - alpha;
+        break;
+      case audio_filter_type::bell:
+        b0 = 1 + alpha * a; b1 = -2 * cos_w; b2 = 1 - alpha * a;
+        a0 = 1 + alpha / a; a1 = -2 * cos_w; a2 = 1 - alpha / a;
+        break;
+      case audio_filter_type::low_shelf: {
+        const double s = 2 * sqrt(a) * alpha;
+        b0 = a * ((a + 1) - (a - 1) * cos_w + s);
+        b1 = 2 * a * ((a - 1) - (a + 1) * cos_w);
+        b2 = a * ((a + 1) - (a - 1) * cos_w - s);
+        a0 = (a + 1) + (a - 1) * cos_w + s;
+        a1 = -2 * ((a - 1) + (a + 1) * cos_w);
+        a2 = (a + 1) + (a - 1) * cos_w - s;
+        break;
+      }
+      case audio_filter_type::high_shelf: {
+        const double s = 2 * sqrt(a) * alpha;
+        b0 = a * ((a + 1) + (a - 1) * cos_w + s);
+        b1 = -2 * a * ((a - 1) + (a + 1) * cos_w);
+        b2 = a * ((a + 1) + (a - 1) * cos_w - s);
+        a0 = (a + 1) - (a - 1) * cos_w + s;
+        a1 = 2 * ((a - 1) - (a + 1) * cos_w);
+        a2 = (a + 1) - (a - 1) * cos_w - s;
+        break;
+      }
+    }
+
+    return {float(b0 / a0), float(b1 / a0), float(b2 / a0), float(a1 / a0), float(a2 / a0)};
+  }
+
+  template <typename _ValueType>
+  static _ValueType process(const _ValueType* c, _ValueType& z1, _ValueType& z2, _ValueType x) noexcept {
+    const _ValueType y = c[0] * x + z1;
+    z1 = c[1] * x - c[3] * y + z2;
+    z2 = c[2] * x - c[4] * y;
+    return y;
+  }
+};
+
+// Trapezoidal state-variable filter (Andrew Simper, "Solving the continuous SVF
+// equations using trapezoidal integration", 2013). Slightly more expensive than the
+// biquad, but stays well-behaved while its coefficients change, so it is the better
+// choice for modulated filters.
+struct __audio_svf_section {
+  static constexpr size_t num_coefficients = 6;  // a1, a2, a3, m0, m1, m2
+  using coefficients = array<float, num_coefficients>;
+
+  static coefficients identity() noexcept {
+    return {1, 0, 0, 1, 0, 0};
+  }
+
+  static coefficients design(audio_filter_type type, double frequency, double q, double gain_db, double sample_rate) noexcept {
+    const double a = pow(10.0, gain_db / 40);
+    double g = tan(3.14159265358979323846 * frequency / sample_rate);
+    double k = 1 / q;
+    double m0 = 0, m1 = 0, m2 = 0;
+
+    switch (type) {
+      case audio_filter_type::lowpass:   m0 = 0; m1 = 0; m2 = 1; break;
+      case audio_filter_type::highpass:  m0 = 1; m1 = -k; m2 = -1; break;
+      case audio_filter_type::bandpass:  m0 = 0; m1 = k; m2 = 0; break;
+      case audio_filter_type::notch:     m0 = 1; m1 = -k; m2 = 0; break;
+      case audio_filter_type::allpass:   m0 = 1; m1 = -2 * k; m2 = 0; break;
+      case audio_filter_type::bell:
+        k = 1 / (q * a);
+        m0 = 1; m1 = k * (a * a - 1); m2 = 0;
+        break;
+      case audio_filter_type::low_shelf:
+        g /= sqrt(a);
+        m0 = 1; m1 = k * (a - 1); m2 = a * a - 1;
+        break;
+      case audio_filter_type::high_shelf:
+        g *= sqrt(a);
+        m0 = a * a; m1 = k * (1 - a) * a; m2 = 1 - a * a;
+        break;
+    }
+
+    const double a1 = 1 / (1 + g * (g + k));
+    const double a2 = g * a1;
+    const double a3 = g * a2;
+    return {float(a1), float(a2), float(a3), float(m0), float(m1), float(m2)};
+  }
+
+  template <typename _ValueType>
+  static _ValueType process(const _ValueType* c, _ValueType& ic1eq, _ValueType& ic2eq, _ValueType x) noexcept {
+    const _ValueType v3 = x - ic2eq;
+    const _ValueType v1 = c[0] * ic1eq + c[1] * v3;
+    const _ValueType v2 = ic2eq + c[1] * ic1eq + c[2] * v3;
+    ic1eq = v1 + v1 - ic1eq;
+    ic2eq = v2 + v2 - ic2eq;
+    return c[3] * x + c[4] * v1 + c[5] * v2;
+  }
+};
+
+// A cascade of filter sections applied to every channel of a buffer, in place. All
+// channels share the coefficients of a section. For float buffers, the work is spread
+// over SIMD lanes:
+//  - with interleaved frames, each lane filters a different channel;
+//  - otherwise, each lane runs a different section of the cascade, one sample
+//    behind the previous section (so this needs several sections).
+// Coefficient changes glide towards their new values in steps of 32 frames, over the
+// smoothing time. All memory is allocated in the constructor.
+template <typename _SectionType>
+class __audio_filter_cascade {
+public:
+  __audio_filter_cascade(double sample_rate, size_t num_channels, size_t num_sections = 1)
+    : _sample_rate(sample_rate),
+      _num_channels(num_channels),
+      _num_sections(num_sections),
+      _padded_channels(_round_up(num_channels)),
+      _padded_sections(_round_up(num_sections)) {
+    assert(sample_rate > 0 && num_sections > 0);
+
+    const auto identity = _SectionType::identity();
+    for (size_t c = 0; c < num_coefficients; ++c) {
+      _current[c].assign(_padded_sections, identity[c]);
+      _target[c].assign(_padded_sections, identity[c]);
+    }
+
+    for (auto& state : _state)
+      state.assign(_padded_sections * _padded_channels, 0.0f);
+
+    set_smoothing_time(0.01);
+  }
+
+  size_t num_channels() const noexcept {
+    return _num_channels;
+  }
+
+  size_t num_sections() const noexcept {
+    return _num_sections;
+  }
+
+  double get_sample_rate() const noexcept {
+    return _sample_rate;
+  }
+
+  // A smoothing time of 0 applies new coefficients at the start of the next block.
+  void set_smoothing_time(double seconds) noexcept {
+    _smoothing_factor = seconds > 0 ? float(1 - exp(-double(_smoothing_block_size) / (seconds * _sample_rate))) : 1.0f;
+  }
+
+  void set_section(size_t section, audio_filter_type type, double frequency_hz,
+                   double q = 0.70710678118654752, double gain_db = 0) noexcept {
+    assert(section < _num_sections);
+    assert(frequency_hz > 0 && frequency_hz < _sample_rate / 2 && q > 0);
+
+    const auto coefficients = _SectionType::design(type, frequency_hz, q, gain_db, _sample_rate);
+    for (size_t c = 0; c < num_coefficients; ++c)
+      _target[c][section] = coefficients[c];
+
+    _is_smoothing = true;
+  }
+
+  // Sets every section to the same filter, e.g. for steeper slopes.
+  void set_all_sections(audio_filter_type type, double frequency_hz, double q = 0.70710678118654752, double gain_db = 0) noexcept {
+    for (size_t section = 0; section < _num_sections; ++section)
+      set_section(section, type, frequency_hz, q, gain_db);
+  }
+
+  // Clears the filter state and jumps to the target coefficients.
+  void reset() noexcept {
+    for (size_t c = 0; c < num_coefficients; ++c)
+      _current[c] = _target[c];
+
+    for (auto& state : _state)
+      fill(state.begin(), state.end(), 0.0f);
+
+    _is_smoothing = false;
+  }
+
+  template <typename _SampleType>
+  void process(audio_buffer<_SampleType>& buffer) noexcept {
+    static_assert(is_floating_point_v<_SampleType>, "audio filters require a floating-point sample type");
+    assert(size_t(buffer.size_channels()) <= _num_channels);
+
+    const size_t num_frames = size_t(buffer.size_frames());
+    size_t first = 0;
+
+    while (first < num_frames) {
+      size_t n = num_frames - first;
+      if (_is_smoothing) {
+        _advance_smoothing();
+        n = min(n, _smoothing_block_size);
+      }
+
+      _process(buffer, first, n);
+      first += n;
+    }
+  }
+
+private:
+  static constexpr size_t num_coefficients = _SectionType::num_coefficients;
+  static constexpr size_t w = __simd_float::width;
+  static constexpr size_t _smoothing_block_size = 32;
+
+  static size_t _round_up(size_t n) noexcept {
+    return (n + w - 1) / w * w;
+  }
+
+  void _advance_smoothing() noexcept {
+    bool done = true;
+    for (size_t c = 0; c < num_coefficients; ++c) {
+      for (size_t section = 0; section < _num_sections; ++section) {
+        auto& current = _current[c][section];
+        const float target = _target[c][section];
+        current += _smoothing_factor * (target - current);
+
+        if (abs(target - current) <= 1e-6f * max(1.0f, abs(target)))
+          current = target;
+        else
+          done = false;
+      }
+    }
+
+    _is_smoothing = !done;
+  }
+
+  float& _state_at(size_t index, size_t section, size_t channel) noexcept {
+    return _state[index][section * _padded_channels + channel];
+  }
+
+  template <typename _SampleType>
+  void _process(audio_buffer<_SampleType>& buffer, size_t first, size_t n) noexcept {
+    const size_t num_channels = size_t(buffer.size_channels());
+
+    if constexpr (is_same_v<_SampleType, float>) {
+      if (num_channels >= w && buffer.frames_are_contiguous() && buffer.data() != nullptr) {
+        _process_interleaved(buffer.data() + first * num_channels, n, num_channels);
+        return;
+      }
+
+      if (_num_sections > 1) {
+        const size_t stride = buffer.channels_are_contiguous() ? 1 : num_channels;
+        for (size_t channel = 0; channel < num_channels; ++channel)
+          _process_pipelined(&buffer(first, channel), stride, n, channel);
+        return;
+      }
+    }
+
+    for (size_t channel = 0; channel < num_channels; ++channel) {
+      for (size_t section = 0; section < _num_sections; ++section) {
+        float c[num_coefficients];
+        for (size_t i = 0; i < num_coefficients; ++i)
+          c[i] = _current[i][section];
+
+        float s0 = _state_at(0, section, channel), s1 = _state_at(1, section, channel);
+        for (size_t frame = first; frame < first + n; ++frame) {
+          auto& sample = buffer(frame, channel);
+          sample = _SampleType(_SectionType::process(c, s0, s1, float(sample)));
+        }
+
+        _state_at(0, section, channel) = s0;
+        _state_at(1, section, channel) = s1;
+      }
+    }
+  }
+
+  // One lane per channel, section after section over the whole block.
+  void _process_interleaved(float* data, size_t n, size_t num_channels) noexcept {
+    for (size_t section = 0; section < _num_sections; ++section) {
+      __simd_float c[num_coefficients];
+      float scalar_c[num_coefficients];
+      for (size_t i = 0; i < num_coefficients; ++i) {
+        scalar_c[i] = _current[i][section];
+        c[i] = __simd_float::broadcast(scalar_c[i]);
+      }
+
+      size_t channel = 0;
+      for (; channel + w <= num_channels; channel += w) {
+        auto s0 = __simd_float::load(&_state_at(0, section, channel));
+        auto s1 = __simd_float::load(&_state_at(1, section, channel));
+
+        for (size_t frame = 0; frame < n; ++frame) {
+          float* p = data + frame * num_channels + channel;
+          _SectionType::process(c, s0, s1, __simd_float::load(p)).store(p);
+        }
+
+        s0.store(&_state_at(0, section, channel));
+        s1.store(&_state_at(1, section, channel));
+      }
+
+      for (; channel < num_channels; ++channel) {
+        float s0 = _state_at(0, section, channel), s1 = _state_at(1, section, channel);
+        for (size_t frame = 0; frame < n; ++frame) {
+          float& sample = data[frame * num_channels + channel];
+          sample = _SectionType::process(scalar_c, s0, s1, sample);
+        }
+
+        _state_at(0, section, channel) = s0;
+        _state_at(1, section, channel) = s1;
+      }
+    }
+  }
+
+  // One lane per section: at step t, lane k filters sample t - k, which lane k - 1
+  // produced in the step before. The w - 1 steps at either end, where the pipeline
+  // is not full, run lane by lane.
+  void _process_pipelined(float* data, size_t stride, size_t n, size_t channel) noexcept {
+    auto x = [=](size_t frame) -> float& { return data[frame * stride]; };
+
+    for (size_t group = 0; group < _padded_sections; group += w) {
+      float c[num_coefficients][w], s0[w], s1[w], pipe[w];
+      for (size_t k = 0; k < w; ++k) {
+        for (size_t i = 0; i < num_coefficients; ++i)
+          c[i][k] = _current[i][group + k];
+
+        s0[k] = _state_at(0, group + k, channel);
+        s1[k] = _state_at(1, group + k, channel);
+      }
+
+      auto step = [&](size_t k, float input) {
+        float lane_c[num_coefficients];
+        for (size_t i = 0; i < num_coefficients; ++i)
+          lane_c[i] = c[i][k];
+
+        return _SectionType::process(lane_c, s0[k], s1[k], input);
+      };
+
+      if (n < w) {
+        for (size_t t = 0; t < n; ++t)
+          for (size_t k = 0; k < w; ++k)
+            x(t) = step(k, x(t));
+      }
+      else {
+        // Fill the pipeline.
+        for (size_t t = 0; t + 1 < w; ++t)
+          for (size_t k = t + 1; k-- > 0;)
+            pipe[k] = step(k, k == 0 ? x(t) : pipe[k - 1]);
+
+        __simd_float vc[num_coefficients];
+        for (size_t i = 0; i < num_coefficients; ++i)
+          vc[i] = __simd_float::load(c[i]);
+
+        auto vs0 = __simd_float::load(s0), vs1 = __simd_float::load(s1);
+        auto out = __simd_float::load(pipe);
+
+        for (size_t t = w - 1; t < n; ++t) {
+          out = _SectionType::process(vc, vs0, vs1, out.shift_in(x(t)));
+          x(t + 1 - w) = out.last();
+        }
+
+        out.store(pipe);
+        vs0.store(s0);
+        vs1.store(s1);
+
+        // Drain it: at step t, lanes from t - n + 1 on still have samples to filter.
+        for (size_t t = n; t + 1 < n + w; ++t) {
+          for (size_t k = w; k-- > t - n + 1;)
+            pipe[k] = step(k, pipe[k - 1]);
+
+          x(t + 1 - w) = pipe[w - 1];
+        }
+      }
+
+      for (size_t k = 0; k < w; ++k) {
+        _state_at(0, group + k, channel) = s0[k];
+        _state_at(1, group + k, channel) = s1[k];
+      }
+    }
+  }
+
+  double _sample_rate;
+  size_t _num_channels;
+  size_t _num_sections;
+  size_t _padded_channels;
+  size_t _padded_sections;
+  float _smoothing_factor = 1;
+  bool _is_smoothing = false;
+
+  // Coefficients by coefficient, then section; the padding sections pass audio through.
+  array<vector<float>, num_coefficients> _current;
+  array<vector<float>, num_coefficients> _target;
+
+  // The two state variables of every section and channel, channels contiguous.
+  array<vector<float>, 2> _state;
+};
+
+using audio_biquad_filter = __audio_filter_cascade<__audio_biquad_section>;
+using audio_svf_filter = __audio_filter_cascade<__audio_svf_section>;
+
+_LIBSTDAUDIO_NAMESPACE_END
@@ -0,0 +1,509 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+_LIBSTDAUDIO_NAMESPACE_BEGIN
+
+// Big-endian bit packing for FLAC, into a byte vector that grows as needed.
+class __audio_flac_bit_writer {
+public:
+  explicit __audio_flac_bit_writer(vector<uint8_t>& bytes) noexcept
+    : _bytes(bytes) {
+  }
+
+  // Writes the low num_bits (at most 32) bits of value.
+  void write(uint64_t value, unsigned num_bits) {
+    _accumulator = (_accumulator << num_bits) | (value & ((uint64_t(1) << num_bits) - 1));
+    _num_bits += num_bits;
+    while (_num_bits >= 8) {
+      _num_bits -= 8;
+      _bytes.push_back(uint8_t(_accumulator >> _num_bits));
+    }
+  }
+
+  void write_signed(int64_t value, unsigned num_bits) {
+    write(uint64_t(value), num_bits);
+  }
+
+  // num_zeros zero bits followed by a one.
+  void write_unary(uint32_t num_zeros) {
+    for (; num_zeros >= 32; num_zeros -= 32)
+      write(0, 32);
+
+    write(1, num_zeros + 1);
+  }
+
+  void write_rice(uint32_t folded, unsigned parameter) {
+    const uint32_t quotient = folded >> parameter;
+    if (quotient + 1 + parameter <= 32) {
+      write((uint64_t(1) << parameter) | (folded & ((uint64_t(1) << parameter) - 1)), quotient + 1 + parameter);
+      return;
+    }
+
+    write_unary(quotient);
+    if (parameter > 0)
+      write(folded, parameter);
+  }
+
+  void align() {
+    if (_num_bits > 0)
+      write(0, 8 - _num_bits);
+  }
+
+private:
+  vector<uint8_t>& _bytes;
+  uint64_t _accumulator = 0;
+  unsigned _num_bits = 0;
+};
+
+// Encodes blocks of integer samples to FLAC frames, using the fixed polynomial
+// predictors and partitioned Rice coding (what the reference encoder does at its
+// lowest compression level) plus, for two channels, the best of the four stereo
+// decorrelation modes. Up to eight channels and 8 to 24 bits per sample, as FLAC
+// allows; blocks are at most block_size samples and every frame stands on its own,
+// so separate encoders may encode the frames of one stream in parallel.
+class __audio_flac_encoder {
+public:
+  static constexpr size_t max_channels = 8;
+  static constexpr size_t block_size = 4096;
+  static constexpr size_t stream_header_size = 4 + 4 + 34;
+
+  __audio_flac_encoder(size_t num_channels, unsigned bits_per_sample, unsigned sample_rate)
+    : _num_channels(num_channels),
+      _bits_per_sample(bits_per_sample),
+      _sample_rate(sample_rate) {
+    assert(num_channels > 0 && num_channels <= max_channels);
+    assert(bits_per_sample >= 8 && bits_per_sample <= 24);
+
+    _residual.resize(block_size);
+    for (auto& channel : _decorrelated)
+      channel.resize(block_size);
+  }
+
+  size_t num_channels() const noexcept {
+    return _num_channels;
+  }
+
+  // Appends one frame that holds num_samples samples of every channel; channels[c]
+  // points to those of channel c.
+  void encode_frame(const int32_t* const* channels, size_t num_samples, uint64_t frame_number, vector<uint8_t>& out) {
+    assert(num_samples > 0 && num_samples <= block_size);
+
+    const size_t frame_start = out.size();
+    __audio_flac_bit_writer bits(out);
+
+    // Choose how to code the channels.
+    array<const int32_t*, max_channels> sources = {};
+    array<unsigned, max_channels> source_bits = {};
+    array<_subframe_choice, max_channels> choices;
+    unsigned channel_assignment = unsigned(_num_channels - 1);
+
+    for (size_t channel = 0; channel < _num_channels; ++channel) {
+      sources[channel] = channels[channel];
+      source_bits[channel] = _bits_per_sample;
+    }
+
+    if (_num_channels == 2) {
+      int32_t* side = _decorrelated[0].data();
+      int32_t* mid = _decorrelated[1].data();
+      for (size_t i = 0; i < num_samples; ++i) {
+        side[i] = channels[0][i] - channels[1][i];
+        mid[i] = (channels[0][i] + channels[1][i]) >> 1;
+      }
+
+      const auto left = _choose(channels[0], num_samples, _bits_per_sample);
+      const auto right = _choose(channels[1], num_samples, _bits_per_sample);
+      const auto side_choice = _choose(side, num_samples, _bits_per_sample + 1);
+      const auto mid_choice = _choose(mid, num_samples, _bits_per_sample);
+
+      // Independent, left/side, side/right and mid/side (assignments 1, 8, 9, 10).
+      const uint64_t costs[] = {left.bits + right.bits, left.bits + side_choice.bits, side_choice.bits + right.bits, mid_choice.bits + side_choice.bits};
+      const size_t best = size_t(min_element(begin(costs), end(costs)) - begin(costs));
+
+      if (best == 0) {
+        choices[0] = left;
+        choices[1] = right;
+      }
+      else if (best == 1) {
+        channel_assignment = 8;
+        sources[1] = side;
+        source_bits[1] = _bits_per_sample + 1;
+        choices[0] = left;
+        choices[1] = side_choice;
+      }
+      else if (best == 2) {
+        channel_assignment = 9;
+        sources[0] = side;
+        source_bits[0] = _bits_per_sample + 1;
+        choices[0] = side_choice;
+        choices[1] = right;
+      }
+      else {
+        channel_assignment = 10;
+        sources[0] = mid;
+        sources[1] = side;
+        source_bits[1] = _bits_per_sample + 1;
+        choices[0] = mid_choice;
+        choices[1] = side_choice;
+      }
+    }
+    else {
+      for (size_t channel = 0; channel < _num_channels; ++channel)
+        choices[channel] = _choose(channels[channel], num_samples, _bits_per_sample);
+    }
+
+    _write_frame_header(bits, num_samples, frame_number, channel_assignment);
+    out.push_back(_crc8(out.data() + frame_start, out.size() - frame_start));
+
+    for (size_t channel = 0; channel < _num_channels; ++channel)
+      _write_subframe(bits, sources[channel], num_samples, source_bits[channel], choices[channel]);
+
+    bits.align();
+    const uint16_t crc = _crc16(out.data() + frame_start, out.size() - frame_start);
+    out.push_back(uint8_t(crc >> 8));
+    out.push_back(uint8_t(crc));
+  }
+
+  // The "fLaC" marker and a STREAMINFO block that is the last metadata block unless
+  // more_metadata is set. Frame sizes of 0 mean unknown; the MD5 signature is left
+  // unset, which decoders treat as not to be checked.
+  void write_stream_header(vector<uint8_t>& out, uint64_t num_samples, uint32_t min_frame_size, uint32_t max_frame_size, bool more_metadata) const {
+    __audio_flac_bit_writer bits(out);
+    bits.write(0x664c'6143, 32);  // "fLaC"
+    bits.write(more_metadata ? 0 : 1, 1);
+    bits.write(0, 7);
+    bits.write(34, 24);
+    bits.write(block_size, 16);
+    bits.write(block_size, 16);
+    bits.write(min_frame_size, 24);
+    bits.write(max_frame_size, 24);
+    bits.write(_sample_rate, 20);
+    bits.write(_num_channels - 1, 3);
+    bits.write(_bits_per_sample - 1, 5);
+    bits.write(num_samples >> 32, 4);
+    bits.write(num_samples, 32);
+    for (int i = 0; i < 4; ++i)
+      bits.write(0, 32);
+  }
+
+  // A PADDING block of num_bytes bytes in total, as the last metadata block.
+  static void write_padding(vector<uint8_t>& out, size_t num_bytes) {
+    assert(num_bytes >= 4);
+    __audio_flac_bit_writer bits(out);
+    bits.write(1, 1);
+    bits.write(1, 7);
+    bits.write(num_bytes - 4, 24);
+    out.insert(out.end(), num_bytes - 4, uint8_t(0));
+  }
+
+private:
+  static constexpr unsigned _max_fixed_order = 4;
+  static constexpr unsigned _max_partition_order = 8;
+
+  enum class _subframe_type { constant, verbatim, fixed };
+
+  struct _subframe_choice {
+    _subframe_type type = _subframe_type::verbatim;
+    unsigned order = 0;
+    unsigned partition_order = 0;
+    uint64_t bits = 0;
+  };
+
+  // The residual of the fixed predictor of the given order, for the samples after
+  // the first order ones.
+  static void _compute_residual(const int32_t* x, size_t n, unsigned order, int32_t* residual) noexcept {
+    switch (order) {
+      case 0:
+        for (size_t i = 0; i < n; ++i)
+          residual[i] = x[i];
+        break;
+      case 1:
+        for (size_t i = 1; i < n; ++i)
+          residual[i] = x[i] - x[i - 1];
+        break;
+      case 2:
+        for (size_t i = 2; i < n; ++i)
+          residual[i] = x[i] - 2 * x[i - 1] + x[i - 2];
+        break;
+      case 3:
+        for (size_t i = 3; i < n; ++i)
+          residual[i] = x[i] - 3 * x[i - 1] + 3 * x[i - 2] - x[i - 3];
+        break;
+      case 4:
+        for (size_t i = 4; i < n; ++i)
+          residual[i] = x[i] - 4 * x[i - 1] + 6 * x[i - 2] - 4 * x[i - 3] + x[i - 4];
+        break;
+    }
+  }
+
+  static uint32_t _fold(int32_t residual) noexcept {
+    return (uint32_t(residual) << 1) ^ uint32_t(residual >> 31);
+  }
+
+  // The Rice parameter that minimises n (k + 1) + (sum >> k), about how many bits
+  // n folded residuals that add up to sum take.
+  static unsigned _rice_parameter(uint64_t sum, size_t n, uint64_t& bits) noexcept {
+    unsigned k = 0;
+    while (k < 30 && (uint64_t(n) << (k + 1)) < sum)
+      ++k;
+
+    bits = n * (k + 1) + (sum >> k);
+    if (k > 0) {
+      const uint64_t smaller = n * k + (sum >> (k - 1));
+      if (smaller < bits) {
+        bits = smaller;
+        --k;
+      }
+    }
+
+    return k;
+  }
+
+  static unsigned _max_partition_order_for(size_t n, unsigned order) noexcept {
+    unsigned partition_order = 0;
+    while (partition_order < _max_partition_order && (n >> (partition_order + 1)) << (partition_order + 1) == n && (n >> (partition_order + 1)) > order)
+      ++partition_order;
+
+    return partition_order;
+  }
+
+  // Estimates the size of the residual in bits and picks its partition order.
+  uint64_t _residual_bits(const int32_t* residual, size_t n, unsigned order, unsigned& best_partition_order) noexcept {
+    const unsigned max_order = _max_partition_order_for(n, order);
+    const size_t num_partitions = size_t(1) << max_order;
+    const size_t partition_size = n >> max_order;
+
+    for (size_t p = 0; p < num_partitions; ++p) {
+      uint64_t sum = 0;
+      for (size_t i = max<size_t>(p * partition_size, order); i < (p + 1) * partition_size; ++i)
+        sum += _fold(residual[i]);
+      _partition_sums[p] = sum;
+    }
+
+    uint64_t best_bits = UINT64_MAX;
+    for (unsigned partition_order = max_order + 1; partition_order-- > 0;) {
+      const size_t count = size_t(1) << partition_order;
+      uint64_t total = 2 + 4;
+      for (size_t p = 0; p < count; ++p) {
+        const size_t size = (n >> partition_order) - (p == 0 ? order : 0);
+        uint64_t bits;
+        const unsigned k = _rice_parameter(_partition_sums[p], size, bits);
+        total += bits + (k > 14 ? 5 : 4);
+      }
+
+      if (total <= best_bits) {
+        best_bits = total;
+        best_partition_order = partition_order;
+      }
+
+      // Merge neighbouring partitions for the next coarser order.
+      for (size_t p = 0; p < count / 2; ++p)
+        _partition_sums[p] = _partition_sums[2 * p] + _partition_sums[2 * p + 1];
+    }
+
+    return best_bits;
+  }
+
+  _subframe_choice _choose(const int32_t* x, size_t n, unsigned bits_per_sample) noexcept {
+    _subframe_choice best;
+    best.bits = 8 + uint64_t(n) * bits_per_sample;
+
+    if (all_of(x + 1, x + n, [value = x[0]](int32_t sample) { return sample == value; })) {
+      best.type = _subframe_type::constant;
+      best.bits = 8 + bits_per_sample;
+      return best;
+    }
+
+    // Like the reference encoder, pick the order whose residual has the smallest
+    // sum of magnitudes, in one pass over all orders, and only size that one exactly.
+    const unsigned order = n > _max_fixed_order ? _best_fixed_order(x, n) : 0;
+    _compute_residual(x, n, order, _residual.data());
+
+    unsigned partition_order = 0;
+    const uint64_t bits = 8 + uint64_t(order) * bits_per_sample + _residual_bits(_residual.data(), n, order, partition_order);
+    if (bits < best.bits) {
+      best.type = _subframe_type::fixed;
+      best.order = order;
+      best.partition_order = partition_order;
+      best.bits = bits;
+    }
+
+    return best;
+  }
+
+  static unsigned _best_fixed_order(const int32_t* x, size_t n) noexcept {
+    // The residuals of orders 0 to 4 are successive differences of each other.
+    int64_t last0 = x[3];
+    int64_t last1 = int64_t(x[3]) - x[2];
+    int64_t last2 = last1 - (int64_t(x[2]) - x[1]);
+    int64_t last3 = last2 - (int64_t(x[2]) - 2 * int64_t(x[1]) + x[0]);
+    array<uint64_t, _max_fixed_order + 1> sums = {};
+
+    for (size_t i = _max_fixed_order; i < n; ++i) {
+      const int64_t e0 = x[i];
+      const int64_t e1 = e0 - last0;
+      const int64_t e2 = e1 - last1;
+      const int64_t e3 = e2 - last2;
+      const int64_t e4 = e3 - last3;
+      sums[0] += uint64_t(e0 < 0 ? -e0 : e0);
+      sums[1] += uint64_t(e1 < 0 ? -e1 : e1);
+      sums[2] += uint64_t(e2 < 0 ? -e2 : e2);
+      sums[3] += uint64_t(e3 < 0 ? -e3 : e3);
+      sums[4] += uint64_t(e4 < 0 ? -e4 : e4);
+      last0 = e0;
+      last1 = e1;
+      last2 = e2;
+      last3 = e3;
+    }
+
+    return unsigned(min_element(sums.begin(), sums.end()) - sums.begin());
+  }
+
+  void _write_subframe(__audio_flac_bit_writer& bits, const int32_t* x, size_t n, unsigned bits_per_sample, const _subframe_choice& choice) {
+    bits.write(0, 1);
+
+    if (choice.type == _subframe_type::constant) {
+      bits.write(0, 6);
+      bits.write(0, 1);
+      bits.write_signed(x[0], bits_per_sample);
+      return;
+    }
+
+    if (choice.type == _subframe_type::verbatim) {
+      bits.write(1, 6);
+      bits.write(0, 1);
+      for (size_t i = 0; i < n; ++i)
+        bits.write_signed(x[i], bits_per_sample);
+      return;
+    }
+
+    bits.write(8 | choice.order, 6);
+    bits.write(0, 1);
+    for (unsigned i = 0; i < choice.order; ++i)
+      bits.write_signed(x[i], bits_per_sample);
+
+    int32_t* residual = _residual.data();
+    _compute_residual(x, n, choice.order, residual);
+
+    const size_t num_partitions = size_t(1) << choice.partition_order;
+    const size_t partition_size = n >> choice.partition_order;
+    array<unsigned, size_t(1) << _max_partition_order> parameters;
+    bool wide_parameters = false;
+
+    for (size_t p = 0; p < num_partitions; ++p) {
+      const size_t first = max<size_t>(p * partition_size, choice.order);
+      uint64_t sum = 0;
+      for (size_t i = first; i < (p + 1) * partition_size; ++i)
+        sum += _fold(residual[i]);
+
+      uint64_t estimate;
+      parameters[p] = _rice_parameter(sum, (p + 1) * partition_size - first, estimate);
+      wide_parameters = wide_parameters || parameters[p] > 14;
+    }
+
+    bits.write(wide_parameters ? 1 : 0, 2);
+    bits.write(choice.partition_order, 4);
+    for (size_t p = 0; p < num_partitions; ++p) {
+      bits.write(parameters[p], wide_parameters ? 5 : 4);
+      for (size_t i = max<size_t>(p * partition_size, choice.order); i < (p + 1) * partition_size; ++i)
+        bits.write_rice(_fold(residual[i]), parameters[p]);
+    }
+  }
+
+  void _write_frame_header(__audio_flac_bit_writer& bits, size_t num_samples, uint64_t frame_number, unsigned channel_assignment) const {
+    // Block sizes of 256 * 2^k have a code of their own; any other follows the header.
+    unsigned block_size_code = 7;
+    for (unsigned k = 0; k < 8; ++k)
+      if (num_samples == size_t(256) << k)
+        block_size_code = 8 + k;
+
+    bits.write(0xfff8, 16);
+    bits.write(block_size_code, 4);
+    bits.write(_sample_rate_code(), 4);
+    bits.write(channel_assignment, 4);
+    bits.write(_bits_per_sample == 8 ? 1 : _bits_per_sample == 12 ? 2 : _bits_per_sample == 16 ? 4 : _bits_per_sample == 20 ? 5 : _bits_per_sample == 24 ? 6 : 0, 3);
+    bits.write(0, 1);
+
+    // The frame number, UTF-8 style.
+    if (frame_number < 0x80) {
+      bits.write(frame_number, 8);
+    }
+    else {
+      unsigned num_continuation_bytes = 1;
+      while (num_continuation_bytes < 6 && frame_number >= (uint64_t(1) << (5 * num_continuation_bytes + 6)))
+        ++num_continuation_bytes;
+
+      bits.write((0xff00u >> (num_continuation_bytes + 1)) | (frame_number >> (6 * num_continuation_bytes)), 8);
+      for (unsigned i = num_continuation_bytes; i-- > 0;)
+        bits.write(0x80 | ((frame_number >> (6 * i)) & 0x3f), 8);
+    }
+
+    if (block_size_code == 7)
+      bits.write(num_samples - 1, 16);
+  }
+
+  unsigned _sample_rate_code() const noexcept {
+    switch (_sample_rate) {
+      case 88'200: return 1;
+      case 176'400: return 2;
+      case 192'000: return 3;
+      case 8'000: return 4;
+      case 16'000: return 5;
+      case 22'050: return 6;
+      case 24'000: return 7;
+      case 32'000: return 8;
+      case 44'100: return 9;
+      case 48'000: return 10;
+      case 96'000: return 11;
+      default: return 0;  // as in STREAMINFO
+    }
+  }
+
+  static uint8_t _crc8(const uint8_t* data, size_t size) noexcept {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < size; ++i) {
+      crc ^= data[i];
+      for (int bit = 0; bit < 8; ++bit)
+        crc = uint8_t((crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1);
+    }
+
+    return crc;
+  }
+
+  static uint16_t _crc16(const uint8_t* data, size_t size) noexcept {
+    static const auto table = [] {
+      array<uint16_t, 256> result = {};
+      for (unsigned i = 0; i < 256; ++i) {
+        uint16_t crc = uint16_t(i << 8);
+        for (int bit = 0; bit < 8; ++bit)
+          crc = uint16_t((crc & 0x8000) ? (crc << 1) ^ 0x8005 : crc << 1);
+        result[i] = crc;
+      }
+      return result;
+    }();
+
+    uint16_t crc = 0;
+    for (size_t i = 0; i < size; ++i)
+      crc = uint16_t((crc << 8) ^ table[(crc >> 8) ^ data[i]]);
+
+    return crc;
+  }
+
+  size_t _num_channels;
+  unsigned _bits_per_sample;
+  unsigned _sample_rate;
+  vector<int32_t> _residual;
+  array<vector<int32_t>, 2> _decorrelated;
+  array<uint64_t, size_t(1) << _max_partition_order> _partition_sums = {};
+};
+
+_LIBSTDAUDIO_NAMESPACE_END
@@ -0,0 +1,114 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <vector>
+
+_LIBSTDAUDIO_NAMESPACE_BEGIN
+
+// Wait-free single-producer, single-consumer FIFO of interleaved audio frames.
+// Instead of copying, both sides get up to two audio_buffer views into the ring
+// (the second one is only non-empty when the region wraps around) and then commit
+// how many frames they have actually written or read.
+template <typename _SampleType>
+class __audio_frame_fifo {
+public:
+  using index_type = typename audio_buffer<_SampleType>::index_type;
+
+  struct regions {
+    audio_buffer<_SampleType> first;
+    audio_buffer<_SampleType> second;
+
+    index_type size_frames() const noexcept {
+      return first.size_frames() + second.size_frames();
+    }
+  };
+
+  __audio_frame_fifo(index_type num_channels, index_type min_capacity_frames)
+    : _num_channels(num_channels),
+      _capacity(_round_up_to_power_of_two(min_capacity_frames)),
+      _data(_capacity * num_channels) {
+    assert(num_channels > 0);
+  }
+
+  __audio_frame_fifo(const __audio_frame_fifo& other) = delete;
+  __audio_frame_fifo& operator=(const __audio_frame_fifo& other) = delete;
+
+  index_type num_channels() const noexcept {
+    return _num_channels;
+  }
+
+  index_type capacity() const noexcept {
+    return _capacity;
+  }
+
+  // Number of frames that can be read; exact on the consumer side, a lower bound elsewhere.
+  index_type size() const noexcept {
+    return index_type(_write_pos.load(memory_order_acquire) - _read_pos.load(memory_order_acquire));
+  }
+
+  // Number of frames that can be written; exact on the producer side, a lower bound elsewhere.
+  index_type space() const noexcept {
+    return _capacity - size();
+  }
+
+  regions prepare_write(index_type num_frames) noexcept {
+    const auto write_pos = _write_pos.load(memory_order_relaxed);
+    const auto read_pos = _read_pos.load(memory_order_acquire);
+    return _regions(write_pos, min(num_frames, index_type(_capacity - (write_pos - read_pos))));
+  }
+
+  void commit_write(index_type num_frames) noexcept {
+    assert(num_frames <= space());
+    _write_pos.store(_write_pos.load(memory_order_relaxed) + num_frames, memory_order_release);
+  }
+
+  regions prepare_read(index_type num_frames) noexcept {
+    const auto read_pos = _read_pos.load(memory_order_relaxed);
+    const auto write_pos = _write_pos.load(memory_order_acquire);
+    return _regions(read_pos, min(num_frames, index_type(write_pos - read_pos)));
+  }
+
+  void commit_read(index_type num_frames) noexcept {
+    assert(num_frames <= size());
+    _read_pos.store(_read_pos.load(memory_order_relaxed) + num_frames, memory_order_release);
+  }
+
+  // Only safe while neither side is running.
+  void reset() noexcept {
+    _write_pos.store(0, memory_order_relaxed);
+    _read_pos.store(0, memory_order_relaxed);
+  }
+
+private:
+  regions _regions(size_t position, index_type num_frames) noexcept {
+    const index_type offset = position & (_capacity - 1);
+    const index_type first_size = min(num_frames, _capacity - offset);
+
+    return {
+      {_data.data() + offset * _num_channels, first_size, _num_channels, contiguous_interleaved},
+      {_data.data(), num_frames - first_size, _num_channels, contiguous_interleaved}
+    };
+  }
+
+  static index_type _round_up_to_power_of_two(index_type n) noexcept {
+    index_type result = 1;
+    while (result < n)
+      result *= 2;
+
+    return result;
+  }
+
+  index_type _num_channels = 0;
+  index_type _capacity = 0;
+  vector<_SampleType> _data;
+  alignas(64) atomic<size_t> _write_pos = 0;
+  alignas(64) atomic<size_t> _read_pos = 0;
+};
+
+_LIBSTDAUDIO_NAMESPACE_END
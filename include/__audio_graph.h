@@ -0,0 +1,433 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <vector>
+#include <__audio_simd.h>
+
+_LIBSTDAUDIO_NAMESPACE_BEGIN
+
+// A directed acyclic graph of processors, meant to be driven by a device callback.
+// Every node is a callable taking an audio_device_io with its input and output
+// buffers; an edge feeds all output channels of one node into the inputs of another,
+// and several edges into the same node are summed. Two built-in nodes stand for the
+// input and output of the device. Processors must overwrite their whole output and
+// must not write to their input, which may be the output of another node.
+//
+// Edits are made on a control thread and take effect once commit() is called: the
+// graph is then compiled into a flat schedule, in which intermediate buffers are
+// shared between nodes whose outputs are not alive at the same time, and handed to
+// the audio thread at the start of its next block. The audio thread neither allocates
+// nor frees; schedules it no longer uses are destroyed by the next commit() or
+// collect_garbage() on the control thread.
+//
+// The graph itself is not copyable; connect it to a device through a callback that
+// refers to it, e.g. [&graph](auto& device, auto& io) noexcept { graph(device, io); }.
+template <typename _SampleType = float>
+class audio_graph {
+public:
+  using sample_type = _SampleType;
+  using index_type = typename audio_buffer<_SampleType>::index_type;
+  using node_id = size_t;
+
+  static constexpr node_id invalid_node_id = ~node_id(0);
+
+  audio_graph(index_type num_input_channels, index_type num_output_channels, index_type max_block_frames = 1024)
+    : _max_block_frames(max_block_frames) {
+    _input_node_id = _add_node(nullptr, 0, num_input_channels);
+    _output_node_id = _add_node(nullptr, num_output_channels, 0);
+  }
+
+  audio_graph(const audio_graph&) = delete;
+  audio_graph& operator=(const audio_graph&) = delete;
+
+  ~audio_graph() {
+    delete _current;
+    delete _pending.load(memory_order_relaxed);
+    delete _retired.load(memory_order_relaxed);
+  }
+
+  // The node whose outputs are the device inputs.
+  node_id input_node_id() const noexcept {
+    return _input_node_id;
+  }
+
+  // The node whose inputs are sent to the device outputs.
+  node_id output_node_id() const noexcept {
+    return _output_node_id;
+  }
+
+  template <typename _ProcessorType,
+            typename = enable_if_t<is_nothrow_invocable_v<_ProcessorType, audio_device_io<_SampleType>&>>>
+  node_id add_node(_ProcessorType processor, index_type num_input_channels, index_type num_output_channels) {
+    return _add_node(_processor_type(move(processor)), num_input_channels, num_output_channels);
+  }
+
+  // Also removes all edges from and to the node. The built-in nodes cannot be removed.
+  bool remove_node(node_id id) {
+    if (!_is_valid(id) || id == _input_node_id || id == _output_node_id)
+      return false;
+
+    _nodes[id].reset();
+    for (auto& node : _nodes) {
+      if (node)
+        node->sources.erase(remove(node->sources.begin(), node->sources.end(), id), node->sources.end());
+    }
+
+    return true;
+  }
+
+  // Fails if the nodes don't exist, the channel counts differ, the edge already
+  // exists or it would create a cycle.
+  bool add_edge(node_id from, node_id to) {
+    if (!_is_valid(from) || !_is_valid(to) || from == to)
+      return false;
+
+    auto& sources = _nodes[to]->sources;
+    if (_nodes[from]->num_output_channels != _nodes[to]->num_input_channels
+        || find(sources.begin(), sources.end(), from) != sources.end()
+        || _depends_on(from, to))
+      return false;
+
+    sources.push_back(from);
+    return true;
+  }
+
+  bool remove_edge(node_id from, node_id to) {
+    if (!_is_valid(from) || !_is_valid(to))
+      return false;
+
+    auto& sources = _nodes[to]->sources;
+    auto it = find(sources.begin(), sources.end(), from);
+    if (it == sources.end())
+      return false;
+
+    sources.erase(it);
+    return true;
+  }
+
+  // Compiles the current state of the graph and hands it to the audio thread.
+  void commit() {
+    collect_garbage();
+
+    auto* schedule = _compile().release();
+    delete _pending.exchange(schedule, memory_order_acq_rel);
+  }
+
+  // Frees the schedule that the audio thread has stopped using, if any.
+  void collect_garbage() {
+    delete _retired.exchange(nullptr, memory_order_acquire);
+  }
+
+  // The number of scratch channels used by the schedule of the last commit().
+  index_type num_scratch_channels() const noexcept {
+    return _last_num_scratch_channels;
+  }
+
+  void process(audio_device_io<_SampleType>& io) noexcept {
+    _update_schedule();
+
+    const index_type num_frames = io.output_buffer.has_value() ? io.output_buffer->size_frames()
+                                : io.input_buffer.has_value() ? io.input_buffer->size_frames()
+                                : 0;
+
+    for (index_type offset = 0; offset < num_frames; offset += _max_block_frames) {
+      const index_type block_frames = min(num_frames - offset, _max_block_frames);
+      if (_current != nullptr)
+        _run_schedule(*_current, io, offset, block_frames);
+      else
+        _clear_output(io, offset, block_frames);
+    }
+  }
+
+  template <typename _DeviceType>
+  void operator()(_DeviceType&, audio_device_io<_SampleType>& io) noexcept {
+    process(io);
+  }
+
+private:
+  using _processor_type = function<void(audio_device_io<_SampleType>&)>;
+
+  struct _node {
+    _processor_type processor;
+    index_type num_input_channels = 0;
+    index_type num_output_channels = 0;
+    vector<node_id> sources;
+  };
+
+  enum class _step_kind {
+    device_input,
+    device_output,
+    processor,
+  };
+
+  struct _step {
+    _step_kind kind = _step_kind::processor;
+    shared_ptr<_node> node;
+
+    // Every input channel is either the output channel of the only source node, or
+    // a scratch channel into which all sources are summed.
+    vector<_SampleType*> inputs;
+    vector<_SampleType*> outputs;
+    vector<_SampleType*> summed_sources;  // num_input_channels pointers per summed source
+    bool sum_inputs = false;
+
+    // Slot indices, resolved into the pointers above once the scratch is allocated.
+    vector<size_t> input_slots;
+    vector<size_t> output_slots;
+    vector<size_t> summed_source_slots;
+  };
+
+  struct _schedule {
+    vector<_step> steps;
+    vector<_SampleType> scratch;
+  };
+
+  node_id _add_node(_processor_type processor, index_type num_input_channels, index_type num_output_channels) {
+    auto node = make_shared<_node>();
+    node->processor = move(processor);
+    node->num_input_channels = num_input_channels;
+    node->num_output_channels = num_output_channels;
+
+    _nodes.push_back(move(node));
+    return _nodes.size() - 1;
+  }
+
+  bool _is_valid(node_id id) const noexcept {
+    return id < _nodes.size() && _nodes[id] != nullptr;
+  }
+
+  // Whether there is a path from id to target.
+  bool _depends_on(node_id target, node_id id) const {
+    vector<node_id> stack = {target};
+    vector<bool> visited(_nodes.size());
+
+    while (!stack.empty()) {
+      const auto current = stack.back();
+      stack.pop_back();
+      if (current == id)
+        return true;
+
+      if (visited[current])
+        continue;
+
+      visited[current] = true;
+      for (auto source : _nodes[current]->sources)
+        stack.push_back(source);
+    }
+
+    return false;
+  }
+
+  vector<node_id> _topological_order() const {
+    vector<size_t> num_pending_sources(_nodes.size());
+    vector<vector<node_id>> consumers(_nodes.size());
+    vector<node_id> order, ready;
+
+    for (node_id id = 0; id < _nodes.size(); ++id) {
+      if (!_nodes[id])
+        continue;
+
+      num_pending_sources[id] = _nodes[id]->sources.size();
+      for (auto source : _nodes[id]->sources)
+        consumers[source].push_back(id);
+
+      if (num_pending_sources[id] == 0)
+        ready.push_back(id);
+    }
+
+    // Process ready nodes in order of their id, so that the schedule is deterministic.
+    while (!ready.empty()) {
+      auto next = min_element(ready.begin(), ready.end());
+      const auto id = *next;
+      ready.erase(next);
+      order.push_back(id);
+
+      for (auto consumer : consumers[id]) {
+        if (--num_pending_sources[consumer] == 0)
+          ready.push_back(consumer);
+      }
+    }
+
+    return order;
+  }
+
+  unique_ptr<_schedule> _compile() {
+    const auto order = _topological_order();
+    auto schedule = make_unique<_schedule>();
+
+    // The step after which the outputs of each node are no longer needed.
+    vector<size_t> step_of(_nodes.size()), last_use(_nodes.size());
+    for (size_t step = 0; step < order.size(); ++step) {
+      step_of[order[step]] = step;
+      last_use[order[step]] = step;
+    }
+
+    for (size_t step = 0; step < order.size(); ++step) {
+      for (auto source : _nodes[order[step]]->sources)
+        last_use[source] = max(last_use[source], step);
+    }
+
+    vector<size_t> free_slots;
+    size_t num_slots = 0;
+    auto allocate = [&]() {
+      if (free_slots.empty())
+        return num_slots++;
+
+      const auto slot = free_slots.back();
+      free_slots.pop_back();
+      return slot;
+    };
+
+    vector<vector<size_t>> output_slots(_nodes.size());
+    vector<vector<node_id>> released_after(order.size());
+    for (auto id : order)
+      released_after[last_use[id]].push_back(id);
+
+    for (size_t step_index = 0; step_index < order.size(); ++step_index) {
+      const auto id = order[step_index];
+      const auto& node = *_nodes[id];
+      _step step;
+      step.node = _nodes[id];
+      step.kind = id == _input_node_id ? _step_kind::device_input
+                : id == _output_node_id ? _step_kind::device_output
+                : _step_kind::processor;
+
+      vector<size_t> temporary_slots;
+      if (node.sources.size() == 1) {
+        step.input_slots = output_slots[node.sources.front()];
+      }
+      else if (node.num_input_channels > 0) {
+        step.sum_inputs = true;
+        for (index_type channel = 0; channel < node.num_input_channels; ++channel)
+          step.input_slots.push_back(allocate());
+
+        temporary_slots = step.input_slots;
+        for (auto source : node.sources)
+          step.summed_source_slots.insert(step.summed_source_slots.end(), output_slots[source].begin(), output_slots[source].end());
+      }
+
+      for (index_type channel = 0; channel < node.num_output_channels; ++channel)
+        output_slots[id].push_back(allocate());
+
+      step.output_slots = output_slots[id];
+
+      free_slots.insert(free_slots.end(), temporary_slots.begin(), temporary_slots.end());
+      for (auto released : released_after[step_index])
+        free_slots.insert(free_slots.end(), output_slots[released].begin(), output_slots[released].end());
+
+      schedule->steps.push_back(move(step));
+    }
+
+    schedule->scratch.resize(num_slots * _max_block_frames);
+    auto resolve = [&](const vector<size_t>& slots, vector<_SampleType*>& pointers) {
+      for (auto slot : slots)
+        pointers.push_back(schedule->scratch.data() + slot * _max_block_frames);
+    };
+
+    for (auto& step : schedule->steps) {
+      resolve(step.input_slots, step.inputs);
+      resolve(step.output_slots, step.outputs);
+      resolve(step.summed_source_slots, step.summed_sources);
+    }
+
+    _last_num_scratch_channels = num_slots;
+    return schedule;
+  }
+
+  // Takes over a newly committed schedule, but only once the control thread has
+  // collected the previously retired one, so that there is never more than one.
+  void _update_schedule() noexcept {
+    if (_pending.load(memory_order_relaxed) == nullptr || _retired.load(memory_order_acquire) != nullptr)
+      return;
+
+    auto* schedule = _pending.exchange(nullptr, memory_order_acq_rel);
+    if (schedule == nullptr)
+      return;
+
+    _retired.store(_current, memory_order_release);
+    _current = schedule;
+  }
+
+  void _run_schedule(_schedule& schedule, audio_device_io<_SampleType>& io, index_type offset, index_type block_frames) noexcept {
+    for (auto& step : schedule.steps) {
+      if (step.sum_inputs) {
+        const index_type num_channels = step.inputs.size();
+        for (index_type channel = 0; channel < num_channels; ++channel) {
+          fill(step.inputs[channel], step.inputs[channel] + block_frames, _SampleType{});
+          for (size_t source = channel; source < step.summed_sources.size(); source += num_channels)
+            __simd_accumulate(step.inputs[channel], step.summed_sources[source], _SampleType(1), block_frames);
+        }
+      }
+
+      switch (step.kind) {
+        case _step_kind::device_input:
+          for (index_type channel = 0; channel < step.outputs.size(); ++channel) {
+            for (index_type frame = 0; frame < block_frames; ++frame) {
+              step.outputs[channel][frame] = io.input_buffer.has_value() && channel < io.input_buffer->size_channels()
+                                           ? (*io.input_buffer)(offset + frame, channel)
+                                           : _SampleType{};
+            }
+          }
+          break;
+
+        case _step_kind::device_output:
+          if (io.output_buffer.has_value()) {
+            auto& out = *io.output_buffer;
+            for (index_type channel = 0; channel < out.size_channels(); ++channel) {
+              for (index_type frame = 0; frame < block_frames; ++frame)
+                out(offset + frame, channel) = channel < step.inputs.size() ? step.inputs[channel][frame] : _SampleType{};
+            }
+          }
+          break;
+
+        case _step_kind::processor: {
+          audio_device_io<_SampleType> node_io;
+          node_io.input_time = io.input_time;
+          node_io.output_time = io.output_time;
+          if (!step.inputs.empty())
+            node_io.input_buffer = audio_buffer<_SampleType>(step.inputs.data(), block_frames, step.inputs.size(), ptr_to_ptr_deinterleaved);
+          if (!step.outputs.empty())
+            node_io.output_buffer = audio_buffer<_SampleType>(step.outputs.data(), block_frames, step.outputs.size(), ptr_to_ptr_deinterleaved);
+
+          step.node->processor(node_io);
+          break;
+        }
+      }
+    }
+  }
+
+  static void _clear_output(audio_device_io<_SampleType>& io, index_type offset, index_type block_frames) noexcept {
+    if (!io.output_buffer.has_value())
+      return;
+
+    auto& out = *io.output_buffer;
+    for (index_type channel = 0; channel < out.size_channels(); ++channel)
+      for (index_type frame = 0; frame < block_frames; ++frame)
+        out(offset + frame, channel) = _SampleType{};
+  }
+
+  index_type _max_block_frames = 0;
+  node_id _input_node_id = invalid_node_id;
+  node_id _output_node_id = invalid_node_id;
+  index_type _last_num_scratch_channels = 0;
+
+  // Control thread only.
+  vector<shared_ptr<_node>> _nodes;
+
+  // _pending is handed from the control thread to the audio thread, _retired back.
+  _schedule* _current = nullptr;
+  atomic<_schedule*> _pending = nullptr;
+  atomic<_schedule*> _retired = nullptr;
+};
+
+_LIBSTDAUDIO_NAMESPACE_END
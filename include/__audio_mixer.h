@@ -0,0 +1,411 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <vector>
+#include <__audio_simd.h>
+
+_LIBSTDAUDIO_NAMESPACE_BEGIN
+
+// Runs task(context, i) for every i in [0, num_tasks), possibly in parallel, and
+// returns once all of them have finished. Must not allocate or block on locks
+// that a non-realtime thread can hold.
+using audio_mixer_executor = function<void(size_t num_tasks, void (*task)(void* context, size_t index), void* context)>;
+
+// Mixes many sources into one output. Each source is a callable that renders a
+// mono or stereo block, which is then added to the output with its own gain and pan.
+// Sources can be added and removed lock-free from any number of control threads
+// while the mixer runs, and gain changes are ramped over one block.
+//
+// Sources are assigned to groups. Every group is mixed into its own sub-mix, and if an
+// executor is set the groups are rendered in parallel.
+//
+// The mixer itself is not copyable; connect it to a device through a callback that
+// refers to it, e.g. [&mixer](auto& device, auto& io) noexcept { mixer(device, io); }.
+template <typename _SampleType = float>
+class audio_mixer {
+public:
+  using sample_type = _SampleType;
+  using index_type = typename audio_buffer<_SampleType>::index_type;
+  using source_id = uint64_t;
+
+  static constexpr source_id invalid_source_id = ~source_id(0);
+
+  audio_mixer(index_type num_output_channels,
+              size_t max_sources,
+              index_type max_block_frames = 1024,
+              size_t num_groups = 1)
+    : _num_output_channels(num_output_channels),
+      _max_block_frames(max_block_frames),
+      _slots(max_sources),
+      _groups(num_groups) {
+    assert(num_output_channels > 0);
+    assert(num_groups > 0);
+
+    for (auto& group : _groups) {
+      group.mix.resize(num_output_channels * max_block_frames);
+      group.source_scratch.resize(_max_source_channels * max_block_frames);
+    }
+
+    _master_mix.resize(num_output_channels * max_block_frames);
+  }
+
+  audio_mixer(const audio_mixer&) = delete;
+  audio_mixer& operator=(const audio_mixer&) = delete;
+
+  index_type num_output_channels() const noexcept {
+    return _num_output_channels;
+  }
+
+  size_t max_sources() const noexcept {
+    return _slots.size();
+  }
+
+  size_t num_groups() const noexcept {
+    return _groups.size();
+  }
+
+  // Adds a source that renders num_channels (1 or 2) channels. The callback is
+  // invoked on the audio thread as callback(buffer) and must overwrite every sample
+  // of the buffer. Returns invalid_source_id if all slots are taken.
+  template <typename _CallbackType,
+            typename = enable_if_t<is_nothrow_invocable_v<_CallbackType, audio_buffer<_SampleType>&>>>
+  source_id add_source(_CallbackType callback, index_type num_channels = 1,
+                       float gain = 1.0f, float pan = 0.0f, size_t group = 0) {
+    assert(num_channels == 1 || num_channels == 2);
+    assert(group < _groups.size());
+    collect_garbage();
+
+    for (size_t index = 0; index < _slots.size(); ++index) {
+      auto& slot = _slots[index];
+      auto tag = slot.tag.load(memory_order_relaxed);
+      if (_state(tag) != _slot_state::free
+          || !slot.tag.compare_exchange_strong(tag, _with_state(tag, _slot_state::claimed), memory_order_acquire))
+        continue;
+
+      slot.callback = move(callback);
+      slot.num_channels = num_channels;
+      slot.group = group;
+      slot.gain.store(gain, memory_order_relaxed);
+      slot.pan.store(pan, memory_order_relaxed);
+      slot.ramp_from_current = false;
+      const auto generation = _generation(tag);
+
+      auto num_slots = _num_slots_in_use.load(memory_order_relaxed);
+      while (num_slots <= index && !_num_slots_in_use.compare_exchange_weak(num_slots, index + 1, memory_order_release));
+
+      slot.tag.store(_make_tag(generation, 0, _slot_state::active), memory_order_release);
+      return (source_id(generation) << 32) | index;
+    }
+
+    return invalid_source_id;
+  }
+
+  // The source stops playing at the next block; its callback is destroyed by a later
+  // call to collect_garbage (or add_source) on a control thread.
+  bool remove_source(source_id id) noexcept {
+    const auto index = size_t(id & 0xffffffff);
+    if (index >= _slots.size())
+      return false;
+
+    // Generation and state change together, so a stale id cannot remove the slot's next source.
+    auto& slot = _slots[index];
+    auto tag = slot.tag.load(memory_order_relaxed);
+    do {
+      if (_generation(tag) != uint32_t(id >> 32) || _state(tag) != _slot_state::active)
+        return false;
+    } while (!slot.tag.compare_exchange_weak(tag, _with_state(tag, _slot_state::removing), memory_order_acq_rel));
+
+    return true;
+  }
+
+  // Destroys the callbacks of removed sources once the audio thread no longer uses them,
+  // and returns how many slots have been freed.
+  size_t collect_garbage() {
+    size_t num_freed = 0;
+    for (auto& slot : _slots) {
+      // A slot that set_gain or set_pan is still using is left for a later call.
+      auto tag = slot.tag.load(memory_order_relaxed);
+      if (_state(tag) != _slot_state::retired || _num_users(tag) != 0
+          || !slot.tag.compare_exchange_strong(tag, _with_state(tag, _slot_state::claimed), memory_order_acquire))
+        continue;
+
+      slot.callback = nullptr;
+      slot.tag.store(_make_tag(_generation(tag) + 1, 0, _slot_state::free), memory_order_release);
+      ++num_freed;
+    }
+
+    return num_freed;
+  }
+
+  bool set_gain(source_id id, float gain) noexcept {
+    auto* slot = _use_slot(id);
+    if (slot == nullptr)
+      return false;
+
+    slot->gain.store(gain, memory_order_relaxed);
+    _release_slot(*slot);
+    return true;
+  }
+
+  // -1 is hard left, 0 centre and 1 hard right. Mono sources are panned with a
+  // constant-power law, stereo sources are balanced.
+  bool set_pan(source_id id, float pan) noexcept {
+    auto* slot = _use_slot(id);
+    if (slot == nullptr)
+      return false;
+
+    slot->pan.store(clamp(pan, -1.0f, 1.0f), memory_order_relaxed);
+    _release_slot(*slot);
+    return true;
+  }
+
+  size_t num_sources() const noexcept {
+    size_t result = 0;
+    for (auto& slot : _slots)
+      result += _state(slot.tag.load(memory_order_relaxed)) == _slot_state::active;
+
+    return result;
+  }
+
+  void set_group_gain(size_t group, float gain) noexcept {
+    _groups.at(group).gain.store(gain, memory_order_relaxed);
+  }
+
+  void set_master_gain(float gain) noexcept {
+    _master_gain.store(gain, memory_order_relaxed);
+  }
+
+  // Not thread-safe; set the executor before the mixer starts processing.
+  void set_executor(audio_mixer_executor executor) {
+    _executor = move(executor);
+  }
+
+  // Overwrites the output with the mix of all sources.
+  void process(audio_buffer<_SampleType>& output) noexcept {
+    assert(output.size_channels() == _num_output_channels);
+
+    for (index_type offset = 0; offset < output.size_frames(); offset += _max_block_frames) {
+      _block_frames = min(output.size_frames() - offset, _max_block_frames);
+
+      if (_executor && _groups.size() > 1)
+        _executor(_groups.size(), &_render_group_task, this);
+      else
+        for (size_t group = 0; group < _groups.size(); ++group)
+          _render_group(group);
+
+      _mix_groups();
+
+      for (index_type channel = 0; channel < _num_output_channels; ++channel) {
+        const _SampleType* mix = _master_mix.data() + channel * _max_block_frames;
+        for (index_type frame = 0; frame < _block_frames; ++frame)
+          output(offset + frame, channel) = mix[frame];
+      }
+    }
+  }
+
+  template <typename _DeviceType>
+  void operator()(_DeviceType&, audio_device_io<_SampleType>& io) noexcept {
+    if (io.output_buffer.has_value())
+      process(*io.output_buffer);
+  }
+
+private:
+  enum class _slot_state : uint8_t {
+    free,
+    claimed,  // owned by a control thread that is setting up or tearing down the slot
+    active,
+    removing,
+    retired,
+  };
+
+  // A slot's generation (the upper half of its source ids), the number of control
+  // threads in set_gain or set_pan on it and its state, in one word that changes as
+  // a whole.
+  using _slot_tag = uint64_t;
+
+  static constexpr _slot_tag _make_tag(uint32_t generation, uint32_t num_users, _slot_state state) noexcept {
+    return (_slot_tag(generation) << 32) | (_slot_tag(num_users) << 8) | _slot_tag(state);
+  }
+
+  static constexpr uint32_t _generation(_slot_tag tag) noexcept {
+    return uint32_t(tag >> 32);
+  }
+
+  static constexpr uint32_t _num_users(_slot_tag tag) noexcept {
+    return uint32_t(tag >> 8) & 0xffffff;
+  }
+
+  static constexpr _slot_state _state(_slot_tag tag) noexcept {
+    return _slot_state(tag & 0xff);
+  }
+
+  static constexpr _slot_tag _with_state(_slot_tag tag, _slot_state state) noexcept {
+    return (tag & ~_slot_tag(0xff)) | _slot_tag(state);
+  }
+
+  struct _slot {
+    atomic<_slot_tag> tag = _make_tag(0, 0, _slot_state::free);
+    function<void(audio_buffer<_SampleType>&)> callback;
+    index_type num_channels = 1;
+    size_t group = 0;
+    atomic<float> gain = 1.0f;
+    atomic<float> pan = 0.0f;
+
+    // Audio thread only: the gains reached at the end of the previous block.
+    array<_SampleType, 2> current_gains = {};
+    bool ramp_from_current = false;
+  };
+
+  struct _group {
+    vector<_SampleType> mix;
+    vector<_SampleType> source_scratch;
+    atomic<float> gain = 1.0f;
+    _SampleType current_gain = 1;
+  };
+
+  // Registers the caller as a user of the source's slot if the source is still
+  // playing, which keeps collect_garbage from handing the slot to another source
+  // until _release_slot.
+  _slot* _use_slot(source_id id) noexcept {
+    const auto index = size_t(id & 0xffffffff);
+    if (index >= _slots.size())
+      return nullptr;
+
+    auto& slot = _slots[index];
+    auto tag = slot.tag.load(memory_order_relaxed);
+    do {
+      if (_generation(tag) != uint32_t(id >> 32) || _state(tag) != _slot_state::active)
+        return nullptr;
+    } while (!slot.tag.compare_exchange_weak(tag, tag + _make_tag(0, 1, _slot_state::free), memory_order_acquire));
+
+    return &slot;
+  }
+
+  void _release_slot(_slot& slot) noexcept {
+    slot.tag.fetch_sub(_make_tag(0, 1, _slot_state::free), memory_order_release);
+  }
+
+  static void _render_group_task(void* context, size_t group) {
+    static_cast<audio_mixer*>(context)->_render_group(group);
+  }
+
+  void _render_group(size_t group_index) noexcept {
+    auto& group = _groups[group_index];
+    fill(group.mix.begin(), group.mix.end(), _SampleType{});
+
+    const size_t num_slots = _num_slots_in_use.load(memory_order_acquire);
+    for (size_t index = 0; index < num_slots; ++index) {
+      auto& slot = _slots[index];
+      auto tag = slot.tag.load(memory_order_acquire);
+      const auto state = _state(tag);
+      if ((state != _slot_state::active && state != _slot_state::removing) || slot.group != group_index)
+        continue;
+
+      if (state == _slot_state::removing) {
+        // Only the number of users can change under us; nobody else leaves this state.
+        while (!slot.tag.compare_exchange_weak(tag, _with_state(tag, _slot_state::retired), memory_order_release));
+        continue;
+      }
+
+      _render_source(slot, group);
+    }
+  }
+
+  void _render_source(_slot& slot, _group& group) noexcept {
+    audio_buffer<_SampleType> buffer(group.source_scratch.data(), _block_frames, slot.num_channels, contiguous_deinterleaved);
+    slot.callback(buffer);
+
+    const array<_SampleType, 2> target_gains = _get_channel_gains(slot);
+    const array<_SampleType, 2> start_gains = slot.ramp_from_current ? slot.current_gains : target_gains;
+    slot.current_gains = target_gains;
+    slot.ramp_from_current = true;
+
+    const _SampleType* left = group.source_scratch.data();
+    const _SampleType* right = slot.num_channels == 2 ? left + _block_frames : left;
+
+    if (_num_output_channels == 1) {
+      __simd_accumulate_ramp(group.mix.data(), left, start_gains[0], target_gains[0], _block_frames);
+      if (slot.num_channels == 2)
+        __simd_accumulate_ramp(group.mix.data(), right, start_gains[1], target_gains[1], _block_frames);
+    }
+    else {
+      __simd_accumulate_ramp(group.mix.data(), left, start_gains[0], target_gains[0], _block_frames);
+      __simd_accumulate_ramp(group.mix.data() + _max_block_frames, right, start_gains[1], target_gains[1], _block_frames);
+    }
+  }
+
+  // Gains from the source's left (or only) channel to output channel 0 and from
+  // its right (or only) channel to output channel 1.
+  array<_SampleType, 2> _get_channel_gains(const _slot& slot) const noexcept {
+    const float gain = slot.gain.load(memory_order_relaxed);
+    const float pan = slot.pan.load(memory_order_relaxed);
+
+    if (_num_output_channels == 1)
+      return {_SampleType(slot.num_channels == 2 ? 0.5f * gain : gain), _SampleType(0.5f * gain)};
+
+    if (slot.num_channels == 1) {
+      const double angle = (double(pan) + 1.0) * _pi / 4.0;
+      return {_SampleType(gain * cos(angle)), _SampleType(gain * sin(angle))};
+    }
+
+    return {_SampleType(gain * min(1.0f, 1.0f - pan)), _SampleType(gain * min(1.0f, 1.0f + pan))};
+  }
+
+  void _mix_groups() noexcept {
+    fill(_master_mix.begin(), _master_mix.end(), _SampleType{});
+
+    for (auto& group : _groups) {
+      const auto target_gain = _SampleType(group.gain.load(memory_order_relaxed));
+      for (index_type channel = 0; channel < _num_output_channels; ++channel) {
+        __simd_accumulate_ramp(_master_mix.data() + channel * _max_block_frames,
+                               group.mix.data() + channel * _max_block_frames,
+                               group.current_gain, target_gain, _block_frames);
+      }
+      group.current_gain = target_gain;
+    }
+
+    const auto master_gain = _SampleType(_master_gain.load(memory_order_relaxed));
+    if (master_gain != _SampleType(1) || _current_master_gain != _SampleType(1)) {
+      for (index_type channel = 0; channel < _num_output_channels; ++channel) {
+        _SampleType* mix = _master_mix.data() + channel * _max_block_frames;
+        const _SampleType step = (master_gain - _current_master_gain) / _SampleType(_block_frames);
+        if (step == _SampleType(0))
+          __simd_scale(mix, master_gain, _block_frames);
+        else
+          for (index_type frame = 0; frame < _block_frames; ++frame)
+            mix[frame] *= _current_master_gain + step * _SampleType(frame);
+      }
+    }
+    _current_master_gain = master_gain;
+  }
+
+  static constexpr double _pi = 3.14159265358979323846;
+  static constexpr index_type _max_source_channels = 2;
+
+  index_type _num_output_channels = 0;
+  index_type _max_block_frames = 0;
+  index_type _block_frames = 0;
+
+  vector<_slot> _slots;
+  atomic<size_t> _num_slots_in_use = 0;
+  vector<_group> _groups;
+  vector<_SampleType> _master_mix;
+  atomic<float> _master_gain = 1.0f;
+  _SampleType _current_master_gain = 1;
+  audio_mixer_executor _executor;
+};
+
+_LIBSTDAUDIO_NAMESPACE_END
@@ -0,0 +1,253 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+#include <__audio_simd.h>
+
+_LIBSTDAUDIO_NAMESPACE_BEGIN
+
+enum class audio_noise_color {
+  // Flat spectrum, uniformly distributed in [-1, 1).
+  white,
+  // -3 dB per octave (Paul Kellet's refined filter).
+  pink,
+  // -6 dB per octave (leaky integrator).
+  brown,
+};
+
+// Block-based noise generator. Every channel interleaves eight independent xoshiro128+
+// generators, which are advanced a SIMD pack at a time, so white noise is produced
+// several samples per step. Pink and brown noise filter the white noise per channel.
+// The output depends only on the seed and the number of samples generated, not on the
+// block sizes or the SIMD width, so it is reproducible (e.g. in tests, across machines).
+// All memory is allocated in the constructor.
+class audio_noise_generator {
+public:
+  explicit audio_noise_generator(audio_noise_color color = audio_noise_color::white,
+                                 size_t num_channels = 1,
+                                 uint64_t seed = 0x5eed'5eed'5eed'5eedull)
+    : _color(color),
+      _channels(num_channels) {
+    this->seed(seed);
+  }
+
+  // Resets every channel to the start of its stream for the given seed.
+  void seed(uint64_t seed) noexcept {
+    for (size_t channel = 0; channel < _channels.size(); ++channel) {
+      auto& state = _channels[channel];
+      uint64_t splitmix_state = seed ^ (0x9e37'79b9'7f4a'7c15ull * (channel + 1));
+
+      for (size_t lane = 0; lane < _num_lanes; ++lane) {
+        for (size_t word = 0; word < 4; word += 2) {
+          const uint64_t bits = _splitmix64(splitmix_state);
+          state.words[word * _num_lanes + lane] = uint32_t(bits);
+          state.words[(word + 1) * _num_lanes + lane] = uint32_t(bits >> 32);
+        }
+
+        // xoshiro must not start from the all-zero state.
+        if (state.words[lane] == 0 && state.words[_num_lanes + lane] == 0
+            && state.words[2 * _num_lanes + lane] == 0 && state.words[3 * _num_lanes + lane] == 0)
+          state.words[lane] = 1;
+      }
+
+      state.num_leftover = 0;
+      state.filter = {};
+    }
+  }
+
+  size_t num_channels() const noexcept {
+    return _channels.size();
+  }
+
+  audio_noise_color get_color() const noexcept {
+    return _color;
+  }
+
+  void set_color(audio_noise_color color) noexcept {
+    _color = color;
+  }
+
+  float get_gain() const noexcept {
+    return _gain;
+  }
+
+  void set_gain(float gain) noexcept {
+    _gain = gain;
+  }
+
+  // Writes the next n samples of the given channel's stream to dst.
+  void render(float* dst, size_t n, size_t channel = 0) noexcept {
+    assert(channel < _channels.size());
+    auto& state = _channels[channel];
+
+    switch (_color) {
+      case audio_noise_color::white:
+        _generate_white(state, dst, n, _gain);
+        break;
+
+      case audio_noise_color::pink:
+        _generate_white(state, dst, n, 1.0f);
+        _filter_pink(state.filter, dst, n, _gain);
+        break;
+
+      case audio_noise_color::brown:
+        _generate_white(state, dst, n, 1.0f);
+        _filter_brown(state.filter, dst, n, _gain);
+        break;
+    }
+  }
+
+  // Fills the buffer, each channel from its own stream.
+  template <typename _SampleType>
+  void process(audio_buffer<_SampleType>& buffer) noexcept {
+    static_assert(is_floating_point_v<_SampleType>, "audio_noise_generator requires a floating-point sample type");
+    assert(size_t(buffer.size_channels()) <= _channels.size());
+
+    const size_t num_frames = size_t(buffer.size_frames());
+    for (size_t channel = 0; channel < size_t(buffer.size_channels()); ++channel) {
+      for (size_t first = 0; first < num_frames; first += _block_size) {
+        const size_t n = min(_block_size, num_frames - first);
+        render(_block, n, channel);
+
+        for (size_t frame = 0; frame < n; ++frame)
+          buffer(first + frame, channel) = _SampleType(_block[frame]);
+      }
+    }
+  }
+
+private:
+  static constexpr size_t w = __simd_uint32::width;
+  static constexpr size_t _num_lanes = 8;
+  static constexpr size_t _block_size = 256;
+  static_assert(_num_lanes % w == 0, "the generators of a channel must fill whole SIMD packs");
+
+  struct _filter_state {
+    float b0 = 0, b1 = 0, b2 = 0, b3 = 0, b4 = 0, b5 = 0, b6 = 0;
+  };
+
+  struct _channel_state {
+    // The four xoshiro128+ state words, each for all lanes in a row.
+    array<uint32_t, 4 * _num_lanes> words = {};
+    // Samples of the last step that have not been handed out yet.
+    array<float, _num_lanes> leftover = {};
+    size_t num_leftover = 0;
+    _filter_state filter;
+  };
+
+  static uint64_t _splitmix64(uint64_t& state) noexcept {
+    uint64_t z = (state += 0x9e37'79b9'7f4a'7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58'476d'1ce4'e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d0'49bb'1331'11ebull;
+    return z ^ (z >> 31);
+  }
+
+  // One step of xoshiro128+ in every lane (Blackman and Vigna, 2018). The top 23 bits
+  // of the result become the mantissa of a float in [1, 2), which maps to [-1, 1).
+  static __simd_float _next(__simd_uint32& s0, __simd_uint32& s1, __simd_uint32& s2, __simd_uint32& s3) noexcept {
+    const auto result = s0 + s3;
+    const auto t = s1.shift_left<9>();
+
+    s2 = s2 ^ s0;
+    s3 = s3 ^ s1;
+    s1 = s1 ^ s2;
+    s0 = s0 ^ s3;
+    s2 = s2 ^ t;
+    s3 = s3.rotate_left<11>();
+
+    const auto one_to_two = (result.shift_right<9>() | __simd_uint32::broadcast(0x3f80'0000u)).bits_as_float();
+    return fma(one_to_two, __simd_float::broadcast(2.0f), __simd_float::broadcast(-3.0f));
+  }
+
+  static void _generate_white(_channel_state& state, float* dst, size_t n, float gain) noexcept {
+    size_t i = 0;
+    for (; i < n && state.num_leftover > 0; ++i)
+      dst[i] = gain * state.leftover[_num_lanes - state.num_leftover--];
+
+    if (i == n)
+      return;
+
+    // Sample i + step * _num_lanes + lane comes from the given lane. Each pack of lanes
+    // runs through all steps in turn, so that its state stays in registers.
+    const size_t num_steps = (n - i) / _num_lanes;
+    const bool has_partial_step = i + num_steps * _num_lanes < n;
+    const auto g = __simd_float::broadcast(gain);
+
+    for (size_t pack = 0; pack < _num_lanes; pack += w) {
+      uint32_t* words = state.words.data() + pack;
+      auto s0 = __simd_uint32::load(words);
+      auto s1 = __simd_uint32::load(words + _num_lanes);
+      auto s2 = __simd_uint32::load(words + 2 * _num_lanes);
+      auto s3 = __simd_uint32::load(words + 3 * _num_lanes);
+
+      float* out = dst + i + pack;
+      for (size_t step = 0; step < num_steps; ++step, out += _num_lanes)
+        (g * _next(s0, s1, s2, s3)).store(out);
+
+      if (has_partial_step)
+        _next(s0, s1, s2, s3).store(state.leftover.data() + pack);
+
+      s0.store(words);
+      s1.store(words + _num_lanes);
+      s2.store(words + 2 * _num_lanes);
+      s3.store(words + 3 * _num_lanes);
+    }
+
+    i += num_steps * _num_lanes;
+    if (has_partial_step) {
+      state.num_leftover = _num_lanes;
+      for (; i < n; ++i)
+        dst[i] = gain * state.leftover[_num_lanes - state.num_leftover--];
+    }
+  }
+
+  // The filters are recursive in time, so they run one sample after the other. The
+  // state is kept in locals, where the compiler knows that writes to data[] cannot
+  // change it.
+  static void _filter_pink(_filter_state& state, float* data, size_t n, float gain) noexcept {
+    // Keeps the output roughly within [-1, 1].
+    const float output_gain = 0.11f * gain;
+    auto f = state;
+
+    for (size_t i = 0; i < n; ++i) {
+      const float white = data[i];
+      f.b0 = 0.99886f * f.b0 + white * 0.0555179f;
+      f.b1 = 0.99332f * f.b1 + white * 0.0750759f;
+      f.b2 = 0.96900f * f.b2 + white * 0.1538520f;
+      f.b3 = 0.86650f * f.b3 + white * 0.3104856f;
+      f.b4 = 0.55000f * f.b4 + white * 0.5329522f;
+      f.b5 = -0.7616f * f.b5 - white * 0.0168980f;
+      data[i] = output_gain * (f.b0 + f.b1 + f.b2 + f.b3 + f.b4 + f.b5 + f.b6 + white * 0.5362f);
+      f.b6 = white * 0.115926f;
+    }
+
+    state = f;
+  }
+
+  static void _filter_brown(_filter_state& state, float* data, size_t n, float gain) noexcept {
+    // The leak keeps the integrator from wandering off; the input gain gives an RMS
+    // level of about 0.2, which keeps the output roughly within [-1, 1].
+    float y = state.b0;
+    for (size_t i = 0; i < n; ++i) {
+      y = 0.995f * y + 0.035f * data[i];
+      data[i] = gain * y;
+    }
+
+    state.b0 = y;
+  }
+
+  audio_noise_color _color;
+  float _gain = 1.0f;
+  vector<_channel_state> _channels;
+  float _block[_block_size] = {};
+};
+
+_LIBSTDAUDIO_NAMESPACE_END
@@ -0,0 +1,392 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <type_traits>
+#include <vector>
+#include <__audio_simd.h>
+
+_LIBSTDAUDIO_NAMESPACE_BEGIN
+
+enum class audio_waveform {
+  sine,
+  // Band-limited with PolyBLEP corrections at the discontinuities.
+  saw,
+  square,
+  // Reads the oscillator's audio_wavetable.
+  wavetable,
+};
+
+// One cycle of a waveform, stored as a set of band-limited versions: level k keeps
+// the harmonics up to (size / 2) >> k, and playback picks the richest level that
+// does not alias at the current frequency. The levels are computed in the
+// constructor with a plain DFT, so construct wavetables outside the audio thread.
+class audio_wavetable {
+public:
+  audio_wavetable(const float* cycle, size_t size) : _size(size) {
+    assert(size >= 2 && (size & (size - 1)) == 0);
+
+    vector<double> sine(size);
+    for (size_t n = 0; n < size; ++n)
+      sine[n] = sin(2 * 3.14159265358979323846 * double(n) / double(size));
+
+    auto sine_at = [&](size_t index) { return sine[index % size]; };
+    auto cosine_at = [&](size_t index) { return sine[(index + size / 4) % size]; };
+
+    const size_t num_harmonics = size / 2;
+    vector<double> cosine_coefficients(num_harmonics + 1), sine_coefficients(num_harmonics + 1);
+    double mean = 0;
+
+    for (size_t n = 0; n < size; ++n)
+      mean += cycle[n];
+
+    mean /= double(size);
+
+    for (size_t h = 1; h <= num_harmonics; ++h) {
+      double a = 0, b = 0;
+      for (size_t n = 0; n < size; ++n) {
+        a += cycle[n] * cosine_at(h * n);
+        b += cycle[n] * sine_at(h * n);
+      }
+
+      // The Nyquist harmonic is its own mirror image.
+      const double scale = h == num_harmonics ? 1.0 / double(size) : 2.0 / double(size);
+      cosine_coefficients[h] = a * scale;
+      sine_coefficients[h] = b * scale;
+    }
+
+    for (size_t max_harmonic = num_harmonics; max_harmonic >= 1; max_harmonic /= 2) {
+      // One extra sample at the end, so interpolation never has to wrap around.
+      auto& level = _levels.emplace_back(size + 1);
+      for (size_t n = 0; n < size; ++n) {
+        double value = mean;
+        for (size_t h = 1; h <= max_harmonic; ++h)
+          value += cosine_coefficients[h] * cosine_at(h * n) + sine_coefficients[h] * sine_at(h * n);
+
+        level[n] = float(value);
+      }
+
+      level[size] = level[0];
+    }
+  }
+
+  size_t size() const noexcept {
+    return _size;
+  }
+
+  size_t num_levels() const noexcept {
+    return _levels.size();
+  }
+
+  // The richest level whose highest harmonic stays below Nyquist for the given phase
+  // increment (frequency divided by sample rate).
+  size_t level_for_increment(double increment) const noexcept {
+    const double frequency = abs(increment);
+    size_t level = 0;
+    size_t max_harmonic = _size / 2;
+
+    while (level + 1 < _levels.size() && double(max_harmonic) * frequency > 0.5) {
+      ++level;
+      max_harmonic /= 2;
+    }
+
+    return level;
+  }
+
+  const float* level_data(size_t level) const noexcept {
+    return _levels[level].data();
+  }
+
+private:
+  size_t _size;
+  vector<vector<float>> _levels;
+};
+
+// Oscillator kernels. The phase is kept in cycles, i.e. in [0, 1). Each kernel adds
+// gain * waveform(phase) to dst for n samples and advances the phase; a pack of
+// consecutive samples is computed at once, with the phase carried in double between
+// blocks so that it does not drift.
+struct __audio_oscillator_kernels {
+  static __simd_float fractional_part(__simd_float x) noexcept {
+    return x - floor(x);
+  }
+
+  static __simd_float sine(__simd_float phase) noexcept {
+    // Fold the phase onto [-1/4, 1/4] cycles, where sin(2 pi y) is odd and smooth,
+    // and evaluate a minimax polynomial there (max. error 3.5e-6).
+    const auto centered = fractional_part(phase + __simd_float::broadcast(0.25f)) - __simd_float::broadcast(0.5f);
+    const auto y = __simd_float::broadcast(0.25f) - max(centered, __simd_float::broadcast(0) - centered);
+    const auto y2 = y * y;
+
+    auto p = __simd_float::broadcast(42.0077971f);
+    p = fma(p, y2, __simd_float::broadcast(-76.7041703f));
+    p = fma(p, y2, __simd_float::broadcast(81.6052237f));
+    p = fma(p, y2, __simd_float::broadcast(-41.3417021f));
+    p = fma(p, y2, __simd_float::broadcast(6.28318531f));
+    return p * y;
+  }
+
+  // 2 t - 1 minus the polynomial band-limited step at the wrap-around (Välimäki 2007),
+  // written branch-free: the correction is (1 - t/dt)^2 just after the wrap and
+  // -(1 - (1-t)/dt)^2 just before it.
+  static __simd_float saw(__simd_float phase, __simd_float inverse_increment) noexcept {
+    const auto zero = __simd_float::broadcast(0);
+    const auto one = __simd_float::broadcast(1);
+    const auto after = max(zero, one - phase * inverse_increment);
+    const auto before = max(zero, one - (one - phase) * inverse_increment);
+    return phase + phase - one + after * after - before * before;
+  }
+
+  // The difference of two saws half a cycle apart: +1 in the first half, -1 in the second.
+  static __simd_float square(__simd_float phase, __simd_float inverse_increment) noexcept {
+    const auto shifted = fractional_part(phase + __simd_float::broadcast(0.5f));
+    return saw(shifted, inverse_increment) - saw(phase, inverse_increment);
+  }
+
+  template <typename _WaveformType>
+  static void render(float* dst, size_t n, double& phase, double increment, float gain, _WaveformType&& waveform) noexcept {
+    constexpr size_t w = __simd_float::width;
+
+    float lane_offsets[w];
+    for (size_t lane = 0; lane < w; ++lane)
+      lane_offsets[lane] = float(increment * double(lane));
+
+    auto p = fractional_part(__simd_float::broadcast(float(phase)) + __simd_float::load(lane_offsets));
+    const auto step = __simd_float::broadcast(float(increment * double(w)));
+    const auto g = __simd_float::broadcast(gain);
+
+    size_t i = 0;
+    for (; i + w <= n; i += w) {
+      fma(g, waveform(p), __simd_float::load(dst + i)).store(dst + i);
+      p = fractional_part(p + step);
+    }
+
+    if (i < n) {
+      float tail[w];
+      (g * waveform(p)).store(tail);
+      for (size_t lane = 0; i + lane < n; ++lane)
+        dst[i + lane] += tail[lane];
+    }
+
+    phase += increment * double(n);
+    phase -= std::floor(phase);
+  }
+
+  static void render(float* dst, size_t n, double& phase, double increment, float gain,
+                     audio_waveform waveform, const audio_wavetable* wavetable) noexcept {
+    const auto inverse_increment = __simd_float::broadcast(float(1.0 / max(abs(increment), 1e-9)));
+
+    switch (waveform) {
+      case audio_waveform::sine:
+        render(dst, n, phase, increment, gain, [](__simd_float p) { return sine(p); });
+        break;
+
+      case audio_waveform::saw:
+        render(dst, n, phase, increment, gain, [=](__simd_float p) { return saw(p, inverse_increment); });
+        break;
+
+      case audio_waveform::square:
+        render(dst, n, phase, increment, gain, [=](__simd_float p) { return square(p, inverse_increment); });
+        break;
+
+      case audio_waveform::wavetable: {
+        if (wavetable == nullptr)
+          break;
+
+        // There is no portable gather, so the lookup itself is scalar.
+        const float* table = wavetable->level_data(wavetable->level_for_increment(increment));
+        const float size = float(wavetable->size());
+
+        render(dst, n, phase, increment, gain, [=](__simd_float p) {
+          constexpr size_t w = __simd_float::width;
+          float phases[w], values[w];
+          (p * __simd_float::broadcast(size)).store(phases);
+
+          for (size_t lane = 0; lane < w; ++lane) {
+            const auto index = min(size_t(phases[lane]), size_t(size) - 1);
+            const float fraction = phases[lane] - float(index);
+            values[lane] = table[index] + fraction * (table[index + 1] - table[index]);
+          }
+
+          return __simd_float::load(values);
+        });
+        break;
+      }
+    }
+  }
+};
+
+// A bank of oscillators in structure-of-arrays layout, rendered block-wise and
+// summed into one channel. Nothing is allocated after construction, so all member
+// functions may be called on the audio thread; like the rest of the state of a
+// callback, the bank itself is not synchronised.
+class audio_oscillator_bank {
+public:
+  audio_oscillator_bank(size_t num_oscillators, double sample_rate)
+    : _sample_rate(sample_rate),
+      _frequencies(num_oscillators, 0.0),
+      _phases(num_oscillators, 0.0),
+      _increments(num_oscillators, 0.0),
+      _gains(num_oscillators, 0.0f),
+      _waveforms(num_oscillators, audio_waveform::sine),
+      _wavetables(num_oscillators, nullptr) {
+    assert(sample_rate > 0);
+  }
+
+  size_t size() const noexcept {
+    return _phases.size();
+  }
+
+  double get_sample_rate() const noexcept {
+    return _sample_rate;
+  }
+
+  void set_sample_rate(double sample_rate) noexcept {
+    assert(sample_rate > 0);
+    _sample_rate = sample_rate;
+    for (size_t i = 0; i < size(); ++i)
+      _increments[i] = _frequencies[i] / _sample_rate;
+  }
+
+  void set_frequency(size_t index, double frequency_hz) noexcept {
+    _frequencies[index] = frequency_hz;
+    _increments[index] = frequency_hz / _sample_rate;
+  }
+
+  double get_frequency(size_t index) const noexcept {
+    return _frequencies[index];
+  }
+
+  // Oscillators start with a gain of 0, i.e. silent.
+  void set_gain(size_t index, float gain) noexcept {
+    _gains[index] = gain;
+  }
+
+  float get_gain(size_t index) const noexcept {
+    return _gains[index];
+  }
+
+  // The wavetable must outlive its use by the bank.
+  void set_waveform(size_t index, audio_waveform waveform, const audio_wavetable* wavetable = nullptr) noexcept {
+    assert(waveform != audio_waveform::wavetable || wavetable != nullptr);
+    _waveforms[index] = waveform;
+    _wavetables[index] = wavetable;
+  }
+
+  audio_waveform get_waveform(size_t index) const noexcept {
+    return _waveforms[index];
+  }
+
+  // In cycles, i.e. 0.5 is half a period.
+  void set_phase(size_t index, double phase) noexcept {
+    _phases[index] = phase - std::floor(phase);
+  }
+
+  double get_phase(size_t index) const noexcept {
+    return _phases[index];
+  }
+
+  // Adds the sum of all oscillators to dst.
+  void render_add(float* dst, size_t num_frames) noexcept {
+    for (size_t i = 0; i < size(); ++i) {
+      if (_gains[i] == 0.0f) {
+        _phases[i] += _increments[i] * double(num_frames);
+        _phases[i] -= std::floor(_phases[i]);
+        continue;
+      }
+
+      __audio_oscillator_kernels::render(dst, num_frames, _phases[i], _increments[i], _gains[i], _waveforms[i], _wavetables[i]);
+    }
+  }
+
+  // Writes the sum of all oscillators to dst.
+  void render(float* dst, size_t num_frames) noexcept {
+    fill(dst, dst + num_frames, 0.0f);
+    render_add(dst, num_frames);
+  }
+
+  // Writes the sum of all oscillators to frames [first_frame, last_frame) of every
+  // channel of the buffer.
+  template <typename _SampleType>
+  void process(audio_buffer<_SampleType>& buffer, size_t first_frame, size_t last_frame) noexcept {
+    static_assert(is_floating_point_v<_SampleType>, "audio_oscillator_bank requires a floating-point sample type");
+    assert(first_frame <= last_frame && last_frame <= size_t(buffer.size_frames()));
+
+    while (first_frame < last_frame) {
+      const size_t num_frames = min(last_frame - first_frame, _block_size);
+      render(_block, num_frames);
+
+      for (size_t channel = 0; channel < size_t(buffer.size_channels()); ++channel)
+        for (size_t frame = 0; frame < num_frames; ++frame)
+          buffer(first_frame + frame, channel) = _SampleType(_block[frame]);
+
+      first_frame += num_frames;
+    }
+  }
+
+  template <typename _SampleType>
+  void process(audio_buffer<_SampleType>& buffer) noexcept {
+    process(buffer, 0, size_t(buffer.size_frames()));
+  }
+
+private:
+  static constexpr size_t _block_size = 256;
+
+  double _sample_rate;
+  vector<double> _frequencies;
+  vector<double> _phases;
+  vector<double> _increments;
+  vector<float> _gains;
+  vector<audio_waveform> _waveforms;
+  vector<const audio_wavetable*> _wavetables;
+  float _block[_block_size] = {};
+};
+
+// A single oscillator, for when a bank is more than is needed.
+class audio_oscillator {
+public:
+  explicit audio_oscillator(double sample_rate, audio_waveform waveform = audio_waveform::sine,
+                            double frequency_hz = 440.0, float gain = 1.0f)
+    : _bank(1, sample_rate) {
+    _bank.set_waveform(0, waveform);
+    _bank.set_frequency(0, frequency_hz);
+    _bank.set_gain(0, gain);
+  }
+
+  void set_sample_rate(double sample_rate) noexcept { _bank.set_sample_rate(sample_rate); }
+  void set_frequency(double frequency_hz) noexcept { _bank.set_frequency(0, frequency_hz); }
+  double get_frequency() const noexcept { return _bank.get_frequency(0); }
+  void set_gain(float gain) noexcept { _bank.set_gain(0, gain); }
+  float get_gain() const noexcept { return _bank.get_gain(0); }
+  void set_phase(double phase) noexcept { _bank.set_phase(0, phase); }
+  double get_phase() const noexcept { return _bank.get_phase(0); }
+
+  void set_waveform(audio_waveform waveform, const audio_wavetable* wavetable = nullptr) noexcept {
+    _bank.set_waveform(0, waveform, wavetable);
+  }
+
+  void render(float* dst, size_t num_frames) noexcept {
+    _bank.render(dst, num_frames);
+  }
+
+  template <typename _SampleType>
+  void process(audio_buffer<_SampleType>& buffer, size_t first_frame, size_t last_frame) noexcept {
+    _bank.process(buffer, first_frame, last_frame);
+  }
+
+  template <typename _SampleType>
+  void process(audio_buffer<_SampleType>& buffer) noexcept {
+    _bank.process(buffer);
+  }
+
+private:
+  audio_oscillator_bank _bank;
+};
+
+_LIBSTDAUDIO_NAMESPACE_END
@@ -0,0 +1,225 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__linux__) || defined(__APPLE__)
+  #include <execinfo.h>
+  #include <unistd.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+  #define _LIBSTDAUDIO_INITIAL_EXEC_TLS __attribute__((tls_model("initial-exec")))
+#else
+  #define _LIBSTDAUDIO_INITIAL_EXEC_TLS
+#endif
+
+_LIBSTDAUDIO_NAMESPACE_BEGIN
+
+// Realtime-safety checking for audio callbacks.
+//
+// Every backend marks the thread as realtime (with an audio_realtime_scope) while a
+// user callback runs. When exactly one translation unit of the program defines
+// LIBSTDAUDIO_REALTIME_SANITIZER_IMPLEMENTATION before including <audio>, memory
+// allocation, mutex locking, sleeping and file I/O are intercepted on Linux, and any
+// such call made inside a realtime scope is reported to the violation handler. Code
+// that drives callbacks without hardware (e.g. in tests) can open a scope itself.
+// Without the implementation, a scope only costs a thread-local increment.
+
+// Called with the name of the offending function. The default handler prints it with
+// a stack trace and aborts. Handlers may call anything; checks are suspended while
+// they run.
+using audio_realtime_violation_handler = void (*)(const char* function_name);
+
+struct __audio_realtime_state {
+  int realtime_depth = 0;
+  int suspended_depth = 0;
+
+  bool is_checking() const noexcept {
+    return realtime_depth > 0 && suspended_depth == 0;
+  }
+};
+
+inline thread_local __audio_realtime_state __audio_this_thread_realtime_state _LIBSTDAUDIO_INITIAL_EXEC_TLS;
+
+inline void __audio_default_realtime_violation_handler(const char* function_name) {
+  fprintf(stderr, "libstdaudio: realtime violation: %s called inside an audio callback\n", function_name);
+
+#if defined(__linux__) || defined(__APPLE__)
+  void* frames[64];
+  const int num_frames = backtrace(frames, 64);
+  backtrace_symbols_fd(frames, num_frames, STDERR_FILENO);
+#endif
+
+  abort();
+}
+
+inline atomic<audio_realtime_violation_handler> __audio_realtime_violation_handler = &__audio_default_realtime_violation_handler;
+
+// Returns the previous handler.
+inline audio_realtime_violation_handler set_audio_realtime_violation_handler(audio_realtime_violation_handler handler) noexcept {
+  return __audio_realtime_violation_handler.exchange(handler != nullptr ? handler : &__audio_default_realtime_violation_handler);
+}
+
+// Marks the current thread as running realtime code until the scope ends. Scopes nest.
+class audio_realtime_scope {
+public:
+  audio_realtime_scope() noexcept {
+    ++__audio_this_thread_realtime_state.realtime_depth;
+  }
+
+  ~audio_realtime_scope() {
+    --__audio_this_thread_realtime_state.realtime_depth;
+  }
+
+  audio_realtime_scope(const audio_realtime_scope&) = delete;
+  audio_realtime_scope& operator=(const audio_realtime_scope&) = delete;
+
+  static bool is_active() noexcept {
+    return __audio_this_thread_realtime_state.realtime_depth > 0;
+  }
+};
+
+// Suspends checking on the current thread, for calls inside a callback that are
+// known to be acceptable (e.g. debug logging).
+class audio_realtime_checks_suspended {
+public:
+  audio_realtime_checks_suspended() noexcept {
+    ++__audio_this_thread_realtime_state.suspended_depth;
+  }
+
+  ~audio_realtime_checks_suspended() {
+    --__audio_this_thread_realtime_state.suspended_depth;
+  }
+
+  audio_realtime_checks_suspended(const audio_realtime_checks_suspended&) = delete;
+  audio_realtime_checks_suspended& operator=(const audio_realtime_checks_suspended&) = delete;
+};
+
+// Reports a violation if the current thread is inside a realtime scope. Interposed
+// functions call this; it can also be called directly by code that must not run on
+// the audio thread.
+inline void audio_realtime_check(const char* function_name) noexcept {
+  if (!__audio_this_thread_realtime_state.is_checking())
+    return;
+
+  audio_realtime_checks_suspended suspended;
+  __audio_realtime_violation_handler.load()(function_name);
+}
+
+_LIBSTDAUDIO_NAMESPACE_END
+
+#ifdef LIBSTDAUDIO_REALTIME_SANITIZER_IMPLEMENTATION
+
+// Interposition is only implemented on Linux; elsewhere only explicit calls to
+// audio_realtime_check() are reported. Memory functions are left alone when the
+// address or thread sanitizer runtime provides its own.
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+  #define _LIBSTDAUDIO_SANITIZER_RUNTIME_OWNS_MALLOC
+#elif defined(__has_feature)
+  #if __has_feature(address_sanitizer) || __has_feature(thread_sanitizer)
+    #define _LIBSTDAUDIO_SANITIZER_RUNTIME_OWNS_MALLOC
+  #endif
+#endif
+
+#if defined(__linux__)
+
+#include <cerrno>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <time.h>
+
+namespace _LIBSTDAUDIO_NAMESPACE {
+  template <typename _FunctionType>
+  _FunctionType __audio_next_symbol(atomic<_FunctionType>& cache, const char* name) noexcept {
+    auto function = cache.load(memory_order_acquire);
+    if (function == nullptr) {
+      function = reinterpret_cast<_FunctionType>(dlsym(RTLD_NEXT, name));
+      cache.store(function, memory_order_release);
+    }
+
+    return function;
+  }
+}
+
+// Interposes a libc function: checks, then forwards to the next definition.
+#define _LIBSTDAUDIO_INTERPOSE(return_type, name, parameters, arguments)                   \
+  extern "C" return_type name parameters {                                                  \
+    using _function_type = return_type (*) parameters;                                      \
+    static std::atomic<_function_type> next = nullptr;                                      \
+    _LIBSTDAUDIO_NAMESPACE::audio_realtime_check(#name);                                    \
+    return _LIBSTDAUDIO_NAMESPACE::__audio_next_symbol(next, #name) arguments;              \
+  }
+
+#ifndef _LIBSTDAUDIO_SANITIZER_RUNTIME_OWNS_MALLOC
+// dlsym itself allocates, so the memory functions forward to glibc's internal
+// entry points instead of looking up the next definition. __THROW matches the
+// exception specification of glibc's declarations.
+extern "C" void* __libc_malloc(size_t);
+extern "C" void* __libc_calloc(size_t, size_t);
+extern "C" void* __libc_realloc(void*, size_t);
+extern "C" void* __libc_memalign(size_t, size_t);
+extern "C" void __libc_free(void*);
+
+extern "C" void* malloc(size_t size) __THROW {
+  _LIBSTDAUDIO_NAMESPACE::audio_realtime_check("malloc");
+  return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size) __THROW {
+  _LIBSTDAUDIO_NAMESPACE::audio_realtime_check("calloc");
+  return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* pointer, size_t size) __THROW {
+  _LIBSTDAUDIO_NAMESPACE::audio_realtime_check("realloc");
+  return __libc_realloc(pointer, size);
+}
+
+extern "C" int posix_memalign(void** pointer, size_t alignment, size_t size) __THROW {
+  _LIBSTDAUDIO_NAMESPACE::audio_realtime_check("posix_memalign");
+  *pointer = __libc_memalign(alignment, size);
+  return *pointer != nullptr || size == 0 ? 0 : ENOMEM;
+}
+
+extern "C" void* aligned_alloc(size_t alignment, size_t size) __THROW {
+  _LIBSTDAUDIO_NAMESPACE::audio_realtime_check("aligned_alloc");
+  return __libc_memalign(alignment, size);
+}
+
+extern "C" void free(void* pointer) __THROW {
+  if (pointer != nullptr)
+    _LIBSTDAUDIO_NAMESPACE::audio_realtime_check("free");
+
+  __libc_free(pointer);
+}
+#endif // _LIBSTDAUDIO_SANITIZER_RUNTIME_OWNS_MALLOC
+
+_LIBSTDAUDIO_INTERPOSE(int, pthread_mutex_lock, (pthread_mutex_t* mutex), (mutex))
+_LIBSTDAUDIO_INTERPOSE(int, pthread_cond_wait, (pthread_cond_t* condition, pthread_mutex_t* mutex), (condition, mutex))
+_LIBSTDAUDIO_INTERPOSE(int, pthread_cond_timedwait, (pthread_cond_t* condition, pthread_mutex_t* mutex, const struct timespec* time), (condition, mutex, time))
+_LIBSTDAUDIO_INTERPOSE(int, pthread_rwlock_rdlock, (pthread_rwlock_t* lock), (lock))
+_LIBSTDAUDIO_INTERPOSE(int, pthread_rwlock_wrlock, (pthread_rwlock_t* lock), (lock))
+_LIBSTDAUDIO_INTERPOSE(int, pthread_join, (pthread_t thread, void** result), (thread, result))
+_LIBSTDAUDIO_INTERPOSE(int, nanosleep, (const struct timespec* duration, struct timespec* remaining), (duration, remaining))
+_LIBSTDAUDIO_INTERPOSE(int, clock_nanosleep, (clockid_t clock, int flags, const struct timespec* time, struct timespec* remaining), (clock, flags, time, remaining))
+_LIBSTDAUDIO_INTERPOSE(int, usleep, (useconds_t duration), (duration))
+_LIBSTDAUDIO_INTERPOSE(unsigned, sleep, (unsigned seconds), (seconds))
+_LIBSTDAUDIO_INTERPOSE(ssize_t, read, (int file, void* data, size_t size), (file, data, size))
+_LIBSTDAUDIO_INTERPOSE(ssize_t, write, (int file, const void* data, size_t size), (file, data, size))
+_LIBSTDAUDIO_INTERPOSE(int, close, (int file), (file))
+_LIBSTDAUDIO_INTERPOSE(int, fsync, (int file), (file))
+_LIBSTDAUDIO_INTERPOSE(FILE*, fopen, (const char* path, const char* mode), (path, mode))
+
+#undef _LIBSTDAUDIO_INTERPOSE
+
+#endif // __linux__
+
+#endif // LIBSTDAUDIO_REALTIME_SANITIZER_IMPLEMENTATION
@@ -0,0 +1,297 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <cassert>
+#include <cmath>
+#include <numeric>
+#include <type_traits>
+#include <vector>
+#include <__audio_simd.h>
+
+_LIBSTDAUDIO_NAMESPACE_BEGIN
+
+enum class audio_resampler_quality {
+  low,
+  medium,
+  high,
+};
+
+enum class audio_resampler_mode {
+  // Exact polyphase conversion between two integer sample rates.
+  fixed_ratio,
+  // Interpolates between filter phases, so the ratio can be changed while running
+  // (e.g. to compensate for clock drift).
+  variable_ratio,
+};
+
+struct audio_resampler_result {
+  size_t input_frames = 0;
+  size_t output_frames = 0;
+};
+
+// Streaming windowed-sinc sample rate converter. process() consumes as much of the
+// input and fills as much of the output as it can, keeping the filter history between
+// calls, so the input and output may be split into blocks of any size. All memory is
+// allocated in the constructor.
+template <typename _SampleType = float>
+class audio_resampler {
+public:
+  static_assert(is_floating_point_v<_SampleType>, "audio_resampler requires a floating-point sample type");
+
+  using sample_type = _SampleType;
+  using index_type = typename audio_buffer<_SampleType>::index_type;
+
+  audio_resampler(double input_sample_rate,
+                  double output_sample_rate,
+                  index_type num_channels,
+                  audio_resampler_quality quality = audio_resampler_quality::medium,
+                  audio_resampler_mode mode = audio_resampler_mode::fixed_ratio)
+    : _num_channels(num_channels),
+      _mode(mode),
+      _ratio(output_sample_rate / input_sample_rate) {
+    assert(input_sample_rate > 0 && output_sample_rate > 0);
+
+    const auto params = _get_quality_params(quality);
+    _num_taps = params.num_taps;
+
+    if (mode == audio_resampler_mode::fixed_ratio) {
+      const auto input_rate = llround(input_sample_rate);
+      const auto output_rate = llround(output_sample_rate);
+      assert(double(input_rate) == input_sample_rate && double(output_rate) == output_sample_rate);
+
+      const auto divisor = gcd(input_rate, output_rate);
+      _num_phases = index_type(output_rate / divisor);
+      _phase_step = index_type(input_rate / divisor);
+
+      // An exact table for ratios like 44100:48001 would be huge; interpolate instead.
+      _interpolate = _num_phases > _max_fixed_phases;
+    }
+    else {
+      _interpolate = true;
+    }
+
+    if (_interpolate) {
+      _num_phases = _num_interpolated_phases;
+      _step = 1.0 / _ratio;
+    }
+
+    _init_filter_table(params);
+    _history.resize(2 * _num_taps * _num_channels);
+    reset();
+  }
+
+  index_type num_channels() const noexcept {
+    return _num_channels;
+  }
+
+  audio_resampler_mode mode() const noexcept {
+    return _mode;
+  }
+
+  // The ratio of output frames to input frames.
+  double get_ratio() const noexcept {
+    return _ratio;
+  }
+
+  // Only available in variable_ratio mode; the anti-aliasing filter stays tuned to the
+  // ratio passed to the constructor, so this is meant for small corrections.
+  void set_ratio(double ratio) noexcept {
+    assert(_mode == audio_resampler_mode::variable_ratio);
+    assert(ratio > 0);
+    _ratio = ratio;
+    _step = 1.0 / ratio;
+  }
+
+  // Group delay of the filter, in input frames.
+  index_type latency_frames() const noexcept {
+    return _num_taps / 2;
+  }
+
+  void reset() noexcept {
+    fill(_history.begin(), _history.end(), _SampleType{});
+    _write_pos = 0;
+    _phase = _num_phases;
+    _position = 1.0;
+  }
+
+  audio_resampler_result process(const audio_buffer<_SampleType>& input, audio_buffer<_SampleType>& output) noexcept {
+    assert(input.size_channels() == _num_channels);
+    assert(output.size_channels() == _num_channels);
+
+    const index_type num_input_frames = input.size_frames();
+    const index_type num_output_frames = output.size_frames();
+    index_type input_pos = 0;
+    index_type output_pos = 0;
+
+    for (;;) {
+      if (_interpolate) {
+        for (; _position < 1.0; _position += _step) {
+          if (output_pos == num_output_frames)
+            return {input_pos, output_pos};
+
+          _render_interpolated_frame(output, output_pos++);
+        }
+      }
+      else {
+        for (; _phase < _num_phases; _phase += _phase_step) {
+          if (output_pos == num_output_frames)
+            return {input_pos, output_pos};
+
+          _render_frame(output, output_pos++);
+        }
+      }
+
+      if (input_pos == num_input_frames)
+        return {input_pos, output_pos};
+
+      _push_frame(input, input_pos++);
+
+      if (_interpolate)
+        _position -= 1.0;
+      else
+        _phase -= _num_phases;
+    }
+  }
+
+private:
+  struct _quality_params {
+    index_type num_taps;
+    double kaiser_beta;
+    double passband;
+  };
+
+  static _quality_params _get_quality_params(audio_resampler_quality quality) noexcept {
+    switch (quality) {
+      case audio_resampler_quality::low:
+        return {16, 5.0, 0.80};
+      case audio_resampler_quality::high:
+        return {64, 9.5, 0.94};
+      case audio_resampler_quality::medium:
+      default:
+        return {32, 7.0, 0.90};
+    }
+  }
+
+  // Row p of the table holds the filter for an output located p / _num_phases input
+  // frames after the centre of the history window. The interpolated table has one
+  // extra row so that rows p and p + 1 always exist.
+  void _init_filter_table(const _quality_params& params) {
+    const index_type num_rows = _interpolate ? _num_phases + 1 : _num_phases;
+    const double cutoff = params.passband * min(1.0, _ratio);
+    const double half_length = double(_num_taps) / 2.0;
+
+    _table.resize(num_rows * _num_taps);
+    for (index_type row = 0; row < num_rows; ++row) {
+      const double offset = double(row) / double(_num_phases);
+      double sum = 0;
+
+      for (index_type tap = 0; tap < _num_taps; ++tap) {
+        const double x = half_length - 1.0 + offset - double(tap);
+        const double value = cutoff * _sinc(cutoff * x) * _kaiser(x / half_length, params.kaiser_beta);
+        _table[row * _num_taps + tap] = _SampleType(value);
+        sum += value;
+      }
+
+      for (index_type tap = 0; tap < _num_taps; ++tap)
+        _table[row * _num_taps + tap] = _SampleType(_table[row * _num_taps + tap] / sum);
+    }
+
+    if (_interpolate) {
+      _table_diff.resize(_num_phases * _num_taps);
+      for (index_type i = 0; i < _table_diff.size(); ++i)
+        _table_diff[i] = _table[i + _num_taps] - _table[i];
+    }
+  }
+
+  static double _sinc(double x) noexcept {
+    if (x == 0)
+      return 1.0;
+
+    return sin(_pi * x) / (_pi * x);
+  }
+
+  static double _kaiser(double x, double beta) noexcept {
+    if (abs(x) >= 1.0)
+      return 0.0;
+
+    return _bessel_i0(beta * sqrt(1.0 - x * x)) / _bessel_i0(beta);
+  }
+
+  static double _bessel_i0(double x) noexcept {
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 50 && term > 1e-12 * sum; ++k) {
+      term *= (x / (2.0 * k)) * (x / (2.0 * k));
+      sum += term;
+    }
+
+    return sum;
+  }
+
+  void _push_frame(const audio_buffer<_SampleType>& input, index_type frame) noexcept {
+    // Every sample is written twice, so that the most recent _num_taps samples of a
+    // channel are always contiguous in memory, starting at _window(channel).
+    for (index_type channel = 0; channel < _num_channels; ++channel) {
+      _SampleType* history = _history.data() + channel * 2 * _num_taps;
+      history[_write_pos] = history[_write_pos + _num_taps] = input(frame, channel);
+    }
+
+    if (++_write_pos == _num_taps)
+      _write_pos = 0;
+  }
+
+  const _SampleType* _window(index_type channel) const noexcept {
+    return _history.data() + channel * 2 * _num_taps + _write_pos;
+  }
+
+  void _render_frame(audio_buffer<_SampleType>& output, index_type frame) noexcept {
+    const _SampleType* coefficients = _table.data() + _phase * _num_taps;
+
+    for (index_type channel = 0; channel < _num_channels; ++channel)
+      output(frame, channel) = __simd_dot(_window(channel), coefficients, _num_taps);
+  }
+
+  void _render_interpolated_frame(audio_buffer<_SampleType>& output, index_type frame) noexcept {
+    const double x = _position * double(_num_phases);
+    const auto row = min(index_type(x), _num_phases - 1);
+    const auto fraction = _SampleType(x - double(row));
+    const _SampleType* coefficients = _table.data() + row * _num_taps;
+    const _SampleType* differences = _table_diff.data() + row * _num_taps;
+
+    for (index_type channel = 0; channel < _num_channels; ++channel) {
+      const _SampleType* window = _window(channel);
+      output(frame, channel) = __simd_dot(window, coefficients, _num_taps)
+                             + fraction * __simd_dot(window, differences, _num_taps);
+    }
+  }
+
+  static constexpr double _pi = 3.14159265358979323846;
+  static constexpr index_type _max_fixed_phases = 1024;
+  static constexpr index_type _num_interpolated_phases = 256;
+
+  index_type _num_channels = 0;
+  audio_resampler_mode _mode;
+  double _ratio = 1.0;
+  bool _interpolate = false;
+
+  index_type _num_taps = 0;
+  index_type _num_phases = 0;
+  vector<_SampleType> _table;
+  vector<_SampleType> _table_diff;
+  vector<_SampleType> _history;
+  index_type _write_pos = 0;
+
+  // fixed_ratio state: the current phase advances by _phase_step per output frame
+  // and wraps by _num_phases per input frame.
+  index_type _phase = 0;
+  index_type _phase_step = 0;
+
+  // variable_ratio state, in input frames.
+  double _position = 0;
+  double _step = 1.0;
+};
+
+_LIBSTDAUDIO_NAMESPACE_END
@@ -0,0 +1,575 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#if defined(__linux__)
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <__audio_worker_pool.h>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+_LIBSTDAUDIO_NAMESPACE_BEGIN
+
+enum class audio_shared_memory_role {
+  producer,
+  consumer,
+};
+
+// The beginning of a shared memory region. It is followed by num_periods slots of
+// slot_size_bytes each, every one holding the time at which the producer rendered
+// it and then buffer_size_frames interleaved float frames.
+//
+// write_count and read_count are the numbers of periods the producer has written
+// and the consumer has read, modulo the largest multiple of num_periods that fits
+// 32 bits, so that a counter modulo num_periods is always its next slot, across the
+// wrap too, and a side reopened after a crash finds its slot in its counter alone.
+// Each side sleeps on the other side's counter with a futex, after announcing this
+// in its waiting flag, so that the other side only needs to make a system call when
+// somebody is actually asleep.
+struct __audio_shared_memory_header {
+  static constexpr uint32_t magic_value = 0x4d535341; // "ASSM"
+  static constexpr uint32_t current_version = 2;
+  static constexpr size_t max_name_length = 63;
+  static constexpr uint32_t max_num_channels = uint32_t(audio_buffer<float>::max_num_channels);
+
+  uint32_t magic;
+  uint32_t version;
+  uint32_t num_channels;
+  uint32_t sample_rate;
+  uint32_t buffer_size_frames;
+  uint32_t num_periods;
+  uint64_t slot_size_bytes;
+  char name[max_name_length + 1];
+
+  alignas(64) atomic<uint32_t> write_count;
+  atomic<uint32_t> consumer_waiting;
+
+  alignas(64) atomic<uint32_t> read_count;
+  atomic<uint32_t> producer_waiting;
+
+  // Where write_count and read_count wrap around.
+  uint64_t count_modulus() const noexcept {
+    return (uint64_t(1) << 32) / num_periods * num_periods;
+  }
+};
+
+static_assert(atomic<uint32_t>::is_always_lock_free, "futexes need plain 32-bit atomics");
+static_assert(sizeof(atomic<uint32_t>) == sizeof(uint32_t));
+
+// One side of an audio connection between two processes through a ring of periods
+// in shared memory. The producer is an output device and the consumer an input
+// device; the audio_buffer each of them gets in its callback points straight into
+// the shared ring, so nothing is copied between the processes.
+//
+// A region is created with create_audio_shared_memory_device(), which makes an
+// anonymous memfd, and the other process attaches with open_audio_shared_memory_device()
+// to that file descriptor, inherited across fork() or passed over a Unix domain socket.
+// There must be at most one producer and one consumer at a time; either side may
+// be closed and reopened, for example after its process crashed, and picks up
+// where the ring stands.
+//
+// Neither side has a clock of its own: the producer runs whenever there is a free
+// slot and the consumer whenever there is a full one, so the pair runs at the pace
+// of whatever drives one of its ends, typically a hardware device whose callback
+// calls process() on the other. Both connect() (with a thread of its own that sleeps
+// on a futex) and wait()/process() are supported.
+//
+// This is a class of its own rather than another kind of audio_device: audio_device is
+// the one device type of the platform backend and has no virtual interface to plug a
+// second implementation into. It has the same interface instead, so generic code such
+// as audio_aggregate_device<float, audio_shared_memory_device> can use it, though an
+// aggregate cannot mix it with the backend's devices.
+class audio_shared_memory_device {
+public:
+  audio_shared_memory_device() = delete;
+  audio_shared_memory_device(const audio_shared_memory_device&) = delete;
+  audio_shared_memory_device& operator=(const audio_shared_memory_device&) = delete;
+
+  // Devices can only be moved while they are stopped.
+  audio_shared_memory_device(audio_shared_memory_device&& other) noexcept
+    : _fd(exchange(other._fd, -1)),
+      _header(exchange(other._header, nullptr)),
+      _mapping_size(exchange(other._mapping_size, 0)),
+      _role(other._role),
+      _flush_denormals(other._flush_denormals),
+      _user_callback(move(other._user_callback)),
+      _clock_estimator(move(other._clock_estimator)) {
+    assert(!other._running);
+  }
+
+  audio_shared_memory_device& operator=(audio_shared_memory_device&& other) noexcept {
+    if (this != &other) {
+      assert(!other._running);
+      stop();
+      _close();
+      _fd = exchange(other._fd, -1);
+      _header = exchange(other._header, nullptr);
+      _mapping_size = exchange(other._mapping_size, 0);
+      _role = other._role;
+      _flush_denormals = other._flush_denormals;
+      _user_callback = move(other._user_callback);
+      _clock_estimator = move(other._clock_estimator);
+    }
+
+    return *this;
+  }
+
+  ~audio_shared_memory_device() {
+    stop();
+    _close();
+  }
+
+  string_view name() const noexcept {
+    return _header->name;
+  }
+
+  // The inode of the shared memory region, which is the same on both sides.
+  using device_id_t = unsigned long;
+
+  device_id_t device_id() const noexcept {
+    struct stat status = {};
+    fstat(_fd, &status);
+    return device_id_t(status.st_ino);
+  }
+
+  audio_shared_memory_role role() const noexcept {
+    return _role;
+  }
+
+  bool is_input() const noexcept {
+    return _role == audio_shared_memory_role::consumer;
+  }
+
+  bool is_output() const noexcept {
+    return _role == audio_shared_memory_role::producer;
+  }
+
+  int get_num_input_channels() const noexcept {
+    return is_input() ? int(_header->num_channels) : 0;
+  }
+
+  int get_num_output_channels() const noexcept {
+    return is_output() ? int(_header->num_channels) : 0;
+  }
+
+  using sample_rate_t = unsigned;
+
+  sample_rate_t get_sample_rate() const noexcept {
+    return _header->sample_rate;
+  }
+
+  // The format is fixed when the region is created.
+  bool set_sample_rate(sample_rate_t new_sample_rate) noexcept {
+    return new_sample_rate == get_sample_rate();
+  }
+
+  using buffer_size_t = unsigned;
+
+  buffer_size_t get_buffer_size_frames() const noexcept {
+    return _header->buffer_size_frames;
+  }
+
+  bool set_buffer_size_frames(buffer_size_t new_buffer_size) noexcept {
+    return new_buffer_size == get_buffer_size_frames();
+  }
+
+  size_t get_num_periods() const noexcept {
+    return _header->num_periods;
+  }
+
+  // Number of periods the producer has written and the consumer not yet read.
+  size_t get_num_queued_periods() const noexcept {
+    return _num_queued_periods();
+  }
+
+  // Besides the period being processed, up to num_periods - 1 more can be queued
+  // in the ring between the two sides.
+  optional<audio_latency> get_input_latency() const noexcept {
+    if (!is_input())
+      return nullopt;
+
+    return _get_latency();
+  }
+
+  optional<audio_latency> get_output_latency() const noexcept {
+    if (!is_output())
+      return nullopt;
+
+    return _get_latency();
+  }
+
+  // Whether callbacks run with flush-to-zero and denormals-are-zero enabled. Can only
+  // be changed while the device is stopped.
+  bool set_flush_denormals(bool enabled) noexcept {
+    if (_running)
+      return false;
+
+    _flush_denormals = enabled;
+    return true;
+  }
+
+  bool get_flush_denormals() const noexcept {
+    return _flush_denormals;
+  }
+
+  template <typename _SampleType>
+  constexpr bool supports_sample_type() const noexcept {
+    return is_same_v<_SampleType, float>;
+  }
+
+  constexpr bool can_connect() const noexcept {
+    return true;
+  }
+
+  constexpr bool can_process() const noexcept {
+    return true;
+  }
+
+  template <typename _CallbackType,
+            typename = enable_if_t<is_nothrow_invocable_v<_CallbackType, audio_shared_memory_device&, audio_device_io<float>&>>>
+  void connect(_CallbackType callback) {
+    assert(!_running);
+    _user_callback = move(callback);
+  }
+
+  // With a connected callback, starts a thread that calls it whenever there is a
+  // period to process. Without one, wait() and process() are to be used instead.
+  bool start() {
+    if (_running)
+      return true;
+
+    _clock_estimator->set_nominal_sample_rate(get_sample_rate());
+    _running = true;
+
+    if (_user_callback) {
+      _thread = thread([this] {
+        __audio_set_realtime_thread_priority();
+
+        while (_running.load(memory_order_relaxed)) {
+          if (_wait_for_io(_thread_wait_timeout))
+            process(_user_callback);
+        }
+      });
+    }
+
+    return true;
+  }
+
+  bool stop() {
+    if (!_running)
+      return true;
+
+    _running = false;
+    if (_thread.joinable()) {
+      _futex_wake(_wait_counter());
+      _thread.join();
+    }
+
+    return true;
+  }
+
+  bool is_running() const noexcept {
+    return _running;
+  }
+
+  // Blocks until there is a period to process or the device is stopped.
+  void wait() const {
+    while (_running.load(memory_order_relaxed) && !_wait_for_io(_thread_wait_timeout))
+      ;
+  }
+
+  // Processes one period if there is one: the producer fills the next free slot
+  // of the ring and the consumer reads the next full one.
+  template <typename _CallbackType,
+            typename = enable_if_t<is_invocable_v<_CallbackType, audio_shared_memory_device&, audio_device_io<float>&>>>
+  void process(_CallbackType& callback) {
+    if (!has_unprocessed_io())
+      return;
+
+    auto& header = *_header;
+    const size_t num_frames = header.buffer_size_frames;
+    audio_device_io<float> io;
+
+    if (is_output()) {
+      const uint32_t count = header.write_count.load(memory_order_relaxed);
+      const uint32_t slot = count % header.num_periods;
+      const auto time = audio_clock_t::now();
+      _slot_time(slot) = time.time_since_epoch().count();
+      io.output_buffer = audio_buffer<float>(_slot_data(slot), num_frames, header.num_channels, contiguous_interleaved);
+      io.output_time = time;
+
+      _run_callback(callback, io);
+      _clock_estimator->update(time, num_frames);
+
+      header.write_count.store(_next_count(count), memory_order_seq_cst);
+      if (header.consumer_waiting.load(memory_order_seq_cst) != 0)
+        _futex_wake(header.write_count);
+    }
+    else {
+      const uint32_t count = header.read_count.load(memory_order_relaxed);
+      const uint32_t slot = count % header.num_periods;
+      const auto time = audio_clock_t::time_point(audio_clock_t::duration(_slot_time(slot)));
+      io.input_buffer = audio_buffer<float>(_slot_data(slot), num_frames, header.num_channels, contiguous_interleaved);
+      io.input_time = time;
+
+      _run_callback(callback, io);
+      _clock_estimator->update(time, num_frames);
+
+      header.read_count.store(_next_count(count), memory_order_seq_cst);
+      if (header.producer_waiting.load(memory_order_seq_cst) != 0)
+        _futex_wake(header.read_count);
+    }
+  }
+
+  bool has_unprocessed_io() const noexcept {
+    const size_t queued = _num_queued_periods();
+    return is_output() ? queued < _header->num_periods : queued > 0;
+  }
+
+  audio_clock_estimate get_clock_estimate() noexcept {
+    return _clock_estimator->get_estimate();
+  }
+
+  // The file descriptor of the shared memory region, to hand to the other process.
+  int native_handle() const noexcept {
+    return _fd;
+  }
+
+private:
+  friend optional<audio_shared_memory_device> create_audio_shared_memory_device(
+    audio_shared_memory_role, string_view, unsigned, unsigned, unsigned, unsigned);
+  friend optional<audio_shared_memory_device> open_audio_shared_memory_device(int, audio_shared_memory_role);
+
+  static constexpr size_t _slot_alignment = 64;
+  static constexpr int _spin_iterations = 256;
+  static constexpr chrono::milliseconds _thread_wait_timeout{50};
+
+  audio_shared_memory_device(int fd, __audio_shared_memory_header* header, size_t mapping_size,
+                             audio_shared_memory_role role)
+    : _fd(fd),
+      _header(header),
+      _mapping_size(mapping_size),
+      _role(role),
+      _clock_estimator(make_unique<audio_clock_estimator>()) {
+  }
+
+  static size_t _header_size() noexcept {
+    return (sizeof(__audio_shared_memory_header) + _slot_alignment - 1) / _slot_alignment * _slot_alignment;
+  }
+
+  static size_t _slot_size(size_t num_channels, size_t buffer_size_frames) noexcept {
+    const size_t size = _slot_alignment + num_channels * buffer_size_frames * sizeof(float);
+    return (size + _slot_alignment - 1) / _slot_alignment * _slot_alignment;
+  }
+
+  byte* _slot(uint32_t slot) const noexcept {
+    return reinterpret_cast<byte*>(_header) + _header_size() + size_t(slot) * _header->slot_size_bytes;
+  }
+
+  int64_t& _slot_time(uint32_t slot) const noexcept {
+    return *reinterpret_cast<int64_t*>(_slot(slot));
+  }
+
+  float* _slot_data(uint32_t slot) const noexcept {
+    return reinterpret_cast<float*>(_slot(slot) + _slot_alignment);
+  }
+
+  uint32_t _next_count(uint32_t count) const noexcept {
+    return uint32_t((uint64_t(count) + 1) % _header->count_modulus());
+  }
+
+  size_t _num_queued_periods() const noexcept {
+    const uint64_t modulus = _header->count_modulus();
+    const uint64_t write_count = _header->write_count.load(memory_order_acquire);
+    const uint64_t read_count = _header->read_count.load(memory_order_acquire);
+    return size_t((write_count + modulus - read_count) % modulus);
+  }
+
+  // As in the device backends, whether the callback runs on our thread or the caller's.
+  template <typename _CallbackType>
+  void _run_callback(_CallbackType& callback, audio_device_io<float>& io) {
+    audio_denormal_guard denormals(_flush_denormals);
+    audio_realtime_scope realtime;
+    invoke(callback, *this, io);
+  }
+
+  // The counter the other side advances, which this side sleeps on.
+  atomic<uint32_t>& _wait_counter() const noexcept {
+    return is_output() ? _header->read_count : _header->write_count;
+  }
+
+  atomic<uint32_t>& _waiting_flag() const noexcept {
+    return is_output() ? _header->producer_waiting : _header->consumer_waiting;
+  }
+
+  // Returns whether there is a period to process, after spinning briefly and then
+  // sleeping for at most the given time.
+  bool _wait_for_io(chrono::nanoseconds timeout) const noexcept {
+    for (int i = 0; i < _spin_iterations; ++i) {
+      if (has_unprocessed_io())
+        return true;
+
+      __audio_cpu_pause();
+    }
+
+    auto& counter = _wait_counter();
+    auto& waiting = _waiting_flag();
+
+    // Announce the sleep before looking at the counter one last time; a side that
+    // advances the counter after that sees the flag and wakes us.
+    waiting.fetch_add(1, memory_order_seq_cst);
+    const uint32_t observed = counter.load(memory_order_seq_cst);
+    if (!has_unprocessed_io()) {
+      const auto seconds = chrono::duration_cast<chrono::seconds>(timeout);
+      timespec relative_timeout = {};
+      relative_timeout.tv_sec = time_t(seconds.count());
+      relative_timeout.tv_nsec = long((timeout - seconds).count());
+      syscall(SYS_futex, reinterpret_cast<uint32_t*>(&counter), FUTEX_WAIT, observed, &relative_timeout, nullptr, 0);
+    }
+    waiting.fetch_sub(1, memory_order_seq_cst);
+
+    return has_unprocessed_io();
+  }
+
+  static void _futex_wake(atomic<uint32_t>& counter) noexcept {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&counter), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+  }
+
+  audio_latency _get_latency() const noexcept {
+    audio_latency latency;
+    latency.safety_offset_frames = size_t(_header->num_periods - 1) * _header->buffer_size_frames;
+    latency.buffer_frames = _header->buffer_size_frames;
+    latency.sample_rate = _header->sample_rate;
+    return latency;
+  }
+
+  void _close() noexcept {
+    if (_header != nullptr)
+      munmap(_header, _mapping_size);
+    if (_fd >= 0)
+      ::close(_fd);
+
+    _header = nullptr;
+    _fd = -1;
+  }
+
+  static optional<audio_shared_memory_device> _map(int fd, audio_shared_memory_role role) {
+    struct stat status = {};
+    if (fstat(fd, &status) != 0 || size_t(status.st_size) < _header_size()) {
+      ::close(fd);
+      return nullopt;
+    }
+
+    const size_t size = size_t(status.st_size);
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    if (data == MAP_FAILED) {
+      ::close(fd);
+      return nullopt;
+    }
+
+    // Best effort: keeps the audio callbacks from faulting the ring back in.
+    mlock(data, size);
+    return audio_shared_memory_device(fd, static_cast<__audio_shared_memory_header*>(data), size, role);
+  }
+
+  int _fd = -1;
+  __audio_shared_memory_header* _header = nullptr;
+  size_t _mapping_size = 0;
+  audio_shared_memory_role _role;
+  atomic<bool> _running = false;
+  bool _flush_denormals = false;
+  function<void(audio_shared_memory_device&, audio_device_io<float>&)> _user_callback;
+  unique_ptr<audio_clock_estimator> _clock_estimator;
+  thread _thread;
+};
+
+// Creates a shared memory region for num_periods periods of buffer_size_frames
+// frames and returns the given side of it. Pass its native_handle() to the other
+// process to open the other side.
+inline optional<audio_shared_memory_device> create_audio_shared_memory_device(
+  audio_shared_memory_role role, string_view name, unsigned num_channels, unsigned sample_rate,
+  unsigned buffer_size_frames, unsigned num_periods = 3) {
+  if (num_channels == 0 || num_channels > __audio_shared_memory_header::max_num_channels
+      || sample_rate == 0 || buffer_size_frames == 0 || num_periods < 2)
+    return nullopt;
+
+  const string fd_name = "libstdaudio " + string(name.substr(0, __audio_shared_memory_header::max_name_length));
+  const int fd = memfd_create(fd_name.c_str(), MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (fd < 0)
+    return nullopt;
+
+  const size_t slot_size = audio_shared_memory_device::_slot_size(num_channels, buffer_size_frames);
+  const size_t size = audio_shared_memory_device::_header_size() + slot_size * num_periods;
+
+  // Sealing the size keeps the other process from truncating the region under our mapping.
+  if (ftruncate(fd, off_t(size)) != 0 || fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) != 0) {
+    ::close(fd);
+    return nullopt;
+  }
+
+  auto device = audio_shared_memory_device::_map(fd, role);
+  if (!device)
+    return nullopt;
+
+  auto& header = *new (device->_header) __audio_shared_memory_header{};
+  header.version = __audio_shared_memory_header::current_version;
+  header.num_channels = num_channels;
+  header.sample_rate = sample_rate;
+  header.buffer_size_frames = buffer_size_frames;
+  header.num_periods = num_periods;
+  header.slot_size_bytes = slot_size;
+  name.substr(0, __audio_shared_memory_header::max_name_length).copy(header.name, __audio_shared_memory_header::max_name_length);
+  header.magic = __audio_shared_memory_header::magic_value;
+  return device;
+}
+
+// Opens the given side of a shared memory region created by another device. The
+// file descriptor is duplicated, so the caller keeps ownership of it. Handing the
+// descriptor over orders the creator's initialisation of the region before this.
+inline optional<audio_shared_memory_device> open_audio_shared_memory_device(int fd, audio_shared_memory_role role) {
+  const int own_fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+  if (own_fd < 0)
+    return nullopt;
+
+  auto device = audio_shared_memory_device::_map(own_fd, role);
+  if (!device)
+    return nullopt;
+
+  const auto& header = *device->_header;
+  if (header.magic != __audio_shared_memory_header::magic_value
+      || header.version != __audio_shared_memory_header::current_version
+      || header.num_channels == 0 || header.num_channels > __audio_shared_memory_header::max_num_channels
+      || header.buffer_size_frames == 0 || header.num_periods < 2
+      || header.write_count.load() >= header.count_modulus() || header.read_count.load() >= header.count_modulus()
+      || header.slot_size_bytes < audio_shared_memory_device::_slot_size(header.num_channels, header.buffer_size_frames)
+      || device->_mapping_size < audio_shared_memory_device::_header_size() + header.slot_size_bytes * header.num_periods)
+    return nullopt;
+
+  return device;
+}
+
+_LIBSTDAUDIO_NAMESPACE_END
+
+#endif // __linux__
@@ -0,0 +1,383 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <vector>
+
+#if defined(__AVX2__) && defined(__FMA__)
+  #include <immintrin.h>
+  #define _LIBSTDAUDIO_SIMD_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #include <emmintrin.h>
+  #define _LIBSTDAUDIO_SIMD_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  #include <arm_neon.h>
+  #define _LIBSTDAUDIO_SIMD_NEON
+#endif
+
+_LIBSTDAUDIO_NAMESPACE_BEGIN
+
+// A pack of floats in the widest SIMD register the target is compiled for:
+// AVX2 (with FMA) if enabled via compiler flags, otherwise SSE2 on x86, NEON on
+// AArch64 and a plain float everywhere else. Kernels are written once against this
+// type, with a scalar loop for the remainder that does not fill a whole pack.
+struct __simd_float {
+#if defined(_LIBSTDAUDIO_SIMD_AVX2)
+  static constexpr size_t width = 8;
+  __m256 value;
+
+  static __simd_float load(const float* p) noexcept { return {_mm256_loadu_ps(p)}; }
+  static __simd_float broadcast(float x) noexcept { return {_mm256_set1_ps(x)}; }
+  void store(float* p) const noexcept { _mm256_storeu_ps(p, value); }
+
+  friend __simd_float operator+(__simd_float a, __simd_float b) noexcept { return {_mm256_add_ps(a.value, b.value)}; }
+  friend __simd_float operator-(__simd_float a, __simd_float b) noexcept { return {_mm256_sub_ps(a.value, b.value)}; }
+  friend __simd_float operator*(__simd_float a, __simd_float b) noexcept { return {_mm256_mul_ps(a.value, b.value)}; }
+
+  // a * b + c
+  friend __simd_float fma(__simd_float a, __simd_float b, __simd_float c) noexcept { return {_mm256_fmadd_ps(a.value, b.value, c.value)}; }
+
+  friend __simd_float min(__simd_float a, __simd_float b) noexcept { return {_mm256_min_ps(a.value, b.value)}; }
+  friend __simd_float max(__simd_float a, __simd_float b) noexcept { return {_mm256_max_ps(a.value, b.value)}; }
+  friend __simd_float floor(__simd_float a) noexcept { return {_mm256_floor_ps(a.value)}; }
+  friend __simd_float sqrt(__simd_float a) noexcept { return {_mm256_sqrt_ps(a.value)}; }
+
+  // {x, lane 0, ..., lane width - 2}
+  __simd_float shift_in(float x) const noexcept {
+    const __m256 shifted = _mm256_permutevar8x32_ps(value, _mm256_setr_epi32(0, 0, 1, 2, 3, 4, 5, 6));
+    return {_mm256_blend_ps(shifted, _mm256_set1_ps(x), 1)};
+  }
+
+  float last() const noexcept { return _mm256_cvtss_f32(_mm256_permutevar8x32_ps(value, _mm256_set1_epi32(7))); }
+
+  float sum() const noexcept {
+    __m128 x = _mm_add_ps(_mm256_castps256_ps128(value), _mm256_extractf128_ps(value, 1));
+    x = _mm_add_ps(x, _mm_movehl_ps(x, x));
+    x = _mm_add_ss(x, _mm_shuffle_ps(x, x, 1));
+    return _mm_cvtss_f32(x);
+  }
+#elif defined(_LIBSTDAUDIO_SIMD_SSE2)
+  static constexpr size_t width = 4;
+  __m128 value;
+
+  static __simd_float load(const float* p) noexcept { return {_mm_loadu_ps(p)}; }
+  static __simd_float broadcast(float x) noexcept { return {_mm_set1_ps(x)}; }
+  void store(float* p) const noexcept { _mm_storeu_ps(p, value); }
+
+  friend __simd_float operator+(__simd_float a, __simd_float b) noexcept { return {_mm_add_ps(a.value, b.value)}; }
+  friend __simd_float operator-(__simd_float a, __simd_float b) noexcept { return {_mm_sub_ps(a.value, b.value)}; }
+  friend __simd_float operator*(__simd_float a, __simd_float b) noexcept { return {_mm_mul_ps(a.value, b.value)}; }
+  friend __simd_float fma(__simd_float a, __simd_float b, __simd_float c) noexcept { return {_mm_add_ps(_mm_mul_ps(a.value, b.value), c.value)}; }
+
+  friend __simd_float min(__simd_float a, __simd_float b) noexcept { return {_mm_min_ps(a.value, b.value)}; }
+  friend __simd_float max(__simd_float a, __simd_float b) noexcept { return {_mm_max_ps(a.value, b.value)}; }
+
+  // SSE2 has no rounding instruction: truncate, then step down where that rounded up.
+  // Only valid for |a| < 2^31.
+  friend __simd_float floor(__simd_float a) noexcept {
+    const __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(a.value));
+    return {_mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, a.value), _mm_set1_ps(1.0f)))};
+  }
+
+  friend __simd_float sqrt(__simd_float a) noexcept { return {_mm_sqrt_ps(a.value)}; }
+
+  __simd_float shift_in(float x) const noexcept {
+    const __m128 shifted = _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(value), 4));
+    return {_mm_move_ss(shifted, _mm_set_ss(x))};
+  }
+
+  float last() const noexcept { return _mm_cvtss_f32(_mm_shuffle_ps(value, value, _MM_SHUFFLE(3, 3, 3, 3))); }
+
+  float sum() const noexcept {
+    __m128 x = _mm_add_ps(value, _mm_movehl_ps(value, value));
+    x = _mm_add_ss(x, _mm_shuffle_ps(x, x, 1));
+    return _mm_cvtss_f32(x);
+  }
+#elif defined(_LIBSTDAUDIO_SIMD_NEON)
+  static constexpr size_t width = 4;
+  float32x4_t value;
+
+  static __simd_float load(const float* p) noexcept { return {vld1q_f32(p)}; }
+  static __simd_float broadcast(float x) noexcept { return {vdupq_n_f32(x)}; }
+  void store(float* p) const noexcept { vst1q_f32(p, value); }
+
+  friend __simd_float operator+(__simd_float a, __simd_float b) noexcept { return {vaddq_f32(a.value, b.value)}; }
+  friend __simd_float operator-(__simd_float a, __simd_float b) noexcept { return {vsubq_f32(a.value, b.value)}; }
+  friend __simd_float operator*(__simd_float a, __simd_float b) noexcept { return {vmulq_f32(a.value, b.value)}; }
+  friend __simd_float fma(__simd_float a, __simd_float b, __simd_float c) noexcept { return {vfmaq_f32(c.value, a.value, b.value)}; }
+
+  friend __simd_float min(__simd_float a, __simd_float b) noexcept { return {vminq_f32(a.value, b.value)}; }
+  friend __simd_float max(__simd_float a, __simd_float b) noexcept { return {vmaxq_f32(a.value, b.value)}; }
+  friend __simd_float floor(__simd_float a) noexcept { return {vrndmq_f32(a.value)}; }
+  friend __simd_float sqrt(__simd_float a) noexcept { return {vsqrtq_f32(a.value)}; }
+
+  __simd_float shift_in(float x) const noexcept { return {vextq_f32(vdupq_n_f32(x), value, 3)}; }
+  float last() const noexcept { return vgetq_lane_f32(value, 3); }
+
+  float sum() const noexcept {
+    return vaddvq_f32(value);
+  }
+#else
+  static constexpr size_t width = 1;
+  float value;
+
+  static __simd_float load(const float* p) noexcept { return {*p}; }
+  static __simd_float broadcast(float x) noexcept { return {x}; }
+  void store(float* p) const noexcept { *p = value; }
+
+  friend __simd_float operator+(__simd_float a, __simd_float b) noexcept { return {a.value + b.value}; }
+  friend __simd_float operator-(__simd_float a, __simd_float b) noexcept { return {a.value - b.value}; }
+  friend __simd_float operator*(__simd_float a, __simd_float b) noexcept { return {a.value * b.value}; }
+  friend __simd_float fma(__simd_float a, __simd_float b, __simd_float c) noexcept { return {a.value * b.value + c.value}; }
+
+  friend __simd_float min(__simd_float a, __simd_float b) noexcept { return {a.value < b.value ? a.value : b.value}; }
+  friend __simd_float max(__simd_float a, __simd_float b) noexcept { return {a.value > b.value ? a.value : b.value}; }
+  friend __simd_float floor(__simd_float a) noexcept { return {std::floor(a.value)}; }
+  friend __simd_float sqrt(__simd_float a) noexcept { return {std::sqrt(a.value)}; }
+
+  __simd_float shift_in(float x) const noexcept { return {x}; }
+  float last() const noexcept { return value; }
+
+  float sum() const noexcept {
+    return value;
+  }
+#endif
+};
+
+// A pack of 32-bit unsigned integers with as many lanes as __simd_float, for integer
+// work that feeds float kernels (e.g. random number generation).
+struct __simd_uint32 {
+  static constexpr size_t width = __simd_float::width;
+
+#if defined(_LIBSTDAUDIO_SIMD_AVX2)
+  __m256i value;
+
+  static __simd_uint32 load(const uint32_t* p) noexcept { return {_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p))}; }
+  void store(uint32_t* p) const noexcept { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), value); }
+
+  friend __simd_uint32 operator+(__simd_uint32 a, __simd_uint32 b) noexcept { return {_mm256_add_epi32(a.value, b.value)}; }
+  friend __simd_uint32 operator^(__simd_uint32 a, __simd_uint32 b) noexcept { return {_mm256_xor_si256(a.value, b.value)}; }
+  friend __simd_uint32 operator|(__simd_uint32 a, __simd_uint32 b) noexcept { return {_mm256_or_si256(a.value, b.value)}; }
+  template <int _Bits> __simd_uint32 shift_left() const noexcept { return {_mm256_slli_epi32(value, _Bits)}; }
+  template <int _Bits> __simd_uint32 shift_right() const noexcept { return {_mm256_srli_epi32(value, _Bits)}; }
+
+  // The lanes' bits as floats.
+  __simd_float bits_as_float() const noexcept { return {_mm256_castsi256_ps(value)}; }
+  static __simd_uint32 broadcast(uint32_t x) noexcept { return {_mm256_set1_epi32(int(x))}; }
+#elif defined(_LIBSTDAUDIO_SIMD_SSE2)
+  __m128i value;
+
+  static __simd_uint32 load(const uint32_t* p) noexcept { return {_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))}; }
+  void store(uint32_t* p) const noexcept { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), value); }
+
+  friend __simd_uint32 operator+(__simd_uint32 a, __simd_uint32 b) noexcept { return {_mm_add_epi32(a.value, b.value)}; }
+  friend __simd_uint32 operator^(__simd_uint32 a, __simd_uint32 b) noexcept { return {_mm_xor_si128(a.value, b.value)}; }
+  friend __simd_uint32 operator|(__simd_uint32 a, __simd_uint32 b) noexcept { return {_mm_or_si128(a.value, b.value)}; }
+  template <int _Bits> __simd_uint32 shift_left() const noexcept { return {_mm_slli_epi32(value, _Bits)}; }
+  template <int _Bits> __simd_uint32 shift_right() const noexcept { return {_mm_srli_epi32(value, _Bits)}; }
+
+  __simd_float bits_as_float() const noexcept { return {_mm_castsi128_ps(value)}; }
+  static __simd_uint32 broadcast(uint32_t x) noexcept { return {_mm_set1_epi32(int(x))}; }
+#elif defined(_LIBSTDAUDIO_SIMD_NEON)
+  uint32x4_t value;
+
+  static __simd_uint32 load(const uint32_t* p) noexcept { return {vld1q_u32(p)}; }
+  void store(uint32_t* p) const noexcept { vst1q_u32(p, value); }
+
+  friend __simd_uint32 operator+(__simd_uint32 a, __simd_uint32 b) noexcept { return {vaddq_u32(a.value, b.value)}; }
+  friend __simd_uint32 operator^(__simd_uint32 a, __simd_uint32 b) noexcept { return {veorq_u32(a.value, b.value)}; }
+  friend __simd_uint32 operator|(__simd_uint32 a, __simd_uint32 b) noexcept { return {vorrq_u32(a.value, b.value)}; }
+  template <int _Bits> __simd_uint32 shift_left() const noexcept { return {vshlq_n_u32(value, _Bits)}; }
+  template <int _Bits> __simd_uint32 shift_right() const noexcept { return {vshrq_n_u32(value, _Bits)}; }
+
+  __simd_float bits_as_float() const noexcept { return {vreinterpretq_f32_u32(value)}; }
+  static __simd_uint32 broadcast(uint32_t x) noexcept { return {vdupq_n_u32(x)}; }
+#else
+  uint32_t value;
+
+  static __simd_uint32 load(const uint32_t* p) noexcept { return {*p}; }
+  void store(uint32_t* p) const noexcept { *p = value; }
+
+  friend __simd_uint32 operator+(__simd_uint32 a, __simd_uint32 b) noexcept { return {a.value + b.value}; }
+  friend __simd_uint32 operator^(__simd_uint32 a, __simd_uint32 b) noexcept { return {a.value ^ b.value}; }
+  friend __simd_uint32 operator|(__simd_uint32 a, __simd_uint32 b) noexcept { return {a.value | b.value}; }
+  template <int _Bits> __simd_uint32 shift_left() const noexcept { return {value << _Bits}; }
+  template <int _Bits> __simd_uint32 shift_right() const noexcept { return {value >> _Bits}; }
+
+  __simd_float bits_as_float() const noexcept {
+    float result;
+    memcpy(&result, &value, sizeof(result));
+    return {result};
+  }
+
+  static __simd_uint32 broadcast(uint32_t x) noexcept { return {x}; }
+#endif
+
+  template <int _Bits> __simd_uint32 rotate_left() const noexcept {
+    return shift_left<_Bits>() | shift_right<32 - _Bits>();
+  }
+};
+
+// Allocator for containers that SIMD kernels stream through, so that no pack
+// straddles two cache lines.
+template <typename _Type, size_t _Alignment = 64>
+struct __simd_aligned_allocator {
+  using value_type = _Type;
+
+  template <typename _Other>
+  struct rebind {
+    using other = __simd_aligned_allocator<_Other, _Alignment>;
+  };
+
+  __simd_aligned_allocator() noexcept = default;
+
+  template <typename _Other>
+  __simd_aligned_allocator(const __simd_aligned_allocator<_Other, _Alignment>&) noexcept {}
+
+  _Type* allocate(size_t n) {
+    return static_cast<_Type*>(::operator new(n * sizeof(_Type), align_val_t(_Alignment)));
+  }
+
+  void deallocate(_Type* p, size_t) noexcept {
+    ::operator delete(p, align_val_t(_Alignment));
+  }
+
+  template <typename _Other>
+  bool operator==(const __simd_aligned_allocator<_Other, _Alignment>&) const noexcept { return true; }
+
+  template <typename _Other>
+  bool operator!=(const __simd_aligned_allocator<_Other, _Alignment>&) const noexcept { return false; }
+};
+
+template <typename _Type>
+using __simd_aligned_vector = vector<_Type, __simd_aligned_allocator<_Type>>;
+
+// Generic kernels; the float overloads are vectorised, everything else stays scalar.
+
+template <typename _SampleType>
+_SampleType __simd_dot(const _SampleType* a, const _SampleType* b, size_t n) noexcept {
+  _SampleType result = 0;
+  for (size_t i = 0; i < n; ++i)
+    result += a[i] * b[i];
+
+  return result;
+}
+
+inline float __simd_dot(const float* a, const float* b, size_t n) noexcept {
+  constexpr size_t w = __simd_float::width;
+  auto acc0 = __simd_float::broadcast(0), acc1 = __simd_float::broadcast(0);
+
+  size_t i = 0;
+  for (; i + 2 * w <= n; i += 2 * w) {
+    acc0 = fma(__simd_float::load(a + i), __simd_float::load(b + i), acc0);
+    acc1 = fma(__simd_float::load(a + i + w), __simd_float::load(b + i + w), acc1);
+  }
+
+  float result = (acc0 + acc1).sum();
+  for (; i < n; ++i)
+    result += a[i] * b[i];
+
+  return result;
+}
+
+// dst[i] += gain * src[i]
+template <typename _SampleType>
+void __simd_accumulate(_SampleType* dst, const _SampleType* src, _SampleType gain, size_t n) noexcept {
+  for (size_t i = 0; i < n; ++i)
+    dst[i] += gain * src[i];
+}
+
+inline void __simd_accumulate(float* dst, const float* src, float gain, size_t n) noexcept {
+  constexpr size_t w = __simd_float::width;
+  const auto g = __simd_float::broadcast(gain);
+
+  size_t i = 0;
+  for (; i + w <= n; i += w)
+    fma(g, __simd_float::load(src + i), __simd_float::load(dst + i)).store(dst + i);
+
+  for (; i < n; ++i)
+    dst[i] += gain * src[i];
+}
+
+// dst[i] += g(i) * src[i], with the gain moving linearly from start_gain towards end_gain,
+// which it reaches at i == n. Used to change gains without zipper noise.
+template <typename _SampleType>
+void __simd_accumulate_ramp(_SampleType* dst, const _SampleType* src, _SampleType start_gain, _SampleType end_gain, size_t n) noexcept {
+  const _SampleType step = n > 0 ? (end_gain - start_gain) / _SampleType(n) : _SampleType(0);
+  for (size_t i = 0; i < n; ++i)
+    dst[i] += (start_gain + step * _SampleType(i)) * src[i];
+}
+
+inline void __simd_accumulate_ramp(float* dst, const float* src, float start_gain, float end_gain, size_t n) noexcept {
+  if (start_gain == end_gain) {
+    __simd_accumulate(dst, src, start_gain, n);
+    return;
+  }
+
+  constexpr size_t w = __simd_float::width;
+  const float step = (end_gain - start_gain) / float(n);
+
+  float initial_gains[w];
+  for (size_t lane = 0; lane < w; ++lane)
+    initial_gains[lane] = start_gain + step * float(lane);
+
+  auto g = __simd_float::load(initial_gains);
+  const auto g_step = __simd_float::broadcast(step * float(w));
+
+  size_t i = 0;
+  for (; i + w <= n; i += w) {
+    fma(g, __simd_float::load(src + i), __simd_float::load(dst + i)).store(dst + i);
+    g = g + g_step;
+  }
+
+  for (; i < n; ++i)
+    dst[i] += (start_gain + step * float(i)) * src[i];
+}
+
+// dst[i] = gain * src[i]
+template <typename _SampleType>
+void __simd_multiply(_SampleType* dst, const _SampleType* src, _SampleType gain, size_t n) noexcept {
+  for (size_t i = 0; i < n; ++i)
+    dst[i] = gain * src[i];
+}
+
+inline void __simd_multiply(float* dst, const float* src, float gain, size_t n) noexcept {
+  constexpr size_t w = __simd_float::width;
+  const auto g = __simd_float::broadcast(gain);
+
+  size_t i = 0;
+  for (; i + w <= n; i += w)
+    (g * __simd_float::load(src + i)).store(dst + i);
+
+  for (; i < n; ++i)
+    dst[i] = gain * src[i];
+}
+
+// dst[i] *= gain
+template <typename _SampleType>
+void __simd_scale(_SampleType* dst, _SampleType gain, size_t n) noexcept {
+  for (size_t i = 0; i < n; ++i)
+    dst[i] *= gain;
+}
+
+inline void __simd_scale(float* dst, float gain, size_t n) noexcept {
+  constexpr size_t w = __simd_float::width;
+  const auto g = __simd_float::broadcast(gain);
+
+  size_t i = 0;
+  for (; i + w <= n; i += w)
+    (g * __simd_float::load(dst + i)).store(dst + i);
+
+  for (; i < n; ++i)
+    dst[i] *= gain;
+}
+
+_LIBSTDAUDIO_NAMESPACE_END
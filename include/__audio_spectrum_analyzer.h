@@ -0,0 +1,164 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+#include <__audio_fft.h>
+#include <__audio_simd.h>
+#include <__audio_triple_buffer.h>
+
+_LIBSTDAUDIO_NAMESPACE_BEGIN
+
+// Streaming short-time Fourier analysis for meters and spectrum displays. process()
+// is meant to be called from the audio thread with every input buffer; it mixes the
+// channels down, and every hop_size frames it transforms the last fft_size frames
+// under a Hann window and publishes their magnitude spectrum. get_magnitudes() may
+// be called from a single other thread (e.g. a UI timer) and returns the most recent
+// spectrum without ever blocking either side.
+//
+// The magnitudes are linear and scaled so that a full-scale sine at the centre of a
+// bin reads 1 in that bin. Bin k is centred on k * sample_rate / fft_size. All memory
+// is allocated in the constructor.
+class audio_spectrum_analyzer {
+public:
+  explicit audio_spectrum_analyzer(size_t fft_size = 2048, size_t hop_size = 0)
+    : _fft(fft_size),
+      _hop_size(hop_size > 0 ? hop_size : fft_size / 4),
+      _history(fft_size),
+      _window(fft_size),
+      _scale(_fft.num_bins()),
+      _windowed(fft_size),
+      _re(_fft.num_bins()),
+      _im(_fft.num_bins()),
+      _spectra(vector<float>(_fft.num_bins())) {
+    assert(_hop_size <= fft_size);
+
+    // Periodic Hann window; its mean of 1/2 is the coherent gain to correct for.
+    double window_sum = 0;
+    for (size_t i = 0; i < fft_size; ++i) {
+      _window[i] = float(0.5 - 0.5 * cos(2 * _pi * double(i) / double(fft_size)));
+      window_sum += _window[i];
+    }
+
+    // A real sine splits its amplitude between the positive and negative frequency,
+    // except at DC and Nyquist.
+    for (size_t k = 0; k < _scale.size(); ++k)
+      _scale[k] = float((k == 0 || k == _scale.size() - 1 ? 1.0 : 2.0) / window_sum);
+  }
+
+  size_t fft_size() const noexcept {
+    return _fft.size();
+  }
+
+  size_t hop_size() const noexcept {
+    return _hop_size;
+  }
+
+  size_t num_bins() const noexcept {
+    return _fft.num_bins();
+  }
+
+  // Audio thread.
+  template <typename _SampleType>
+  void process(const audio_buffer<_SampleType>& buffer) noexcept {
+    static_assert(is_floating_point_v<_SampleType>, "audio_spectrum_analyzer requires a floating-point sample type");
+
+    const size_t num_frames = size_t(buffer.size_frames());
+    const size_t num_channels = size_t(buffer.size_channels());
+    if (num_channels == 0)
+      return;
+
+    const float mix_gain = 1.0f / float(num_channels);
+    const size_t size = _history.size();
+
+    for (size_t frame = 0; frame < num_frames; ++frame) {
+      _SampleType sum = 0;
+      for (size_t channel = 0; channel < num_channels; ++channel)
+        sum += buffer(frame, channel);
+
+      _history[_write_position] = mix_gain * float(sum);
+      _write_position = (_write_position + 1) & (size - 1);
+
+      if (++_frames_since_analysis == _hop_size) {
+        _frames_since_analysis = 0;
+        _analyze();
+      }
+    }
+  }
+
+  // Clears the history. Must not be called concurrently with process().
+  void reset() noexcept {
+    fill(_history.begin(), _history.end(), 0.0f);
+    _write_position = 0;
+    _frames_since_analysis = 0;
+  }
+
+  // Any one thread. The returned magnitudes stay valid until the next call.
+  const vector<float>& get_magnitudes() noexcept {
+    _spectra.update();
+    return _spectra.read_buffer();
+  }
+
+private:
+  static constexpr double _pi = 3.14159265358979323846;
+
+  void _analyze() noexcept {
+    constexpr size_t w = __simd_float::width;
+    const size_t size = _history.size();
+
+    // The history is a ring; its oldest sample is at the write position.
+    const size_t num_old = size - _write_position;
+    _multiply(_window.data(), _history.data() + _write_position, _windowed.data(), num_old);
+    _multiply(_window.data() + num_old, _history.data(), _windowed.data() + num_old, _write_position);
+
+    _fft.forward(_windowed.data(), _re.data(), _im.data());
+
+    auto& magnitudes = _spectra.write_buffer();
+    const size_t num_bins = magnitudes.size();
+
+    size_t k = 0;
+    for (; k + w <= num_bins; k += w) {
+      const auto re = __simd_float::load(_re.data() + k), im = __simd_float::load(_im.data() + k);
+      (__simd_float::load(_scale.data() + k) * sqrt(fma(re, re, im * im))).store(magnitudes.data() + k);
+    }
+
+    for (; k < num_bins; ++k)
+      magnitudes[k] = _scale[k] * sqrt(_re[k] * _re[k] + _im[k] * _im[k]);
+
+    _spectra.publish();
+  }
+
+  // dst[i] = a[i] * b[i]
+  static void _multiply(const float* a, const float* b, float* dst, size_t n) noexcept {
+    constexpr size_t w = __simd_float::width;
+
+    size_t i = 0;
+    for (; i + w <= n; i += w)
+      (__simd_float::load(a + i) * __simd_float::load(b + i)).store(dst + i);
+
+    for (; i < n; ++i)
+      dst[i] = a[i] * b[i];
+  }
+
+  audio_real_fft _fft;
+  size_t _hop_size;
+  __simd_aligned_vector<float> _history;
+  __simd_aligned_vector<float> _window;
+  __simd_aligned_vector<float> _scale;
+  __simd_aligned_vector<float> _windowed;
+  __simd_aligned_vector<float> _re;
+  __simd_aligned_vector<float> _im;
+  size_t _write_position = 0;
+  size_t _frames_since_analysis = 0;
+  __triple_buffer<vector<float>> _spectra;
+};
+
+_LIBSTDAUDIO_NAMESPACE_END
@@ -0,0 +1,364 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+  #define _LIBSTDAUDIO_HAS_COROUTINES
+#endif
+
+#ifdef _LIBSTDAUDIO_HAS_COROUTINES
+
+#include <atomic>
+#include <cassert>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <new>
+#include <utility>
+
+_LIBSTDAUDIO_NAMESPACE_BEGIN
+
+// A fixed block of memory from which coroutine frames are allocated. A frame that is
+// freed last-in, first-out, as nested tasks are, gives its memory back to the top of
+// the arena; any other freed frame is kept for the next frame of the same size. A
+// coroutine that starts the same nested tasks over and over therefore needs no more
+// memory than its deepest nesting, and an arena should be sized for that.
+class audio_stream_arena {
+public:
+  audio_stream_arena(void* data, size_t size_bytes) noexcept
+    : _data(static_cast<byte*>(data)), _size(size_bytes) {
+  }
+
+  audio_stream_arena(const audio_stream_arena&) = delete;
+  audio_stream_arena& operator=(const audio_stream_arena&) = delete;
+
+  // Returns nullptr if the arena is exhausted.
+  void* allocate(size_t size_bytes) noexcept {
+    const size_t block_size = _header_size + _align(size_bytes);
+
+    for (_free_block** link = &_free_list; *link != nullptr; link = &(*link)->next) {
+      if ((*link)->size == block_size) {
+        byte* block = reinterpret_cast<byte*>(exchange(*link, (*link)->next));
+        return _start(block, block_size);
+      }
+    }
+
+    const size_t offset = _align(_used);
+    if (offset + block_size > _size)
+      return nullptr;
+
+    _used = offset + block_size;
+    return _start(_data + offset, block_size);
+  }
+
+  void deallocate(void* ptr) noexcept {
+    if (ptr == nullptr)
+      return;
+
+    byte* block = static_cast<byte*>(ptr) - _header_size;
+    const size_t block_size = reinterpret_cast<_block_header*>(block)->size;
+
+    if (block + block_size == _data + _used) {
+      _used = size_t(block - _data);
+      _release_top();
+    }
+    else {
+      _free_list = ::new (block) _free_block{block_size, _free_list};
+    }
+  }
+
+  // The arena a frame was allocated from.
+  static audio_stream_arena& owner(void* ptr) noexcept {
+    return *reinterpret_cast<_block_header*>(static_cast<byte*>(ptr) - _header_size)->arena;
+  }
+
+  size_t size_bytes() const noexcept {
+    return _size;
+  }
+
+  // The high-water mark: memory up to here is either in use or kept for reuse.
+  size_t used_bytes() const noexcept {
+    return _used;
+  }
+
+  // Only valid once every coroutine allocated from the arena has been destroyed.
+  void reset() noexcept {
+    _used = 0;
+    _free_list = nullptr;
+  }
+
+private:
+  struct _block_header {
+    audio_stream_arena* arena;
+    size_t size;
+  };
+
+  struct _free_block {
+    size_t size;
+    _free_block* next;
+  };
+
+  static constexpr size_t _alignment = alignof(max_align_t);
+
+  static constexpr size_t _align(size_t size) noexcept {
+    return (size + _alignment - 1) & ~(_alignment - 1);
+  }
+
+  static constexpr size_t _header_size = (sizeof(_block_header) + _alignment - 1) & ~(_alignment - 1);
+
+  void* _start(byte* block, size_t block_size) noexcept {
+    ::new (block) _block_header{this, block_size};
+    return block + _header_size;
+  }
+
+  // Once the top of the arena has been given back, free blocks that are now on top
+  // can be given back as well.
+  void _release_top() noexcept {
+    for (bool released = true; released;) {
+      released = false;
+      for (_free_block** link = &_free_list; *link != nullptr; link = &(*link)->next) {
+        byte* block = reinterpret_cast<byte*>(*link);
+        if (block + (*link)->size == _data + _used) {
+          _used = size_t(block - _data);
+          *link = (*link)->next;
+          released = true;
+          break;
+        }
+      }
+    }
+  }
+
+  byte* _data = nullptr;
+  size_t _size = 0;
+  size_t _used = 0;
+  _free_block* _free_list = nullptr;
+};
+
+// The return type of coroutines driven by an audio_stream. The first parameter of
+// such a coroutine must be the audio_stream_arena to allocate its frame from; the
+// heap is never used. A task can itself be co_awaited, which runs it to completion
+// as part of the awaiting coroutine.
+//
+// If the arena is exhausted, the coroutine call returns a task that is not valid()
+// and, when co_awaited, completes immediately without running anything.
+class audio_stream_task {
+public:
+  struct promise_type {
+    template <typename... _Args>
+    static void* operator new(size_t size_bytes, audio_stream_arena& arena, _Args&...) noexcept {
+      return arena.allocate(size_bytes);
+    }
+
+    // Matches the operator new above, for a promise constructor that throws.
+    template <typename... _Args>
+    static void operator delete(void* ptr, audio_stream_arena& arena, _Args&...) noexcept {
+      arena.deallocate(ptr);
+    }
+
+    static void operator delete(void* ptr) noexcept {
+      if (ptr != nullptr)
+        audio_stream_arena::owner(ptr).deallocate(ptr);
+    }
+
+    static audio_stream_task get_return_object_on_allocation_failure() noexcept {
+      return {};
+    }
+
+    audio_stream_task get_return_object() noexcept {
+      return audio_stream_task(coroutine_handle<promise_type>::from_promise(*this));
+    }
+
+    suspend_always initial_suspend() noexcept {
+      return {};
+    }
+
+    struct _final_awaiter {
+      bool await_ready() noexcept {
+        return false;
+      }
+
+      coroutine_handle<> await_suspend(coroutine_handle<promise_type> handle) noexcept {
+        auto continuation = handle.promise().continuation;
+        return continuation ? continuation : noop_coroutine();
+      }
+
+      void await_resume() noexcept {
+      }
+    };
+
+    _final_awaiter final_suspend() noexcept {
+      return {};
+    }
+
+    void return_void() noexcept {
+    }
+
+    // Coroutines run inside noexcept device callbacks.
+    void unhandled_exception() noexcept {
+      terminate();
+    }
+
+    coroutine_handle<> continuation;
+  };
+
+  audio_stream_task() noexcept = default;
+
+  audio_stream_task(audio_stream_task&& other) noexcept
+    : _handle(exchange(other._handle, nullptr)) {
+  }
+
+  audio_stream_task& operator=(audio_stream_task&& other) noexcept {
+    if (this != &other) {
+      _destroy();
+      _handle = exchange(other._handle, nullptr);
+    }
+
+    return *this;
+  }
+
+  ~audio_stream_task() {
+    _destroy();
+  }
+
+  bool valid() const noexcept {
+    return bool(_handle);
+  }
+
+  bool done() const noexcept {
+    return !_handle || _handle.done();
+  }
+
+  bool await_ready() const noexcept {
+    return done();
+  }
+
+  coroutine_handle<> await_suspend(coroutine_handle<> awaiting) noexcept {
+    _handle.promise().continuation = awaiting;
+    return _handle;
+  }
+
+  void await_resume() const noexcept {
+  }
+
+private:
+  template <typename>
+  friend class audio_stream;
+
+  explicit audio_stream_task(coroutine_handle<promise_type> handle) noexcept
+    : _handle(handle) {
+  }
+
+  void _destroy() noexcept {
+    if (_handle)
+      _handle.destroy();
+
+    _handle = nullptr;
+  }
+
+  coroutine_handle<promise_type> _handle;
+};
+
+// Drives a coroutine from a device callback, so that audio code can be written as
+// straight-line code that waits for the next period:
+//
+//   audio_stream_task play(audio_stream_arena&, audio_stream<float>& stream) {
+//     for (;;) {
+//       auto& io = co_await stream.next_period();
+//       ...
+//     }
+//   }
+//
+// The coroutine is resumed directly on the audio thread, once per period; its output
+// buffer is cleared before that. The stream is not copyable; connect it to a device
+// through a callback that refers to it.
+template <typename _SampleType = float>
+class audio_stream {
+public:
+  audio_stream() noexcept = default;
+  audio_stream(const audio_stream&) = delete;
+  audio_stream& operator=(const audio_stream&) = delete;
+
+  // Not thread-safe; call this before the device is started.
+  void set_task(audio_stream_task task) noexcept {
+    _task = move(task);
+    _waiting = _task._handle;
+    _done.store(_task.done(), memory_order_release);
+  }
+
+  // Can be called from any thread.
+  bool is_done() const noexcept {
+    return _done.load(memory_order_acquire);
+  }
+
+  class period_awaiter {
+  public:
+    bool await_ready() const noexcept {
+      return _stream._has_unclaimed_period;
+    }
+
+    void await_suspend(coroutine_handle<> handle) noexcept {
+      _stream._waiting = handle;
+    }
+
+    audio_device_io<_SampleType>& await_resume() noexcept {
+      assert(_stream._io != nullptr);
+      _stream._has_unclaimed_period = false;
+      return *_stream._io;
+    }
+
+  private:
+    friend class audio_stream;
+
+    explicit period_awaiter(audio_stream& stream) noexcept
+      : _stream(stream) {
+    }
+
+    audio_stream& _stream;
+  };
+
+  // Suspends the coroutine until the next period, unless the current one
+  // has not been claimed yet.
+  period_awaiter next_period() noexcept {
+    return period_awaiter(*this);
+  }
+
+  void process(audio_device_io<_SampleType>& io) noexcept {
+    if (io.output_buffer.has_value()) {
+      auto& out = *io.output_buffer;
+      for (size_t channel = 0; channel < out.size_channels(); ++channel)
+        for (size_t frame = 0; frame < out.size_frames(); ++frame)
+          out(frame, channel) = _SampleType{};
+    }
+
+    if (!_waiting)
+      return;
+
+    _io = &io;
+    _has_unclaimed_period = true;
+    exchange(_waiting, nullptr).resume();
+    _has_unclaimed_period = false;
+    _io = nullptr;
+
+    if (_task.done())
+      _done.store(true, memory_order_release);
+  }
+
+  template <typename _DeviceType>
+  void operator()(_DeviceType&, audio_device_io<_SampleType>& io) noexcept {
+    process(io);
+  }
+
+private:
+  audio_stream_task _task;
+  coroutine_handle<> _waiting;
+  audio_device_io<_SampleType>* _io = nullptr;
+  bool _has_unclaimed_period = false;
+  atomic<bool> _done = true;
+};
+
+_LIBSTDAUDIO_NAMESPACE_END
+
+#endif // _LIBSTDAUDIO_HAS_COROUTINES
@@ -0,0 +1,74 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <array>
+#include <atomic>
+
+_LIBSTDAUDIO_NAMESPACE_BEGIN
+
+// Wait-free single-writer, single-reader hand-over of the most recent value.
+// The writer fills write_buffer() and calls publish(); the reader calls
+// update() and then inspects read_buffer(). Neither side ever blocks.
+template <typename _Type>
+class __triple_buffer {
+public:
+  __triple_buffer() = default;
+
+  // Starts all three buffers as copies of initial, e.g. to size them up front.
+  explicit __triple_buffer(const _Type& initial)
+    : _buffers{initial, initial, initial} {
+  }
+
+  // Copying is only safe while neither side is being accessed concurrently.
+  __triple_buffer(const __triple_buffer& other)
+    : _buffers(other._buffers),
+      _middle(other._middle.load(memory_order_relaxed)),
+      _write_index(other._write_index),
+      _read_index(other._read_index) {
+  }
+
+  __triple_buffer& operator=(const __triple_buffer& other) {
+    _buffers = other._buffers;
+    _middle.store(other._middle.load(memory_order_relaxed), memory_order_relaxed);
+    _write_index = other._write_index;
+    _read_index = other._read_index;
+    return *this;
+  }
+
+  _Type& write_buffer() noexcept {
+    return _buffers[_write_index];
+  }
+
+  void publish() noexcept {
+    const auto previous = _middle.exchange(_write_index | _dirty_bit, memory_order_acq_rel);
+    _write_index = previous & _index_mask;
+  }
+
+  bool update() noexcept {
+    if ((_middle.load(memory_order_relaxed) & _dirty_bit) == 0)
+      return false;
+
+    const auto previous = _middle.exchange(_read_index, memory_order_acq_rel);
+    _read_index = previous & _index_mask;
+    return true;
+  }
+
+  const _Type& read_buffer() const noexcept {
+    return _buffers[_read_index];
+  }
+
+private:
+  static constexpr unsigned _dirty_bit = 4;
+  static constexpr unsigned _index_mask = 3;
+
+  array<_Type, 3> _buffers = {};
+  atomic<unsigned> _middle = 1;
+  unsigned _write_index = 0;
+  unsigned _read_index = 2;
+};
+
+_LIBSTDAUDIO_NAMESPACE_END
@@ -0,0 +1,370 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <__audio_denormals.h>
+
+#if defined(__linux__)
+  #include <linux/futex.h>
+  #include <pthread.h>
+  #include <sys/syscall.h>
+  #include <unistd.h>
+#elif defined(_WIN32)
+  #include <windows.h>
+  #pragma comment(lib, "Synchronization.lib")
+#else
+  #include <condition_variable>
+  #include <mutex>
+  #include <pthread.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+  #include <immintrin.h>
+#endif
+
+_LIBSTDAUDIO_NAMESPACE_BEGIN
+
+// Fixed-capacity Chase-Lev work-stealing deque (Lê et al., "Correct and Efficient
+// Work-Stealing for Weak Memory Models", 2013). The owner pushes and pops at the
+// bottom; any other thread may steal from the top.
+class __work_stealing_deque {
+public:
+  explicit __work_stealing_deque(size_t capacity)
+    : _buffer(capacity), _mask(int64_t(capacity) - 1) {
+    assert(capacity > 0 && (capacity & (capacity - 1)) == 0);
+  }
+
+  // Owner only; fails if the deque is full.
+  bool push(uint64_t item) noexcept {
+    const auto bottom = _bottom.load(memory_order_relaxed);
+    const auto top = _top.load(memory_order_acquire);
+    if (bottom - top > _mask)
+      return false;
+
+    _buffer[size_t(bottom & _mask)].store(item, memory_order_relaxed);
+    _bottom.store(bottom + 1, memory_order_release);
+    return true;
+  }
+
+  // Owner only.
+  bool pop(uint64_t& item) noexcept {
+    const auto bottom = _bottom.load(memory_order_relaxed) - 1;
+    _bottom.store(bottom, memory_order_seq_cst);
+    auto top = _top.load(memory_order_seq_cst);
+
+    if (top > bottom) {
+      _bottom.store(bottom + 1, memory_order_relaxed);
+      return false;
+    }
+
+    item = _buffer[size_t(bottom & _mask)].load(memory_order_relaxed);
+    if (top < bottom)
+      return true;
+
+    // The last item; race against thieves for it.
+    const bool won = _top.compare_exchange_strong(top, top + 1, memory_order_seq_cst, memory_order_relaxed);
+    _bottom.store(bottom + 1, memory_order_relaxed);
+    return won;
+  }
+
+  // Any thread.
+  bool steal(uint64_t& item) noexcept {
+    auto top = _top.load(memory_order_seq_cst);
+    const auto bottom = _bottom.load(memory_order_seq_cst);
+    if (top >= bottom)
+      return false;
+
+    item = _buffer[size_t(top & _mask)].load(memory_order_relaxed);
+    return _top.compare_exchange_strong(top, top + 1, memory_order_seq_cst, memory_order_relaxed);
+  }
+
+private:
+  vector<atomic<uint64_t>> _buffer;
+  int64_t _mask;
+  alignas(64) atomic<int64_t> _top = 0;
+  alignas(64) atomic<int64_t> _bottom = 0;
+};
+
+// Tells the CPU that the current thread is spinning.
+inline void __audio_cpu_pause() noexcept {
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+  _mm_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield");
+#endif
+}
+
+// Gives the current thread (almost) the priority of an audio thread.
+inline void __audio_set_realtime_thread_priority() noexcept {
+#if defined(_WIN32)
+  SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+#else
+  // Best effort: this needs privileges that many processes don't have.
+  sched_param param = {};
+  param.sched_priority = sched_get_priority_max(SCHED_FIFO) - 1;
+  pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+#endif
+}
+
+// Sleeping and waking on a 32-bit counter without taking locks where the platform
+// allows it: futex on Linux, WaitOnAddress on Windows, a condition variable elsewhere.
+class __audio_wake_event {
+public:
+  uint32_t epoch() const noexcept {
+    return _epoch.load(memory_order_seq_cst);
+  }
+
+  // Returns once the epoch differs from the given one (or spuriously).
+  void wait(uint32_t epoch) noexcept {
+#if defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&_epoch), FUTEX_WAIT_PRIVATE, epoch, nullptr, nullptr, 0);
+#elif defined(_WIN32)
+    WaitOnAddress(&_epoch, &epoch, sizeof(epoch), INFINITE);
+#else
+    unique_lock<mutex> lock(_mutex);
+    _condition.wait(lock, [&] { return _epoch.load() != epoch; });
+#endif
+  }
+
+  void notify_all() noexcept {
+#if defined(__linux__)
+    _epoch.fetch_add(1, memory_order_seq_cst);
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&_epoch), FUTEX_WAKE_PRIVATE, INT32_MAX, nullptr, nullptr, 0);
+#elif defined(_WIN32)
+    _epoch.fetch_add(1, memory_order_seq_cst);
+    WakeByAddressAll(&_epoch);
+#else
+    {
+      lock_guard<mutex> lock(_mutex);
+      _epoch.fetch_add(1, memory_order_seq_cst);
+    }
+    _condition.notify_all();
+#endif
+  }
+
+  // Advances the epoch without waking anybody, for when nobody is sleeping.
+  void advance() noexcept {
+    _epoch.fetch_add(1, memory_order_seq_cst);
+  }
+
+private:
+  static_assert(sizeof(atomic<uint32_t>) == sizeof(uint32_t));
+  atomic<uint32_t> _epoch = 0;
+
+#if !defined(__linux__) && !defined(_WIN32)
+  mutex _mutex;
+  condition_variable _condition;
+#endif
+};
+
+// A pool of pre-spawned high-priority threads that helps the audio thread run
+// independent tasks within one period. parallel_for hands out the tasks through
+// work-stealing deques, takes part in executing them and only returns once all of
+// them have finished, so it can be called from a device callback and the results
+// are complete before the callback returns.
+//
+// parallel_for may be called from one external thread at a time (normally the audio
+// thread) and, nested, from inside tasks. Idle workers spin for a short while before
+// going to sleep, so that a new period usually finds them awake.
+class audio_worker_pool {
+public:
+  explicit audio_worker_pool(size_t num_workers = max(thread::hardware_concurrency(), 1u) - 1,
+                             size_t max_tasks_per_thread = 1024)
+    : _participants(num_workers + 1) {
+    size_t capacity = 1;
+    while (capacity < max_tasks_per_thread)
+      capacity *= 2;
+
+    for (auto& participant : _participants)
+      participant = make_unique<_participant>(capacity);
+
+    _workers.reserve(num_workers);
+    for (size_t i = 1; i <= num_workers; ++i)
+      _workers.emplace_back([this, i] { _worker_main(i); });
+  }
+
+  audio_worker_pool(const audio_worker_pool&) = delete;
+  audio_worker_pool& operator=(const audio_worker_pool&) = delete;
+
+  ~audio_worker_pool() {
+    _running.store(false, memory_order_seq_cst);
+    _wake_event.notify_all();
+
+    for (auto& worker : _workers)
+      worker.join();
+  }
+
+  size_t num_workers() const noexcept {
+    return _workers.size();
+  }
+
+  // Calls task(context, i) for every i in [0, num_tasks) and returns when all calls have finished.
+  void parallel_for(size_t num_tasks, void (*task)(void* context, size_t index), void* context) noexcept {
+    if (num_tasks == 0)
+      return;
+
+    if (_workers.empty() || num_tasks == 1) {
+      for (size_t i = 0; i < num_tasks; ++i)
+        task(context, i);
+      return;
+    }
+
+    const size_t participant_index = _current_participant_index();
+    auto& participant = *_participants[participant_index];
+    assert(participant.depth < _max_nesting_depth);
+
+    const size_t depth = participant.depth++;
+    auto& job = participant.jobs[depth];
+    job.task = task;
+    job.context = context;
+    job.flush_denormals = __audio_fp_mode::flushes_denormals();
+    job.remaining.store(num_tasks, memory_order_relaxed);
+
+    for (size_t i = 1; i < num_tasks; ++i) {
+      if (!participant.deque.push(_encode(participant_index, depth, i)))
+        _run(job, i);
+    }
+
+    _wake_workers();
+    _run(job, 0);
+
+    // Help with whatever is left, ours or others', until our job is done.
+    while (job.remaining.load(memory_order_acquire) > 0) {
+      if (!_try_run_one(participant_index))
+        __audio_cpu_pause();
+    }
+
+    --participant.depth;
+  }
+
+  template <typename _Function>
+  void parallel_for(size_t num_tasks, _Function&& function) noexcept {
+    parallel_for(num_tasks, [](void* context, size_t index) {
+      (*static_cast<remove_reference_t<_Function>*>(context))(index);
+    }, const_cast<void*>(static_cast<const void*>(&function)));
+  }
+
+  // Makes the pool usable as an audio_mixer_executor, e.g. mixer.set_executor(ref(pool)).
+  void operator()(size_t num_tasks, void (*task)(void* context, size_t index), void* context) noexcept {
+    parallel_for(num_tasks, task, context);
+  }
+
+private:
+  static constexpr size_t _max_nesting_depth = 8;
+  static constexpr int _spin_iterations = 20'000;
+
+  struct _job {
+    void (*task)(void*, size_t) = nullptr;
+    void* context = nullptr;
+    bool flush_denormals = false;
+    atomic<size_t> remaining = 0;
+  };
+
+  struct _participant {
+    explicit _participant(size_t capacity) : deque(capacity) {}
+
+    __work_stealing_deque deque;
+    array<_job, _max_nesting_depth> jobs;
+    size_t depth = 0;
+  };
+
+  // A task is identified by the participant that created its job, the job's
+  // nesting depth on that participant and the task index.
+  static uint64_t _encode(size_t participant, size_t depth, size_t index) noexcept {
+    return (uint64_t(participant) << 48) | (uint64_t(depth) << 40) | uint64_t(index);
+  }
+
+  // Tasks run with denormals flushed if the thread that called parallel_for had
+  // them flushed, so that the audio thread's setting carries over to the workers.
+  void _run(uint64_t item) noexcept {
+    auto& job = _participants[size_t(item >> 48)]->jobs[size_t((item >> 40) & 0xff)];
+    audio_denormal_guard denormals(job.flush_denormals);
+    _run(job, size_t(item & 0xff'ffff'ffff));
+  }
+
+  static void _run(_job& job, size_t index) noexcept {
+    job.task(job.context, index);
+    job.remaining.fetch_sub(1, memory_order_acq_rel);
+  }
+
+  bool _try_run_one(size_t participant_index) noexcept {
+    uint64_t item;
+    if (_participants[participant_index]->deque.pop(item)) {
+      _run(item);
+      return true;
+    }
+
+    for (size_t i = 1; i < _participants.size(); ++i) {
+      const size_t victim = (participant_index + i) % _participants.size();
+      if (_participants[victim]->deque.steal(item)) {
+        _run(item);
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  void _wake_workers() noexcept {
+    if (_num_sleeping.load(memory_order_seq_cst) > 0)
+      _wake_event.notify_all();
+    else
+      _wake_event.advance();
+  }
+
+  void _worker_main(size_t participant_index) {
+    _this_thread_pool = this;
+    _this_thread_participant_index = participant_index;
+    __audio_set_realtime_thread_priority();
+
+    int spins = 0;
+    while (_running.load(memory_order_relaxed)) {
+      if (_try_run_one(participant_index)) {
+        spins = 0;
+        continue;
+      }
+
+      if (++spins < _spin_iterations) {
+        __audio_cpu_pause();
+        continue;
+      }
+
+      // Read the epoch before checking for work one last time; if work is pushed
+      // after that check, the epoch will have moved on and wait() returns at once.
+      _num_sleeping.fetch_add(1, memory_order_seq_cst);
+      const auto epoch = _wake_event.epoch();
+      if (_running.load(memory_order_seq_cst) && !_try_run_one(participant_index))
+        _wake_event.wait(epoch);
+
+      _num_sleeping.fetch_sub(1, memory_order_seq_cst);
+      spins = 0;
+    }
+  }
+
+  size_t _current_participant_index() const noexcept {
+    return _this_thread_pool == this ? _this_thread_participant_index : 0;
+  }
+
+  static inline thread_local audio_worker_pool* _this_thread_pool = nullptr;
+  static inline thread_local size_t _this_thread_participant_index = 0;
+
+  // Participant 0 is the external thread calling parallel_for, the others are workers.
+  vector<unique_ptr<_participant>> _participants;
+  vector<thread> _workers;
+  atomic<bool> _running = true;
+  atomic<size_t> _num_sleeping = 0;
+  __audio_wake_event _wake_event;
+};
+
+_LIBSTDAUDIO_NAMESPACE_END
@@ -176,6 +176,34 @@ public:
       _device_id, &pa, 0, nullptr, sizeof(buffer_size_t), &new_buffer_size));
   }
 
+  optional<audio_latency> get_input_latency() const noexcept {
+    if (!is_input())
+      return {};
+
+    return _get_latency(kAudioDevicePropertyScopeInput);
+  }
+
+  optional<audio_latency> get_output_latency() const noexcept {
+    if (!is_output())
+      return {};
+
+    return _get_latency(kAudioDevicePropertyScopeOutput);
+  }
+
+  // Whether callbacks run with flush-to-zero and denormals-are-zero enabled. Can only
+  // be changed while the device is stopped.
+  bool set_flush_denormals(bool enabled) noexcept {
+    if (_running)
+      return false;
+
+    _flush_denormals = enabled;
+    return true;
+  }
+
+  bool get_flush_denormals() const noexcept {
+    return _flush_denormals;
+  }
+
   template <typename _SampleType>
   constexpr bool supports_sample_type() const noexcept {
     return is_same_v<_SampleType, __coreaudio_native_sample_type>;
@@ -208,6 +236,8 @@ public:
   bool start(_StartCallbackType&& start_callback = [](audio_device&) noexcept {},
              _StopCallbackType&& stop_callback = [](audio_device&) noexcept {}) {
     if (!_running) {
+      _clock_estimator.set_nominal_sample_rate(get_sample_rate());
+
       // TODO: ProcID is a resource; wrap it into an RAII guard
       if (!__coreaudio_util::check_error(AudioDeviceCreateIOProcID(
           _device_id, _device_callback, this, &_proc_id)))
@@ -262,6 +292,10 @@ public:
     return false;
   }
 
+  audio_clock_estimate get_clock_estimate() noexcept {
+    return _clock_estimator.get_estimate();
+  }
+
 private:
   friend class __audio_device_enumerator;
 
@@ -288,11 +322,23 @@ private:
     audio_device& this_device = *reinterpret_cast<audio_device*>(void_ptr_to_this_device);
 
     _fill_buffers(input_data, input_time, output_data, output_time, this_device._current_buffers);
+    _update_clock_estimator(this_device._current_buffers, this_device._clock_estimator);
 
+    // The IO thread belongs to CoreAudio, so the FP mode is set and restored around each callback.
+    audio_denormal_guard denormals(this_device._flush_denormals);
+    audio_realtime_scope realtime;
     invoke(this_device._user_callback, this_device, this_device._current_buffers);
     return noErr;
   }
 
+  static void _update_clock_estimator(const audio_device_io<__coreaudio_native_sample_type>& buffers,
+                                      audio_clock_estimator& clock_estimator) noexcept {
+    if (buffers.output_buffer.has_value() && buffers.output_time.has_value())
+      clock_estimator.update(*buffers.output_time, buffers.output_buffer->size_frames());
+    else if (buffers.input_buffer.has_value() && buffers.input_time.has_value())
+      clock_estimator.update(*buffers.input_time, buffers.input_buffer->size_frames());
+  }
+
   static void _fill_buffers(const AudioBufferList* input_bl,
                             const AudioTimeStamp* input_time,
                             const AudioBufferList* output_bl,
@@ -393,9 +439,66 @@ private:
     assert(_max_supported_buffer_size >= _min_supported_buffer_size);
   }
 
+  audio_latency _get_latency(AudioObjectPropertyScope scope) const noexcept {
+    audio_latency latency;
+    latency.device_frames = _get_uint32_property(_device_id, kAudioDevicePropertyLatency, scope)
+                          + _get_stream_latency(scope);
+    latency.safety_offset_frames = _get_uint32_property(_device_id, kAudioDevicePropertySafetyOffset, scope);
+    latency.buffer_frames = get_buffer_size_frames();
+    latency.sample_rate = get_sample_rate();
+    return latency;
+  }
+
+  uint32_t _get_stream_latency(AudioObjectPropertyScope scope) const noexcept {
+    AudioObjectPropertyAddress pa = {
+      kAudioDevicePropertyStreams,
+      scope,
+      kAudioObjectPropertyElementMaster
+    };
+
+    uint32_t data_size = 0;
+    if (!__coreaudio_util::check_error(AudioObjectGetPropertyDataSize(
+      _device_id, &pa, 0, nullptr, &data_size)))
+      return 0;
+
+    if (data_size < sizeof(AudioStreamID))
+      return 0;
+
+    // we only support devices with a single stream per direction (see _fill_buffers),
+    // so the latency of the first stream is the one that applies.
+    AudioStreamID stream_id = {};
+    data_size = sizeof(stream_id);
+
+    if (!__coreaudio_util::check_error(AudioObjectGetPropertyData(
+      _device_id, &pa, 0, nullptr, &data_size, &stream_id)))
+      return 0;
+
+    return _get_uint32_property(stream_id, kAudioStreamPropertyLatency, kAudioObjectPropertyScopeGlobal);
+  }
+
+  static uint32_t _get_uint32_property(AudioObjectID object_id,
+                                       AudioObjectPropertySelector selector,
+                                       AudioObjectPropertyScope scope) noexcept {
+    AudioObjectPropertyAddress pa = {
+      selector,
+      scope,
+      kAudioObjectPropertyElementMaster
+    };
+
+    uint32_t value = 0;
+    uint32_t data_size = sizeof(value);
+
+    if (!__coreaudio_util::check_error(AudioObjectGetPropertyData(
+      object_id, &pa, 0, nullptr, &data_size, &value)))
+      return 0;
+
+    return value;
+  }
+
   AudioObjectID _device_id = {};
   AudioDeviceIOProcID _proc_id = {};
   bool _running = false;
+  bool _flush_denormals = false;
   string _name = {};
   __coreaudio_stream_config _config;
   vector<sample_rate_t> _supported_sample_rates = {};
@@ -405,6 +508,7 @@ private:
   using __coreaudio_callback_t = function<void(audio_device&, audio_device_io<__coreaudio_native_sample_type>&)>;
   __coreaudio_callback_t _user_callback;
   audio_device_io<__coreaudio_native_sample_type> _current_buffers;
+  audio_clock_estimator _clock_estimator;
 };
 
 class audio_device_list : public forward_list<audio_device> {
@@ -8,82 +8,321 @@
 #include <string_view>
 #include <chrono>
 #include <cassert>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <forward_list>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <__audio_worker_pool.h>
+
+// The backend for platforms without a native one. It has no devices of its own;
+// the only devices it lists are loopback pairs that the program adds with
+// add_audio_loopback_device_pair(), which makes it possible to run and measure
+// everything from the device callbacks onwards without audio hardware.
+
+#define _LIBSTDAUDIO_HAS_LOOPBACK_DEVICES 1
 
 _LIBSTDAUDIO_NAMESPACE_BEGIN
 
+enum class audio_loopback_clock {
+  // Periods follow each other at the sample rate (times clock_ratio), as with hardware.
+  realtime,
+  // The next period starts as soon as the callbacks of the previous one have returned.
+  free_running,
+};
+
+struct audio_loopback_config {
+  string name = "Loopback";
+  int num_channels = 2;
+  unsigned sample_rate = 48'000;
+  unsigned buffer_size_frames = 256;
+
+  // A frame rendered by the output device at frame position t is received by the
+  // input device at frame position t + latency_frames.
+  size_t latency_frames = 0;
+
+  audio_loopback_clock clock = audio_loopback_clock::realtime;
+
+  // How much faster than audio_clock_t the device clock runs, e.g. 1.001 for a
+  // device that is 0.1% fast. Only used by the realtime clock.
+  double clock_ratio = 1.0;
+};
+
+class audio_device;
+
+// The shared "hardware" of a loopback pair: one clock thread that runs the output
+// device's callback, feeds what it rendered through a delay line of latency_frames
+// frames and runs the input device's callback with what comes out of it.
+//
+// Each side has at most one started audio_device as its client. Clients attach
+// and detach with a Dekker-style handshake against the clock thread (client
+// pointers on one side, _in_period on the other), so the clock thread never
+// blocks and a detached client is guaranteed not to be called any more.
+class __audio_loopback_pair {
+public:
+  __audio_loopback_pair(audio_loopback_config config, unsigned output_device_id, unsigned input_device_id)
+    : _config(move(config)),
+      _output_device_id(output_device_id),
+      _input_device_id(input_device_id),
+      _output_buffer(_num_samples(_config.buffer_size_frames)),
+      _input_buffer(_num_samples(_config.buffer_size_frames)),
+      _delay_line(_num_samples(_config.latency_frames + _config.buffer_size_frames)) {
+    _clock_thread = thread([this] { _clock_thread_main(); });
+  }
+
+  __audio_loopback_pair(const __audio_loopback_pair&) = delete;
+  __audio_loopback_pair& operator=(const __audio_loopback_pair&) = delete;
+
+  ~__audio_loopback_pair() {
+    shutdown();
+  }
+
+  const audio_loopback_config& config() const noexcept {
+    return _config;
+  }
+
+  unsigned device_id(bool is_output) const noexcept {
+    return is_output ? _output_device_id : _input_device_id;
+  }
+
+  bool attach(bool is_output, audio_device* client) noexcept {
+    if (!_active.load())
+      return false;
+
+    audio_device* expected = nullptr;
+    return _clients[_side(is_output)].compare_exchange_strong(expected, client, memory_order_seq_cst);
+  }
+
+  // Must not be called from within a callback of this pair.
+  void detach(bool is_output, audio_device* client) noexcept {
+    audio_device* expected = client;
+    _clients[_side(is_output)].compare_exchange_strong(expected, nullptr, memory_order_seq_cst);
+
+    while (_in_period.load(memory_order_seq_cst))
+      this_thread::yield();
+  }
+
+  // Stops the clock for good; called when the pair is removed.
+  void shutdown() noexcept {
+    _active = false;
+    if (_clock_thread.joinable())
+      _clock_thread.join();
+  }
+
+private:
+  static size_t _side(bool is_output) noexcept {
+    return is_output ? 0 : 1;
+  }
+
+  size_t _num_samples(size_t num_frames) const noexcept {
+    return num_frames * size_t(_config.num_channels);
+  }
+
+  void _clock_thread_main();
+  void _run_period(chrono::time_point<audio_clock_t> time) noexcept;
+
+  const audio_loopback_config _config;
+  const unsigned _output_device_id;
+  const unsigned _input_device_id;
+
+  array<atomic<audio_device*>, 2> _clients = {};
+  atomic<bool> _in_period = false;
+  atomic<bool> _active = true;
+
+  // Only touched by the clock thread.
+  vector<float> _output_buffer;
+  vector<float> _input_buffer;
+  vector<float> _delay_line;
+  size_t _delay_line_position = 0;
+
+  thread _clock_thread;
+};
+
 class audio_device {
 public:
   audio_device() = delete;
+  audio_device(const audio_device&) = delete;
+  audio_device& operator=(const audio_device&) = delete;
+
+  // Devices can only be moved while they are stopped.
+  audio_device(audio_device&& other) noexcept
+    : _pair(move(other._pair)),
+      _is_output(other._is_output),
+      _name(move(other._name)),
+      _flush_denormals(other._flush_denormals),
+      _user_callback(move(other._user_callback)),
+      _stop_callback(move(other._stop_callback)),
+      _clock_estimator(other._clock_estimator) {
+    assert(!other._running);
+  }
+
+  audio_device& operator=(audio_device&& other) noexcept {
+    if (this != &other) {
+      assert(!other._running);
+      stop();
+      _pair = move(other._pair);
+      _is_output = other._is_output;
+      _name = move(other._name);
+      _flush_denormals = other._flush_denormals;
+      _user_callback = move(other._user_callback);
+      _stop_callback = move(other._stop_callback);
+      _clock_estimator = other._clock_estimator;
+    }
+
+    return *this;
+  }
+
+  ~audio_device() {
+    stop();
+  }
 
   string_view name() const noexcept {
-    return {};
+    return _name;
   }
 
   using device_id_t = unsigned;
 
   device_id_t device_id() const noexcept {
-    return {};
+    return _pair->device_id(_is_output);
   }
 
   bool is_input() const noexcept {
-    return false;
+    return !_is_output;
   }
 
   bool is_output() const noexcept {
-    return false;
+    return _is_output;
   }
 
   int get_num_input_channels() const noexcept {
-    return 0;
+    return is_input() ? _pair->config().num_channels : 0;
   }
 
   int get_num_output_channels() const noexcept {
-    return 0;
+    return is_output() ? _pair->config().num_channels : 0;
   }
 
   using sample_rate_t = unsigned;
 
   sample_rate_t get_sample_rate() const noexcept {
-    return {};
+    return _pair->config().sample_rate;
   }
 
-  bool set_sample_rate(sample_rate_t) {
-    return false;
+  // The format of a loopback pair is fixed by its audio_loopback_config.
+  bool set_sample_rate(sample_rate_t new_sample_rate) {
+    return new_sample_rate == get_sample_rate();
   }
 
   using buffer_size_t  = unsigned;
 
   buffer_size_t get_buffer_size_frames() const noexcept {
-    return {};
+    return _pair->config().buffer_size_frames;
   }
 
-  bool set_buffer_size_frames([[maybe_unused]] buffer_size_t new_buffer_size) {
-    return false;
+  bool set_buffer_size_frames(buffer_size_t new_buffer_size) {
+    return new_buffer_size == get_buffer_size_frames();
+  }
+
+  // The delay line of the pair counts as the input side's device latency.
+  optional<audio_latency> get_input_latency() const noexcept {
+    if (!is_input())
+      return {};
+
+    audio_latency latency;
+    latency.device_frames = _pair->config().latency_frames;
+    latency.buffer_frames = get_buffer_size_frames();
+    latency.sample_rate = get_sample_rate();
+    return latency;
+  }
+
+  optional<audio_latency> get_output_latency() const noexcept {
+    if (!is_output())
+      return {};
+
+    audio_latency latency;
+    latency.buffer_frames = get_buffer_size_frames();
+    latency.sample_rate = get_sample_rate();
+    return latency;
+  }
+
+  // Whether callbacks run with flush-to-zero and denormals-are-zero enabled. Can only
+  // be changed while the device is stopped.
+  bool set_flush_denormals(bool enabled) noexcept {
+    if (_running)
+      return false;
+
+    _flush_denormals = enabled;
+    return true;
+  }
+
+  bool get_flush_denormals() const noexcept {
+    return _flush_denormals;
   }
 
   template <typename _SampleType>
   constexpr bool supports_sample_type() const noexcept {
-    return false;
+    return is_same_v<_SampleType, float>;
   }
 
   constexpr bool can_connect() const noexcept {
-    return false;
+    return true;
   }
 
   constexpr bool can_process() const noexcept {
     return false;
   }
 
-  bool start() {
-    return false;
+  template <typename _CallbackType,
+            typename = enable_if_t<is_nothrow_invocable_v<_CallbackType, audio_device&, audio_device_io<float>&>>>
+  void connect(_CallbackType callback) {
+    assert(!_running);
+    _user_callback = move(callback);
+  }
+
+  // Type-erased start and stop callbacks, so that stop() can call the one start() was given.
+  using no_op_t = std::function<void(audio_device&)>;
+
+  // Fails if another audio_device for the same side of the pair is running, or
+  // the pair has been removed.
+  template <typename _StartCallbackType = no_op_t,
+            typename _StopCallbackType = no_op_t,
+            typename = enable_if_t<is_invocable_v<_StartCallbackType, audio_device&> && is_invocable_v<_StopCallbackType, audio_device&>>>
+  bool start(_StartCallbackType&& start_callback = [](audio_device&) noexcept {},
+             _StopCallbackType&& stop_callback = [](audio_device&) noexcept {}) {
+    if (!_running) {
+      _clock_estimator.set_nominal_sample_rate(get_sample_rate());
+      if (!_pair->attach(_is_output, this))
+        return false;
+
+      _running = true;
+      _stop_callback = stop_callback;
+      start_callback(*this);
+    }
+
+    return true;
   }
 
+  // Must not be called from within the device's own callback.
   bool stop() {
-    return false;
+    if (_running) {
+      _pair->detach(_is_output, this);
+      _running = false;
+
+      if (_stop_callback)
+        _stop_callback(*this);
+    }
+
+    return true;
   }
 
   bool is_running() const noexcept {
-    return false;
+    return _running;
   }
 
   void wait() const {
@@ -98,44 +337,275 @@ public:
   constexpr bool has_unprocessed_io() const noexcept {
     return false;
   }
-};
 
-class audio_device_list
-{
+  audio_clock_estimate get_clock_estimate() noexcept {
+    return _clock_estimator.get_estimate();
+  }
+
 private:
-  class iterator {
-  public:
-    auto operator==(const iterator&) const noexcept { return true; }
-    auto operator!=(const iterator&) const noexcept { return false; }
-    auto operator++() -> const iterator& { assert(false); return *this; }
-    auto operator*() -> audio_device& {
-      assert(false); static audio_device device{};
-      return device;
+  friend class __audio_loopback_pair;
+  friend class __audio_loopback_registry;
+
+  audio_device(shared_ptr<__audio_loopback_pair> pair, bool is_output)
+    : _pair(move(pair)),
+      _is_output(is_output),
+      _name(_pair->config().name + (is_output ? " output" : " input")) {
+  }
+
+  // Runs on the pair's clock thread.
+  void _run_callback(audio_device_io<float>& io) noexcept {
+    if (io.output_buffer.has_value())
+      _clock_estimator.update(*io.output_time, io.output_buffer->size_frames());
+    else
+      _clock_estimator.update(*io.input_time, io.input_buffer->size_frames());
+
+    if (_user_callback) {
+      audio_denormal_guard denormals(_flush_denormals);
+      audio_realtime_scope realtime;
+      invoke(_user_callback, *this, io);
+    }
+  }
+
+  shared_ptr<__audio_loopback_pair> _pair;
+  bool _is_output = false;
+  string _name;
+  bool _running = false;
+  bool _flush_denormals = false;
+  function<void(audio_device&, audio_device_io<float>&)> _user_callback;
+  no_op_t _stop_callback;
+  audio_clock_estimator _clock_estimator;
+};
+
+inline void __audio_loopback_pair::_clock_thread_main() {
+  __audio_set_realtime_thread_priority();
+
+  const auto period = chrono::duration<double>(double(_config.buffer_size_frames) / (double(_config.sample_rate) * _config.clock_ratio));
+  const auto to_clock_duration = [](chrono::duration<double> duration) {
+    return chrono::duration_cast<audio_clock_t::duration>(duration);
+  };
+
+  auto schedule_start = audio_clock_t::now();
+  uint64_t period_index = 0;
+
+  while (_active.load(memory_order_relaxed)) {
+    const bool idle = _clients[0].load() == nullptr && _clients[1].load() == nullptr;
+
+    if (_config.clock == audio_loopback_clock::free_running) {
+      if (idle)
+        this_thread::sleep_for(chrono::milliseconds(1));
+      else
+        _run_period(audio_clock_t::now());
+
+      continue;
     }
+
+    const auto time = schedule_start + to_clock_duration(period * double(period_index));
+    this_thread::sleep_until(time);
+
+    // Like a device that glitched: after falling far behind, the clock starts afresh
+    // rather than delivering the missed periods in a burst.
+    if (audio_clock_t::now() - time > to_clock_duration(period * 4.0)) {
+      schedule_start = audio_clock_t::now();
+      period_index = 0;
+      continue;
+    }
+
+    _run_period(time);
+    ++period_index;
+  }
+}
+
+inline void __audio_loopback_pair::_run_period(chrono::time_point<audio_clock_t> time) noexcept {
+  _in_period.store(true, memory_order_seq_cst);
+  auto* output_client = _clients[0].load(memory_order_seq_cst);
+  auto* input_client = _clients[1].load(memory_order_seq_cst);
+
+  const size_t num_channels = size_t(_config.num_channels);
+  const size_t num_frames = _config.buffer_size_frames;
+
+  fill(_output_buffer.begin(), _output_buffer.end(), 0.0f);
+  if (output_client != nullptr) {
+    audio_device_io<float> io;
+    io.output_buffer = audio_buffer<float>(_output_buffer.data(), num_frames, num_channels, contiguous_interleaved);
+    io.output_time = time;
+    output_client->_run_callback(io);
+  }
+
+  // The delay line holds the last latency_frames + buffer_size_frames frames that
+  // were rendered; after writing this period at the current position, the oldest
+  // period in it starts right behind the period that was just written.
+  const size_t delay_line_frames = _delay_line.size() / num_channels;
+  const size_t write_position = _delay_line_position;
+  const size_t read_position = (write_position + num_frames) % delay_line_frames;
+
+  const auto copy_frames = [&](float* destination, size_t destination_frame,
+                               const float* source, size_t source_frame, size_t frames) {
+    memcpy(destination + destination_frame * num_channels, source + source_frame * num_channels, frames * num_channels * sizeof(float));
   };
 
+  const size_t write_head = min(num_frames, delay_line_frames - write_position);
+  copy_frames(_delay_line.data(), write_position, _output_buffer.data(), 0, write_head);
+  copy_frames(_delay_line.data(), 0, _output_buffer.data(), write_head, num_frames - write_head);
+
+  const size_t read_head = min(num_frames, delay_line_frames - read_position);
+  copy_frames(_input_buffer.data(), 0, _delay_line.data(), read_position, read_head);
+  copy_frames(_input_buffer.data(), read_head, _delay_line.data(), 0, num_frames - read_head);
+
+  _delay_line_position = read_position;
+
+  if (input_client != nullptr) {
+    audio_device_io<float> io;
+    io.input_buffer = audio_buffer<float>(_input_buffer.data(), num_frames, num_channels, contiguous_interleaved);
+    io.input_time = time;
+    input_client->_run_callback(io);
+  }
+
+  _in_period.store(false, memory_order_seq_cst);
+}
+
+class audio_device_list : public forward_list<audio_device> {
+};
+
+struct audio_loopback_device_pair {
+  audio_device output;
+  audio_device input;
+};
+
+class __audio_loopback_registry {
 public:
-  auto begin() -> iterator { return {}; }
-  auto end() -> iterator { return {}; }
-  auto begin() const -> iterator { return {}; }
-  auto end() const -> iterator { return {}; }
-  auto empty() const -> bool { return true; }
+  static __audio_loopback_registry& get_instance() {
+    static __audio_loopback_registry registry;
+    return registry;
+  }
+
+  optional<audio_loopback_device_pair> add(audio_loopback_config config) {
+    if (config.name.empty() || config.num_channels <= 0 || config.num_channels > int(audio_buffer<float>::max_num_channels)
+        || config.sample_rate == 0 || config.buffer_size_frames == 0 || !(config.clock_ratio > 0))
+      return {};
+
+    shared_ptr<__audio_loopback_pair> pair;
+    bool was_empty = false;
+    {
+      lock_guard<mutex> lock(_mutex);
+      was_empty = _pairs.empty();
+      pair = make_shared<__audio_loopback_pair>(move(config), _next_device_id, _next_device_id + 1);
+      _next_device_id += 2;
+      _pairs.push_back(pair);
+    }
+
+    _notify(audio_device_list_event::device_list_changed);
+    if (was_empty) {
+      _notify(audio_device_list_event::default_input_device_changed);
+      _notify(audio_device_list_event::default_output_device_changed);
+    }
+
+    return audio_loopback_device_pair{audio_device(pair, true), audio_device(pair, false)};
+  }
+
+  bool remove(audio_device::device_id_t device_id) {
+    shared_ptr<__audio_loopback_pair> pair;
+    bool was_default = false;
+    {
+      lock_guard<mutex> lock(_mutex);
+      auto it = find_if(_pairs.begin(), _pairs.end(), [&](const auto& p) {
+        return p->device_id(true) == device_id || p->device_id(false) == device_id;
+      });
+
+      if (it == _pairs.end())
+        return false;
+
+      was_default = it == _pairs.begin();
+      pair = move(*it);
+      _pairs.erase(it);
+    }
+
+    // Devices that still refer to the pair stay valid, but are not called any more.
+    pair->shutdown();
+
+    _notify(audio_device_list_event::device_list_changed);
+    if (was_default) {
+      _notify(audio_device_list_event::default_input_device_changed);
+      _notify(audio_device_list_event::default_output_device_changed);
+    }
+
+    return true;
+  }
+
+  audio_device_list get_device_list(bool is_output) {
+    lock_guard<mutex> lock(_mutex);
+    audio_device_list devices;
+    for (auto it = _pairs.rbegin(); it != _pairs.rend(); ++it)
+      devices.push_front(audio_device(*it, is_output));
+
+    return devices;
+  }
+
+  // The device of the pair that was added first.
+  optional<audio_device> get_default_device(bool is_output) {
+    lock_guard<mutex> lock(_mutex);
+    if (_pairs.empty())
+      return {};
+
+    return audio_device(_pairs.front(), is_output);
+  }
+
+  void set_callback(audio_device_list_event event, function<void()> callback) {
+    lock_guard<mutex> lock(_mutex);
+    _callbacks[size_t(event)] = move(callback);
+  }
+
+private:
+  __audio_loopback_registry() = default;
+
+  void _notify(audio_device_list_event event) {
+    function<void()> callback;
+    {
+      lock_guard<mutex> lock(_mutex);
+      callback = _callbacks[size_t(event)];
+    }
+
+    if (callback)
+      callback();
+  }
+
+  mutex _mutex;
+  vector<shared_ptr<__audio_loopback_pair>> _pairs;
+  unsigned _next_device_id = 1;
+  array<function<void()>, 3> _callbacks;
 };
 
+// Adds a loopback pair, whose devices then appear in the device lists like any
+// other. Returns nullopt if the configuration is invalid. The device list
+// callbacks are called from within this function.
+inline optional<audio_loopback_device_pair> add_audio_loopback_device_pair(audio_loopback_config config = {}) {
+  return __audio_loopback_registry::get_instance().add(move(config));
+}
+
+// Removes the loopback pair that the given device belongs to. Must not be called
+// from within a callback of one of its devices.
+inline bool remove_audio_loopback_device_pair(const audio_device& device) {
+  return __audio_loopback_registry::get_instance().remove(device.device_id());
+}
+
 optional<audio_device> get_default_audio_input_device() {
-  return {};
+  return __audio_loopback_registry::get_instance().get_default_device(false);
 }
 
 optional<audio_device> get_default_audio_output_device() {
-  return {};
+  return __audio_loopback_registry::get_instance().get_default_device(true);
 }
 
 audio_device_list get_audio_input_device_list() {
-  return {};
+  return __audio_loopback_registry::get_instance().get_device_list(false);
 }
 
 audio_device_list get_audio_output_device_list() {
-  return {};
+  return __audio_loopback_registry::get_instance().get_device_list(true);
+}
+
+template <typename F, typename /* = enable_if_t<is_nothrow_invocable_v<F>> */ >
+void set_audio_device_list_callback(audio_device_list_event event, F&& cb) {
+  __audio_loopback_registry::get_instance().set_callback(event, function<void()>(cb));
 }
 
-_LIBSTDAUDIO_NAMESPACE_END
\ No newline at end of file
+_LIBSTDAUDIO_NAMESPACE_END
@@ -134,8 +134,10 @@ public:
 		_processing_thread(std::move(other._processing_thread)),
 		_buffer_frame_count(other._buffer_frame_count),
 		_is_render_device(other._is_render_device),
+		_flush_denormals(other._flush_denormals),
 		_stop_callback(std::move(other._stop_callback)),
-		_user_callback(std::move(other._user_callback))
+		_user_callback(std::move(other._user_callback)),
+		_clock_estimator(other._clock_estimator)
 	{
 		other._device = nullptr;
 		other._audio_client = nullptr;
@@ -161,8 +163,10 @@ public:
 		_processing_thread = std::move(other._processing_thread);
 		_buffer_frame_count = other._buffer_frame_count;
 		_is_render_device = other._is_render_device;
+		_flush_denormals = other._flush_denormals;
 		_stop_callback = std::move(other._stop_callback);
 		_user_callback = std::move(other._user_callback);
+		_clock_estimator = other._clock_estimator;
 
 		other._device = nullptr;
 		other._audio_client = nullptr;
@@ -253,6 +257,38 @@ public:
 		return true;
 	}
 
+	optional<audio_latency> get_input_latency() const noexcept
+	{
+		if (is_input() == false)
+			return nullopt;
+
+		return _get_latency();
+	}
+
+	optional<audio_latency> get_output_latency() const noexcept
+	{
+		if (is_output() == false)
+			return nullopt;
+
+		return _get_latency();
+	}
+
+	// Whether callbacks run with flush-to-zero and denormals-are-zero enabled. Can only
+	// be changed while the device is stopped.
+	bool set_flush_denormals(bool enabled) noexcept
+	{
+		if (_running)
+			return false;
+
+		_flush_denormals = enabled;
+		return true;
+	}
+
+	bool get_flush_denormals() const noexcept
+	{
+		return _flush_denormals;
+	}
+
 	template <typename _SampleType>
 	constexpr bool supports_sample_type() const noexcept
 	{
@@ -361,6 +397,8 @@ public:
 			if (FAILED(hr))
 				return false;
 
+			_clock_estimator.set_nominal_sample_rate(_mix_format.Format.nSamplesPerSec);
+
 			hr = _audio_client->Start();
 			if (FAILED(hr))
 				return false;
@@ -372,6 +410,7 @@ public:
 				_processing_thread = thread{ [this]()
 				{
 					SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+					audio_denormal_guard denormals(_flush_denormals);
 
 					while (_running)
 					{
@@ -470,6 +509,11 @@ public:
 		return num_frames_available > 0;
 	}
 
+	audio_clock_estimate get_clock_estimate() noexcept
+	{
+		return _clock_estimator.get_estimate();
+	}
+
 private:
 	friend class __audio_device_enumerator;
 
@@ -554,6 +598,33 @@ private:
 		CoTaskMemFree(device_mix_format);
 	}
 
+	audio_latency _get_latency() const noexcept
+	{
+		audio_latency latency;
+		latency.sample_rate = _mix_format.Format.nSamplesPerSec;
+		latency.buffer_frames = _buffer_frame_count;
+
+		if (_audio_client == nullptr)
+			return latency;
+
+		// The stream latency is only known once the client has been initialized in start().
+		REFERENCE_TIME stream_latency = 0;
+		if (SUCCEEDED(_audio_client->GetStreamLatency(&stream_latency)))
+			latency.device_frames = _reference_time_to_frames(stream_latency);
+
+		REFERENCE_TIME engine_period = 0;
+		if (SUCCEEDED(_audio_client->GetDevicePeriod(&engine_period, nullptr)))
+			latency.safety_offset_frames = _reference_time_to_frames(engine_period);
+
+		return latency;
+	}
+
+	size_t _reference_time_to_frames(REFERENCE_TIME reference_time) const noexcept
+	{
+		const REFERENCE_TIME ref_times_per_second = 10'000'000;
+		return static_cast<size_t>((reference_time * _mix_format.Format.nSamplesPerSec + ref_times_per_second / 2) / ref_times_per_second);
+	}
+
 	void _fixup_mix_format()
 	{
 		_mix_format.Format.nBlockAlign = _mix_format.Format.nChannels * _mix_format.Format.wBitsPerSample / 8;
@@ -617,7 +688,12 @@ private:
 
 			audio_device_io<_SampleType> device_io;
 			device_io.output_buffer = { reinterpret_cast<_SampleType*>(data), num_frames_available, _mix_format.Format.nChannels, contiguous_interleaved };
-			callback(*this, device_io);
+			device_io.output_time = audio_clock_t::now();
+			_clock_estimator.update(*device_io.output_time, num_frames_available);
+			{
+				audio_realtime_scope realtime;
+				callback(*this, device_io);
+			}
 
 			_audio_render_client->ReleaseBuffer(num_frames_available, 0);
 		}
@@ -631,13 +707,19 @@ private:
 			// TODO: Support device position.
 			DWORD flags = 0;
 			BYTE* data = nullptr;
-			_audio_capture_client->GetBuffer(&data, &next_packet_size, &flags, nullptr, nullptr);
+			UINT64 qpc_position = 0;
+			_audio_capture_client->GetBuffer(&data, &next_packet_size, &flags, nullptr, &qpc_position);
 			if (data == nullptr)
 				return;
 
 			audio_device_io<_SampleType> device_io;
 			device_io.input_buffer = { reinterpret_cast<_SampleType*>(data), next_packet_size, _mix_format.Format.nChannels, contiguous_interleaved };
-			callback(*this, device_io);
+			device_io.input_time = _qpc_position_to_time_point(qpc_position);
+			_clock_estimator.update(*device_io.input_time, next_packet_size);
+			{
+				audio_realtime_scope realtime;
+				callback(*this, device_io);
+			}
 
 			_audio_capture_client->ReleaseBuffer(next_packet_size);
 		}
@@ -668,6 +750,14 @@ private:
 		return true;
 	}
 
+	// The capture position is reported in 100-nanosecond units of the performance counter,
+	// which is also the time base of audio_clock_t on this platform.
+	static audio_clock_t::time_point _qpc_position_to_time_point(UINT64 qpc_position) noexcept
+	{
+		using qpc_duration = chrono::duration<long long, ratio<1, 10'000'000>>;
+		return audio_clock_t::time_point(chrono::duration_cast<audio_clock_t::duration>(qpc_duration(qpc_position)));
+	}
+
 	bool _is_connected() const noexcept
 	{
 		if (_user_callback.valueless_by_exception())
@@ -692,6 +782,7 @@ private:
 	thread _processing_thread;
 	UINT32 _buffer_frame_count = 0;
 	bool _is_render_device = true;
+	bool _flush_denormals = false;
 
 	using __stop_callback_t = function<void(audio_device&)>;
 	__stop_callback_t _stop_callback;
@@ -701,6 +792,8 @@ private:
 	using __wasapi_int16_callback_t = function<void(audio_device&, audio_device_io<int16_t>&)>;
 	variant<__wasapi_float_callback_t, __wasapi_int32_callback_t, __wasapi_int16_callback_t> _user_callback;
 
+	audio_clock_estimator _clock_estimator;
+
 	__wasapi_util::com_initializer _com_initializer;
 };
 
@@ -0,0 +1,208 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#include <audio>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <vector>
+#include "catch/catch.hpp"
+
+using namespace std::experimental;
+
+namespace {
+  // A device driven by a simulated clock that runs at a slightly different
+  // speed than its nominal sample rate says.
+  class virtual_device {
+  public:
+    virtual_device(double nominal_sample_rate, double clock_speed, std::size_t buffer_size_frames,
+                   int num_input_channels, int num_output_channels)
+      : _nominal_sample_rate(nominal_sample_rate),
+        _clock_speed(clock_speed),
+        _buffer_size_frames(buffer_size_frames),
+        _num_input_channels(num_input_channels),
+        _num_output_channels(num_output_channels),
+        _input(buffer_size_frames * std::size_t(num_input_channels)),
+        _output(buffer_size_frames * std::size_t(num_output_channels)) {
+    }
+
+    double get_sample_rate() const noexcept { return _nominal_sample_rate; }
+    std::size_t get_buffer_size_frames() const noexcept { return _buffer_size_frames; }
+    int get_num_input_channels() const noexcept { return _num_input_channels; }
+    int get_num_output_channels() const noexcept { return _num_output_channels; }
+
+    template <typename Callback>
+    void connect(Callback callback) { _callback = std::move(callback); }
+    bool start() { _running = true; return true; }
+    bool stop() { _running = false; return true; }
+
+    double next_callback_seconds() const noexcept {
+      return double(_frame_position) / (_nominal_sample_rate * _clock_speed);
+    }
+
+    // Runs one period at the time given by next_callback_seconds().
+    void run_period(float input_value) {
+      const auto time = audio_clock_t::time_point() + std::chrono::duration_cast<audio_clock_t::duration>(
+        std::chrono::duration<double>(next_callback_seconds()));
+
+      std::fill(_input.begin(), _input.end(), input_value);
+      audio_device_io<float> io;
+      if (_num_input_channels > 0) {
+        io.input_buffer = audio_buffer<float>(_input.data(), _buffer_size_frames, std::size_t(_num_input_channels), contiguous_interleaved);
+        io.input_time = time;
+      }
+      if (_num_output_channels > 0) {
+        io.output_buffer = audio_buffer<float>(_output.data(), _buffer_size_frames, std::size_t(_num_output_channels), contiguous_interleaved);
+        io.output_time = time;
+      }
+
+      if (_running && _callback)
+        _callback(*this, io);
+
+      _frame_position += _buffer_size_frames;
+    }
+
+    const std::vector<float>& last_output() const noexcept { return _output; }
+
+  private:
+    double _nominal_sample_rate;
+    double _clock_speed;
+    std::size_t _buffer_size_frames;
+    int _num_input_channels;
+    int _num_output_channels;
+    std::vector<float> _input, _output;
+    std::size_t _frame_position = 0;
+    bool _running = false;
+    std::function<void(virtual_device&, audio_device_io<float>&)> _callback;
+  };
+
+  // Runs all devices in the order of their simulated callback times.
+  template <typename Visitor>
+  void run_simulation(std::vector<virtual_device*> devices, double duration_seconds, Visitor&& visitor) {
+    for (;;) {
+      auto next = std::min_element(devices.begin(), devices.end(), [](auto* a, auto* b) {
+        return a->next_callback_seconds() < b->next_callback_seconds();
+      });
+
+      const double seconds = (*next)->next_callback_seconds();
+      if (seconds >= duration_seconds)
+        return;
+
+      visitor(**next, seconds);
+    }
+  }
+}
+
+TEST_CASE("Aggregate device sums the channels of all devices")
+{
+  virtual_device a(48'000, 1.0, 256, 2, 2), b(44'100, 1.0, 128, 1, 0), c(96'000, 1.0, 512, 0, 4);
+  audio_aggregate_device<float, virtual_device> aggregate({&a, &b, &c}, 0);
+
+  CHECK(aggregate.num_devices() == 3);
+  CHECK(aggregate.master_index() == 0);
+  CHECK(aggregate.get_num_input_channels() == 3);
+  CHECK(aggregate.get_num_output_channels() == 6);
+  CHECK(aggregate.get_sample_rate() == 48'000);
+}
+
+TEST_CASE("Aggregate device leaves out channels beyond what an audio_buffer can view")
+{
+  constexpr int max_channels = int(audio_buffer<float>::max_num_channels);
+  virtual_device master(48'000, 1.0, 256, 2, max_channels), wide(48'000, 1.0, 256, max_channels, max_channels);
+  audio_aggregate_device<float, virtual_device> aggregate({&master, &wide}, 0);
+
+  REQUIRE(aggregate.get_num_input_channels() == max_channels);
+  REQUIRE(aggregate.get_num_output_channels() == max_channels);
+
+  std::size_t num_callbacks = 0;
+  aggregate.connect([&](auto&, audio_device_io<float>& io) noexcept {
+    if (io.input_buffer->size_channels() == std::size_t(max_channels)
+        && io.output_buffer->size_channels() == std::size_t(max_channels))
+      ++num_callbacks;
+  });
+
+  REQUIRE(aggregate.start());
+  run_simulation({&master, &wide}, 1.0, [](virtual_device& device, double) {
+    device.run_period(0.5f);
+  });
+  aggregate.stop();
+
+  CHECK(num_callbacks > 100);
+
+  // None of the wide device's output channels made it into the aggregate.
+  CHECK(std::all_of(wide.last_output().begin(), wide.last_output().end(), [](float sample) { return sample == 0.0f; }));
+}
+
+TEST_CASE("Aggregate device passes audio between drifting devices without dropouts")
+{
+  // The master runs at 48 kHz; the input device runs 0.2% fast and the output device
+  // at a different nominal rate and 0.1% slow, each with its own period size.
+  virtual_device master(48'000, 1.0, 256, 0, 1);
+  virtual_device input(48'000, 1.002, 192, 1, 0);
+  virtual_device output(44'100, 0.999, 441, 0, 1);
+
+  audio_aggregate_device<float, virtual_device> aggregate({&master, &input, &output}, 0);
+  REQUIRE(aggregate.get_num_input_channels() == 1);
+  REQUIRE(aggregate.get_num_output_channels() == 2);
+
+  aggregate.connect([](auto&, audio_device_io<float>& io) noexcept {
+    auto& in = *io.input_buffer;
+    auto& out = *io.output_buffer;
+    for (std::size_t frame = 0; frame < out.size_frames(); ++frame) {
+      out(frame, 0) = in(frame, 0);
+      out(frame, 1) = 0.25f;
+    }
+  });
+
+  REQUIRE(aggregate.start());
+
+  const double settle_seconds = 5.0;
+  std::size_t underruns_after_settling = 0, overruns_after_settling = 0;
+  float min_master_output = 1.0f, max_master_output = 0.0f;
+  float min_device_output = 1.0f, max_device_output = 0.0f;
+  bool settled = false;
+
+  run_simulation({&master, &input, &output}, 30.0, [&](virtual_device& device, double seconds) {
+    device.run_period(0.5f);
+
+    if (!settled && seconds >= settle_seconds) {
+      settled = true;
+      underruns_after_settling = aggregate.get_underrun_count(1) + aggregate.get_underrun_count(2);
+      overruns_after_settling = aggregate.get_overrun_count(1) + aggregate.get_overrun_count(2);
+    }
+
+    if (settled) {
+      auto [min_out, max_out] = std::minmax_element(device.last_output().begin(), device.last_output().end());
+      if (&device == &master) {
+        min_master_output = std::min(min_master_output, *min_out);
+        max_master_output = std::max(max_master_output, *max_out);
+      }
+      else if (&device == &output) {
+        min_device_output = std::min(min_device_output, *min_out);
+        max_device_output = std::max(max_device_output, *max_out);
+      }
+    }
+  });
+
+  aggregate.stop();
+
+  CHECK(aggregate.get_underrun_count(1) + aggregate.get_underrun_count(2) == underruns_after_settling);
+  CHECK(aggregate.get_overrun_count(1) + aggregate.get_overrun_count(2) == overruns_after_settling);
+
+  CHECK(min_master_output == Approx(0.5f).margin(1e-3));
+  CHECK(max_master_output == Approx(0.5f).margin(1e-3));
+  CHECK(min_device_output == Approx(0.25f).margin(1e-3));
+  CHECK(max_device_output == Approx(0.25f).margin(1e-3));
+
+  // The resampling ratios converge to the ratio of the actual clock rates.
+  CHECK(aggregate.get_input_resampling_ratio(1) == Approx(1.0 / 1.002).epsilon(2e-4));
+  CHECK(aggregate.get_output_resampling_ratio(2) == Approx(44'100 * 0.999 / 48'000).epsilon(2e-4));
+
+  // The estimates the audio thread used are published for control threads.
+  CHECK(aggregate.get_clock_estimate(0).num_periods > 1000);
+  CHECK(aggregate.get_clock_estimate(1).rate_ratio == Approx(1.002).epsilon(2e-4));
+  CHECK(aggregate.get_clock_estimate(2).rate_ratio == Approx(0.999).epsilon(2e-4));
+}
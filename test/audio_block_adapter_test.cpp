@@ -0,0 +1,156 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#include <audio>
+#include <random>
+#include <vector>
+#include "catch/catch.hpp"
+
+using namespace std::experimental;
+
+namespace {
+  struct fake_device {};
+
+  // Calls the adapter with randomly sized periods, feeding a ramp into every input
+  // channel and recording the first output channel.
+  template <typename Adapter>
+  std::vector<float> run_with_random_period_sizes(Adapter& adapter, std::size_t num_channels, std::size_t total_frames, unsigned seed) {
+    fake_device device;
+    std::minstd_rand gen(seed);
+    std::uniform_int_distribution<std::size_t> period_sizes(1, 700);
+
+    std::vector<float> result;
+    std::vector<float> input, output;
+    std::size_t frame_position = 0;
+
+    while (frame_position < total_frames) {
+      const std::size_t num_frames = period_sizes(gen);
+      input.resize(num_frames * num_channels);
+      output.assign(num_frames * num_channels, -1.0f);
+
+      for (std::size_t frame = 0; frame < num_frames; ++frame)
+        for (std::size_t channel = 0; channel < num_channels; ++channel)
+          input[frame * num_channels + channel] = float(frame_position + frame + 1) * (channel == 0 ? 1.0f : -1.0f);
+
+      audio_device_io<float> io;
+      io.input_buffer = audio_buffer<float>(input.data(), num_frames, num_channels, contiguous_interleaved);
+      io.output_buffer = audio_buffer<float>(output.data(), num_frames, num_channels, contiguous_interleaved);
+      adapter(device, io);
+
+      for (std::size_t frame = 0; frame < num_frames; ++frame) {
+        result.push_back(output[frame * num_channels]);
+        CHECK(output[frame * num_channels + 1] == -output[frame * num_channels]);
+      }
+
+      frame_position += num_frames;
+    }
+
+    return result;
+  }
+}
+
+TEST_CASE("Block adapter always calls the callback with the block size")
+{
+  for (std::size_t block_size : {1, 16, 64, 256, 1024}) {
+    std::size_t num_calls = 0;
+    bool all_blocks_full = true;
+
+    auto adapter = make_audio_block_adapter<float>(block_size, 2, 2, [&](fake_device&, audio_device_io<float>& io) noexcept {
+      ++num_calls;
+      all_blocks_full = all_blocks_full
+                        && io.input_buffer->size_frames() == block_size
+                        && io.output_buffer->size_frames() == block_size;
+    });
+
+    auto output = run_with_random_period_sizes(adapter, 2, 20'000, unsigned(block_size));
+    CHECK(all_blocks_full);
+    CHECK(num_calls == output.size() / block_size);
+  }
+}
+
+TEST_CASE("Block adapter delays the signal by exactly its reported latency")
+{
+  for (std::size_t block_size : {1, 32, 128, 512}) {
+    auto adapter = make_audio_block_adapter<float>(block_size, 2, 2, [](fake_device&, audio_device_io<float>& io) noexcept {
+      auto& in = *io.input_buffer;
+      auto& out = *io.output_buffer;
+      for (std::size_t frame = 0; frame < out.size_frames(); ++frame)
+        for (std::size_t channel = 0; channel < out.size_channels(); ++channel)
+          out(frame, channel) = in(frame, channel);
+    });
+
+    REQUIRE(adapter.latency_frames() == block_size - 1);
+
+    auto output = run_with_random_period_sizes(adapter, 2, 20'000, 1234);
+    bool signal_matches = true;
+    for (std::size_t i = 0; i < output.size(); ++i) {
+      float expected = i < adapter.latency_frames() ? 0.0f : float(i - adapter.latency_frames() + 1);
+      signal_matches = signal_matches && output[i] == expected;
+    }
+
+    CHECK(signal_matches);
+  }
+}
+
+TEST_CASE("Block adapter fills output-only devices continuously")
+{
+  float next_value = 1;
+  auto adapter = make_audio_block_adapter<float>(64, 0, 1, [&](fake_device&, audio_device_io<float>& io) noexcept {
+    CHECK_FALSE(io.input_buffer.has_value());
+    auto& out = *io.output_buffer;
+    for (std::size_t frame = 0; frame < out.size_frames(); ++frame)
+      out(frame, 0) = next_value++;
+  });
+
+  fake_device device;
+  std::minstd_rand gen(99);
+  std::uniform_int_distribution<std::size_t> period_sizes(1, 300);
+  std::vector<float> result;
+
+  while (result.size() < 10'000) {
+    std::vector<float> output(period_sizes(gen) * 2, -1.0f);
+    audio_device_io<float> io;
+    io.output_buffer = audio_buffer<float>(output.data(), output.size() / 2, 2, contiguous_interleaved);
+    adapter(device, io);
+
+    for (std::size_t frame = 0; frame < output.size() / 2; ++frame) {
+      result.push_back(output[2 * frame]);
+      CHECK(output[2 * frame + 1] == 0.0f);
+    }
+  }
+
+  bool signal_matches = true;
+  for (std::size_t i = 0; i < result.size(); ++i) {
+    float expected = i < 63 ? 0.0f : float(i - 62);
+    signal_matches = signal_matches && result[i] == expected;
+  }
+
+  CHECK(signal_matches);
+}
+
+TEST_CASE("Block adapter reset restores the initial latency")
+{
+  auto adapter = make_audio_block_adapter<float>(8, 1, 1, [](fake_device&, audio_device_io<float>& io) noexcept {
+    for (std::size_t frame = 0; frame < 8; ++frame)
+      (*io.output_buffer)(frame, 0) = 1.0f;
+  });
+
+  fake_device device;
+  std::array<float, 5> data = {};
+
+  auto process = [&] {
+    audio_device_io<float> io;
+    io.output_buffer = audio_buffer<float>(data.data(), data.size(), 1, contiguous_interleaved);
+    adapter(device, io);
+  };
+
+  process();
+  process();
+  CHECK(data == std::array<float, 5>{0, 0, 1, 1, 1});
+
+  adapter.reset();
+  process();
+  CHECK(data == std::array<float, 5>{0, 0, 0, 0, 0});
+}
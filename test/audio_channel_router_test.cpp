@@ -0,0 +1,184 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#include <audio>
+#include <vector>
+#include "catch/catch.hpp"
+
+using namespace std::experimental;
+
+namespace {
+  constexpr float minus_3_db = 0.70710678f;
+
+  // Sample (frame, channel) of the test input is unique and easy to predict.
+  float input_sample(std::size_t frame, std::size_t channel) {
+    return float(channel + 1) + 0.001f * float(frame);
+  }
+
+  template <typename _SampleType>
+  std::vector<_SampleType> make_input(std::size_t num_frames, std::size_t num_channels, bool interleaved) {
+    std::vector<_SampleType> data(num_frames * num_channels);
+    for (std::size_t frame = 0; frame < num_frames; ++frame)
+      for (std::size_t channel = 0; channel < num_channels; ++channel)
+        data[interleaved ? frame * num_channels + channel : channel * num_frames + frame] = _SampleType(input_sample(frame, channel));
+
+    return data;
+  }
+
+  template <typename _SampleType>
+  audio_buffer<_SampleType> make_buffer(std::vector<_SampleType>& data, std::size_t num_frames, std::size_t num_channels, bool interleaved) {
+    if (interleaved)
+      return audio_buffer<_SampleType>(data.data(), num_frames, num_channels, contiguous_interleaved);
+
+    return audio_buffer<_SampleType>(data.data(), num_frames, num_channels, contiguous_deinterleaved);
+  }
+
+  // Routes the test input and checks every output sample against the matrix.
+  template <typename _SampleType>
+  void check_process(audio_channel_router<_SampleType>& router, std::size_t num_frames, bool interleaved_input, bool interleaved_output) {
+    const std::size_t num_inputs = router.num_input_channels(), num_outputs = router.num_output_channels();
+    auto input_data = make_input<_SampleType>(num_frames, num_inputs, interleaved_input);
+    std::vector<_SampleType> output_data(num_frames * num_outputs, _SampleType(-99));
+
+    auto input = make_buffer(input_data, num_frames, num_inputs, interleaved_input);
+    auto output = make_buffer(output_data, num_frames, num_outputs, interleaved_output);
+    router.process(input, output);
+
+    for (std::size_t frame = 0; frame < num_frames; ++frame) {
+      for (std::size_t out = 0; out < num_outputs; ++out) {
+        double expected = 0;
+        for (std::size_t in = 0; in < num_inputs; ++in)
+          expected += double(router.get_gain(out, in)) * double(input_sample(frame, in));
+
+        REQUIRE(double(output(frame, out)) == Approx(expected).margin(1e-4));
+      }
+    }
+  }
+
+  template <typename _SampleType>
+  void check_all_layouts(audio_channel_router<_SampleType>& router) {
+    for (std::size_t num_frames : {1, 7, 100, 1500}) {
+      check_process(router, num_frames, true, true);
+      check_process(router, num_frames, true, false);
+      check_process(router, num_frames, false, true);
+      check_process(router, num_frames, false, false);
+    }
+  }
+}
+
+TEST_CASE("Channel router starts as the identity")
+{
+  audio_channel_router<float> router(3, 5);
+  REQUIRE(router.num_input_channels() == 3);
+  REQUIRE(router.num_output_channels() == 5);
+  REQUIRE(router.is_pure_routing());
+
+  for (std::size_t out = 0; out < 5; ++out)
+    for (std::size_t in = 0; in < 3; ++in)
+      REQUIRE(router.get_gain(out, in) == (out == in ? 1.0f : 0.0f));
+
+  check_all_layouts(router);
+}
+
+TEST_CASE("Channel router permutes and duplicates channels as pure routing")
+{
+  audio_channel_router<float> router(4, 6, 256);
+  router.clear();
+  router.set_gain(0, 3, 1.0f);
+  router.set_gain(1, 0, 1.0f);
+  router.set_gain(2, 0, 1.0f);
+  router.set_gain(5, 2, 1.0f);
+  REQUIRE(router.is_pure_routing());
+  check_all_layouts(router);
+
+  router.set_gain(5, 2, 0.5f);
+  REQUIRE_FALSE(router.is_pure_routing());
+  check_all_layouts(router);
+}
+
+TEST_CASE("Channel router mixes with a dense matrix")
+{
+  audio_channel_router<float> router(8, 3, 64);
+  for (std::size_t out = 0; out < 3; ++out)
+    for (std::size_t in = 0; in < 8; ++in)
+      router.set_gain(out, in, 0.1f * float(out + 1) - 0.05f * float(in));
+
+  check_all_layouts(router);
+
+  SECTION("in double precision") {
+    audio_channel_router<double> double_router(8, 3, 64);
+    for (std::size_t out = 0; out < 3; ++out)
+      for (std::size_t in = 0; in < 8; ++in)
+        double_router.set_gain(out, in, router.get_gain(out, in));
+
+    check_all_layouts(double_router);
+  }
+}
+
+TEST_CASE("Channel router converts between standard layouts")
+{
+  SECTION("mono to stereo copies to both channels") {
+    audio_channel_router<float> router(audio_channel_layout::mono, audio_channel_layout::stereo);
+    REQUIRE(router.get_gain(0, 0) == 1.0f);
+    REQUIRE(router.get_gain(1, 0) == 1.0f);
+    REQUIRE(router.is_pure_routing());
+  }
+
+  SECTION("stereo to mono averages") {
+    audio_channel_router<float> router(audio_channel_layout::stereo, audio_channel_layout::mono);
+    REQUIRE(router.get_gain(0, 0) == 0.5f);
+    REQUIRE(router.get_gain(0, 1) == 0.5f);
+  }
+
+  SECTION("5.1 to stereo follows ITU-R BS.775") {
+    audio_channel_router<float> router(audio_channel_layout::surround_5_1, audio_channel_layout::stereo);
+    const float left[] = {1, 0, minus_3_db, 0, minus_3_db, 0};
+    const float right[] = {0, 1, minus_3_db, 0, 0, minus_3_db};
+    for (std::size_t in = 0; in < 6; ++in) {
+      REQUIRE(router.get_gain(0, in) == Approx(left[in]));
+      REQUIRE(router.get_gain(1, in) == Approx(right[in]));
+    }
+
+    check_all_layouts(router);
+  }
+
+  SECTION("stereo to 5.1 uses the front channels") {
+    audio_channel_router<float> router(audio_channel_layout::stereo, audio_channel_layout::surround_5_1);
+    REQUIRE(router.is_pure_routing());
+    for (std::size_t out = 0; out < 6; ++out)
+      for (std::size_t in = 0; in < 2; ++in)
+        REQUIRE(router.get_gain(out, in) == (out == in ? 1.0f : 0.0f));
+  }
+
+  SECTION("7.1 to 5.1 folds the back into the surround channels") {
+    audio_channel_router<float> router(audio_channel_layout::surround_7_1, audio_channel_layout::surround_5_1);
+    REQUIRE(router.get_gain(4, 4) == Approx(minus_3_db));
+    REQUIRE(router.get_gain(4, 6) == 1.0f);
+    REQUIRE(router.get_gain(5, 5) == Approx(minus_3_db));
+    REQUIRE(router.get_gain(5, 7) == 1.0f);
+    REQUIRE(router.get_gain(3, 3) == 1.0f);
+  }
+
+  SECTION("5.1 to mono") {
+    audio_channel_router<float> router(audio_channel_layout::surround_5_1, audio_channel_layout::mono);
+    const float expected[] = {0.5f, 0.5f, minus_3_db, 0, 0.5f * minus_3_db, 0.5f * minus_3_db};
+    for (std::size_t in = 0; in < 6; ++in)
+      REQUIRE(router.get_gain(0, in) == Approx(expected[in]));
+  }
+
+  SECTION("to a device with more channels than the layout") {
+    audio_channel_router<float> router(audio_channel_layout::stereo, 3);
+    REQUIRE(router.num_output_channels() == 3);
+    REQUIRE(router.get_gain(0, 0) == 1.0f);
+    REQUIRE(router.get_gain(1, 1) == 1.0f);
+    REQUIRE(router.get_gain(2, 0) == 0.0f);
+    REQUIRE(router.get_gain(2, 1) == 0.0f);
+
+    audio_channel_router<float> wide(audio_channel_layout::surround_5_1, 64);
+    REQUIRE(wide.get_gain(0, 0) == 1.0f);
+    REQUIRE(wide.get_gain(7, 5) == 1.0f);
+    check_all_layouts(wide);
+  }
+}
@@ -0,0 +1,137 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#include <audio>
+#include <random>
+#include "catch/catch.hpp"
+
+using namespace std::experimental;
+
+namespace {
+  // Simulates a device whose clock runs at actual_sample_rate, timestamped with jitter.
+  struct simulated_clock {
+    double actual_sample_rate;
+    double jitter_seconds = 0;
+    audio_clock_t::time_point start = audio_clock_t::time_point() + std::chrono::hours(1);
+    std::minstd_rand gen{42};
+    double frame_position = 0;
+
+    audio_clock_t::time_point next_timestamp(std::size_t num_frames) {
+      std::uniform_real_distribution<double> noise(-jitter_seconds, jitter_seconds);
+      const double seconds = frame_position / actual_sample_rate + noise(gen);
+      frame_position += double(num_frames);
+      return start + std::chrono::duration_cast<audio_clock_t::duration>(std::chrono::duration<double>(seconds));
+    }
+  };
+
+  double to_seconds(audio_clock_t::duration d) {
+    return std::chrono::duration<double>(d).count();
+  }
+}
+
+TEST_CASE("Clock estimator reports nothing before the first period")
+{
+  audio_clock_estimator estimator(48000);
+  auto estimate = estimator.get_estimate();
+  CHECK(estimate.num_periods == 0);
+  CHECK_FALSE(estimate.next_period_time.has_value());
+}
+
+TEST_CASE("Clock estimator ignores updates without a nominal sample rate")
+{
+  audio_clock_estimator estimator;
+  estimator.update(audio_clock_t::now(), 256);
+  CHECK(estimator.get_estimate().num_periods == 0);
+}
+
+TEST_CASE("Clock estimator converges to the actual rate of a drifting clock")
+{
+  simulated_clock clock{48'010.0, 50e-6};
+  audio_clock_estimator estimator(48'000.0);
+
+  for (int i = 0; i < 4000; ++i)
+    estimator.update(clock.next_timestamp(256), 256);
+
+  auto estimate = estimator.get_estimate();
+  CHECK(estimate.num_periods == 4000);
+  CHECK(estimate.rate_ratio == Approx(48'010.0 / 48'000.0).epsilon(2e-5));
+  CHECK(estimate.sample_rate == Approx(48'010.0).epsilon(2e-5));
+}
+
+TEST_CASE("Clock estimator predicts the time of the next period")
+{
+  simulated_clock clock{44'100.0 * 0.9995};
+  audio_clock_estimator estimator(44'100.0);
+
+  for (int i = 0; i < 2000; ++i)
+    estimator.update(clock.next_timestamp(512), 512);
+
+  auto estimate = estimator.get_estimate();
+  REQUIRE(estimate.next_period_time.has_value());
+
+  auto actual_next_period_time = clock.next_timestamp(512);
+  CHECK(std::abs(to_seconds(*estimate.next_period_time - actual_next_period_time)) < 1e-6);
+}
+
+TEST_CASE("Clock estimator handles periods of varying size")
+{
+  simulated_clock clock{96'000.0 * 1.0002, 20e-6};
+  audio_clock_estimator estimator(96'000.0);
+  std::minstd_rand gen(7);
+  std::uniform_int_distribution<std::size_t> period_sizes(400, 600);
+
+  for (int i = 0; i < 4000; ++i) {
+    auto num_frames = period_sizes(gen);
+    estimator.update(clock.next_timestamp(num_frames), num_frames);
+  }
+
+  CHECK(estimator.get_estimate().rate_ratio == Approx(1.0002).epsilon(2e-5));
+}
+
+TEST_CASE("Clock estimator measures timestamp jitter")
+{
+  const double jitter_seconds = 100e-6;
+  simulated_clock clock{48'000.0, jitter_seconds};
+  audio_clock_estimator estimator(48'000.0);
+
+  for (int i = 0; i < 4000; ++i)
+    estimator.update(clock.next_timestamp(256), 256);
+
+  // uniform noise in [-a, a] has an RMS value of a / sqrt(3)
+  auto jitter = to_seconds(estimator.get_estimate().jitter);
+  CHECK(jitter > 0.5 * jitter_seconds / std::sqrt(3.0));
+  CHECK(jitter < 2.0 * jitter_seconds / std::sqrt(3.0));
+}
+
+TEST_CASE("Clock estimator restarts after a discontinuity")
+{
+  simulated_clock clock{48'000.0};
+  audio_clock_estimator estimator(48'000.0);
+
+  for (int i = 0; i < 100; ++i)
+    estimator.update(clock.next_timestamp(256), 256);
+
+  clock.frame_position += 48'000.0;
+  estimator.update(clock.next_timestamp(256), 256);
+  CHECK(estimator.get_estimate().num_periods == 1);
+
+  estimator.update(clock.next_timestamp(256), 256);
+  CHECK(estimator.get_estimate().num_periods == 2);
+}
+
+TEST_CASE("Clock estimator resets when the nominal sample rate changes")
+{
+  simulated_clock clock{48'000.0};
+  audio_clock_estimator estimator(48'000.0);
+  estimator.update(clock.next_timestamp(256), 256);
+
+  estimator.set_nominal_sample_rate(44'100.0);
+  CHECK(estimator.get_nominal_sample_rate() == 44'100.0);
+
+  estimator.update(clock.next_timestamp(256), 256);
+  auto estimate = estimator.get_estimate();
+  CHECK(estimate.num_periods == 1);
+  CHECK(estimate.rate_ratio == 1.0);
+}
@@ -0,0 +1,169 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#include <audio>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "catch/catch.hpp"
+
+using namespace std::experimental;
+
+TEST_CASE("Command queue is first in, first out and bounded")
+{
+  audio_command_queue<int> queue(3);
+  REQUIRE(queue.capacity() == 4);
+
+  for (int i = 0; i < 4; ++i)
+    CHECK(queue.try_push(i));
+  CHECK_FALSE(queue.try_push(4));
+
+  int command = -1;
+  for (int i = 0; i < 4; ++i) {
+    CHECK(queue.try_pop(command));
+    CHECK(command == i);
+  }
+  CHECK_FALSE(queue.try_pop(command));
+
+  CHECK(queue.try_push(5));
+  CHECK(queue.drain([](int c) { CHECK(c == 5); }) == 1);
+}
+
+TEST_CASE("Command queue delivers every command from many producers")
+{
+  constexpr int num_producers = 4;
+  constexpr int commands_per_producer = 50'000;
+  audio_command_queue<std::pair<int, int>> queue(256);
+
+  std::vector<std::thread> producers;
+  for (int p = 0; p < num_producers; ++p) {
+    producers.emplace_back([&queue, p] {
+      for (int i = 0; i < commands_per_producer; ++i)
+        while (!queue.try_push({p, i}))
+          std::this_thread::yield();
+    });
+  }
+
+  // Commands of each producer arrive in order.
+  std::vector<int> next(num_producers, 0);
+  int num_received = 0;
+  bool in_order = true;
+  while (num_received < num_producers * commands_per_producer) {
+    queue.drain([&](const std::pair<int, int>& command) {
+      in_order = in_order && command.second == next[std::size_t(command.first)];
+      ++next[std::size_t(command.first)];
+      ++num_received;
+    });
+  }
+
+  for (auto& producer : producers)
+    producer.join();
+
+  CHECK(in_order);
+  CHECK(num_received == num_producers * commands_per_producer);
+}
+
+TEST_CASE("Event queue splits the period at event times")
+{
+  audio_event_queue<float> queue(16);
+  const auto period_time = audio_clock_t::time_point() + std::chrono::seconds(1);
+  const double sample_rate = 1000;
+
+  queue.push(0.5f, period_time + std::chrono::milliseconds(10));
+  queue.push(0.25f, period_time + std::chrono::milliseconds(3));
+  queue.push(1.0f);
+  queue.push(2.0f, period_time + std::chrono::milliseconds(40));
+
+  std::vector<float> output(32);
+  float value = 0;
+  std::vector<std::pair<std::size_t, std::size_t>> segments;
+
+  queue.process(output.size(), period_time, sample_rate,
+    [&](float v) { value = v; },
+    [&](std::size_t first, std::size_t last) {
+      segments.emplace_back(first, last);
+      for (std::size_t frame = first; frame < last; ++frame)
+        output[frame] = value;
+    });
+
+  CHECK(segments == std::vector<std::pair<std::size_t, std::size_t>>{{0, 3}, {3, 10}, {10, 32}});
+  CHECK(output[0] == 1.0f);
+  CHECK(output[2] == 1.0f);
+  CHECK(output[3] == 0.25f);
+  CHECK(output[9] == 0.25f);
+  CHECK(output[10] == 0.5f);
+  CHECK(output[31] == 0.5f);
+
+  // The last event falls into the next period, at frame 40 - 32 = 8.
+  segments.clear();
+  queue.process(output.size(), period_time + std::chrono::milliseconds(32), sample_rate,
+    [&](float v) { value = v; },
+    [&](std::size_t first, std::size_t last) { segments.emplace_back(first, last); });
+
+  CHECK(value == 2.0f);
+  CHECK(segments == std::vector<std::pair<std::size_t, std::size_t>>{{0, 8}, {8, 32}});
+}
+
+TEST_CASE("Event queue applies late events at the start of the period")
+{
+  audio_event_queue<int> queue(4);
+  const auto period_time = audio_clock_t::time_point() + std::chrono::seconds(1);
+  queue.push(1, period_time - std::chrono::milliseconds(5));
+  queue.push(2, period_time - std::chrono::milliseconds(1));
+
+  std::vector<int> events;
+  std::size_t num_segments = 0;
+  queue.process(64, period_time, 48'000,
+    [&](int event) { events.push_back(event); },
+    [&](std::size_t first, std::size_t last) { ++num_segments; CHECK(first == 0); CHECK(last == 64); });
+
+  CHECK(events == std::vector<int>{1, 2});
+  CHECK(num_segments == 1);
+}
+
+TEST_CASE("Event queue reads the period from a device callback")
+{
+  audio_event_queue<int> queue(4);
+  std::vector<float> data(100);
+  audio_device_io<float> io;
+  io.output_buffer = audio_buffer<float>(data.data(), 100, 1, contiguous_interleaved);
+  io.output_time = audio_clock_t::time_point() + std::chrono::seconds(5);
+
+  queue.push(7, *io.output_time + std::chrono::microseconds(500));
+
+  std::size_t event_frame = 0, rendered_until = 0;
+  queue.process(io, 100'000,
+    [&](int) { event_frame = rendered_until; },
+    [&](std::size_t, std::size_t last) { rendered_until = last; });
+
+  CHECK(event_frame == 50);
+  CHECK(rendered_until == 100);
+}
+
+TEST_CASE("Garbage queue destroys retired objects on the collecting thread")
+{
+  audio_garbage_queue garbage(2);
+  auto tracker = std::make_shared<int>(0);
+
+  auto a = std::make_unique<std::shared_ptr<int>>(tracker);
+  auto b = std::make_unique<std::shared_ptr<int>>(tracker);
+  auto c = std::make_unique<std::shared_ptr<int>>(tracker);
+  CHECK(tracker.use_count() == 4);
+
+  CHECK(garbage.retire(a));
+  CHECK(garbage.retire(b));
+  CHECK_FALSE(garbage.retire(c));
+  CHECK(a == nullptr);
+  CHECK(c != nullptr);
+  CHECK(tracker.use_count() == 4);
+
+  CHECK(garbage.collect() == 2);
+  CHECK(tracker.use_count() == 2);
+  CHECK(garbage.retire(c));
+  CHECK(garbage.collect() == 1);
+  CHECK(tracker.use_count() == 1);
+}
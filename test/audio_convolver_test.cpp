@@ -0,0 +1,127 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#include <audio>
+#include <cmath>
+#include <vector>
+#include "catch/catch.hpp"
+
+using namespace std::experimental;
+
+namespace {
+  std::vector<float> noise(std::size_t n, std::uint64_t seed) {
+    audio_noise_generator generator(audio_noise_color::white, 1, seed);
+    std::vector<float> result(n);
+    generator.render(result.data(), n);
+    return result;
+  }
+
+  // A decaying noise burst, like the tail of a room.
+  std::vector<float> impulse_response(std::size_t length, std::uint64_t seed) {
+    auto result = noise(length, seed);
+    for (std::size_t i = 0; i < length; ++i)
+      result[i] *= float(std::exp(-3.0 * double(i) / double(length)));
+
+    return result;
+  }
+
+  std::vector<double> direct_convolution(const std::vector<float>& x, const std::vector<float>& h) {
+    std::vector<double> y(x.size());
+    for (std::size_t n = 0; n < x.size(); ++n)
+      for (std::size_t m = 0; m < h.size() && m <= n; ++m)
+        y[n] += double(h[m]) * double(x[n - m]);
+
+    return y;
+  }
+
+  // Feeds the convolver deinterleaved blocks of varying sizes, in place.
+  std::vector<std::vector<float>> convolve(audio_convolver& convolver, std::vector<std::vector<float>> signals) {
+    const std::size_t num_frames = signals[0].size();
+    const std::size_t block_sizes[] = {1, 17, 64, 5, 200, 33, 128};
+    std::vector<float*> channels(signals.size());
+
+    for (std::size_t first = 0, i = 0; first < num_frames; ++i) {
+      const std::size_t n = std::min(block_sizes[i % 7], num_frames - first);
+      for (std::size_t channel = 0; channel < signals.size(); ++channel)
+        channels[channel] = signals[channel].data() + first;
+
+      audio_buffer<float> buffer(channels.data(), n, signals.size(), ptr_to_ptr_deinterleaved);
+      convolver.process(buffer);
+      first += n;
+    }
+
+    return signals;
+  }
+
+  double max_error(const std::vector<float>& actual, const std::vector<double>& expected) {
+    double error = 0;
+    for (std::size_t i = 0; i < actual.size(); ++i)
+      error = std::max(error, std::abs(double(actual[i]) - expected[i]));
+
+    return error;
+  }
+}
+
+TEST_CASE("The convolver has no latency")
+{
+  const auto h = impulse_response(3000, 1);
+  audio_convolver convolver({h}, 64, 1024, false);
+
+  std::vector<float> x(4000, 0.0f);
+  x[0] = 1.0f;
+  const auto y = convolve(convolver, {x})[0];
+
+  for (std::size_t i = 0; i < h.size(); ++i)
+    REQUIRE(y[i] == Approx(h[i]).margin(1e-5));
+
+  for (std::size_t i = h.size(); i < y.size(); ++i)
+    REQUIRE(y[i] == Approx(0).margin(1e-5));
+}
+
+TEST_CASE("The convolver matches direct convolution")
+{
+  // With blocks of 32 and partitions of up to 1024, 5000 samples need a head, a
+  // segment computed in the callback and two tail segments.
+  const auto x = noise(20'000, 2);
+
+  SECTION("impulse response shorter than a block") {
+    const auto h = impulse_response(20, 3);
+    audio_convolver convolver({h}, 32, 1024, false);
+    REQUIRE(max_error(convolve(convolver, {x})[0], direct_convolution(x, h)) < 1e-5);
+  }
+
+  SECTION("tail computed in the callback") {
+    const auto h = impulse_response(5000, 3);
+    audio_convolver convolver({h}, 32, 1024, false);
+    REQUIRE(max_error(convolve(convolver, {x})[0], direct_convolution(x, h)) < 1e-4);
+  }
+
+  SECTION("tail computed on background threads") {
+    const auto h = impulse_response(5000, 3);
+    audio_convolver convolver({h}, 32, 1024, true);
+    REQUIRE(max_error(convolve(convolver, {x})[0], direct_convolution(x, h)) < 1e-4);
+  }
+}
+
+TEST_CASE("The convolver convolves every channel with its own impulse response")
+{
+  const std::vector<std::vector<float>> h = {impulse_response(700, 4), impulse_response(2500, 5)};
+  const std::vector<std::vector<float>> x = {noise(6000, 6), noise(6000, 7)};
+
+  audio_convolver convolver(h, 16, 256);
+  REQUIRE(convolver.num_channels() == 2);
+  REQUIRE(convolver.impulse_response_length() == 2500);
+
+  const auto y = convolve(convolver, x);
+  for (std::size_t channel = 0; channel < 2; ++channel)
+    REQUIRE(max_error(y[channel], direct_convolution(x[channel], h[channel])) < 1e-4);
+
+  SECTION("reset clears the history") {
+    convolver.reset();
+    const auto again = convolve(convolver, x);
+    for (std::size_t channel = 0; channel < 2; ++channel)
+      REQUIRE(max_error(again[channel], direct_convolution(x[channel], h[channel])) < 1e-4);
+  }
+}
@@ -0,0 +1,77 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#include <audio>
+#include <atomic>
+#include <limits>
+#include "catch/catch.hpp"
+
+using namespace std::experimental;
+
+namespace {
+  // Computed at run time so that the compiler cannot fold it.
+  float halve_smallest_normal() {
+    volatile float smallest_normal = std::numeric_limits<float>::min();
+    volatile float half = 0.5f;
+    return smallest_normal * half;
+  }
+}
+
+TEST_CASE("Denormals are produced by default")
+{
+  CHECK(halve_smallest_normal() != 0.0f);
+}
+
+TEST_CASE("Denormal guard flushes denormals and restores the previous mode")
+{
+  if (!__audio_fp_mode::is_supported())
+    return;
+
+  const auto previous_mode = __audio_fp_mode::get();
+  {
+    audio_denormal_guard denormals;
+    CHECK(__audio_fp_mode::flushes_denormals());
+    CHECK(halve_smallest_normal() == 0.0f);
+  }
+
+  CHECK(__audio_fp_mode::get() == previous_mode);
+  CHECK(halve_smallest_normal() != 0.0f);
+}
+
+TEST_CASE("Disabled denormal guard leaves the mode alone")
+{
+  audio_denormal_guard denormals(false);
+  CHECK_FALSE(__audio_fp_mode::flushes_denormals());
+  CHECK(halve_smallest_normal() != 0.0f);
+}
+
+TEST_CASE("Worker pool tasks inherit flushing of denormals from the caller")
+{
+  if (!__audio_fp_mode::is_supported())
+    return;
+
+  audio_worker_pool pool(2);
+  std::atomic<int> num_flushed = 0;
+  constexpr std::size_t num_tasks = 64;
+
+  auto count_flushed = [&](std::size_t) {
+    if (halve_smallest_normal() == 0.0f)
+      ++num_flushed;
+  };
+
+  pool.parallel_for(num_tasks, count_flushed);
+  CHECK(num_flushed == 0);
+
+  {
+    audio_denormal_guard denormals;
+    pool.parallel_for(num_tasks, count_flushed);
+  }
+
+  CHECK(num_flushed == num_tasks);
+
+  num_flushed = 0;
+  pool.parallel_for(num_tasks, count_flushed);
+  CHECK(num_flushed == 0);
+}
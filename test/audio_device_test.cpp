@@ -201,6 +201,49 @@ TEST_CASE("Setting a supported buffer size on output devices")
   // TODO: this needs to wait until we have an API to query supported settings
 }
 
+TEST_CASE("Input devices report an input latency that includes their buffer size")
+{
+  auto devices = get_audio_input_device_list();
+  for (auto& device : devices) {
+    auto latency = device.get_input_latency();
+    REQUIRE(latency.has_value());
+    CHECK(latency->buffer_frames == device.get_buffer_size_frames());
+    CHECK(latency->total_frames() >= latency->buffer_frames);
+  }
+}
+
+TEST_CASE("Output devices report an output latency that includes their buffer size")
+{
+  auto devices = get_audio_output_device_list();
+  for (auto& device : devices) {
+    auto latency = device.get_output_latency();
+    REQUIRE(latency.has_value());
+    CHECK(latency->buffer_frames == device.get_buffer_size_frames());
+    CHECK(latency->total_frames() >= latency->buffer_frames);
+  }
+}
+
+TEST_CASE("Latency components are converted to durations using the sample rate")
+{
+  audio_latency latency;
+  latency.device_frames = 24;
+  latency.safety_offset_frames = 8;
+  latency.buffer_frames = 64;
+  latency.sample_rate = 48000;
+
+  CHECK(latency.total_frames() == 96);
+  CHECK(latency.device_duration() == std::chrono::microseconds(500));
+  CHECK(latency.buffer_duration() == std::chrono::nanoseconds(1'333'333));
+  CHECK(latency.total_duration() == std::chrono::milliseconds(2));
+}
+
+TEST_CASE("Latency durations are zero without a sample rate")
+{
+  audio_latency latency;
+  latency.buffer_frames = 64;
+  CHECK(latency.total_duration() == std::chrono::nanoseconds(0));
+}
+
 TEST_CASE("On any platform that supports multithreading, all input devices must support connect")
 {
   if (std::thread::hardware_concurrency()) {
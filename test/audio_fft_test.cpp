@@ -0,0 +1,81 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#include <audio>
+#include <cmath>
+#include <vector>
+#include "catch/catch.hpp"
+
+using namespace std::experimental;
+
+namespace {
+  constexpr double pi = 3.14159265358979323846;
+
+  std::vector<float> noise(std::size_t n, std::uint64_t seed) {
+    audio_noise_generator generator(audio_noise_color::white, 1, seed);
+    std::vector<float> result(n);
+    generator.render(result.data(), n);
+    return result;
+  }
+}
+
+TEST_CASE("The real FFT matches the DFT")
+{
+  // Covers plans with only radix-4 passes, with a final radix-2 pass, and with
+  // butterflies both narrower and wider than a SIMD pack.
+  for (std::size_t size = 2; size <= 2048; size *= 2) {
+    audio_real_fft fft(size);
+    REQUIRE(fft.size() == size);
+    REQUIRE(fft.num_bins() == size / 2 + 1);
+
+    const auto x = noise(size, size);
+    std::vector<float> re(fft.num_bins()), im(fft.num_bins());
+    fft.forward(x.data(), re.data(), im.data());
+
+    for (std::size_t k = 0; k < fft.num_bins(); ++k) {
+      double expected_re = 0, expected_im = 0;
+      for (std::size_t n = 0; n < size; ++n) {
+        expected_re += double(x[n]) * std::cos(2 * pi * double(k * n % size) / double(size));
+        expected_im -= double(x[n]) * std::sin(2 * pi * double(k * n % size) / double(size));
+      }
+
+      REQUIRE(re[k] == Approx(expected_re).margin(1e-5 * double(size)));
+      REQUIRE(im[k] == Approx(expected_im).margin(1e-5 * double(size)));
+    }
+  }
+}
+
+TEST_CASE("The inverse real FFT undoes the forward transform, scaled by the size")
+{
+  for (std::size_t size = 2; size <= 8192; size *= 2) {
+    audio_real_fft fft(size);
+    const auto x = noise(size, 3 * size);
+
+    std::vector<float> re(fft.num_bins()), im(fft.num_bins()), y(size);
+    fft.forward(x.data(), re.data(), im.data());
+    fft.inverse(re.data(), im.data(), y.data());
+
+    for (std::size_t n = 0; n < size; ++n)
+      REQUIRE(y[n] / float(size) == Approx(x[n]).margin(1e-5));
+  }
+}
+
+TEST_CASE("The real FFT of a cosine is a single bin")
+{
+  constexpr std::size_t size = 256;
+  audio_real_fft fft(size);
+
+  std::vector<float> x(size);
+  for (std::size_t n = 0; n < size; ++n)
+    x[n] = float(std::cos(2 * pi * 10.0 * double(n) / double(size)));
+
+  std::vector<float> re(fft.num_bins()), im(fft.num_bins());
+  fft.forward(x.data(), re.data(), im.data());
+
+  for (std::size_t k = 0; k < fft.num_bins(); ++k) {
+    REQUIRE(re[k] == Approx(k == 10 ? double(size) / 2 : 0.0).margin(1e-3));
+    REQUIRE(im[k] == Approx(0.0).margin(1e-3));
+  }
+}
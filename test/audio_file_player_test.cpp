@@ -0,0 +1,444 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#include <audio>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "catch/catch.hpp"
+#include "test_utilities.h"
+
+using namespace std::experimental;
+using test_utilities::wait_until;
+
+namespace {
+  // Builds the bytes of an audio file.
+  struct byte_writer {
+    std::vector<std::uint8_t> bytes;
+    bool big_endian = false;
+
+    void tag(const char* id) {
+      bytes.insert(bytes.end(), id, id + 4);
+    }
+
+    void integer(std::uint64_t value, std::size_t num_bytes) {
+      for (std::size_t i = 0; i < num_bytes; ++i)
+        bytes.push_back(std::uint8_t(value >> (8 * (big_endian ? num_bytes - 1 - i : i))));
+    }
+
+    void float32(float value) {
+      std::uint32_t bits;
+      std::memcpy(&bits, &value, sizeof(bits));
+      integer(bits, 4);
+    }
+
+    void float64(double value) {
+      std::uint64_t bits;
+      std::memcpy(&bits, &value, sizeof(bits));
+      integer(bits, 8);
+    }
+
+    // 80-bit extended precision, for the sample rate of an AIFF file.
+    void extended(double value) {
+      int exponent;
+      const double mantissa = std::frexp(value, &exponent);
+      integer(std::uint64_t(exponent - 1 + 16383), 2);
+      integer(std::uint64_t(std::ldexp(mantissa, 64)), 8);
+    }
+  };
+
+  class temporary_file {
+  public:
+    temporary_file(const std::string& name, const std::vector<std::uint8_t>& bytes)
+      : _path((std::filesystem::temp_directory_path() / ("libstdaudio_" + name)).string()) {
+      std::ofstream(_path, std::ios::binary).write(reinterpret_cast<const char*>(bytes.data()), std::streamsize(bytes.size()));
+    }
+
+    ~temporary_file() {
+      std::error_code error;
+      std::filesystem::remove(_path, error);
+    }
+
+    const std::string& path() const {
+      return _path;
+    }
+
+  private:
+    std::string _path;
+  };
+
+  // A float32 test signal in which every sample is unique and exactly representable.
+  float test_sample(std::size_t frame, std::size_t channel) {
+    return float(frame % 10'000) + 0.25f * float(channel);
+  }
+
+  std::vector<std::uint8_t> wav_file(std::size_t num_frames, std::size_t num_channels, bool rf64 = false) {
+    const std::size_t data_size = num_frames * num_channels * 4;
+
+    byte_writer w;
+    w.tag(rf64 ? "RF64" : "RIFF");
+    w.integer(rf64 ? 0xffff'ffff : 4 + 8 + 16 + 8 + 2 + 8 + data_size, 4);
+    w.tag("WAVE");
+
+    if (rf64) {
+      w.tag("ds64");
+      w.integer(28, 4);
+      w.integer(4 + 8 + 36 + 8 + 16 + 8 + data_size, 8);
+      w.integer(data_size, 8);
+      w.integer(num_frames, 8);
+      w.integer(0, 4);
+    }
+
+    w.tag("fmt ");
+    w.integer(16, 4);
+    w.integer(3, 2);
+    w.integer(num_channels, 2);
+    w.integer(48'000, 4);
+    w.integer(48'000 * num_channels * 4, 4);
+    w.integer(num_channels * 4, 2);
+    w.integer(32, 2);
+
+    // An odd-sized chunk to skip, including its pad byte.
+    w.tag("junk");
+    w.integer(1, 4);
+    w.integer(0, 2);
+
+    w.tag("data");
+    w.integer(rf64 ? 0xffff'ffff : data_size, 4);
+    for (std::size_t frame = 0; frame < num_frames; ++frame)
+      for (std::size_t channel = 0; channel < num_channels; ++channel)
+        w.float32(test_sample(frame, channel));
+
+    return w.bytes;
+  }
+
+  std::vector<float> read_all(const audio_file_reader& reader, std::size_t num_channels) {
+    std::vector<float> data(reader.size_frames() * num_channels);
+    audio_buffer<float> buffer(data.data(), reader.size_frames(), num_channels, contiguous_interleaved);
+    REQUIRE(reader.read(0, buffer) == reader.size_frames());
+    return data;
+  }
+
+  audio_file_player::statistics wait_until_ready(const audio_file_player& player) {
+    REQUIRE(wait_until([&] { return player.is_ready(); }));
+
+    return player.get_statistics();
+  }
+
+  // Once the ring is full, the I/O thread stops and the position is exact.
+  void wait_until_full(const audio_file_player& player, std::size_t capacity) {
+    REQUIRE(wait_until([&] { return player.get_statistics().buffered_frames >= capacity; }));
+  }
+
+  bool wait_until_finished(const audio_file_player& player) {
+    return wait_until([&] { return player.is_finished(); }, std::chrono::seconds(1));
+  }
+
+  // Plays num_frames frames in blocks of up to max_block_frames, each one only once
+  // the I/O thread has buffered it, so that the result does not depend on timing.
+  std::vector<float> play(audio_file_player& player, std::size_t num_frames, std::size_t num_channels, std::size_t max_block_frames) {
+    std::vector<float> result(num_frames * num_channels);
+    for (std::size_t first = 0; first < num_frames;) {
+      std::size_t buffered = 0;
+      REQUIRE(wait_until([&] { return (buffered = player.get_statistics().buffered_frames) != 0; }));
+
+      const std::size_t n = std::min({max_block_frames, buffered, num_frames - first});
+      audio_buffer<float> buffer(result.data() + first * num_channels, n, num_channels, contiguous_interleaved);
+      player.process(buffer);
+      first += n;
+    }
+
+    return result;
+  }
+}
+
+TEST_CASE("audio_file_reader reads WAV files")
+{
+  SECTION("16-bit PCM") {
+    byte_writer w;
+    w.tag("RIFF");
+    w.integer(36 + 8, 4);
+    w.tag("WAVE");
+    w.tag("fmt ");
+    w.integer(16, 4);
+    w.integer(1, 2);
+    w.integer(2, 2);
+    w.integer(44'100, 4);
+    w.integer(44'100 * 4, 4);
+    w.integer(4, 2);
+    w.integer(16, 2);
+    w.tag("data");
+    w.integer(8, 4);
+    for (std::int16_t sample : {0, 16'384, -32'768, 32'767})
+      w.integer(std::uint16_t(sample), 2);
+
+    temporary_file file("int16.wav", w.bytes);
+    auto reader = open_audio_file(file.path());
+    REQUIRE(reader.has_value());
+    REQUIRE(reader->get_format().sample_rate == 44'100);
+    REQUIRE(reader->get_format().num_channels == 2);
+    REQUIRE(reader->get_format().sample_format == audio_sample_format::int16);
+    REQUIRE(reader->size_frames() == 2);
+    REQUIRE(read_all(*reader, 2) == std::vector<float>{0.0f, 0.5f, -1.0f, 32'767.0f / 32'768});
+  }
+
+  SECTION("24-bit WAVE_FORMAT_EXTENSIBLE") {
+    byte_writer w;
+    w.tag("RIFF");
+    w.integer(4 + 48 + 8 + 6, 4);
+    w.tag("WAVE");
+    w.tag("fmt ");
+    w.integer(40, 4);
+    w.integer(0xfffe, 2);
+    w.integer(1, 2);
+    w.integer(96'000, 4);
+    w.integer(96'000 * 3, 4);
+    w.integer(3, 2);
+    w.integer(24, 2);
+    w.integer(22, 2);
+    w.integer(24, 2);
+    w.integer(4, 4);
+    w.integer(1, 2);
+    for (int i = 0; i < 14; ++i)
+      w.bytes.push_back(0);
+    w.tag("data");
+    w.integer(6, 4);
+    w.integer(0x400000, 3);
+    w.integer(0xc00000, 3);
+
+    temporary_file file("int24.wav", w.bytes);
+    auto reader = open_audio_file(file.path());
+    REQUIRE(reader.has_value());
+    REQUIRE(reader->get_format().sample_format == audio_sample_format::int24);
+    REQUIRE(read_all(*reader, 1) == std::vector<float>{0.5f, -0.5f});
+  }
+
+  SECTION("32-bit float") {
+    temporary_file file("float32.wav", wav_file(100, 3));
+    auto reader = open_audio_file(file.path());
+    REQUIRE(reader.has_value());
+    REQUIRE(reader->get_format().sample_format == audio_sample_format::float32);
+    REQUIRE(reader->size_frames() == 100);
+
+    const auto data = read_all(*reader, 3);
+    for (std::size_t frame = 0; frame < 100; ++frame)
+      for (std::size_t channel = 0; channel < 3; ++channel)
+        REQUIRE(data[frame * 3 + channel] == test_sample(frame, channel));
+  }
+
+  SECTION("RF64") {
+    temporary_file file("rf64.wav", wav_file(50, 2, true));
+    auto reader = open_audio_file(file.path());
+    REQUIRE(reader.has_value());
+    REQUIRE(reader->size_frames() == 50);
+    REQUIRE(read_all(*reader, 2)[99] == test_sample(49, 1));
+  }
+}
+
+TEST_CASE("audio_file_reader reads AIFF files")
+{
+  byte_writer w;
+  w.big_endian = true;
+
+  SECTION("16-bit AIFF") {
+    w.tag("FORM");
+    w.integer(4 + 26 + 16 + 4, 4);
+    w.tag("AIFF");
+    w.tag("COMM");
+    w.integer(18, 4);
+    w.integer(1, 2);
+    w.integer(2, 4);
+    w.integer(16, 2);
+    w.extended(44'100);
+    w.tag("SSND");
+    w.integer(8 + 4, 4);
+    w.integer(0, 4);
+    w.integer(0, 4);
+    w.integer(std::uint16_t(-16'384), 2);
+    w.integer(8'192, 2);
+
+    temporary_file file("int16.aiff", w.bytes);
+    auto reader = open_audio_file(file.path());
+    REQUIRE(reader.has_value());
+    REQUIRE(reader->get_format().sample_rate == 44'100);
+    REQUIRE(reader->get_format().big_endian);
+    REQUIRE(read_all(*reader, 1) == std::vector<float>{-0.5f, 0.25f});
+  }
+
+  SECTION("float AIFC") {
+    w.tag("FORM");
+    w.integer(4 + 30 + 24 + 8, 4);
+    w.tag("AIFC");
+    w.tag("COMM");
+    w.integer(22, 4);
+    w.integer(1, 2);
+    w.integer(2, 4);
+    w.integer(64, 2);
+    w.extended(48'000);
+    w.tag("fl64");
+    w.tag("SSND");
+    w.integer(8 + 16, 4);
+    w.integer(0, 4);
+    w.integer(0, 4);
+    w.float64(0.125);
+    w.float64(-0.75);
+
+    temporary_file file("float64.aifc", w.bytes);
+    auto reader = open_audio_file(file.path());
+    REQUIRE(reader.has_value());
+    REQUIRE(reader->get_format().sample_rate == 48'000);
+    REQUIRE(reader->get_format().sample_format == audio_sample_format::float64);
+    REQUIRE(read_all(*reader, 1) == std::vector<float>{0.125f, -0.75f});
+  }
+}
+
+TEST_CASE("audio_file_reader reads raw PCM files")
+{
+  byte_writer w;
+  w.tag("HEAD");
+  for (std::int32_t sample : {1 << 30, -(1 << 29), 0, 1 << 28})
+    w.integer(std::uint32_t(sample), 4);
+
+  temporary_file file("int32.raw", w.bytes);
+  const audio_file_format format = {48'000, 2, audio_sample_format::int32, false};
+  auto reader = open_raw_audio_file(file.path(), format, 4);
+  REQUIRE(reader.has_value());
+  REQUIRE(reader->size_frames() == 2);
+
+  SECTION("extra channels are silenced") {
+    std::vector<float> data(9, 1.0f);
+    audio_buffer<float> buffer(data.data(), 3, 3, contiguous_interleaved);
+    REQUIRE(reader->read(0, buffer) == 2);
+    REQUIRE(data == std::vector<float>{0.5f, -0.25f, 0.0f, 0.0f, 0.125f, 0.0f, 1.0f, 1.0f, 1.0f});
+  }
+
+  SECTION("reading past the end") {
+    std::vector<float> data(2);
+    audio_buffer<float> buffer(data.data(), 1, 2, contiguous_interleaved);
+    REQUIRE(reader->read(1, buffer) == 1);
+    REQUIRE(reader->read(2, buffer) == 0);
+  }
+}
+
+TEST_CASE("open_audio_file rejects what it cannot read")
+{
+  REQUIRE_FALSE(open_audio_file("/nonexistent/libstdaudio.wav").has_value());
+
+  byte_writer w;
+  w.tag("RIFF");
+  w.integer(4 + 24, 4);
+  w.tag("WAVE");
+  w.tag("fmt ");
+  w.integer(16, 4);
+  w.integer(2, 2);  // ADPCM
+  w.integer(1, 2);
+  w.integer(44'100, 4);
+  w.integer(0, 4);
+  w.integer(0, 2);
+  w.integer(4, 2);
+
+  temporary_file file("adpcm.wav", w.bytes);
+  REQUIRE_FALSE(open_audio_file(file.path()).has_value());
+
+  // More channels than an audio_buffer can view.
+  const std::size_t max_num_channels = audio_buffer<float>::max_num_channels;
+  temporary_file widest_file("widest.wav", wav_file(4, max_num_channels));
+  REQUIRE(open_audio_file(widest_file.path()).has_value());
+
+  temporary_file too_wide_file("too_wide.wav", wav_file(4, 200));
+  REQUIRE_FALSE(open_audio_file(too_wide_file.path()).has_value());
+
+  const audio_file_format too_wide_format = {48'000, max_num_channels + 1, audio_sample_format::float32, false};
+  REQUIRE_FALSE(open_raw_audio_file(too_wide_file.path(), too_wide_format).has_value());
+}
+
+TEST_CASE("audio_file_player streams a file")
+{
+  const std::size_t num_frames = 20'000;
+  temporary_file file("player.wav", wav_file(num_frames, 2));
+  audio_file_player player(*open_audio_file(file.path()), 4096, 1024);
+
+  REQUIRE(wait_until_ready(player).buffered_frames >= 1024);
+  wait_until_full(player, 4096);
+  REQUIRE(player.get_position() == 0);
+  REQUIRE_FALSE(player.is_finished());
+
+  SECTION("from start to end") {
+    const auto data = play(player, num_frames, 2, 300);
+    for (std::size_t frame = 0; frame < num_frames; ++frame)
+      REQUIRE(data[frame * 2 + 1] == test_sample(frame, 1));
+
+    REQUIRE(wait_until_finished(player));
+    REQUIRE(player.get_statistics().num_underruns == 0);
+
+    // After the end, the player outputs silence and does not count an underrun.
+    std::vector<float> silence(64, 1.0f);
+    audio_buffer<float> buffer(silence.data(), 32, 2, contiguous_interleaved);
+    player.process(buffer);
+    REQUIRE(silence == std::vector<float>(64, 0.0f));
+    REQUIRE(player.get_statistics().num_underruns == 0);
+  }
+
+  SECTION("seeking pre-rolls from the new position") {
+    play(player, 100, 2, 100);
+
+    player.seek(15'000);
+    REQUIRE(wait_until_ready(player).buffered_frames >= 1024);
+    wait_until_full(player, 4096);
+    REQUIRE(player.get_position() == 15'000);
+
+    const auto data = play(player, num_frames - 15'000, 2, 512);
+    for (std::size_t frame = 0; frame < num_frames - 15'000; ++frame)
+      REQUIRE(data[frame * 2] == test_sample(15'000 + frame, 0));
+
+    REQUIRE(wait_until_finished(player));
+  }
+
+  SECTION("looping") {
+    player.set_looping(true, 1000, 1100);
+    player.seek(1050);
+    wait_until_ready(player);
+
+    const auto data = play(player, 1000, 2, 64);
+    for (std::size_t frame = 0; frame < 1000; ++frame)
+      REQUIRE(data[frame * 2] == test_sample(1000 + (50 + frame) % 100, 0));
+
+    REQUIRE_FALSE(player.is_finished());
+  }
+
+  SECTION("output channels beyond the file's are silenced") {
+    std::vector<float> data(4 * 10, 1.0f);
+    audio_buffer<float> buffer(data.data(), 10, 4, contiguous_interleaved);
+    player.process(buffer);
+
+    for (std::size_t frame = 0; frame < 10; ++frame) {
+      REQUIRE(data[frame * 4 + 1] == test_sample(frame, 1));
+      REQUIRE(data[frame * 4 + 2] == 0.0f);
+      REQUIRE(data[frame * 4 + 3] == 0.0f);
+    }
+  }
+}
+
+TEST_CASE("audio_file_player counts underruns")
+{
+  temporary_file file("underrun.wav", wav_file(10'000, 1));
+  audio_file_player player(*open_audio_file(file.path()), 256, 256);
+  wait_until_ready(player);
+
+  // More than the ring holds can never be available at once.
+  std::vector<float> data(1024, 1.0f);
+  audio_buffer<float> buffer(data.data(), 1024, 1, contiguous_interleaved);
+  player.process(buffer);
+
+  const auto statistics = player.get_statistics();
+  REQUIRE(statistics.num_underruns == 1);
+  REQUIRE(statistics.num_missing_frames == 1024 - 256);
+  REQUIRE(data[255] == test_sample(255, 0));
+  REQUIRE(data[256] == 0.0f);
+}
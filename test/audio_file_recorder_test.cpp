@@ -0,0 +1,206 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#include <audio>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "catch/catch.hpp"
+
+using namespace std::experimental;
+
+namespace {
+  std::string temporary_path(const std::string& name) {
+    return (std::filesystem::temp_directory_path() / ("libstdaudio_" + name)).string();
+  }
+
+  float test_sample(std::size_t frame, std::size_t channel) {
+    return 0.9f * float(std::sin(0.01 * double(frame) * double(channel + 1)));
+  }
+
+  // Records num_frames frames of the test signal in interleaved blocks of varying sizes.
+  void record(audio_file_recorder& recorder, std::size_t num_frames, std::size_t num_channels) {
+    const std::size_t block_sizes[] = {64, 1, 500, 37, 256};
+    std::vector<float> block(500 * num_channels);
+
+    for (std::size_t first = 0, i = 0; first < num_frames; ++i) {
+      const std::size_t n = std::min(block_sizes[i % 5], num_frames - first);
+      for (std::size_t frame = 0; frame < n; ++frame)
+        for (std::size_t channel = 0; channel < num_channels; ++channel)
+          block[frame * num_channels + channel] = test_sample(first + frame, channel);
+
+      recorder.process(audio_buffer<float>(block.data(), n, num_channels, contiguous_interleaved));
+      first += n;
+    }
+  }
+
+  std::vector<float> read_back(const std::string& path, std::size_t num_channels) {
+    auto reader = open_audio_file(path);
+    REQUIRE(reader.has_value());
+    REQUIRE(reader->get_format().num_channels == num_channels);
+
+    std::vector<float> data(reader->size_frames() * num_channels);
+    audio_buffer<float> buffer(data.data(), reader->size_frames(), num_channels, contiguous_interleaved);
+    reader->read(0, buffer);
+    return data;
+  }
+
+  std::string file_tag(const std::string& path) {
+    char tag[4] = {};
+    std::ifstream(path, std::ios::binary).read(tag, 4);
+    return std::string(tag, 4);
+  }
+}
+
+TEST_CASE("audio_file_recorder records to WAV")
+{
+  const std::string path = temporary_path("recording.wav");
+
+  SECTION("24-bit, several write blocks") {
+    audio_file_recorder recorder(3, 48'000);
+    recorder.set_write_block_size(8192);
+    recorder.set_sync_interval(65'536);
+    REQUIRE(recorder.start(path, 100'000));
+    REQUIRE(recorder.is_recording());
+
+    record(recorder, 20'001, 3);
+    REQUIRE(recorder.stop());
+    REQUIRE_FALSE(recorder.is_recording());
+
+    const auto statistics = recorder.get_statistics();
+    REQUIRE(statistics.num_recorded_frames == 20'001);
+    REQUIRE(statistics.num_dropped_frames == 0);
+    REQUIRE_FALSE(statistics.write_failed);
+
+    REQUIRE(file_tag(path) == "RIFF");
+    // The preallocated space beyond the data is cut off, and the odd-sized data padded.
+    REQUIRE(std::filesystem::file_size(path) == 4096 + 20'001 * 9 + 1);
+
+    auto reader = open_audio_file(path);
+    REQUIRE(reader.has_value());
+    REQUIRE(reader->get_format().sample_rate == 48'000);
+    REQUIRE(reader->get_format().sample_format == audio_sample_format::int24);
+
+    const auto data = read_back(path, 3);
+    REQUIRE(data.size() == 20'001 * 3);
+    for (std::size_t frame = 0; frame < 20'001; ++frame)
+      for (std::size_t channel = 0; channel < 3; ++channel)
+        REQUIRE(data[frame * 3 + channel] == Approx(test_sample(frame, channel)).margin(1e-6));
+  }
+
+  SECTION("16-bit clips") {
+    audio_file_recorder recorder(1, 44'100, audio_sample_format::int16);
+    REQUIRE(recorder.start(path));
+
+    std::vector<float> samples = {2.0f, -2.0f, 0.5f};
+    recorder.process(audio_buffer<float>(samples.data(), 3, 1, contiguous_interleaved));
+    REQUIRE(recorder.stop());
+
+    REQUIRE(read_back(path, 1) == std::vector<float>{32'767.0f / 32'768, -1.0f, 0.5f});
+  }
+
+  SECTION("RF64, from deinterleaved doubles") {
+    audio_file_recorder recorder(2, 96'000, audio_sample_format::float32);
+    recorder.set_always_rf64(true);
+    recorder.set_direct_io(false);
+    REQUIRE(recorder.start(path));
+
+    std::vector<double> left(1000), right(1000);
+    for (std::size_t frame = 0; frame < 1000; ++frame) {
+      left[frame] = test_sample(frame, 0);
+      right[frame] = test_sample(frame, 1);
+    }
+
+    double* channels[] = {left.data(), right.data()};
+    recorder.process(audio_buffer<double>(channels, 1000, 2, ptr_to_ptr_deinterleaved));
+    REQUIRE(recorder.stop());
+
+    REQUIRE(file_tag(path) == "RF64");
+    const auto data = read_back(path, 2);
+    REQUIRE(data.size() == 2000);
+    for (std::size_t frame = 0; frame < 1000; ++frame)
+      REQUIRE(data[frame * 2 + 1] == test_sample(frame, 1));
+  }
+
+  SECTION("a second recording") {
+    audio_file_recorder recorder(2, 48'000, audio_sample_format::float32);
+    REQUIRE(recorder.start(path));
+    record(recorder, 5000, 2);
+
+    const std::string second_path = temporary_path("recording_2.wav");
+    REQUIRE(recorder.start(second_path));
+    record(recorder, 300, 2);
+    REQUIRE(recorder.stop());
+
+    REQUIRE(read_back(path, 2).size() == 5000 * 2);
+    REQUIRE(read_back(second_path, 2).size() == 300 * 2);
+    REQUIRE(recorder.get_statistics().num_recorded_frames == 300);
+    std::filesystem::remove(second_path);
+  }
+
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("audio_file_recorder ignores input while not recording")
+{
+  audio_file_recorder recorder(1, 48'000);
+  std::vector<float> samples(64, 0.5f);
+  recorder.process(audio_buffer<float>(samples.data(), 64, 1, contiguous_interleaved));
+
+  REQUIRE(recorder.get_statistics().num_recorded_frames == 0);
+  REQUIRE(recorder.stop());
+}
+
+TEST_CASE("audio_file_recorder counts dropped frames")
+{
+  const std::string path = temporary_path("overrun.wav");
+  audio_file_recorder recorder(1, 48'000, audio_sample_format::float32, 256);
+  REQUIRE(recorder.start(path));
+
+  // More than the ring holds can never be taken at once.
+  std::vector<float> samples(1024, 0.25f);
+  recorder.process(audio_buffer<float>(samples.data(), 1024, 1, contiguous_interleaved));
+  REQUIRE(recorder.stop());
+
+  const auto statistics = recorder.get_statistics();
+  REQUIRE(statistics.num_overruns == 1);
+  REQUIRE(statistics.num_dropped_frames == 1024 - 256);
+  REQUIRE(statistics.num_recorded_frames == 256);
+  REQUIRE(read_back(path, 1) == std::vector<float>(256, 0.25f));
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("audio_file_recorder reports a file it cannot create")
+{
+  audio_file_recorder recorder(2, 48'000);
+  REQUIRE_FALSE(recorder.start("/nonexistent/libstdaudio/recording.wav"));
+  REQUIRE_FALSE(recorder.is_recording());
+}
+
+TEST_CASE("audio_file_recorder rejects channel counts that audio_buffer cannot view")
+{
+  const std::string path = temporary_path("unsupported_channels.wav");
+  const std::size_t max_num_channels = audio_buffer<float>::max_num_channels;
+
+  for (std::size_t num_channels : {std::size_t(0), max_num_channels + 1, std::size_t(200)}) {
+    audio_file_recorder recorder(num_channels, 48'000);
+    REQUIRE_FALSE(recorder.start(path));
+    REQUIRE_FALSE(recorder.is_recording());
+
+    // The audio thread may still hand it input, which it ignores.
+    std::vector<float> block(16 * max_num_channels, 0.5f);
+    recorder.process(audio_buffer<float>(block.data(), 16, max_num_channels, contiguous_interleaved));
+    REQUIRE(recorder.get_statistics().num_recorded_frames == 0);
+  }
+
+  audio_file_recorder recorder(max_num_channels, 48'000);
+  REQUIRE(recorder.start(path));
+  record(recorder, 1000, max_num_channels);
+  REQUIRE(recorder.stop());
+  REQUIRE(read_back(path, max_num_channels).size() == 1000 * max_num_channels);
+  std::filesystem::remove(path);
+}
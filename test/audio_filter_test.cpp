@@ -0,0 +1,222 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#include <audio>
+#include <cmath>
+#include <vector>
+#include "catch/catch.hpp"
+
+using namespace std::experimental;
+
+namespace {
+  constexpr double pi = 3.14159265358979323846;
+  constexpr double sample_rate = 48'000;
+
+  // Gain of the filter for a sine of the given frequency, measured after it has settled.
+  template <typename _FilterType>
+  double measure_gain(_FilterType& filter, double frequency) {
+    constexpr std::size_t num_frames = 9'600;
+    std::vector<float> data(num_frames);
+    for (std::size_t n = 0; n < num_frames; ++n)
+      data[n] = float(std::sin(2 * pi * frequency * double(n) / sample_rate));
+
+    audio_buffer<float> buffer(data.data(), num_frames, 1, contiguous_interleaved);
+    filter.process(buffer);
+
+    double peak = 0;
+    for (std::size_t n = num_frames / 2; n < num_frames; ++n)
+      peak = std::max(peak, double(std::abs(data[n])));
+
+    return peak;
+  }
+
+  std::vector<float> test_signal(std::size_t num_frames, std::size_t num_channels) {
+    audio_noise_generator noise(audio_noise_color::white, 1, 7);
+    std::vector<float> signal(num_frames * num_channels);
+    noise.render(signal.data(), signal.size());
+    return signal;
+  }
+
+  // Filters a deinterleaved copy in double precision, which always takes the scalar path.
+  template <typename _FilterType>
+  std::vector<double> reference(_FilterType filter, const std::vector<float>& interleaved, std::size_t num_channels) {
+    const std::size_t num_frames = interleaved.size() / num_channels;
+    std::vector<double> data(interleaved.size());
+    audio_buffer<double> buffer(data.data(), num_frames, num_channels, contiguous_deinterleaved);
+    for (std::size_t frame = 0; frame < num_frames; ++frame)
+      for (std::size_t channel = 0; channel < num_channels; ++channel)
+        buffer(frame, channel) = interleaved[frame * num_channels + channel];
+
+    filter.process(buffer);
+    return data;
+  }
+}
+
+TEST_CASE("Lowpass filters pass low and attenuate high frequencies")
+{
+  SECTION("biquad") {
+    audio_biquad_filter filter(sample_rate, 1);
+    filter.set_section(0, audio_filter_type::lowpass, 1'000);
+    filter.reset();
+    CHECK(measure_gain(filter, 100) == Approx(1.0).epsilon(0.01));
+    CHECK(measure_gain(filter, 1'000) == Approx(std::sqrt(0.5)).epsilon(0.01));
+    CHECK(measure_gain(filter, 10'000) < 0.02);
+  }
+
+  SECTION("svf") {
+    audio_svf_filter filter(sample_rate, 1);
+    filter.set_section(0, audio_filter_type::lowpass, 1'000);
+    filter.reset();
+    CHECK(measure_gain(filter, 100) == Approx(1.0).epsilon(0.01));
+    CHECK(measure_gain(filter, 1'000) == Approx(std::sqrt(0.5)).epsilon(0.01));
+    CHECK(measure_gain(filter, 10'000) < 0.02);
+  }
+}
+
+TEST_CASE("Biquad and SVF agree on EQ shapes")
+{
+  struct shape { audio_filter_type type; double gain_db; double frequency; double expected_gain; };
+  const shape shapes[] = {
+    {audio_filter_type::highpass, 0, 100, 0.01},
+    {audio_filter_type::bell, 6, 2'000, std::pow(10.0, 6.0 / 20)},
+    {audio_filter_type::low_shelf, -6, 50, std::pow(10.0, -6.0 / 20)},
+    {audio_filter_type::high_shelf, 6, 15'000, std::pow(10.0, 6.0 / 20)},
+    {audio_filter_type::notch, 0, 2'000, 0.0},
+    {audio_filter_type::allpass, 0, 500, 1.0},
+  };
+
+  for (const auto& s : shapes) {
+    audio_biquad_filter biquad(sample_rate, 1);
+    audio_svf_filter svf(sample_rate, 1);
+    biquad.set_section(0, s.type, 2'000, 0.7071, s.gain_db);
+    svf.set_section(0, s.type, 2'000, 0.7071, s.gain_db);
+    biquad.reset();
+    svf.reset();
+
+    const double biquad_gain = measure_gain(biquad, s.frequency);
+    CHECK(biquad_gain == Approx(measure_gain(svf, s.frequency)).margin(0.01));
+    CHECK(biquad_gain == Approx(s.expected_gain).margin(0.05 * std::max(1.0, s.expected_gain)));
+  }
+}
+
+TEST_CASE("Filtering interleaved channels in SIMD lanes matches the scalar path")
+{
+  constexpr std::size_t num_channels = 13;
+  constexpr std::size_t num_frames = 500;
+
+  audio_biquad_filter filter(sample_rate, num_channels, 2);
+  filter.set_section(0, audio_filter_type::lowpass, 3'000, 2.0);
+  filter.set_section(1, audio_filter_type::bell, 500, 1.0, -6);
+  filter.reset();
+
+  auto data = test_signal(num_frames, num_channels);
+  const auto expected = reference(filter, data, num_channels);
+
+  audio_buffer<float> buffer(data.data(), num_frames, num_channels, contiguous_interleaved);
+  filter.process(buffer);
+
+  for (std::size_t frame = 0; frame < num_frames; ++frame)
+    for (std::size_t channel = 0; channel < num_channels; ++channel)
+      REQUIRE(buffer(frame, channel) == Approx(expected[channel * num_frames + frame]).margin(1e-5));
+}
+
+TEST_CASE("Filtering cascaded sections in SIMD lanes matches the scalar path")
+{
+  constexpr std::size_t num_channels = 2;
+  constexpr std::size_t num_frames = 700;
+
+  for (std::size_t num_sections : {2, 4, 11}) {
+    audio_svf_filter filter(sample_rate, num_channels, num_sections);
+    for (std::size_t section = 0; section < num_sections; ++section)
+      filter.set_section(section, audio_filter_type::bell, 200.0 * double(section + 1), 2.0, section % 2 ? 3 : -3);
+
+    filter.reset();
+
+    auto data = test_signal(num_frames, num_channels);
+    const auto expected = reference(filter, data, num_channels);
+
+    // Deinterleave, then process in blocks of varying size, including ones smaller
+    // than the SIMD width.
+    std::vector<float> deinterleaved(data.size());
+    for (std::size_t frame = 0; frame < num_frames; ++frame)
+      for (std::size_t channel = 0; channel < num_channels; ++channel)
+        deinterleaved[channel * num_frames + frame] = data[frame * num_channels + channel];
+
+    std::size_t first = 0, block_size = 1;
+    while (first < num_frames) {
+      const std::size_t n = std::min(block_size, num_frames - first);
+      float* channels[num_channels] = {deinterleaved.data() + first, deinterleaved.data() + num_frames + first};
+      audio_buffer<float> buffer(channels, n, num_channels, ptr_to_ptr_deinterleaved);
+      filter.process(buffer);
+
+      first += n;
+      block_size = block_size * 3 % 101 + 1;
+    }
+
+    for (std::size_t i = 0; i < deinterleaved.size(); ++i)
+      REQUIRE(deinterleaved[i] == Approx(expected[i]).margin(1e-4));
+  }
+}
+
+TEST_CASE("Filtering cascaded sections of an interleaved stereo buffer matches the scalar path")
+{
+  constexpr std::size_t num_channels = 2;
+  constexpr std::size_t num_frames = 300;
+
+  audio_biquad_filter filter(sample_rate, num_channels, 3);
+  filter.set_all_sections(audio_filter_type::lowpass, 5'000);
+  filter.reset();
+
+  auto data = test_signal(num_frames, num_channels);
+  const auto expected = reference(filter, data, num_channels);
+
+  audio_buffer<float> buffer(data.data(), num_frames, num_channels, contiguous_interleaved);
+  filter.process(buffer);
+
+  for (std::size_t frame = 0; frame < num_frames; ++frame)
+    for (std::size_t channel = 0; channel < num_channels; ++channel)
+      REQUIRE(buffer(frame, channel) == Approx(expected[channel * num_frames + frame]).margin(1e-5));
+}
+
+TEST_CASE("Filter coefficient changes are smoothed")
+{
+  audio_svf_filter filter(sample_rate, 1);
+  filter.set_smoothing_time(0.01);
+  filter.set_section(0, audio_filter_type::lowpass, 10'000);
+  filter.reset();
+
+  audio_svf_filter switched = filter;
+  filter.set_section(0, audio_filter_type::lowpass, 200);
+  switched.set_section(0, audio_filter_type::lowpass, 200);
+  switched.set_smoothing_time(0);
+
+  const auto signal = test_signal(48'000, 1);
+  auto smoothed = signal, immediate = signal;
+  audio_buffer<float> a(smoothed.data(), smoothed.size(), 1, contiguous_interleaved);
+  audio_buffer<float> b(immediate.data(), immediate.size(), 1, contiguous_interleaved);
+  filter.process(a);
+  switched.process(b);
+
+  // Different at first, the same once the coefficients have arrived.
+  CHECK(std::abs(smoothed[100] - immediate[100]) > 1e-3);
+  for (std::size_t n = 24'000; n < smoothed.size(); ++n)
+    REQUIRE(smoothed[n] == Approx(immediate[n]).margin(1e-4));
+}
+
+TEST_CASE("Filters process 64-channel buffers")
+{
+  constexpr std::size_t num_channels = 64;
+  audio_biquad_filter filter(sample_rate, num_channels);
+  filter.set_section(0, audio_filter_type::highpass, 1'000);
+  filter.reset();
+
+  // DC is removed from every channel.
+  std::vector<float> data(num_channels * 4'800, 1.0f);
+  audio_buffer<float> buffer(data.data(), 4'800, num_channels, contiguous_interleaved);
+  filter.process(buffer);
+
+  for (std::size_t channel = 0; channel < num_channels; ++channel)
+    CHECK(std::abs(buffer(4'799, channel)) < 1e-4);
+}
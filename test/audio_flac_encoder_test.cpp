@@ -0,0 +1,386 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#include <audio>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "catch/catch.hpp"
+
+using namespace std::experimental;
+
+namespace {
+  // Just enough of a FLAC decoder to check what the encoder produces.
+  class bit_reader {
+  public:
+    explicit bit_reader(const std::vector<std::uint8_t>& bytes) : _bytes(bytes) {}
+
+    std::uint64_t read(unsigned num_bits) {
+      std::uint64_t result = 0;
+      for (unsigned i = 0; i < num_bits; ++i, ++_position) {
+        REQUIRE(_position / 8 < _bytes.size());
+        result = (result << 1) | ((_bytes[_position / 8] >> (7 - _position % 8)) & 1);
+      }
+
+      return result;
+    }
+
+    std::int64_t read_signed(unsigned num_bits) {
+      const std::uint64_t value = read(num_bits);
+      return std::int64_t(value << (64 - num_bits)) >> (64 - num_bits);
+    }
+
+    std::uint32_t read_unary() {
+      std::uint32_t result = 0;
+      while (read(1) == 0)
+        ++result;
+
+      return result;
+    }
+
+    void align() {
+      _position = (_position + 7) / 8 * 8;
+    }
+
+    std::size_t byte_position() const {
+      return _position / 8;
+    }
+
+    bool at_end() const {
+      return _position / 8 >= _bytes.size();
+    }
+
+  private:
+    const std::vector<std::uint8_t>& _bytes;
+    std::size_t _position = 0;
+  };
+
+  std::uint8_t crc8(const std::uint8_t* data, std::size_t size) {
+    std::uint8_t crc = 0;
+    for (std::size_t i = 0; i < size; ++i) {
+      crc ^= data[i];
+      for (int bit = 0; bit < 8; ++bit)
+        crc = std::uint8_t((crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1);
+    }
+
+    return crc;
+  }
+
+  std::uint16_t crc16(const std::uint8_t* data, std::size_t size) {
+    std::uint16_t crc = 0;
+    for (std::size_t i = 0; i < size; ++i) {
+      crc ^= std::uint16_t(data[i] << 8);
+      for (int bit = 0; bit < 8; ++bit)
+        crc = std::uint16_t((crc & 0x8000) ? (crc << 1) ^ 0x8005 : crc << 1);
+    }
+
+    return crc;
+  }
+
+  struct flac_stream {
+    unsigned sample_rate = 0;
+    unsigned num_channels = 0;
+    unsigned bits_per_sample = 0;
+    std::uint64_t num_samples = 0;
+    std::uint32_t min_frame_size = 0;
+    std::uint32_t max_frame_size = 0;
+    std::size_t num_stereo_decorrelated_frames = 0;
+    std::vector<std::vector<std::int32_t>> channels;
+  };
+
+  std::vector<std::int32_t> decode_subframe(bit_reader& bits, std::size_t n, unsigned bits_per_sample) {
+    REQUIRE(bits.read(1) == 0);
+    const auto type = unsigned(bits.read(6));
+    REQUIRE(bits.read(1) == 0);
+
+    std::vector<std::int32_t> x(n);
+    if (type == 0) {
+      std::fill(x.begin(), x.end(), std::int32_t(bits.read_signed(bits_per_sample)));
+      return x;
+    }
+
+    if (type == 1) {
+      for (auto& sample : x)
+        sample = std::int32_t(bits.read_signed(bits_per_sample));
+      return x;
+    }
+
+    REQUIRE((type >= 8 && type <= 12));
+    const unsigned order = type - 8;
+    for (unsigned i = 0; i < order; ++i)
+      x[i] = std::int32_t(bits.read_signed(bits_per_sample));
+
+    const auto method = unsigned(bits.read(2));
+    REQUIRE(method <= 1);
+    const unsigned parameter_bits = method == 0 ? 4 : 5;
+    const auto partition_order = unsigned(bits.read(4));
+    const std::size_t partition_size = n >> partition_order;
+
+    std::vector<std::int64_t> residual(n);
+    for (std::size_t p = 0; p < (std::size_t(1) << partition_order); ++p) {
+      const auto parameter = unsigned(bits.read(parameter_bits));
+      REQUIRE(parameter != (1u << parameter_bits) - 1);
+      for (std::size_t i = std::max<std::size_t>(p * partition_size, order); i < (p + 1) * partition_size; ++i) {
+        const std::uint64_t folded = (std::uint64_t(bits.read_unary()) << parameter) | bits.read(parameter);
+        residual[i] = std::int64_t(folded >> 1) ^ -std::int64_t(folded & 1);
+      }
+    }
+
+    const std::int64_t coefficients[5][4] = {{}, {1}, {2, -1}, {3, -3, 1}, {4, -6, 4, -1}};
+    for (std::size_t i = order; i < n; ++i) {
+      std::int64_t prediction = 0;
+      for (unsigned j = 0; j < order; ++j)
+        prediction += coefficients[order][j] * x[i - 1 - j];
+      x[i] = std::int32_t(prediction + residual[i]);
+    }
+
+    return x;
+  }
+
+  flac_stream decode(const std::vector<std::uint8_t>& bytes) {
+    flac_stream stream;
+    bit_reader bits(bytes);
+    REQUIRE(bits.read(32) == 0x664c'6143);
+
+    for (bool last = false; !last;) {
+      last = bits.read(1) == 1;
+      const auto type = unsigned(bits.read(7));
+      const auto length = std::size_t(bits.read(24));
+
+      if (type == 0) {
+        REQUIRE(length == 34);
+        REQUIRE(bits.read(16) == 4096);
+        REQUIRE(bits.read(16) == 4096);
+        stream.min_frame_size = std::uint32_t(bits.read(24));
+        stream.max_frame_size = std::uint32_t(bits.read(24));
+        stream.sample_rate = unsigned(bits.read(20));
+        stream.num_channels = unsigned(bits.read(3)) + 1;
+        stream.bits_per_sample = unsigned(bits.read(5)) + 1;
+        stream.num_samples = bits.read(36);
+        bits.read(64);
+        bits.read(64);
+      }
+      else {
+        bits.read(8 * unsigned(length));
+      }
+    }
+
+    stream.channels.resize(stream.num_channels);
+
+    for (std::uint64_t frame_number = 0; !bits.at_end(); ++frame_number) {
+      const std::size_t frame_start = bits.byte_position();
+      REQUIRE(bits.read(15) == 0x7ffc);
+      REQUIRE(bits.read(1) == 0);
+
+      const auto block_size_code = unsigned(bits.read(4));
+      bits.read(4);
+      const auto channel_assignment = unsigned(bits.read(4));
+      const auto sample_size_code = unsigned(bits.read(3));
+      REQUIRE(bits.read(1) == 0);
+
+      // The UTF-8 style frame number.
+      std::uint64_t number = bits.read(8);
+      unsigned num_continuation_bytes = 0;
+      while ((number & 0x80) && (number & (0x40 >> num_continuation_bytes)))
+        ++num_continuation_bytes;
+      if (num_continuation_bytes > 0) {
+        number &= 0x3f >> num_continuation_bytes;
+        for (unsigned i = 0; i < num_continuation_bytes; ++i)
+          number = (number << 6) | (bits.read(8) & 0x3f);
+      }
+      REQUIRE(number == frame_number);
+
+      std::size_t n = 0;
+      if (block_size_code == 7)
+        n = std::size_t(bits.read(16)) + 1;
+      else
+        n = std::size_t(256) << (block_size_code - 8);
+
+      const auto header_crc = std::uint8_t(bits.read(8));
+      REQUIRE(header_crc == crc8(bytes.data() + frame_start, bits.byte_position() - 1 - frame_start));
+
+      const unsigned sample_size_bits[] = {0, 8, 12, 0, 16, 20, 24, 32};
+      REQUIRE(sample_size_bits[sample_size_code] == stream.bits_per_sample);
+
+      std::vector<std::vector<std::int32_t>> subframes;
+      for (unsigned channel = 0; channel < stream.num_channels; ++channel) {
+        const bool is_side = (channel_assignment == 8 && channel == 1) || (channel_assignment == 9 && channel == 0) || (channel_assignment == 10 && channel == 1);
+        subframes.push_back(decode_subframe(bits, n, stream.bits_per_sample + (is_side ? 1 : 0)));
+      }
+
+      bits.align();
+      const std::size_t frame_end = bits.byte_position();
+      REQUIRE(bits.read(16) == crc16(bytes.data() + frame_start, frame_end - frame_start));
+      REQUIRE(frame_end + 2 - frame_start >= stream.min_frame_size);
+      REQUIRE(frame_end + 2 - frame_start <= stream.max_frame_size);
+
+      if (channel_assignment >= 8) {
+        ++stream.num_stereo_decorrelated_frames;
+        for (std::size_t i = 0; i < n; ++i) {
+          const std::int32_t a = subframes[0][i], b = subframes[1][i];
+          if (channel_assignment == 8) {
+            subframes[1][i] = a - b;
+          }
+          else if (channel_assignment == 9) {
+            subframes[0][i] = a + b;
+          }
+          else {
+            const std::int32_t mid = (a << 1) | (b & 1);
+            subframes[0][i] = (mid + b) >> 1;
+            subframes[1][i] = (mid - b) >> 1;
+          }
+        }
+      }
+
+      for (unsigned channel = 0; channel < stream.num_channels; ++channel)
+        stream.channels[channel].insert(stream.channels[channel].end(), subframes[channel].begin(), subframes[channel].end());
+    }
+
+    return stream;
+  }
+
+  std::vector<std::uint8_t> read_file(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+  }
+
+  std::string temporary_path(const std::string& name) {
+    return (std::filesystem::temp_directory_path() / ("libstdaudio_" + name)).string();
+  }
+
+  // Integer test signals, recorded as exactly representable floats. Some channels
+  // are smooth and correlated, one is noise, one is silent.
+  std::int32_t test_sample(std::size_t frame, std::size_t channel, unsigned bits) {
+    const double full_scale = double(1 << (bits - 1));
+    switch (channel % 4) {
+      case 0: return std::int32_t(std::lround(0.5 * full_scale * std::sin(0.003 * double(frame))));
+      case 1: return std::int32_t(std::lround(0.5 * full_scale * std::sin(0.003 * double(frame) + 0.01)));
+      case 2: return std::int32_t((frame * 2654435761u + channel) % (1u << bits)) - std::int32_t(full_scale);
+      default: return 0;
+    }
+  }
+
+  void record(audio_file_recorder& recorder, std::size_t num_frames, std::size_t num_channels, unsigned bits) {
+    const float scale = 1.0f / float(1 << (bits - 1));
+    std::vector<float> block(1000 * num_channels);
+
+    for (std::size_t first = 0; first < num_frames;) {
+      const std::size_t n = std::min<std::size_t>(1000, num_frames - first);
+      for (std::size_t frame = 0; frame < n; ++frame)
+        for (std::size_t channel = 0; channel < num_channels; ++channel)
+          block[frame * num_channels + channel] = float(test_sample(first + frame, channel, bits)) * scale;
+
+      recorder.process(audio_buffer<float>(block.data(), n, num_channels, contiguous_interleaved));
+      first += n;
+    }
+  }
+
+  void check_stream(const flac_stream& stream, std::size_t num_frames, std::size_t first_channel, unsigned bits) {
+    REQUIRE(stream.num_samples == num_frames);
+    REQUIRE(stream.bits_per_sample == bits);
+    for (std::size_t channel = 0; channel < stream.num_channels; ++channel) {
+      REQUIRE(stream.channels[channel].size() == num_frames);
+      for (std::size_t frame = 0; frame < num_frames; ++frame)
+        REQUIRE(stream.channels[channel][frame] == test_sample(frame, first_channel + channel, bits));
+    }
+  }
+}
+
+TEST_CASE("audio_file_recorder records FLAC")
+{
+  const std::string path = temporary_path("recording.flac");
+
+  SECTION("stereo, 16-bit") {
+    audio_file_recorder recorder(2, 44'100, audio_sample_format::int16);
+    recorder.set_file_type(audio_file_type::flac);
+    REQUIRE(recorder.start(path));
+    record(recorder, 50'000, 2, 16);
+    REQUIRE(recorder.stop());
+
+    const auto bytes = read_file(path);
+    const auto stream = decode(bytes);
+    REQUIRE(stream.sample_rate == 44'100);
+    REQUIRE(stream.num_channels == 2);
+    check_stream(stream, 50'000, 0, 16);
+
+    // The two channels are nearly the same, which stereo decorrelation exploits.
+    REQUIRE(stream.num_stereo_decorrelated_frames > 0);
+    REQUIRE(bytes.size() < 50'000 * 2 * 2 / 2);
+  }
+
+  SECTION("24-bit, with frame numbers beyond one byte") {
+    // Big enough a ring that nothing is dropped, however fast the frames come.
+    audio_file_recorder recorder(1, 96'000, audio_sample_format::int24, 1 << 20);
+    recorder.set_file_type(audio_file_type::flac);
+    REQUIRE(recorder.start(path));
+    record(recorder, 4096 * 130 + 123, 1, 24);
+    REQUIRE(recorder.stop());
+    REQUIRE(recorder.get_statistics().num_dropped_frames == 0);
+
+    const auto stream = decode(read_file(path));
+    REQUIRE(stream.sample_rate == 96'000);
+    check_stream(stream, 4096 * 130 + 123, 0, 24);
+  }
+
+  SECTION("8-bit") {
+    audio_file_recorder recorder(4, 48'000, audio_sample_format::int8);
+    recorder.set_file_type(audio_file_type::flac);
+    REQUIRE(recorder.start(path));
+    record(recorder, 10'000, 4, 8);
+    REQUIRE(recorder.stop());
+
+    const auto stream = decode(read_file(path));
+    REQUIRE(stream.num_channels == 4);
+    check_stream(stream, 10'000, 0, 8);
+  }
+
+  SECTION("more than eight channels, encoded on a worker pool") {
+    audio_worker_pool pool(3);
+    audio_file_recorder recorder(12, 48'000, audio_sample_format::int16);
+    recorder.set_file_type(audio_file_type::flac);
+    recorder.set_executor(std::ref(pool));
+    REQUIRE(recorder.start(path));
+    record(recorder, 100'000, 12, 16);
+    REQUIRE(recorder.stop());
+    REQUIRE(recorder.get_statistics().num_recorded_frames == 100'000);
+
+    const std::string first_path = temporary_path("recording_1.flac");
+    const std::string second_path = temporary_path("recording_2.flac");
+
+    const auto first = decode(read_file(first_path));
+    REQUIRE(first.num_channels == 8);
+    check_stream(first, 100'000, 0, 16);
+
+    const auto second = decode(read_file(second_path));
+    REQUIRE(second.num_channels == 4);
+    check_stream(second, 100'000, 8, 16);
+
+    std::filesystem::remove(first_path);
+    std::filesystem::remove(second_path);
+  }
+
+  SECTION("an executor that throws fails the recording") {
+    audio_file_recorder recorder(2, 48'000, audio_sample_format::int16);
+    recorder.set_file_type(audio_file_type::flac);
+    recorder.set_executor([](std::size_t, void (*)(void*, std::size_t), void*) { throw std::runtime_error("no workers"); });
+    REQUIRE(recorder.start(path));
+    record(recorder, 50'000, 2, 16);
+    REQUIRE_FALSE(recorder.stop());
+    REQUIRE(recorder.get_statistics().write_failed);
+  }
+
+  SECTION("FLAC cannot store floating-point samples") {
+    audio_file_recorder recorder(2, 48'000, audio_sample_format::float32);
+    recorder.set_file_type(audio_file_type::flac);
+    REQUIRE_FALSE(recorder.start(path));
+  }
+
+  std::filesystem::remove(path);
+}
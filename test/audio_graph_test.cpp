@@ -0,0 +1,191 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#include <audio>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "catch/catch.hpp"
+
+using namespace std::experimental;
+
+namespace {
+  auto gain_processor(float gain) {
+    return [gain](audio_device_io<float>& io) noexcept {
+      auto& in = *io.input_buffer;
+      auto& out = *io.output_buffer;
+      for (std::size_t channel = 0; channel < out.size_channels(); ++channel)
+        for (std::size_t frame = 0; frame < out.size_frames(); ++frame)
+          out(frame, channel) = gain * in(frame, channel);
+    };
+  }
+
+  auto constant_processor(float value) {
+    return [value](audio_device_io<float>& io) noexcept {
+      auto& out = *io.output_buffer;
+      for (std::size_t channel = 0; channel < out.size_channels(); ++channel)
+        for (std::size_t frame = 0; frame < out.size_frames(); ++frame)
+          out(frame, channel) = value;
+    };
+  }
+
+  struct graph_runner {
+    graph_runner(std::size_t num_channels, std::size_t num_frames)
+      : input(num_channels * num_frames, 1.0f),
+        output(num_channels * num_frames, -1.0f) {
+      io.input_buffer = audio_buffer<float>(input.data(), num_frames, num_channels, contiguous_interleaved);
+      io.output_buffer = audio_buffer<float>(output.data(), num_frames, num_channels, contiguous_interleaved);
+    }
+
+    float run(audio_graph<float>& graph, std::size_t channel = 0) {
+      graph.process(io);
+      return (*io.output_buffer)(io.output_buffer->size_frames() - 1, channel);
+    }
+
+    std::vector<float> input, output;
+    audio_device_io<float> io;
+  };
+}
+
+TEST_CASE("Graph outputs silence until a schedule is committed")
+{
+  audio_graph<float> graph(2, 2);
+  graph_runner runner(2, 64);
+
+  CHECK(runner.run(graph) == 0.0f);
+}
+
+TEST_CASE("Graph passes audio through a chain of nodes")
+{
+  audio_graph<float> graph(2, 2);
+  auto a = graph.add_node(gain_processor(0.5f), 2, 2);
+  auto b = graph.add_node(gain_processor(3.0f), 2, 2);
+
+  CHECK(graph.add_edge(graph.input_node_id(), a));
+  CHECK(graph.add_edge(a, b));
+  CHECK(graph.add_edge(b, graph.output_node_id()));
+  graph.commit();
+
+  graph_runner runner(2, 64);
+  CHECK(runner.run(graph, 0) == 1.5f);
+  CHECK(runner.run(graph, 1) == 1.5f);
+}
+
+TEST_CASE("Graph sums edges into the same node")
+{
+  audio_graph<float> graph(1, 1);
+  auto a = graph.add_node(constant_processor(0.25f), 0, 1);
+  auto b = graph.add_node(constant_processor(0.5f), 0, 1);
+  graph.add_edge(a, graph.output_node_id());
+  graph.add_edge(b, graph.output_node_id());
+  graph.add_edge(graph.input_node_id(), graph.output_node_id());
+  graph.commit();
+
+  graph_runner runner(1, 32);
+  CHECK(runner.run(graph) == 1.75f);
+}
+
+TEST_CASE("Graph rejects invalid edges")
+{
+  audio_graph<float> graph(2, 2);
+  auto a = graph.add_node(gain_processor(1.0f), 2, 2);
+  auto b = graph.add_node(gain_processor(1.0f), 2, 2);
+  auto mono = graph.add_node(gain_processor(1.0f), 1, 1);
+
+  CHECK(graph.add_edge(a, b));
+  CHECK_FALSE(graph.add_edge(a, b));
+  CHECK_FALSE(graph.add_edge(b, a));
+  CHECK_FALSE(graph.add_edge(a, a));
+  CHECK_FALSE(graph.add_edge(a, mono));
+  CHECK_FALSE(graph.add_edge(a, 1234));
+  CHECK_FALSE(graph.remove_node(graph.output_node_id()));
+
+  CHECK(graph.remove_edge(a, b));
+  CHECK_FALSE(graph.remove_edge(a, b));
+  CHECK(graph.add_edge(b, a));
+}
+
+TEST_CASE("Graph reuses buffers of nodes whose outputs are no longer needed")
+{
+  audio_graph<float> graph(1, 1);
+  auto previous = graph.input_node_id();
+  for (int i = 0; i < 20; ++i) {
+    auto node = graph.add_node(gain_processor(1.0f), 1, 1);
+    graph.add_edge(previous, node);
+    previous = node;
+  }
+
+  graph.add_edge(previous, graph.output_node_id());
+  graph.commit();
+
+  // Along a chain, only the input and output of the current node are alive.
+  CHECK(graph.num_scratch_channels() == 2);
+
+  graph_runner runner(1, 16);
+  CHECK(runner.run(graph) == 1.0f);
+}
+
+TEST_CASE("Graph keeps outputs alive until their last consumer has run")
+{
+  // input -> a -> b -> c -> output, plus a -> c, so a's output must survive b.
+  audio_graph<float> graph(1, 1);
+  auto a = graph.add_node(gain_processor(2.0f), 1, 1);
+  auto b = graph.add_node(gain_processor(3.0f), 1, 1);
+  auto c = graph.add_node(gain_processor(1.0f), 1, 1);
+  graph.add_edge(graph.input_node_id(), a);
+  graph.add_edge(a, b);
+  graph.add_edge(b, c);
+  graph.add_edge(a, c);
+  graph.add_edge(c, graph.output_node_id());
+  graph.commit();
+
+  graph_runner runner(1, 16);
+  CHECK(runner.run(graph) == 2.0f + 6.0f);
+}
+
+TEST_CASE("Graph splits blocks larger than its maximum block size")
+{
+  audio_graph<float> graph(1, 1, 16);
+  auto a = graph.add_node(gain_processor(2.0f), 1, 1);
+  graph.add_edge(graph.input_node_id(), a);
+  graph.add_edge(a, graph.output_node_id());
+  graph.commit();
+
+  graph_runner runner(1, 100);
+  runner.run(graph);
+  for (auto sample : runner.output)
+    CHECK(sample == 2.0f);
+}
+
+TEST_CASE("Graph edits are applied while processing")
+{
+  audio_graph<float> graph(1, 1);
+  std::atomic<bool> done = false;
+  std::atomic<float> last_output = 0;
+
+  std::thread audio_thread([&] {
+    graph_runner runner(1, 64);
+    while (!done)
+      last_output = runner.run(graph);
+  });
+
+  for (int i = 0; i < 200; ++i) {
+    auto node = graph.add_node(constant_processor(float(i)), 0, 1);
+    graph.add_edge(node, graph.output_node_id());
+    graph.commit();
+    graph.remove_node(node);
+  }
+
+  auto final_node = graph.add_node(constant_processor(0.5f), 0, 1);
+  graph.add_edge(final_node, graph.output_node_id());
+  graph.commit();
+
+  while (last_output != 0.5f)
+    std::this_thread::yield();
+
+  done = true;
+  audio_thread.join();
+  graph.collect_garbage();
+}
@@ -0,0 +1,231 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#include <audio>
+
+// Loopback pairs are the devices of the backend for platforms without a native one.
+#ifdef _LIBSTDAUDIO_HAS_LOOPBACK_DEVICES
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include "catch/catch.hpp"
+#include "test_utilities.h"
+
+using namespace std::experimental;
+using test_utilities::wait_until;
+
+TEST_CASE("Loopback pairs appear in the device lists")
+{
+  int num_list_changes = 0, num_default_output_changes = 0;
+  set_audio_device_list_callback(audio_device_list_event::device_list_changed, [&] { ++num_list_changes; });
+  set_audio_device_list_callback(audio_device_list_event::default_output_device_changed, [&] { ++num_default_output_changes; });
+
+  audio_loopback_config config;
+  config.name = "Bus A";
+  config.num_channels = 4;
+  config.sample_rate = 96'000;
+  config.buffer_size_frames = 128;
+  config.latency_frames = 32;
+  auto first = add_audio_loopback_device_pair(config);
+  REQUIRE(first.has_value());
+
+  config.name = "Bus B";
+  auto second = add_audio_loopback_device_pair(config);
+  REQUIRE(second.has_value());
+
+  CHECK(num_list_changes == 2);
+  CHECK(num_default_output_changes == 1);
+
+  CHECK(first->output.name() == "Bus A output");
+  CHECK(first->input.name() == "Bus A input");
+  CHECK(first->output.is_output());
+  CHECK(first->input.is_input());
+  CHECK(first->output.get_num_output_channels() == 4);
+  CHECK(first->input.get_num_input_channels() == 4);
+  CHECK(first->input.get_num_output_channels() == 0);
+  CHECK(first->input.get_sample_rate() == 96'000);
+  CHECK(first->input.get_buffer_size_frames() == 128);
+  CHECK(first->input.get_input_latency()->total_frames() == 32 + 128);
+  CHECK(first->output.get_output_latency()->total_frames() == 128);
+
+  auto outputs = get_audio_output_device_list();
+  REQUIRE(std::distance(outputs.begin(), outputs.end()) == 2);
+  CHECK(outputs.begin()->device_id() == first->output.device_id());
+  CHECK(std::next(outputs.begin())->device_id() == second->output.device_id());
+
+  auto inputs = get_audio_input_device_list();
+  REQUIRE(std::distance(inputs.begin(), inputs.end()) == 2);
+  CHECK(inputs.begin()->name() == "Bus A input");
+
+  CHECK(get_default_audio_output_device()->device_id() == first->output.device_id());
+  CHECK(get_default_audio_input_device()->device_id() == first->input.device_id());
+
+  REQUIRE(remove_audio_loopback_device_pair(first->input));
+  CHECK_FALSE(remove_audio_loopback_device_pair(first->output));
+  CHECK(num_list_changes == 3);
+  CHECK(num_default_output_changes == 2);
+  CHECK(get_default_audio_output_device()->device_id() == second->output.device_id());
+
+  REQUIRE(remove_audio_loopback_device_pair(second->output));
+  CHECK(get_audio_output_device_list().empty());
+  CHECK_FALSE(get_default_audio_input_device().has_value());
+
+  set_audio_device_list_callback(audio_device_list_event::device_list_changed, [] {});
+  set_audio_device_list_callback(audio_device_list_event::default_output_device_changed, [] {});
+}
+
+TEST_CASE("Loopback pairs deliver the output to the input after the configured latency")
+{
+  constexpr std::size_t latency_frames = 100;
+  constexpr std::size_t num_frames = 64 * 50;
+
+  audio_loopback_config config;
+  config.num_channels = 2;
+  config.buffer_size_frames = 64;
+  config.latency_frames = latency_frames;
+  config.clock = audio_loopback_clock::free_running;
+  auto pair = add_audio_loopback_device_pair(config);
+  REQUIRE(pair.has_value());
+
+  std::size_t frames_rendered = 0;
+  pair->output.connect([&](audio_device&, audio_device_io<float>& io) noexcept {
+    auto& buffer = *io.output_buffer;
+    for (std::size_t frame = 0; frame < buffer.size_frames(); ++frame) {
+      buffer(frame, 0) = float(frames_rendered + frame + 1);
+      buffer(frame, 1) = -float(frames_rendered + frame + 1);
+    }
+    frames_rendered += buffer.size_frames();
+  });
+
+  std::vector<float> received;
+  received.reserve(num_frames + 64);
+  std::atomic<bool> done = false;
+  pair->input.connect([&](audio_device&, audio_device_io<float>& io) noexcept {
+    auto& buffer = *io.input_buffer;
+    for (std::size_t frame = 0; frame < buffer.size_frames() && received.size() < num_frames; ++frame) {
+      received.push_back(buffer(frame, 0));
+      if (buffer(frame, 1) != -buffer(frame, 0))
+        received.back() = -1;
+    }
+    if (received.size() == num_frames)
+      done = true;
+  });
+
+  // Start the input first, so that it sees the very first period the output renders.
+  REQUIRE(pair->input.start());
+  REQUIRE(pair->output.start());
+  REQUIRE(wait_until([&] { return done.load(); }));
+  REQUIRE(pair->output.stop());
+  REQUIRE(pair->input.stop());
+
+  for (std::size_t frame = 0; frame < num_frames; ++frame) {
+    const float expected = frame < latency_frames ? 0.0f : float(frame - latency_frames + 1);
+    REQUIRE(received[frame] == expected);
+  }
+
+  remove_audio_loopback_device_pair(pair->output);
+}
+
+TEST_CASE("Loopback pairs run at the configured clock speed")
+{
+  audio_loopback_config config;
+  config.num_channels = 1;
+  config.sample_rate = 48'000;
+  config.buffer_size_frames = 240;
+  config.clock_ratio = 1.05;
+  auto pair = add_audio_loopback_device_pair(config);
+  REQUIRE(pair.has_value());
+
+  std::atomic<std::size_t> num_periods = 0;
+  std::atomic<bool> had_time = true;
+  pair->input.connect([&](audio_device&, audio_device_io<float>& io) noexcept {
+    if (!io.input_time.has_value() || io.output_buffer.has_value())
+      had_time = false;
+    ++num_periods;
+  });
+
+  // The estimator starts counting afresh after a late period, so wait for it rather
+  // than for the callbacks.
+  audio_clock_estimate estimate;
+  const auto start = std::chrono::steady_clock::now();
+  REQUIRE(pair->input.start());
+  REQUIRE(wait_until([&] { return (estimate = pair->input.get_clock_estimate()).num_periods >= 100; }));
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  REQUIRE(pair->input.stop());
+  CHECK(had_time);
+  CHECK(num_periods >= 100);
+
+  // 100 periods of 5 ms at 5% over speed take about 476 ms.
+  CHECK(elapsed.count() > 0.4);
+
+  CHECK(estimate.rate_ratio == Approx(1.05).epsilon(0.01));
+
+  remove_audio_loopback_device_pair(pair->input);
+}
+
+TEST_CASE("Only one device per side of a loopback pair can run")
+{
+  auto pair = add_audio_loopback_device_pair();
+  REQUIRE(pair.has_value());
+
+  auto output = get_default_audio_output_device();
+  REQUIRE(output.has_value());
+  REQUIRE(output->device_id() == pair->output.device_id());
+
+  int num_starts = 0, num_stops = 0;
+  REQUIRE(pair->output.start([&](audio_device&) { ++num_starts; }, [&](audio_device&) { ++num_stops; }));
+  CHECK(num_starts == 1);
+  CHECK_FALSE(output->start());
+  CHECK(pair->input.start());
+
+  REQUIRE(pair->output.stop());
+  CHECK(num_stops == 1);
+  CHECK(output->start());
+  CHECK(output->stop());
+
+  // Devices of a removed pair stay valid, but can no longer run.
+  REQUIRE(remove_audio_loopback_device_pair(pair->output));
+  CHECK_FALSE(pair->output.start());
+  CHECK(pair->input.is_running());
+  CHECK(pair->input.stop());
+}
+
+TEST_CASE("Loopback pairs can be aggregated into a duplex device")
+{
+  audio_loopback_config config;
+  config.num_channels = 2;
+  config.buffer_size_frames = 128;
+  auto pair = add_audio_loopback_device_pair(config);
+  REQUIRE(pair.has_value());
+
+  audio_aggregate_device<float> aggregate({&pair->output, &pair->input}, 0);
+  REQUIRE(aggregate.get_num_input_channels() == 2);
+  REQUIRE(aggregate.get_num_output_channels() == 2);
+
+  std::atomic<std::size_t> num_periods = 0;
+  std::atomic<float> last_input = 0;
+  aggregate.connect([&](audio_aggregate_device<float>&, audio_device_io<float>& io) noexcept {
+    for (std::size_t frame = 0; frame < io.output_buffer->size_frames(); ++frame) {
+      io.output_buffer->operator()(frame, 0) = 0.5f;
+      io.output_buffer->operator()(frame, 1) = 0.5f;
+    }
+
+    if (io.input_buffer.has_value())
+      last_input = io.input_buffer->operator()(io.input_buffer->size_frames() - 1, 0);
+
+    ++num_periods;
+  });
+
+  REQUIRE(aggregate.start());
+  REQUIRE(wait_until([&] { return num_periods >= 100; }));
+  REQUIRE(aggregate.stop());
+
+  // What the aggregate rendered comes back through its own input.
+  CHECK(last_input.load() == Approx(0.5f).epsilon(0.01));
+  remove_audio_loopback_device_pair(pair->output);
+}
+
+#endif
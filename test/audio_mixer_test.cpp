@@ -0,0 +1,233 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#include <audio>
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <vector>
+#include "catch/catch.hpp"
+
+using namespace std::experimental;
+
+namespace {
+  auto constant_source(float value) {
+    return [value](audio_buffer<float>& buffer) noexcept {
+      for (std::size_t channel = 0; channel < buffer.size_channels(); ++channel)
+        for (std::size_t frame = 0; frame < buffer.size_frames(); ++frame)
+          buffer(frame, channel) = value * float(channel + 1);
+    };
+  }
+
+  // Processes enough blocks for gain ramps to settle and returns the last frame.
+  std::vector<float> process_and_get_last_frame(audio_mixer<float>& mixer, std::size_t num_frames = 64) {
+    std::vector<float> data(num_frames * mixer.num_output_channels());
+    audio_buffer<float> output(data.data(), num_frames, mixer.num_output_channels(), contiguous_interleaved);
+    mixer.process(output);
+    mixer.process(output);
+
+    return {data.end() - std::ptrdiff_t(mixer.num_output_channels()), data.end()};
+  }
+}
+
+TEST_CASE("Mixer sums its sources with their gains")
+{
+  audio_mixer<float> mixer(2, 8, 128);
+  mixer.add_source(constant_source(0.25f), 2);
+  mixer.add_source(constant_source(0.5f), 2, 0.5f);
+  CHECK(mixer.num_sources() == 2);
+
+  auto frame = process_and_get_last_frame(mixer);
+  CHECK(frame[0] == Approx(0.25f + 0.25f));
+  CHECK(frame[1] == Approx(0.5f + 0.5f));
+}
+
+TEST_CASE("Mixer pans mono sources with constant power")
+{
+  audio_mixer<float> mixer(2, 4);
+  auto id = mixer.add_source(constant_source(1.0f));
+
+  auto centre = process_and_get_last_frame(mixer);
+  CHECK(centre[0] == Approx(std::sqrt(0.5f)));
+  CHECK(centre[1] == Approx(std::sqrt(0.5f)));
+
+  CHECK(mixer.set_pan(id, -1.0f));
+  auto left = process_and_get_last_frame(mixer);
+  CHECK(left[0] == Approx(1.0f));
+  CHECK(left[1] == Approx(0.0f).margin(1e-6));
+
+  CHECK(mixer.set_pan(id, 1.0f));
+  auto right = process_and_get_last_frame(mixer);
+  CHECK(right[0] == Approx(0.0f).margin(1e-6));
+  CHECK(right[1] == Approx(1.0f));
+}
+
+TEST_CASE("Mixer balances stereo sources")
+{
+  audio_mixer<float> mixer(2, 4);
+  auto id = mixer.add_source(constant_source(1.0f), 2, 1.0f, 0.5f);
+
+  auto frame = process_and_get_last_frame(mixer);
+  CHECK(frame[0] == Approx(0.5f));
+  CHECK(frame[1] == Approx(2.0f));
+
+  CHECK(mixer.set_pan(id, 0.0f));
+  frame = process_and_get_last_frame(mixer);
+  CHECK(frame[0] == Approx(1.0f));
+  CHECK(frame[1] == Approx(2.0f));
+}
+
+TEST_CASE("Mixer ramps gain changes over one block")
+{
+  audio_mixer<float> mixer(1, 1, 100);
+  auto id = mixer.add_source(constant_source(1.0f));
+
+  std::vector<float> data(100);
+  audio_buffer<float> output(data.data(), 100, 1, contiguous_interleaved);
+  mixer.process(output);
+  CHECK(data.front() == Approx(1.0f));
+
+  mixer.set_gain(id, 0.0f);
+  mixer.process(output);
+  CHECK(data.front() == Approx(1.0f));
+  CHECK(data[50] == Approx(0.5f));
+  for (std::size_t i = 1; i < data.size(); ++i)
+    CHECK(data[i] < data[i - 1]);
+
+  mixer.process(output);
+  CHECK(data.back() == 0.0f);
+}
+
+TEST_CASE("Mixer splits outputs larger than its block size")
+{
+  audio_mixer<float> mixer(2, 1, 32);
+  mixer.add_source(constant_source(0.5f), 2);
+
+  std::vector<float> data(2 * 100, -1.0f);
+  audio_buffer<float> output(data.data(), 100, 2, contiguous_deinterleaved);
+  mixer.process(output);
+
+  for (std::size_t frame = 0; frame < 100; ++frame) {
+    CHECK(output(frame, 0) == Approx(0.5f));
+    CHECK(output(frame, 1) == Approx(1.0f));
+  }
+}
+
+TEST_CASE("Removed mixer sources are released after the next block")
+{
+  audio_mixer<float> mixer(2, 2);
+  auto counter = std::make_shared<int>(0);
+  auto id = mixer.add_source([counter](audio_buffer<float>& buffer) noexcept {
+    ++*counter;
+    for (std::size_t frame = 0; frame < buffer.size_frames(); ++frame)
+      buffer(frame, 0) = 1.0f;
+  });
+
+  process_and_get_last_frame(mixer);
+  CHECK(*counter == 2);
+  CHECK(counter.use_count() == 2);
+
+  CHECK(mixer.remove_source(id));
+  CHECK_FALSE(mixer.remove_source(id));
+  CHECK(mixer.num_sources() == 0);
+  CHECK(mixer.collect_garbage() == 0);
+
+  auto frame = process_and_get_last_frame(mixer);
+  CHECK(frame[0] == 0.0f);
+  CHECK(*counter == 2);
+
+  CHECK(mixer.collect_garbage() == 1);
+  CHECK(counter.use_count() == 1);
+
+  // The slot is reused, but the old id stays invalid.
+  auto new_id = mixer.add_source(constant_source(1.0f));
+  CHECK(new_id != id);
+  CHECK_FALSE(mixer.set_gain(id, 0.5f));
+  CHECK(mixer.set_gain(new_id, 0.5f));
+}
+
+TEST_CASE("Stale mixer source ids do not reach the next source in their slot")
+{
+  audio_mixer<float> mixer(2, 1);
+  auto old_id = mixer.add_source(constant_source(1.0f));
+  CHECK(mixer.remove_source(old_id));
+  process_and_get_last_frame(mixer);
+
+  auto new_id = mixer.add_source(constant_source(1.0f));
+  REQUIRE(new_id != audio_mixer<float>::invalid_source_id);
+  CHECK_FALSE(mixer.remove_source(old_id));
+  CHECK_FALSE(mixer.set_gain(old_id, 0.0f));
+  CHECK_FALSE(mixer.set_pan(old_id, 1.0f));
+  CHECK(mixer.num_sources() == 1);
+
+  auto frame = process_and_get_last_frame(mixer);
+  CHECK(frame[0] == Approx(std::sqrt(0.5f)));
+  CHECK(frame[1] == Approx(std::sqrt(0.5f)));
+}
+
+TEST_CASE("Mixer reports when it is full")
+{
+  audio_mixer<float> mixer(2, 2);
+  CHECK(mixer.add_source(constant_source(1.0f)) != audio_mixer<float>::invalid_source_id);
+  CHECK(mixer.add_source(constant_source(1.0f)) != audio_mixer<float>::invalid_source_id);
+  CHECK(mixer.add_source(constant_source(1.0f)) == audio_mixer<float>::invalid_source_id);
+}
+
+TEST_CASE("Mixer renders groups through the executor")
+{
+  audio_mixer<float> mixer(2, 8, 64, 3);
+  std::vector<std::size_t> executed_tasks;
+  mixer.set_executor([&](std::size_t num_tasks, void (*task)(void*, std::size_t), void* context) {
+    for (std::size_t i = num_tasks; i-- > 0;) {
+      executed_tasks.push_back(i);
+      task(context, i);
+    }
+  });
+
+  mixer.add_source(constant_source(1.0f), 2, 1.0f, 0.0f, 0);
+  mixer.add_source(constant_source(2.0f), 2, 1.0f, 0.0f, 1);
+  mixer.add_source(constant_source(4.0f), 2, 1.0f, 0.0f, 2);
+  mixer.set_group_gain(1, 0.5f);
+  mixer.set_master_gain(0.5f);
+
+  auto frame = process_and_get_last_frame(mixer);
+  CHECK(executed_tasks == std::vector<std::size_t>{2, 1, 0, 2, 1, 0});
+  CHECK(frame[0] == Approx(0.5f * (1.0f + 1.0f + 4.0f)));
+  CHECK(frame[1] == Approx(0.5f * (2.0f + 2.0f + 8.0f)));
+}
+
+TEST_CASE("Mixer sources can be added and removed while it is processing")
+{
+  audio_mixer<float> mixer(2, 16, 64);
+  std::atomic<bool> done = false;
+
+  std::thread audio_thread([&] {
+    std::vector<float> data(2 * 64);
+    audio_buffer<float> output(data.data(), 64, 2, contiguous_interleaved);
+    while (!done)
+      mixer.process(output);
+  });
+
+  std::vector<std::thread> control_threads;
+  for (int t = 0; t < 4; ++t) {
+    control_threads.emplace_back([&] {
+      for (int i = 0; i < 2000; ++i) {
+        auto id = mixer.add_source(constant_source(0.1f));
+        if (id != audio_mixer<float>::invalid_source_id) {
+          mixer.set_gain(id, 0.5f);
+          mixer.remove_source(id);
+        }
+      }
+    });
+  }
+
+  for (auto& thread : control_threads)
+    thread.join();
+
+  done = true;
+  audio_thread.join();
+  mixer.collect_garbage();
+  CHECK(mixer.num_sources() == 0);
+}
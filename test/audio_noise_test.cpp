@@ -0,0 +1,187 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#include <audio>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "catch/catch.hpp"
+
+using namespace std::experimental;
+
+namespace {
+  std::vector<float> render(audio_noise_generator& generator, std::size_t num_samples,
+                            std::size_t block_size = 256, std::size_t channel = 0) {
+    std::vector<float> output(num_samples);
+    for (std::size_t i = 0; i < num_samples; i += block_size)
+      generator.render(output.data() + i, std::min(block_size, num_samples - i), channel);
+
+    return output;
+  }
+
+  double mean(const std::vector<float>& x) {
+    double sum = 0;
+    for (auto sample : x)
+      sum += sample;
+
+    return sum / double(x.size());
+  }
+
+  double rms(const std::vector<float>& x) {
+    double sum = 0;
+    for (auto sample : x)
+      sum += double(sample) * sample;
+
+    return std::sqrt(sum / double(x.size()));
+  }
+
+  double correlation(const std::vector<float>& a, const std::vector<float>& b) {
+    double sum = 0;
+    for (std::size_t i = 0; i < a.size(); ++i)
+      sum += double(a[i]) * b[i];
+
+    return sum / (double(a.size()) * rms(a) * rms(b));
+  }
+
+  // Average power of the signal in frames of 256 samples at DFT bin k.
+  double band_power(const std::vector<float>& x, std::size_t k) {
+    constexpr std::size_t n = 256;
+    constexpr double pi = 3.14159265358979323846;
+    double power = 0;
+
+    for (std::size_t start = 0; start + n <= x.size(); start += n) {
+      double re = 0, im = 0;
+      for (std::size_t i = 0; i < n; ++i) {
+        const double window = 0.5 - 0.5 * std::cos(2 * pi * double(i) / n);
+        re += window * x[start + i] * std::cos(2 * pi * double(k * i) / n);
+        im += window * x[start + i] * std::sin(2 * pi * double(k * i) / n);
+      }
+      power += re * re + im * im;
+    }
+
+    return power;
+  }
+
+  // White noise of channel 0 the slow way, one generator after the other, as the
+  // generator documents it: eight xoshiro128+ generators seeded by splitmix64 and
+  // interleaved sample by sample.
+  std::vector<float> reference_white_noise(std::uint64_t seed, std::size_t num_samples) {
+    constexpr std::size_t num_lanes = 8;
+    std::array<std::array<std::uint32_t, 4>, num_lanes> lanes;
+    std::uint64_t splitmix_state = seed ^ 0x9e37'79b9'7f4a'7c15ull;
+    for (auto& lane : lanes) {
+      for (std::size_t word = 0; word < 4; word += 2) {
+        std::uint64_t z = (splitmix_state += 0x9e37'79b9'7f4a'7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58'476d'1ce4'e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d0'49bb'1331'11ebull;
+        z ^= z >> 31;
+        lane[word] = std::uint32_t(z);
+        lane[word + 1] = std::uint32_t(z >> 32);
+      }
+    }
+
+    std::vector<float> output(num_samples);
+    for (std::size_t i = 0; i < num_samples; ++i) {
+      auto& s = lanes[i % num_lanes];
+      const std::uint32_t bits = ((s[0] + s[3]) >> 9) | 0x3f80'0000u;
+      const std::uint32_t t = s[1] << 9;
+      s[2] ^= s[0];
+      s[3] ^= s[1];
+      s[1] ^= s[2];
+      s[0] ^= s[3];
+      s[2] ^= t;
+      s[3] = (s[3] << 11) | (s[3] >> 21);
+
+      float one_to_two;
+      std::memcpy(&one_to_two, &bits, sizeof(bits));
+      output[i] = 2.0f * one_to_two - 3.0f;
+    }
+
+    return output;
+  }
+}
+
+TEST_CASE("White noise is uniform in [-1, 1)")
+{
+  audio_noise_generator generator;
+  const auto noise = render(generator, 100'000);
+
+  for (auto sample : noise) {
+    REQUIRE(sample >= -1.0f);
+    REQUIRE(sample < 1.0f);
+  }
+
+  CHECK(std::abs(mean(noise)) < 0.01);
+  CHECK(rms(noise) == Approx(1 / std::sqrt(3.0)).epsilon(0.01));
+}
+
+TEST_CASE("Noise is reproducible and independent of block sizes")
+{
+  for (auto color : {audio_noise_color::white, audio_noise_color::pink, audio_noise_color::brown}) {
+    audio_noise_generator a(color, 1, 42), b(color, 1, 42), c(color, 1, 43);
+
+    const auto whole = render(a, 1'000, 1'000);
+    const auto pieces = render(b, 1'000, 3);
+    CHECK(whole == pieces);
+    CHECK(whole != render(c, 1'000));
+
+    a.seed(42);
+    CHECK(render(a, 1'000, 17) == whole);
+  }
+}
+
+TEST_CASE("Noise does not depend on the SIMD width")
+{
+  audio_noise_generator generator(audio_noise_color::white, 1, 42);
+  CHECK(render(generator, 1'003, 5) == reference_white_noise(42, 1'003));
+}
+
+TEST_CASE("Noise channels are uncorrelated")
+{
+  audio_noise_generator generator(audio_noise_color::white, 2);
+
+  std::vector<float> data(2 * 10'000);
+  audio_buffer<float> buffer(data.data(), 10'000, 2, contiguous_interleaved);
+  generator.process(buffer);
+
+  std::vector<float> left(10'000), right(10'000);
+  for (std::size_t frame = 0; frame < 10'000; ++frame) {
+    left[frame] = buffer(frame, 0);
+    right[frame] = buffer(frame, 1);
+  }
+
+  CHECK(std::abs(correlation(left, right)) < 0.05);
+
+  // Nor are neighbouring samples, which come from different SIMD lanes.
+  std::vector<float> shifted(left.begin() + 1, left.end());
+  left.pop_back();
+  CHECK(std::abs(correlation(left, shifted)) < 0.05);
+}
+
+TEST_CASE("Pink and brown noise fall off with frequency")
+{
+  // Power at bins 4 and 64, four octaves apart.
+  SECTION("white") {
+    audio_noise_generator generator(audio_noise_color::white);
+    const auto noise = render(generator, 256 * 400);
+    CHECK(band_power(noise, 4) / band_power(noise, 64) == Approx(1.0).epsilon(0.3));
+  }
+
+  SECTION("pink") {
+    audio_noise_generator generator(audio_noise_color::pink);
+    const auto noise = render(generator, 256 * 400);
+    CHECK(band_power(noise, 4) / band_power(noise, 64) == Approx(16.0).epsilon(0.3));
+    CHECK(rms(noise) < 1.0);
+  }
+
+  SECTION("brown") {
+    audio_noise_generator generator(audio_noise_color::brown);
+    const auto noise = render(generator, 256 * 400);
+    CHECK(band_power(noise, 4) / band_power(noise, 64) > 100.0);
+    CHECK(rms(noise) < 1.0);
+  }
+}
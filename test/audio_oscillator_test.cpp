@@ -0,0 +1,158 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#include <audio>
+#include <cmath>
+#include <vector>
+#include "catch/catch.hpp"
+
+using namespace std::experimental;
+
+namespace {
+  constexpr double pi = 3.14159265358979323846;
+
+  std::vector<float> render(audio_oscillator& oscillator, std::size_t num_frames, std::size_t block_size = 64) {
+    std::vector<float> output(num_frames);
+    for (std::size_t frame = 0; frame < num_frames; frame += block_size)
+      oscillator.render(output.data() + frame, std::min(block_size, num_frames - frame));
+
+    return output;
+  }
+
+  // Magnitude of the given frequency in the signal, normalised so that a sine of
+  // amplitude 1 gives 1.
+  double magnitude_at(const std::vector<float>& signal, double frequency, double sample_rate) {
+    double re = 0, im = 0;
+    for (std::size_t n = 0; n < signal.size(); ++n) {
+      const double w = 2 * pi * frequency * double(n) / sample_rate;
+      re += signal[n] * std::cos(w);
+      im += signal[n] * std::sin(w);
+    }
+
+    return 2 * std::sqrt(re * re + im * im) / double(signal.size());
+  }
+}
+
+TEST_CASE("Sine oscillator matches std::sin")
+{
+  audio_oscillator oscillator(48'000, audio_waveform::sine, 1'000);
+  const auto output = render(oscillator, 4'800, 37);
+
+  double max_error = 0;
+  for (std::size_t n = 0; n < output.size(); ++n)
+    max_error = std::max(max_error, std::abs(output[n] - std::sin(2 * pi * 1'000 * double(n) / 48'000)));
+
+  CHECK(max_error < 1e-4);
+}
+
+TEST_CASE("Oscillator phase continues across blocks of any size")
+{
+  audio_oscillator a(44'100, audio_waveform::sine, 441);
+  audio_oscillator b(44'100, audio_waveform::sine, 441);
+
+  const auto whole = render(a, 1'000, 1'000);
+  const auto pieces = render(b, 1'000, 7);
+
+  for (std::size_t n = 0; n < whole.size(); ++n)
+    CHECK(whole[n] == Approx(pieces[n]).margin(1e-4));
+}
+
+TEST_CASE("Saw and square oscillators have the expected harmonics")
+{
+  const double sample_rate = 48'000;
+  const double frequency = 1'000;
+
+  SECTION("saw") {
+    audio_oscillator oscillator(sample_rate, audio_waveform::saw, frequency);
+    const auto output = render(oscillator, 4'800);
+    CHECK(magnitude_at(output, frequency, sample_rate) == Approx(2 / pi).epsilon(0.01));
+    CHECK(magnitude_at(output, 2 * frequency, sample_rate) == Approx(1 / pi).epsilon(0.02));
+  }
+
+  SECTION("square") {
+    audio_oscillator oscillator(sample_rate, audio_waveform::square, frequency);
+    const auto output = render(oscillator, 4'800);
+    CHECK(magnitude_at(output, frequency, sample_rate) == Approx(4 / pi).epsilon(0.01));
+    CHECK(magnitude_at(output, 2 * frequency, sample_rate) < 0.01);
+    CHECK(magnitude_at(output, 3 * frequency, sample_rate) == Approx(4 / (3 * pi)).epsilon(0.02));
+  }
+}
+
+TEST_CASE("PolyBLEP reduces aliasing of the saw oscillator")
+{
+  // At 5 kHz, the 5th harmonic (25 kHz) folds back to 23 kHz.
+  const double sample_rate = 48'000;
+  audio_oscillator oscillator(sample_rate, audio_waveform::saw, 5'000);
+  const auto output = render(oscillator, 4'800);
+
+  std::vector<float> naive(output.size());
+  for (std::size_t n = 0; n < naive.size(); ++n) {
+    const double phase = 5'000 * double(n) / sample_rate;
+    naive[n] = float(2 * (phase - std::floor(phase)) - 1);
+  }
+
+  CHECK(magnitude_at(output, 23'000, sample_rate) < 0.5 * magnitude_at(naive, 23'000, sample_rate));
+}
+
+TEST_CASE("Wavetable oscillator plays back the table")
+{
+  std::vector<float> cycle(256);
+  for (std::size_t n = 0; n < cycle.size(); ++n)
+    cycle[n] = float(std::sin(2 * pi * double(n) / 256) + 0.5 * std::sin(2 * pi * 3 * double(n) / 256));
+
+  audio_wavetable table(cycle.data(), cycle.size());
+  CHECK(table.num_levels() == 8);
+
+  audio_oscillator oscillator(48'000);
+  oscillator.set_waveform(audio_waveform::wavetable, &table);
+  oscillator.set_frequency(375);
+  const auto output = render(oscillator, 4'800);
+
+  CHECK(magnitude_at(output, 375, 48'000) == Approx(1.0).epsilon(0.01));
+  CHECK(magnitude_at(output, 1'125, 48'000) == Approx(0.5).epsilon(0.01));
+}
+
+TEST_CASE("Wavetable drops harmonics above Nyquist")
+{
+  std::vector<float> cycle(256);
+  for (std::size_t n = 0; n < cycle.size(); ++n)
+    cycle[n] = float(std::sin(2 * pi * double(n) / 256) + 0.5 * std::sin(2 * pi * 3 * double(n) / 256));
+
+  audio_wavetable table(cycle.data(), cycle.size());
+
+  // The 3rd harmonic of 10 kHz is above the Nyquist frequency of 48 kHz.
+  audio_oscillator oscillator(48'000);
+  oscillator.set_waveform(audio_waveform::wavetable, &table);
+  oscillator.set_frequency(10'000);
+  const auto output = render(oscillator, 4'800);
+
+  CHECK(magnitude_at(output, 10'000, 48'000) == Approx(1.0).epsilon(0.02));
+  CHECK(magnitude_at(output, 18'000, 48'000) < 0.01);
+}
+
+TEST_CASE("Oscillator bank sums its oscillators into every channel")
+{
+  audio_oscillator_bank bank(3, 48'000);
+  bank.set_frequency(0, 1'000);
+  bank.set_gain(0, 0.5f);
+  bank.set_frequency(1, 3'000);
+  bank.set_gain(1, 0.25f);
+  bank.set_frequency(2, 5'000);
+
+  std::vector<float> data(2 * 480, 1.0f);
+  audio_buffer<float> buffer(data.data(), 480, 2, contiguous_interleaved);
+  bank.process(buffer);
+
+  std::vector<float> left(480), right(480);
+  for (std::size_t frame = 0; frame < 480; ++frame) {
+    left[frame] = buffer(frame, 0);
+    right[frame] = buffer(frame, 1);
+  }
+
+  CHECK(left == right);
+  CHECK(magnitude_at(left, 1'000, 48'000) == Approx(0.5).epsilon(0.01));
+  CHECK(magnitude_at(left, 3'000, 48'000) == Approx(0.25).epsilon(0.01));
+  CHECK(magnitude_at(left, 5'000, 48'000) < 0.01);
+}
@@ -0,0 +1,166 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#define LIBSTDAUDIO_REALTIME_SANITIZER_IMPLEMENTATION
+#include <audio>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "catch/catch.hpp"
+
+using namespace std::experimental;
+
+namespace {
+  int num_violations = 0;
+  const char* last_violation = nullptr;
+
+  void count_violation(const char* function_name) {
+    ++num_violations;
+    last_violation = function_name;
+  }
+
+  struct counting_handler {
+    counting_handler() : previous(set_audio_realtime_violation_handler(&count_violation)) {
+      num_violations = 0;
+      last_violation = nullptr;
+    }
+
+    ~counting_handler() {
+      set_audio_realtime_violation_handler(previous);
+    }
+
+    audio_realtime_violation_handler previous;
+  };
+
+  // Keeps the compiler from eliding allocations in the tests.
+  void* volatile sink = nullptr;
+}
+
+TEST_CASE("Realtime checks only report inside a realtime scope")
+{
+  counting_handler handler;
+
+  audio_realtime_check("outside");
+  CHECK(num_violations == 0);
+  CHECK_FALSE(audio_realtime_scope::is_active());
+
+  {
+    audio_realtime_scope realtime;
+    CHECK(audio_realtime_scope::is_active());
+    audio_realtime_check("inside");
+  }
+
+  CHECK(num_violations == 1);
+  CHECK(std::strcmp(last_violation, "inside") == 0);
+  CHECK_FALSE(audio_realtime_scope::is_active());
+}
+
+TEST_CASE("Realtime scopes nest")
+{
+  counting_handler handler;
+
+  {
+    audio_realtime_scope outer;
+    {
+      audio_realtime_scope inner;
+    }
+
+    audio_realtime_check("after inner scope");
+  }
+
+  CHECK(num_violations == 1);
+}
+
+TEST_CASE("Realtime checks can be suspended")
+{
+  counting_handler handler;
+
+  audio_realtime_scope realtime;
+  {
+    audio_realtime_checks_suspended suspended;
+    audio_realtime_check("suspended");
+  }
+
+  CHECK(num_violations == 0);
+}
+
+TEST_CASE("Realtime checks are per thread")
+{
+  counting_handler handler;
+  std::atomic<bool> main_thread_is_realtime = false;
+
+  std::thread other([&] {
+    while (!main_thread_is_realtime)
+      std::this_thread::yield();
+
+    audio_realtime_check("other thread");
+  });
+
+  {
+    audio_realtime_scope realtime;
+    main_thread_is_realtime = true;
+
+    audio_realtime_checks_suspended suspended;
+    other.join();
+  }
+
+  CHECK(num_violations == 0);
+}
+
+#if defined(__linux__)
+TEST_CASE("Locking a mutex inside a realtime scope is reported")
+{
+  counting_handler handler;
+  std::mutex mutex;
+
+  {
+    audio_realtime_scope realtime;
+    std::lock_guard<std::mutex> lock(mutex);
+  }
+
+  CHECK(num_violations == 1);
+  CHECK(std::strcmp(last_violation, "pthread_mutex_lock") == 0);
+}
+
+#if !defined(_LIBSTDAUDIO_SANITIZER_RUNTIME_OWNS_MALLOC)
+TEST_CASE("Allocating inside a realtime scope is reported")
+{
+  counting_handler handler;
+
+  {
+    audio_realtime_scope realtime;
+    sink = std::malloc(64);
+    std::free(sink);
+  }
+
+  CHECK(num_violations == 2);
+
+  {
+    audio_realtime_scope realtime;
+    auto object = std::make_unique<std::string>(100, 'x');
+    sink = object.get();
+  }
+
+  // The string and its buffer are each allocated and freed.
+  CHECK(num_violations == 6);
+}
+
+TEST_CASE("Allocating outside a realtime scope is not reported")
+{
+  counting_handler handler;
+
+  sink = std::malloc(64);
+  std::free(sink);
+  auto object = std::make_unique<std::string>(100, 'x');
+  sink = object.get();
+
+  CHECK(num_violations == 0);
+}
+#endif
+#endif
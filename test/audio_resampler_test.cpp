@@ -0,0 +1,175 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#include <audio>
+#include <cmath>
+#include <random>
+#include <vector>
+#include "catch/catch.hpp"
+
+using namespace std::experimental;
+
+namespace {
+  constexpr double pi = 3.14159265358979323846;
+
+  std::vector<float> make_sine(double frequency_hz, double sample_rate, std::size_t num_frames) {
+    std::vector<float> result(num_frames);
+    for (std::size_t i = 0; i < num_frames; ++i)
+      result[i] = float(std::sin(2.0 * pi * frequency_hz * double(i) / sample_rate));
+
+    return result;
+  }
+
+  std::vector<float> resample_mono(audio_resampler<float>& resampler, std::vector<float> input, std::size_t max_output_frames) {
+    std::vector<float> output(max_output_frames);
+    audio_buffer<float> in(input.data(), input.size(), 1, contiguous_interleaved);
+    audio_buffer<float> out(output.data(), output.size(), 1, contiguous_interleaved);
+
+    auto result = resampler.process(in, out);
+    output.resize(result.output_frames);
+    return output;
+  }
+
+  // Output frame m of a resampler corresponds to input time m / ratio - latency.
+  double max_error_against_ideal_sine(const std::vector<float>& output, double frequency_hz, double input_rate,
+                                      double ratio, double latency_frames, std::size_t skip_frames) {
+    double max_error = 0;
+    for (std::size_t m = skip_frames; m < output.size(); ++m) {
+      const double input_time = double(m) / ratio - latency_frames;
+      const double expected = std::sin(2.0 * pi * frequency_hz * input_time / input_rate);
+      max_error = std::max(max_error, std::abs(double(output[m]) - expected));
+    }
+
+    return max_error;
+  }
+}
+
+TEST_CASE("Fixed-ratio resampling between common sample rates reproduces a sine")
+{
+  const std::pair<double, double> rates[] = {
+    {44'100, 48'000}, {48'000, 44'100}, {48'000, 96'000}, {96'000, 48'000}, {44'100, 96'000}, {96'000, 44'100}
+  };
+
+  for (auto [input_rate, output_rate] : rates) {
+    audio_resampler<float> resampler(input_rate, output_rate, 1, audio_resampler_quality::high);
+    auto output = resample_mono(resampler, make_sine(1000, input_rate, 20'000), 50'000);
+
+    const double ratio = output_rate / input_rate;
+    CHECK(std::abs(double(output.size()) - 20'000 * ratio) <= 1.0);
+    CHECK(max_error_against_ideal_sine(output, 1000, input_rate, ratio, double(resampler.latency_frames()), 200) < 1e-3);
+  }
+}
+
+TEST_CASE("Resampling quality improves with the quality preset")
+{
+  double previous_error = 1.0;
+  for (auto quality : {audio_resampler_quality::low, audio_resampler_quality::medium, audio_resampler_quality::high}) {
+    audio_resampler<float> resampler(44'100, 48'000, 1, quality);
+    auto output = resample_mono(resampler, make_sine(10'000, 44'100, 10'000), 20'000);
+    auto error = max_error_against_ideal_sine(output, 10'000, 44'100, 48'000.0 / 44'100.0, double(resampler.latency_frames()), 200);
+
+    CHECK(error < previous_error);
+    previous_error = error;
+  }
+}
+
+TEST_CASE("Variable-ratio resampling follows the requested ratio")
+{
+  const double ratio = 1.0007;
+  audio_resampler<float> resampler(48'000, 48'000, 1, audio_resampler_quality::medium, audio_resampler_mode::variable_ratio);
+  resampler.set_ratio(ratio);
+  CHECK(resampler.get_ratio() == ratio);
+
+  auto output = resample_mono(resampler, make_sine(1000, 48'000, 20'000), 30'000);
+  CHECK(std::abs(double(output.size()) - 20'000 * ratio) <= 1.0);
+  CHECK(max_error_against_ideal_sine(output, 1000, 48'000, ratio, double(resampler.latency_frames()), 100) < 1e-3);
+}
+
+TEST_CASE("Resampler output does not depend on how the stream is split into blocks")
+{
+  for (auto mode : {audio_resampler_mode::fixed_ratio, audio_resampler_mode::variable_ratio}) {
+    const std::size_t num_channels = 2;
+    const std::size_t num_frames = 5000;
+    std::vector<float> input(num_frames * num_channels);
+    std::minstd_rand gen(3);
+    std::uniform_real_distribution<float> noise(-1.0f, 1.0f);
+    for (auto& sample : input)
+      sample = noise(gen);
+
+    audio_resampler<float> reference_resampler(48'000, 44'100, num_channels, audio_resampler_quality::low, mode);
+    std::vector<float> reference(num_frames * num_channels);
+    audio_buffer<float> reference_in(input.data(), num_frames, num_channels, contiguous_interleaved);
+    audio_buffer<float> reference_out(reference.data(), num_frames, num_channels, contiguous_interleaved);
+    auto reference_result = reference_resampler.process(reference_in, reference_out);
+    REQUIRE(reference_result.input_frames == num_frames);
+
+    audio_resampler<float> resampler(48'000, 44'100, num_channels, audio_resampler_quality::low, mode);
+    std::vector<float> output(num_frames * num_channels);
+    std::uniform_int_distribution<std::size_t> block_sizes(0, 97);
+    std::size_t input_pos = 0, output_pos = 0;
+
+    while (output_pos < reference_result.output_frames) {
+      auto input_frames = std::min(block_sizes(gen), num_frames - input_pos);
+      auto output_frames = std::min(block_sizes(gen), reference_result.output_frames - output_pos);
+
+      audio_buffer<float> in(input.data() + input_pos * num_channels, input_frames, num_channels, contiguous_interleaved);
+      audio_buffer<float> out(output.data() + output_pos * num_channels, output_frames, num_channels, contiguous_interleaved);
+      auto result = resampler.process(in, out);
+
+      CHECK(result.input_frames <= input_frames);
+      CHECK(result.output_frames <= output_frames);
+      input_pos += result.input_frames;
+      output_pos += result.output_frames;
+    }
+
+    output.resize(reference_result.output_frames * num_channels);
+    reference.resize(reference_result.output_frames * num_channels);
+    CHECK(output == reference);
+  }
+}
+
+TEST_CASE("Resampler processes channels independently")
+{
+  std::vector<float> input(2 * 1000);
+  for (std::size_t i = 0; i < 1000; ++i) {
+    input[2 * i] = 1.0f;
+    input[2 * i + 1] = 0.0f;
+  }
+
+  std::vector<float> output(2 * 2000);
+  audio_resampler<float> resampler(48'000, 96'000, 2);
+  audio_buffer<float> in(input.data(), 1000, 2, contiguous_interleaved);
+  audio_buffer<float> out(output.data(), 2000, 2, contiguous_deinterleaved);
+  auto result = resampler.process(in, out);
+  REQUIRE(result.output_frames == 2000);
+
+  for (std::size_t frame = 100; frame < 1900; ++frame) {
+    CHECK(out(frame, 0) == Approx(1.0f).margin(1e-4));
+    CHECK(out(frame, 1) == 0.0f);
+  }
+}
+
+TEST_CASE("Resampler reset clears the filter history")
+{
+  audio_resampler<float> resampler(44'100, 48'000, 1);
+  auto first = resample_mono(resampler, make_sine(440, 44'100, 1000), 2000);
+
+  resampler.reset();
+  auto second = resample_mono(resampler, make_sine(440, 44'100, 1000), 2000);
+  CHECK(first == second);
+}
+
+TEST_CASE("Double precision resampling")
+{
+  std::vector<double> input(1000, 0.5), output(1000);
+  audio_resampler<double> resampler(48'000, 48'000, 1);
+  audio_buffer<double> in(input.data(), input.size(), 1, contiguous_interleaved);
+  audio_buffer<double> out(output.data(), output.size(), 1, contiguous_interleaved);
+
+  auto result = resampler.process(in, out);
+  CHECK(result.input_frames == 1000);
+  CHECK(result.output_frames == 1000);
+  CHECK(output.back() == Approx(0.5));
+}
@@ -0,0 +1,288 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#include <audio>
+
+#if defined(__linux__)
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "catch/catch.hpp"
+#include "test_utilities.h"
+
+using namespace std::experimental;
+using test_utilities::wait_until;
+
+namespace {
+  float test_sample(std::size_t frame, std::size_t channel) {
+    return float(frame) + 0.25f * float(channel);
+  }
+
+  void fill_period(audio_buffer<float>& buffer, std::size_t first_frame) {
+    for (std::size_t frame = 0; frame < buffer.size_frames(); ++frame)
+      for (std::size_t channel = 0; channel < buffer.size_channels(); ++channel)
+        buffer(frame, channel) = test_sample(first_frame + frame, channel);
+  }
+}
+
+TEST_CASE("Both sides of a shared memory device look like ordinary devices")
+{
+  auto producer = create_audio_shared_memory_device(audio_shared_memory_role::producer, "bus", 2, 48'000, 128, 4);
+  REQUIRE(producer.has_value());
+  auto consumer = open_audio_shared_memory_device(producer->native_handle(), audio_shared_memory_role::consumer);
+  REQUIRE(consumer.has_value());
+
+  CHECK(producer->name() == "bus");
+  CHECK(consumer->name() == "bus");
+  CHECK(producer->device_id() == consumer->device_id());
+
+  CHECK(producer->is_output());
+  CHECK_FALSE(producer->is_input());
+  CHECK(producer->get_num_output_channels() == 2);
+  CHECK(producer->get_num_input_channels() == 0);
+  CHECK(consumer->is_input());
+  CHECK(consumer->get_num_input_channels() == 2);
+  CHECK(consumer->get_num_output_channels() == 0);
+
+  CHECK(consumer->get_sample_rate() == 48'000);
+  CHECK(consumer->get_buffer_size_frames() == 128);
+  CHECK(consumer->get_num_periods() == 4);
+  CHECK_FALSE(consumer->set_sample_rate(44'100));
+  CHECK(consumer->set_buffer_size_frames(128));
+  CHECK(consumer->supports_sample_type<float>());
+  CHECK_FALSE(consumer->supports_sample_type<int>());
+
+  REQUIRE(consumer->get_input_latency().has_value());
+  CHECK(consumer->get_input_latency()->total_frames() == 4 * 128);
+  CHECK_FALSE(consumer->get_output_latency().has_value());
+}
+
+TEST_CASE("Shared memory devices pass periods through the ring")
+{
+  auto producer = create_audio_shared_memory_device(audio_shared_memory_role::producer, "ring", 3, 48'000, 64, 3);
+  REQUIRE(producer.has_value());
+  auto consumer = open_audio_shared_memory_device(producer->native_handle(), audio_shared_memory_role::consumer);
+  REQUIRE(consumer.has_value());
+  REQUIRE(producer->start());
+  REQUIRE(consumer->start());
+
+  // The callbacks run in a realtime scope, so they must not allocate or report failures
+  // themselves; they record them for the checks below instead.
+  std::size_t frames_written = 0;
+  std::vector<audio_clock_t::time_point> output_times;
+  output_times.reserve(32);
+  bool producer_buffers_ok = true;
+  auto produce = [&](audio_shared_memory_device&, audio_device_io<float>& io) noexcept {
+    if (!io.output_buffer.has_value() || io.input_buffer.has_value()) {
+      producer_buffers_ok = false;
+      return;
+    }
+
+    fill_period(*io.output_buffer, frames_written);
+    frames_written += io.output_buffer->size_frames();
+    output_times.push_back(*io.output_time);
+  };
+
+  std::size_t frames_read = 0;
+  std::vector<audio_clock_t::time_point> input_times;
+  input_times.reserve(32);
+  bool consumer_buffers_ok = true, mismatch = false;
+  auto consume = [&](audio_shared_memory_device&, audio_device_io<float>& io) noexcept {
+    if (!io.input_buffer.has_value() || io.output_buffer.has_value()) {
+      consumer_buffers_ok = false;
+      return;
+    }
+
+    auto& buffer = *io.input_buffer;
+    for (std::size_t frame = 0; frame < buffer.size_frames(); ++frame)
+      for (std::size_t channel = 0; channel < 3; ++channel)
+        if (buffer(frame, channel) != test_sample(frames_read + frame, channel))
+          mismatch = true;
+
+    frames_read += buffer.size_frames();
+    input_times.push_back(*io.input_time);
+  };
+
+  CHECK_FALSE(consumer->has_unprocessed_io());
+
+  // The producer can get ahead by the whole ring and no further.
+  for (int i = 0; i < 5; ++i)
+    producer->process(produce);
+  CHECK(frames_written == 3 * 64);
+  CHECK(producer->get_num_queued_periods() == 3);
+  CHECK_FALSE(producer->has_unprocessed_io());
+
+  for (int i = 0; i < 2; ++i) {
+    consumer->wait();
+    consumer->process(consume);
+  }
+  CHECK(frames_read == 2 * 64);
+  CHECK(producer->has_unprocessed_io());
+
+  // Keep going past the end of the ring.
+  for (int i = 0; i < 20; ++i) {
+    producer->wait();
+    producer->process(produce);
+    consumer->wait();
+    consumer->process(consume);
+  }
+
+  consumer->process(consume);
+  CHECK(frames_read == frames_written);
+  CHECK_FALSE(consumer->has_unprocessed_io());
+  CHECK(producer_buffers_ok);
+  CHECK(consumer_buffers_ok);
+  CHECK_FALSE(mismatch);
+
+  // The consumer sees the time at which the producer rendered each period.
+  CHECK(input_times == output_times);
+}
+
+TEST_CASE("Shared memory devices keep their slots apart when the period counters wrap")
+{
+  auto producer = create_audio_shared_memory_device(audio_shared_memory_role::producer, "wrap", 1, 48'000, 16, 3);
+  REQUIRE(producer.has_value());
+  auto consumer = open_audio_shared_memory_device(producer->native_handle(), audio_shared_memory_role::consumer);
+  REQUIRE(consumer.has_value());
+
+  // Start two periods short of where the counters wrap, 2^32 - 1 for three periods.
+  const std::size_t header_size = sizeof(__audio_shared_memory_header);
+  void* mapping = mmap(nullptr, header_size, PROT_READ | PROT_WRITE, MAP_SHARED, producer->native_handle(), 0);
+  REQUIRE(mapping != MAP_FAILED);
+  auto& header = *static_cast<__audio_shared_memory_header*>(mapping);
+  header.write_count = 0xffff'fffe;
+  header.read_count = 0xffff'fffe;
+  munmap(mapping, header_size);
+
+  std::size_t frames_written = 0;
+  auto produce = [&](audio_shared_memory_device&, audio_device_io<float>& io) noexcept {
+    fill_period(*io.output_buffer, frames_written);
+    frames_written += io.output_buffer->size_frames();
+  };
+
+  std::size_t frames_read = 0;
+  bool mismatch = false;
+  auto consume = [&](audio_shared_memory_device&, audio_device_io<float>& io) noexcept {
+    auto& buffer = *io.input_buffer;
+    for (std::size_t frame = 0; frame < buffer.size_frames(); ++frame)
+      if (buffer(frame, 0) != test_sample(frames_read + frame, 0))
+        mismatch = true;
+
+    frames_read += buffer.size_frames();
+  };
+
+  // Keep the ring full across the wrap, so that a reused slot would overwrite a queued period.
+  for (int i = 0; i < 3; ++i)
+    producer->process(produce);
+
+  for (int i = 0; i < 6; ++i) {
+    consumer->process(consume);
+    producer->process(produce);
+
+    // A reopened side picks up where the ring stands, with nothing but the counters to go by.
+    if (i == 2) {
+      consumer.reset();
+      consumer = open_audio_shared_memory_device(producer->native_handle(), audio_shared_memory_role::consumer);
+      REQUIRE(consumer.has_value());
+    }
+  }
+
+  while (consumer->has_unprocessed_io())
+    consumer->process(consume);
+
+  CHECK(frames_written == 9 * 16);
+  CHECK(frames_read == frames_written);
+  CHECK_FALSE(mismatch);
+}
+
+TEST_CASE("Shared memory devices connect two processes")
+{
+  constexpr std::size_t num_periods = 200;
+  auto consumer = create_audio_shared_memory_device(audio_shared_memory_role::consumer, "pipe", 2, 48'000, 32, 3);
+  REQUIRE(consumer.has_value());
+
+  const pid_t child = fork();
+  REQUIRE(child >= 0);
+
+  if (child == 0) {
+    // Process mode in the producer process, so that nothing but the device runs there.
+    auto producer = open_audio_shared_memory_device(consumer->native_handle(), audio_shared_memory_role::producer);
+    if (!producer || !producer->start())
+      _exit(1);
+
+    std::size_t frames_written = 0;
+    auto produce = [&](audio_shared_memory_device&, audio_device_io<float>& io) noexcept {
+      fill_period(*io.output_buffer, frames_written);
+      frames_written += io.output_buffer->size_frames();
+    };
+
+    for (std::size_t i = 0; i < num_periods; ++i) {
+      producer->wait();
+      producer->process(produce);
+    }
+
+    _exit(0);
+  }
+
+  std::atomic<std::size_t> frames_read = 0;
+  std::atomic<bool> mismatch = false;
+  consumer->connect([&](audio_shared_memory_device&, audio_device_io<float>& io) noexcept {
+    auto& buffer = *io.input_buffer;
+    const std::size_t first = frames_read.load();
+    for (std::size_t frame = 0; frame < buffer.size_frames(); ++frame)
+      if (buffer(frame, 1) != test_sample(first + frame, 1))
+        mismatch = true;
+
+    frames_read = first + buffer.size_frames();
+  });
+  REQUIRE(consumer->start());
+
+  int status = 0;
+  REQUIRE(waitpid(child, &status, 0) == child);
+  REQUIRE(WIFEXITED(status));
+  REQUIRE(WEXITSTATUS(status) == 0);
+
+  CHECK(wait_until([&] { return frames_read >= num_periods * 32; }));
+  REQUIRE(consumer->stop());
+  CHECK(frames_read == num_periods * 32);
+  CHECK_FALSE(mismatch);
+  CHECK(consumer->get_clock_estimate().num_periods > 0);
+}
+
+TEST_CASE("A shared memory device without a peer stops promptly")
+{
+  auto consumer = create_audio_shared_memory_device(audio_shared_memory_role::consumer, "idle", 1, 48'000, 64);
+  REQUIRE(consumer.has_value());
+
+  bool called = false;
+  consumer->connect([&](audio_shared_memory_device&, audio_device_io<float>&) noexcept { called = true; });
+  REQUIRE(consumer->start());
+  CHECK(consumer->is_running());
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  REQUIRE(consumer->stop());
+  CHECK_FALSE(consumer->is_running());
+  CHECK_FALSE(called);
+}
+
+TEST_CASE("Shared memory devices reject invalid regions")
+{
+  CHECK_FALSE(create_audio_shared_memory_device(audio_shared_memory_role::producer, "none", 0, 48'000, 64).has_value());
+  CHECK_FALSE(create_audio_shared_memory_device(audio_shared_memory_role::producer, "one", 2, 48'000, 64, 1).has_value());
+  CHECK_FALSE(open_audio_shared_memory_device(-1, audio_shared_memory_role::consumer).has_value());
+
+  const int fd = memfd_create("not audio", MFD_CLOEXEC);
+  REQUIRE(fd >= 0);
+  std::vector<char> garbage(4096, 'x');
+  REQUIRE(write(fd, garbage.data(), garbage.size()) == ssize_t(garbage.size()));
+  CHECK_FALSE(open_audio_shared_memory_device(fd, audio_shared_memory_role::consumer).has_value());
+  close(fd);
+}
+
+#endif // __linux__
@@ -0,0 +1,98 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#include <audio>
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <vector>
+#include "catch/catch.hpp"
+
+using namespace std::experimental;
+
+namespace {
+  constexpr double pi = 3.14159265358979323846;
+  constexpr double sample_rate = 48'000;
+
+  std::vector<float> make_sine(double frequency, float amplitude, std::size_t num_frames, std::size_t num_channels) {
+    std::vector<float> result(num_frames * num_channels);
+    for (std::size_t frame = 0; frame < num_frames; ++frame)
+      for (std::size_t channel = 0; channel < num_channels; ++channel)
+        result[frame * num_channels + channel] = amplitude * float(std::sin(2 * pi * frequency * double(frame) / sample_rate));
+
+    return result;
+  }
+}
+
+TEST_CASE("Spectrum analyzer reports the amplitude of a sine in its bin")
+{
+  audio_spectrum_analyzer analyzer(1024);
+  REQUIRE(analyzer.num_bins() == 513);
+  REQUIRE(analyzer.hop_size() == 256);
+
+  // Bin 40 is centred on 40 * 48000 / 1024 = 1875 Hz.
+  auto data = make_sine(1875.0, 0.5f, 4096, 2);
+  audio_buffer<float> buffer(data.data(), 4096, 2, contiguous_interleaved);
+  analyzer.process(buffer);
+
+  const auto magnitudes = analyzer.get_magnitudes();
+  REQUIRE(magnitudes.size() == 513);
+  REQUIRE(magnitudes[40] == Approx(0.5).margin(1e-3));
+
+  // The Hann window leaks into the neighbouring bins only.
+  REQUIRE(magnitudes[39] == Approx(0.25).margin(1e-3));
+  REQUIRE(magnitudes[41] == Approx(0.25).margin(1e-3));
+  for (std::size_t k = 0; k < magnitudes.size(); ++k) {
+    if (k < 39 || k > 41)
+      REQUIRE(magnitudes[k] < 1e-4);
+  }
+}
+
+TEST_CASE("Spectrum analyzer publishes a spectrum every hop")
+{
+  audio_spectrum_analyzer analyzer(256, 64);
+
+  // Silence first, so that a new spectrum is recognisable.
+  std::vector<float> silence(256);
+  audio_buffer<float> quiet(silence.data(), 256, 1, contiguous_interleaved);
+  analyzer.process(quiet);
+  REQUIRE(analyzer.get_magnitudes()[8] == 0.0f);
+
+  auto data = make_sine(1500.0, 1.0f, 63, 1);
+  audio_buffer<float> short_buffer(data.data(), 63, 1, contiguous_interleaved);
+  analyzer.process(short_buffer);
+  REQUIRE(analyzer.get_magnitudes()[8] == 0.0f);
+
+  float one_more = 0.0f;
+  audio_buffer<float> single(&one_more, 1, 1, contiguous_interleaved);
+  analyzer.process(single);
+  REQUIRE(analyzer.get_magnitudes()[8] > 0.0f);
+}
+
+TEST_CASE("Spectrum analyzer hands spectra to another thread")
+{
+  audio_spectrum_analyzer analyzer(512, 128);
+  std::atomic<bool> done = false;
+  std::atomic<bool> consistent = true;
+
+  // A constant input gives the same spectrum every time; a torn read would not.
+  std::thread reader([&] {
+    while (!done.load()) {
+      const auto magnitudes = analyzer.get_magnitudes();
+      if (magnitudes[0] != 0.0f && std::abs(magnitudes[0] - 0.25f) > 1e-4f)
+        consistent = false;
+    }
+  });
+
+  std::vector<float> data(100, 0.25f);
+  audio_buffer<float> buffer(data.data(), 100, 1, contiguous_interleaved);
+  for (int i = 0; i < 2'000; ++i)
+    analyzer.process(buffer);
+
+  done = true;
+  reader.join();
+  REQUIRE(consistent);
+  REQUIRE(analyzer.get_magnitudes()[0] == Approx(0.25f).margin(1e-4));
+}
@@ -0,0 +1,150 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#include <audio>
+#include <vector>
+#include "catch/catch.hpp"
+
+// The coroutine interface is only available when compiling as C++20; the test_cxx20
+// target builds these tests that way.
+#ifdef _LIBSTDAUDIO_HAS_COROUTINES
+
+using namespace std::experimental;
+
+namespace {
+  struct period_runner {
+    explicit period_runner(std::size_t num_frames)
+      : data(num_frames, -1.0f) {
+    }
+
+    float run(audio_stream<float>& stream) {
+      audio_device_io<float> io;
+      io.output_buffer = audio_buffer<float>(data.data(), data.size(), 1, contiguous_interleaved);
+      stream.process(io);
+      return data.back();
+    }
+
+    std::vector<float> data;
+  };
+
+  audio_stream_task count_periods(audio_stream_arena&, audio_stream<float>& stream, int num_periods) {
+    for (int i = 1; i <= num_periods; ++i) {
+      auto& io = co_await stream.next_period();
+      auto& out = *io.output_buffer;
+      for (std::size_t frame = 0; frame < out.size_frames(); ++frame)
+        out(frame, 0) = float(i);
+    }
+  }
+
+  audio_stream_task play_value(audio_stream_arena&, audio_stream<float>& stream, float value, int num_periods) {
+    for (int i = 0; i < num_periods; ++i) {
+      auto& io = co_await stream.next_period();
+      (*io.output_buffer)(io.output_buffer->size_frames() - 1, 0) = value;
+    }
+  }
+
+  audio_stream_task sequence(audio_stream_arena& arena, audio_stream<float>& stream) {
+    co_await play_value(arena, stream, 1.0f, 2);
+    co_await play_value(arena, stream, 2.0f, 1);
+    co_await play_value(arena, stream, 3.0f, 2);
+  }
+
+  audio_stream_task repeat(audio_stream_arena& arena, audio_stream<float>& stream, int num_repeats) {
+    for (int i = 0; i < num_repeats; ++i)
+      co_await play_value(arena, stream, float(i % 2), 1);
+  }
+}
+
+TEST_CASE("Audio stream resumes its coroutine once per period")
+{
+  alignas(std::max_align_t) std::byte memory[1024];
+  audio_stream_arena arena(memory, sizeof(memory));
+  audio_stream<float> stream;
+  stream.set_task(count_periods(arena, stream, 3));
+  CHECK(arena.used_bytes() > 0);
+
+  period_runner runner(16);
+  CHECK(runner.run(stream) == 1.0f);
+  CHECK(runner.run(stream) == 2.0f);
+  CHECK_FALSE(stream.is_done());
+
+  // The coroutine returns during the last period; the output is silent from then on.
+  CHECK(runner.run(stream) == 3.0f);
+  CHECK(stream.is_done());
+  CHECK(runner.run(stream) == 0.0f);
+}
+
+TEST_CASE("Audio stream coroutines can await nested tasks")
+{
+  alignas(std::max_align_t) std::byte memory[4096];
+  audio_stream_arena arena(memory, sizeof(memory));
+  audio_stream<float> stream;
+  stream.set_task(sequence(arena, stream));
+
+  period_runner runner(8);
+  std::vector<float> outputs;
+  for (int i = 0; i < 6; ++i)
+    outputs.push_back(runner.run(stream));
+
+  CHECK(outputs == std::vector<float>{1.0f, 1.0f, 2.0f, 3.0f, 3.0f, 0.0f});
+  CHECK(stream.is_done());
+}
+
+TEST_CASE("Audio stream coroutines reuse the memory of finished nested tasks")
+{
+  alignas(std::max_align_t) std::byte memory[4096];
+  audio_stream_arena arena(memory, sizeof(memory));
+  audio_stream<float> stream;
+  stream.set_task(repeat(arena, stream, 10'000));
+
+  period_runner runner(8);
+  runner.run(stream);
+  const std::size_t used_bytes = arena.used_bytes();
+
+  for (int i = 1; i < 10'000; ++i) {
+    REQUIRE(runner.run(stream) == float(i % 2));
+    REQUIRE(arena.used_bytes() <= used_bytes);
+  }
+
+  CHECK(stream.is_done());
+
+  // Once every frame is gone, so is all of the memory.
+  stream.set_task({});
+  CHECK(arena.used_bytes() == 0);
+}
+
+TEST_CASE("Frames freed out of order are reused for frames of the same size")
+{
+  alignas(std::max_align_t) std::byte memory[4096];
+  audio_stream_arena arena(memory, sizeof(memory));
+  audio_stream<float> stream;
+
+  auto first = play_value(arena, stream, 1.0f, 1);
+  auto second = play_value(arena, stream, 2.0f, 1);
+  const std::size_t used_bytes = arena.used_bytes();
+
+  first = {};
+  CHECK(arena.used_bytes() == used_bytes);
+  auto third = play_value(arena, stream, 3.0f, 1);
+  CHECK(arena.used_bytes() == used_bytes);
+
+  second = {};
+  third = {};
+  CHECK(arena.used_bytes() == 0);
+}
+
+TEST_CASE("Audio stream arena reports exhaustion when the coroutine is created")
+{
+  alignas(std::max_align_t) std::byte memory[8];
+  audio_stream_arena arena(memory, sizeof(memory));
+  audio_stream<float> stream;
+
+  auto task = count_periods(arena, stream, 1);
+  CHECK_FALSE(task.valid());
+  CHECK(task.done());
+  CHECK(arena.used_bytes() == 0);
+}
+
+#endif // _LIBSTDAUDIO_HAS_COROUTINES
@@ -0,0 +1,144 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#include <audio>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+#include "catch/catch.hpp"
+
+using namespace std::experimental;
+
+TEST_CASE("Work-stealing deque pops in LIFO and steals in FIFO order")
+{
+  __work_stealing_deque deque(4);
+  CHECK(deque.push(1));
+  CHECK(deque.push(2));
+  CHECK(deque.push(3));
+  CHECK(deque.push(4));
+  CHECK_FALSE(deque.push(5));
+
+  std::uint64_t item = 0;
+  CHECK(deque.steal(item));
+  CHECK(item == 1);
+  CHECK(deque.pop(item));
+  CHECK(item == 4);
+  CHECK(deque.pop(item));
+  CHECK(item == 3);
+  CHECK(deque.steal(item));
+  CHECK(item == 2);
+  CHECK_FALSE(deque.pop(item));
+  CHECK_FALSE(deque.steal(item));
+}
+
+TEST_CASE("Work-stealing deque hands every item to exactly one thread")
+{
+  constexpr std::size_t num_items = 100'000;
+  __work_stealing_deque deque(1024);
+  std::vector<std::atomic<int>> seen(num_items);
+  std::atomic<bool> done = false;
+
+  auto thief = [&] {
+    std::uint64_t item;
+    while (!done)
+      if (deque.steal(item))
+        ++seen[item];
+  };
+
+  std::thread thief1(thief), thief2(thief);
+
+  std::uint64_t item;
+  for (std::size_t i = 0; i < num_items; ++i) {
+    while (!deque.push(i))
+      if (deque.pop(item))
+        ++seen[item];
+
+    if (i % 3 == 0 && deque.pop(item))
+      ++seen[item];
+  }
+
+  while (deque.pop(item))
+    ++seen[item];
+
+  done = true;
+  thief1.join();
+  thief2.join();
+
+  std::size_t num_wrong = 0;
+  for (auto& count : seen)
+    num_wrong += count != 1;
+
+  CHECK(num_wrong == 0);
+}
+
+TEST_CASE("Worker pool runs every task exactly once before returning")
+{
+  for (std::size_t num_workers : {0, 1, 3, 8}) {
+    audio_worker_pool pool(num_workers);
+    CHECK(pool.num_workers() == num_workers);
+
+    for (std::size_t num_tasks : {0, 1, 2, 7, 64, 1000, 3000}) {
+      std::vector<std::atomic<int>> counts(num_tasks);
+      pool.parallel_for(num_tasks, [&](std::size_t i) noexcept { ++counts[i]; });
+
+      std::size_t num_wrong = 0;
+      for (auto& count : counts)
+        num_wrong += count != 1;
+
+      CHECK(num_wrong == 0);
+    }
+  }
+}
+
+TEST_CASE("Worker pool supports nested parallel_for")
+{
+  audio_worker_pool pool(4);
+  std::vector<std::atomic<int>> counts(16 * 16);
+
+  pool.parallel_for(16, [&](std::size_t i) noexcept {
+    pool.parallel_for(16, [&](std::size_t j) noexcept { ++counts[i * 16 + j]; });
+  });
+
+  std::size_t num_wrong = 0;
+  for (auto& count : counts)
+    num_wrong += count != 1;
+
+  CHECK(num_wrong == 0);
+}
+
+TEST_CASE("Worker pool wakes up sleeping workers for a new period")
+{
+  audio_worker_pool pool(2);
+
+  for (int period = 0; period < 3; ++period) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    std::atomic<int> sum = 0;
+    pool.parallel_for(100, [&](std::size_t i) noexcept { sum += int(i); });
+    CHECK(sum == 4950);
+  }
+}
+
+TEST_CASE("Worker pool can be used as a mixer executor")
+{
+  audio_worker_pool pool(3);
+  audio_mixer<float> mixer(2, 64, 128, 4);
+  mixer.set_executor(std::ref(pool));
+
+  for (std::size_t i = 0; i < 64; ++i) {
+    mixer.add_source([](audio_buffer<float>& buffer) noexcept {
+      for (std::size_t frame = 0; frame < buffer.size_frames(); ++frame)
+        buffer(frame, 0) = 0.125f;
+    }, 1, 1.0f, -1.0f, i % 4);
+  }
+
+  std::vector<float> data(2 * 128);
+  audio_buffer<float> output(data.data(), 128, 2, contiguous_interleaved);
+  mixer.process(output);
+
+  CHECK(output(127, 0) == Approx(8.0f));
+  CHECK(output(127, 1) == Approx(0.0f).margin(1e-5));
+}
@@ -0,0 +1,26 @@
+// libstdaudio
+// Copyright (c) 2018 - Timur Doumler
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at http://boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <chrono>
+#include <thread>
+
+namespace test_utilities {
+  // Polls the condition until it holds, or gives up after the timeout. For waiting on
+  // other threads and processes, whose progress the tests cannot otherwise observe.
+  template <typename Condition>
+  bool wait_until(Condition condition, std::chrono::milliseconds timeout = std::chrono::seconds(10)) {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!condition()) {
+      if (std::chrono::steady_clock::now() > deadline)
+        return false;
+
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    return true;
+  }
+}